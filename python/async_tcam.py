@@ -0,0 +1,413 @@
+"""
+  tCam asyncio client
+
+  AsyncTCam communicates with a tCam or tCam-Mini over the network socket interface
+  from an asyncio event loop so many cameras can be managed from one thread.  Each
+  camera uses one reader task that splits received data into responses, matches
+  command responses to the commands that caused them and queues images with a
+  bounded queue.  The connection is reopened with exponential backoff if it fails
+  and a running stream is restarted.
+
+  The camera has no command identifiers.  It processes commands in order and answers
+  each with a response object (for example "config" for get_config) or a "cam_info"
+  acknowledgement naming the command, so a response is matched to the oldest pending
+  command expecting it.  Responses that match no command (alarms, debug messages)
+  are put in the events queue.
+
+  Copyright 2020-2022 Dan Julio
+
+  This file is part of tCam.
+
+  tCam is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  tCam is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+"""
+import json
+import array
+import base64
+import random
+import asyncio
+from collections import deque
+
+try:
+    import frame
+except ImportError:
+    # numpy is only required to decode images
+    frame = None
+
+# cam_info info_value
+INFO_CMD_NACK = 0
+INFO_CMD_ACK = 1
+INFO_CMD_UNIMPL = 2
+INFO_CMD_BAD = 3
+
+# Response object returned by commands that do not answer with a cam_info acknowledgement
+RESPONSE_KEYS = {
+    "get_status": "status",
+    "get_config": "config",
+    "get_wifi": "wifi",
+    "get_lep_cci": "cci_reg",
+    "set_lep_cci": "cci_reg",
+    "get_roi": "roi",
+    "get_roi_stats": "roi_stats",
+    "get_alarm": "alarm_rules",
+    "get_filter": "filter",
+    "get_perf": "perf",
+}
+
+# Frame queue policies when the application does not keep up with the camera
+BACKPRESSURE_DROP = "drop"      # Discard the oldest queued image
+BACKPRESSURE_BLOCK = "block"    # Stop reading so TCP flow control slows the camera
+
+
+class CommandError(Exception):
+    """Raised when the camera rejects a command"""
+
+    def __init__(self, cmd, response):
+        self.cmd = cmd
+        self.response = response
+        super().__init__(f"{cmd}: {response['cam_info']['info_string']}")
+
+
+class _Pending:
+    def __init__(self, name, future):
+        self.name = name
+        self.key = RESPONSE_KEYS.get(name, "cam_info")
+        self.future = future
+
+
+class AsyncTCam:
+    """
+    AsyncTCam - asyncio network client for one camera.  Create it from a running event loop.
+
+        cam = AsyncTCam("192.168.4.1")
+        await cam.connect()
+        async for img in cam.stream():
+            ...
+        await cam.close()
+    """
+
+    def __init__(self, host="192.168.4.1", port=5001, decode=False, max_frames=4,
+                 backpressure=BACKPRESSURE_DROP, responseTimeout=10, connectTimeout=5,
+                 backoffMin=0.5, backoffMax=30):
+        """
+        Set decode to have images returned with numpy arrays instead of base64 strings (requires numpy).
+        max_frames is the size of the frame queue and backpressure selects what happens when it is full.
+        """
+        if decode and frame is None:
+            raise ImportError("decode requires numpy")
+        if backpressure not in (BACKPRESSURE_DROP, BACKPRESSURE_BLOCK):
+            raise ValueError(f"unknown backpressure {backpressure}")
+        self.host = host
+        self.port = port
+        self.decode = decode
+        self.backpressure = backpressure
+        self.responseTimeout = responseTimeout
+        self.connectTimeout = connectTimeout
+        self.backoffMin = backoffMin
+        self.backoffMax = backoffMax
+
+        self.frameQueue = asyncio.Queue(max_frames)
+        self.events = asyncio.Queue()
+        self.pending = deque()
+        self.imageWaiters = deque()
+        self.streamCmd = None
+
+        self.reader = None
+        self.writer = None
+        self.task = None
+        self.connected = asyncio.Event()
+        self.running = False
+
+        # Statistics
+        self.frames = 0
+        self.dropped = 0
+        self.reconnects = 0
+
+    ##########################################################################################
+    # Connection management
+    async def connect(self, timeout=None):
+        """
+        connect()
+        Start the connection task and wait for the first connection.  The task keeps reconnecting
+        until close() is called even if this times out.
+        """
+        if not self.running:
+            self.running = True
+            self.task = asyncio.ensure_future(self._run())
+        try:
+            await asyncio.wait_for(self.connected.wait(), timeout or self.connectTimeout)
+        except asyncio.TimeoutError:
+            return {"status": "timeout"}
+        return {"status": "connected"}
+
+    async def close(self):
+        """
+        close()
+        Stop the connection task and close the socket.  Pending commands fail with ConnectionError.
+        """
+        self.running = False
+        if self.task:
+            self.task.cancel()
+            try:
+                await self.task
+            except asyncio.CancelledError:
+                pass
+            self.task = None
+        self._close_socket()
+        self._fail_pending(ConnectionError("closed"))
+
+    async def _run(self):
+        backoff = self.backoffMin
+        while self.running:
+            try:
+                self.reader, self.writer = await asyncio.wait_for(
+                    asyncio.open_connection(self.host, self.port), self.connectTimeout)
+            except (OSError, asyncio.TimeoutError):
+                await asyncio.sleep(backoff * random.uniform(0.5, 1.0))
+                backoff = min(backoff * 2, self.backoffMax)
+                continue
+
+            backoff = self.backoffMin
+            self.connected.set()
+            try:
+                if self.streamCmd:
+                    # Restart the stream interrupted by the previous connection failure
+                    self._write(self.streamCmd)
+                await self._read_responses()
+            except (OSError, asyncio.IncompleteReadError):
+                pass
+            finally:
+                self.connected.clear()
+                self._close_socket()
+                self._fail_pending(ConnectionError("connection lost"))
+            if self.running:
+                self.reconnects += 1
+                await asyncio.sleep(backoff * random.uniform(0.5, 1.0))
+
+    def _close_socket(self):
+        if self.writer:
+            self.writer.close()
+        self.reader = None
+        self.writer = None
+
+    def _fail_pending(self, exc):
+        while self.pending:
+            p = self.pending.popleft()
+            if not p.future.done():
+                p.future.set_exception(exc)
+        while self.imageWaiters:
+            f = self.imageWaiters.popleft()
+            if not f.done():
+                f.set_exception(exc)
+
+    ##########################################################################################
+    # Response processing
+    async def _read_responses(self):
+        """
+        Split received data into responses.  Responses are located with a cursor and the
+        remainder is only moved once per read (see TCamManagerThreadBase.find_responses).
+        """
+        buf = bytearray()
+        while True:
+            data = await self.reader.read(65536)
+            if not data:
+                return
+            buf += data
+            start = 0
+            idx = buf.find(3)
+            while idx != -1:
+                s = buf.find(2, start, idx)
+                s = start if s == -1 else s + 1
+                with memoryview(buf) as mv, mv[s:idx] as response:
+                    try:
+                        if self.decode:
+                            msg = frame.parse_packet(response)
+                        else:
+                            msg = json.loads(response.tobytes())
+                    except (ValueError, UnicodeDecodeError):
+                        msg = None
+                if msg is not None:
+                    await self._dispatch(msg)
+                start = idx + 1
+                idx = buf.find(3, start)
+            del buf[:start]
+
+    async def _dispatch(self, msg):
+        if "radiometric" in msg:
+            await self._put_frame(msg)
+            return
+
+        names = [p.name for p in self.pending]
+        for p in self.pending:
+            if self._matches(p, msg, names):
+                self.pending.remove(p)
+                if not p.future.done():
+                    p.future.set_result(msg)
+                return
+
+        # Unsolicited response
+        if self.events.qsize() > 256:
+            self.events.get_nowait()
+        self.events.put_nowait(msg)
+
+    def _matches(self, p, msg, names):
+        if p.key in msg:
+            return True
+        info = msg.get("cam_info")
+        if info is None:
+            return False
+        value = info.get("info_value")
+        if value in (INFO_CMD_ACK, INFO_CMD_NACK):
+            # Usually "<cmd> success" or "<cmd> failed", otherwise it belongs to the oldest command
+            # acknowledged with cam_info
+            word = info.get("info_string", "").split(" ")[0]
+            return word == p.name if word in names else p.key == "cam_info"
+        return value in (INFO_CMD_UNIMPL, INFO_CMD_BAD)
+
+    async def _put_frame(self, msg):
+        self.frames += 1
+        while self.imageWaiters:
+            f = self.imageWaiters.popleft()
+            if not f.done():
+                f.set_result(msg)
+                return
+        if self.backpressure == BACKPRESSURE_BLOCK:
+            await self.frameQueue.put(msg)
+            return
+        if self.frameQueue.full():
+            self.frameQueue.get_nowait()
+            self.dropped += 1
+        self.frameQueue.put_nowait(msg)
+
+    ##########################################################################################
+    # Commands
+    def _write(self, cmd):
+        self.writer.write(f"\x02{json.dumps(cmd)}\x03".encode())
+
+    async def command(self, name, args=None, timeout=None):
+        """
+        command()
+        Send a command and return its response.  Raises CommandError if the camera rejects it,
+        ConnectionError if the connection fails and asyncio.TimeoutError if there is no response.
+        """
+        if not self.connected.is_set():
+            raise ConnectionError("not connected")
+        cmd = {"cmd": name}
+        if args is not None:
+            cmd["args"] = args
+        p = _Pending(name, asyncio.get_running_loop().create_future())
+        self.pending.append(p)
+        try:
+            self._write(cmd)
+            await self.writer.drain()
+            rsp = await asyncio.wait_for(p.future, timeout or self.responseTimeout)
+        except BaseException:
+            if p in self.pending:
+                self.pending.remove(p)
+            raise
+        info = rsp.get("cam_info")
+        if info is not None and info.get("info_value") != INFO_CMD_ACK:
+            raise CommandError(name, rsp)
+        return rsp
+
+    async def get_image(self, timeout=None):
+        """
+        get_image()
+        Request one image and return it
+        """
+        if not self.connected.is_set():
+            raise ConnectionError("not connected")
+        f = asyncio.get_running_loop().create_future()
+        self.imageWaiters.append(f)
+        try:
+            self._write({"cmd": "get_image"})
+            await self.writer.drain()
+            return await asyncio.wait_for(f, timeout or self.responseTimeout)
+        finally:
+            if f in self.imageWaiters:
+                self.imageWaiters.remove(f)
+
+    async def start_stream(self, delay_msec=0, num_frames=0, timeout=None):
+        args = {"delay_msec": delay_msec, "num_frames": num_frames}
+        rsp = await self.command("stream_on", args, timeout)
+        self.streamCmd = {"cmd": "stream_on", "args": args} if num_frames == 0 else None
+        return rsp
+
+    async def stop_stream(self, timeout=None):
+        self.streamCmd = None
+        return await self.command("stream_off", timeout=timeout)
+
+    async def stream(self, delay_msec=0, num_frames=0):
+        """
+        stream()
+        Asynchronous iterator over streamed images.  The stream is started when iteration begins and
+        stopped when it ends.  Images are not lost if the connection is reopened while iterating.
+        """
+        await self.start_stream(delay_msec, num_frames)
+        count = 0
+        try:
+            while num_frames == 0 or count < num_frames:
+                yield await self.frameQueue.get()
+                count += 1
+        finally:
+            if self.connected.is_set():
+                try:
+                    await self.stop_stream()
+                except (ConnectionError, CommandError, asyncio.TimeoutError):
+                    pass
+            self.streamCmd = None
+
+    async def get_frame(self):
+        """
+        get_frame()
+        Wait for the next image in the frame queue
+        """
+        return await self.frameQueue.get()
+
+    async def get_status(self, timeout=None):
+        return await self.command("get_status", timeout=timeout)
+
+    async def get_config(self, timeout=None):
+        return await self.command("get_config", timeout=timeout)
+
+    async def set_config(self, timeout=None, **args):
+        """
+        set_config()
+        Keyword arguments are the set_config arguments (for example agc_enabled=0)
+        """
+        return await self.command("set_config", args, timeout)
+
+    async def run_ffc(self, timeout=None):
+        return await self.command("run_ffc", timeout=timeout)
+
+    async def set_spotmeter(self, c1=79, c2=80, r1=59, r2=60, timeout=None):
+        return await self.command("set_spotmeter", {"c1": c1, "c2": c2, "r1": r1, "r2": r2}, timeout)
+
+    async def get_lep_cci(self, command=0x4ECC, length=4, timeout=None):
+        return await self.command("get_lep_cci", {"command": command, "length": length}, timeout)
+
+    async def set_lep_cci(self, command, data, timeout=None):
+        dataArray = array.array('H', data)
+        args = {
+            "command": command,
+            "length": len(dataArray),
+            "data": base64.b64encode(dataArray.tobytes()).decode('ascii'),
+        }
+        return await self.command("set_lep_cci", args, timeout)
+
+    def stats(self):
+        """
+        stats()
+        Returns the number of images received, images dropped from the frame queue and reconnections
+        """
+        return {"frames": self.frames, "dropped": self.dropped, "reconnects": self.reconnects}
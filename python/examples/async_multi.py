@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+
+'''
+Async_multi streams from several cameras at once from one asyncio event loop and periodically
+prints the image rate and spot temperature for each camera.
+'''
+
+import argparse
+import asyncio
+import time
+from async_tcam import AsyncTCam
+
+async def run_camera(ip, counts, spots):
+    cam = AsyncTCam(ip, decode=True)
+    rsp = await cam.connect()
+    if rsp["status"] != "connected":
+        print(f"{ip}: {rsp['status']}, retrying in the background")
+    await cam.connected.wait()
+    try:
+        async for img in cam.stream():
+            counts[ip] += 1
+            tel = img["telemetry"]
+            spots[ip] = tel["spot_mean"] * (0.01 if tel["tlinear_res"] else 0.1) - 273.15
+    finally:
+        await cam.close()
+
+async def report(counts, spots, interval):
+    while True:
+        await asyncio.sleep(interval)
+        line = []
+        for ip in counts:
+            line.append(f"{ip}: {counts[ip] / interval:4.1f} fps {spots[ip]:6.1f}C")
+            counts[ip] = 0
+        print(" | ".join(line))
+
+async def main(ips, interval):
+    counts = dict.fromkeys(ips, 0)
+    spots = dict.fromkeys(ips, 0.0)
+    await asyncio.gather(report(counts, spots, interval), *[run_camera(ip, counts, spots) for ip in ips])
+
+
+########### Main Program ############
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+
+    parser.prog = "async_multi"
+    parser.description = f"{parser.prog} - stream images from multiple cameras in one event loop\n"
+    parser.usage = "async_multi.py <ip address> [<ip address> ...]"
+    parser.add_argument("ip", nargs="+", help="Camera IP addresses")
+    parser.add_argument("--interval", type=float, default=2, help="Report interval (seconds)")
+    args = parser.parse_args()
+
+    try:
+        asyncio.run(main(args.ip, args.interval))
+    except KeyboardInterrupt:
+        pass
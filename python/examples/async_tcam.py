@@ -0,0 +1 @@
+../async_tcam.py
\ No newline at end of file
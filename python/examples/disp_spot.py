@@ -7,6 +7,7 @@ import argparse
 import array
 import base64
 from tcam import TCam
+from temperature import TempConverter
 import sys
 
 parser = argparse.ArgumentParser()
@@ -58,12 +59,9 @@ if __name__ == "__main__":
     rsp_vals = rsp["cci_reg"]
     dec_data = base64.b64decode(rsp_vals["data"])
     reg_array = array.array('H', dec_data)
-    if reg_array[0] == 0:
-        res = 0.1
-    else:
-        res = 0.01
+    conv = TempConverter(reg_array[0])
 
-    print(f"T-Linear resolution = {res}")
+    print(f"T-Linear resolution = {0.01 if reg_array[0] else 0.1}")
     
     #
     # Request the RAD Spotmeter Value (RAD 0xED0)
@@ -84,8 +82,8 @@ if __name__ == "__main__":
     
     #
     # Convert the Spotmeter Value into degrees C
-    #   Temp = (Spotmeter Value / (1 / T-Linear Resolution)) - 273.15
-    temp = (reg_array[0] / (1 / res)) - 273.15
+    #   Temp = (Spotmeter Value * T-Linear Resolution) - 273.15
+    temp = conv.to_temp(reg_array[0])
     print(f"spot average = {temp} C")
 
     cam.shutdown()
@@ -7,6 +7,7 @@ import argparse
 import array
 import base64
 from tcam import TCam
+from temperature import TempConverter
 import sys
 
 parser = argparse.ArgumentParser()
@@ -88,11 +89,9 @@ if __name__ == "__main__":
     print(f"  Gain Mode     = {ra[165]}")
     print(f"  Eff Gain Mode = {ra[166]}")
     print(f"  TLinear Mode  = {ra[208]}")
-    if ra[209] == 0:
-        res = 0.1
-    else:
-        res = 0.01
-    print(f"  TLinear Res   = {res}")
-    t = (ra[210] / (1 / res))  - 273.15
+    conv = TempConverter()
+    conv.set_from_telemetry(ra)
+    print(f"  TLinear Res   = {0.01 if ra[209] else 0.1}")
+    t = conv.to_temp(ra[210])
     print(f"  Spotmeter     = {t} C")
   
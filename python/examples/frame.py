@@ -0,0 +1 @@
+../frame.py
\ No newline at end of file
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+
+'''
+Frame_bench measures the host-side cost of parsing image responses and converting them to
+temperatures and palette colors using plain python, numpy and the _tcam native module (if
+built, see setup.py).  A synthetic image response is used so no camera is required.
+'''
+
+import argparse
+import base64
+import json
+import time
+import numpy as np
+import frame
+from palettes import palettes
+from temperature import TempConverter
+
+def make_packet():
+    rng = np.random.default_rng(1)
+    img = rng.integers(27315, 31315, size=(frame.IMG_HEIGHT, frame.IMG_WIDTH), dtype=np.uint16)
+    tel = np.zeros(frame.TEL_WORDS, dtype=np.uint16)
+    tel[209] = 1
+    obj = {
+        "metadata": {"Camera": "tCam-Mini", "Version": 2, "Time": "12:00:00.000", "Date": "1/1/22"},
+        "radiometric": base64.b64encode(img.tobytes()).decode(),
+        "telemetry": base64.b64encode(tel.tobytes()).decode(),
+    }
+    return json.dumps(obj).encode()
+
+def run_python(packet, palette):
+    obj = json.loads(packet)
+    data = base64.b64decode(obj["radiometric"])
+    pixels = [data[i] | (data[i+1] << 8) for i in range(0, len(data), 2)]
+    temps = [p * 0.01 - 273.15 for p in pixels]
+    vmin = min(pixels)
+    delta = max(max(pixels) - vmin, 1)
+    rgb = [palette[(p - vmin) * 255 // delta] for p in pixels]
+    return temps, rgb
+
+def run_numpy(packet, palette, conv):
+    obj = frame.decode_frame(json.loads(packet))
+    img = obj["radiometric"]
+    temps = conv.frame_to_temp(img)
+    rgb = palette[frame.normalize(img)]
+    return temps, rgb
+
+def run_ext(packet, palette, out, temps, rgb):
+    obj = frame.parse_packet(packet, out)
+    frame.to_temp(out, 1, "C", temps)
+    frame.to_rgb(out, palette, out=rgb)
+    return temps, rgb
+
+def bench(name, count, func, *args):
+    func(*args)
+    t = time.perf_counter()
+    for i in range(count):
+        func(*args)
+    msec = (time.perf_counter() - t) * 1000 / count
+    print(f"{name:8s} {msec:8.3f} mSec/image  {1000 / msec:8.1f} images/sec")
+
+
+########### Main Program ############
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+
+    parser.prog = "frame_bench"
+    parser.description = f"{parser.prog} - measure image parsing and conversion performance\n"
+    parser.usage = "frame_bench.py [--count=<images>] [--palette=<name>]"
+    parser.add_argument("--count", type=int, default=200, help="Images per method")
+    parser.add_argument("--palette", default="ironblack", help="Palette name")
+    args = parser.parse_args()
+
+    packet = make_packet()
+    palette = palettes[args.palette]
+    palette_np = np.array(palette, dtype=np.uint8)
+
+    bench("python", max(args.count // 20, 1), run_python, packet, palette)
+    bench("numpy", args.count, run_numpy, packet, palette_np, TempConverter(1, "C"))
+    if frame.HAVE_EXT:
+        out = np.empty((frame.IMG_HEIGHT, frame.IMG_WIDTH), dtype=np.uint16)
+        temps = np.empty(out.shape, dtype=np.float32)
+        rgb = np.empty(out.shape + (3,), dtype=np.uint8)
+        bench("native", args.count, run_ext, packet, palette_np, out, temps, rgb)
+    else:
+        print("native   _tcam not built (python3 setup.py build_ext --inplace)")
@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+
+'''
+Record_stream records images streamed from a camera to a tCam recording file (.tcrec) or, with
+--play, replays a recording (or a .tjsn/.tmjsn file) and prints the image rate and frame counter.
+'''
+
+import argparse
+import time
+from tcam import TCam
+from recording import Recorder, TCamPlayer
+
+def record(args):
+    cam = TCam()
+    rsp = cam.connect(args.ip)
+    if rsp["status"] != "connected":
+        print(f"Could not connect to {args.ip}")
+        cam.shutdown()
+        return
+    cam.start_stream(num_frames=args.num)
+    with Recorder(args.file, compress=args.compress) as rec:
+        while len(rec) < args.num:
+            img = cam.get_frame()
+            if img is None:
+                time.sleep(0.01)
+                continue
+            rec.write(img)
+            print(f"\r{len(rec)} images", end="")
+    print()
+    cam.stop_stream()
+    cam.shutdown()
+
+def play(args):
+    player = TCamPlayer(args.file, speed=args.speed, decode=True)
+    player.start()
+    count = 0
+    t0 = time.monotonic()
+    while not player.finished or player.frame_count():
+        img = player.get_frame()
+        if img is None:
+            time.sleep(0.005)
+            continue
+        count += 1
+        fps = count / max(time.monotonic() - t0, 0.001)
+        print(f"\r{count} images ({fps:.1f} fps) frame counter {img['telemetry']['frame_counter']}", end="")
+    print()
+    player.shutdown()
+
+
+########### Main Program ############
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+
+    parser.prog = "record_stream"
+    parser.description = f"{parser.prog} - record a stream from a camera or replay a recording\n"
+    parser.usage = "record_stream.py -i <ip address> [-n <images>] [-z] <file>\n       record_stream.py --play [-s <speed>] <file>"
+    parser.add_argument("file", help="Recording file")
+    parser.add_argument("-i", "--ip", default="192.168.4.1", help="IP address of the camera")
+    parser.add_argument("-n", "--num", type=int, default=100, help="Number of images to record")
+    parser.add_argument("-z", "--compress", action="store_true", help="Compress the recording")
+    parser.add_argument("--play", action="store_true", help="Replay the file")
+    parser.add_argument("-s", "--speed", type=float, default=1.0, help="Replay speed (0 for fastest)")
+    args = parser.parse_args()
+
+    if args.play:
+        play(args)
+    else:
+        record(args)
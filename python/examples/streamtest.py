@@ -6,37 +6,17 @@ Streamtest is a simple utility to demonstrate streaming the frames from a tCam-M
 author: bitreaper
 '''
 
-import base64
 import argparse
 import numpy as np
 from tcam import TCam
+from frame import normalize
 from tkinter import *
-from array import array
 from PIL import Image, ImageTk
 from threading import Event
 
 def convert(img):
-
-    dimg = base64.b64decode(img["radiometric"])
-    ra = array('H', dimg)
-
-    imgmin = 65535
-    imgmax = 0
-    for i in ra:
-        if i < imgmin:
-            imgmin = i
-        if i > imgmax:
-            imgmax = i
-    delta = imgmax - imgmin
-    a = np.zeros((120,160,3), np.uint8)
-    for r in range(0, 120):
-        for c in range(0, 160):
-            val = int((ra[(r * 160) + c] - imgmin) * 255 / delta)
-            if val > 255:
-                a[r, c] = [255, 255, 255]
-            else:
-                a[r, c] = [val, val, val]
-    return a
+    # The driver decodes "radiometric" into a (120, 160) uint16 array
+    return np.repeat(normalize(img["radiometric"])[:, :, np.newaxis], 3, axis=2)
 
 def update():
     if tcam.frameQueue.empty():
@@ -66,7 +46,7 @@ if __name__ == '__main__':
         args.ip = "192.168.4.1"
         print(f"Using default of {args.ip}")
 
-    tcam = TCam()
+    tcam = TCam(decode=True)
     tcam.connect(args.ip)
 
     root = Tk()
@@ -8,38 +8,20 @@ streamtest.py demo is to specify the hardware interface when the driver is insta
 original author: bitreaper (hacked to use the hw interface by Dan Julio)
 '''
 
-import base64
 import argparse
 import numpy as np
 from tcam import TCam
+from frame import normalize
 from palettes import rainbow_palette
 from tkinter import *
-from array import array
 from PIL import Image, ImageTk
 from threading import Event
 
-def convert(img):
+palette = np.array(rainbow_palette, dtype=np.uint8)
 
-    dimg = base64.b64decode(img["radiometric"])
-    ra = array('H', dimg)
-
-    imgmin = 65535
-    imgmax = 0
-    for i in ra:
-        if i < imgmin:
-            imgmin = i
-        if i > imgmax:
-            imgmax = i
-    delta = imgmax - imgmin
-    a = np.zeros((120,160,3), np.uint8)
-    for r in range(0, 120):
-        for c in range(0, 160):
-            val = int((ra[(r * 160) + c] - imgmin) * 255 / delta)
-            if val > 255:
-                a[r, c] = rainbow_palette[255]
-            else:
-                a[r, c] = rainbow_palette[val]
-    return a
+def convert(img):
+    # The driver decodes "radiometric" into a (120, 160) uint16 array
+    return palette[normalize(img["radiometric"])]
 
 def update():
     if tcam.frameQueue.empty():
@@ -59,7 +41,7 @@ if __name__ == '__main__':
     #
     # Instantiate the driver and configure it to use the hardware interface
     #
-    tcam = TCam(is_hw=True)
+    tcam = TCam(is_hw=True, decode=True)
 
     #
     # Connect to the camera using the default serial and SPI ports (/dev/serial0 and
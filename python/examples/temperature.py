@@ -0,0 +1 @@
+../temperature.py
\ No newline at end of file
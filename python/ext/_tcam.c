@@ -0,0 +1,411 @@
+/*
+ * tCam python driver native helpers
+ *
+ * Optional compiled module used by frame.py to decode image responses and convert
+ * images to temperatures and palette colors without per-pixel python.  Temperature
+ * conversion is the firmware's temp_utilities.c.  Functions operate on objects
+ * supporting the buffer protocol (bytes, bytearray, numpy arrays) so the module
+ * does not depend on the numpy C API.  The GIL is released during pixel loops.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "temp_utilities.h"
+
+
+
+//
+// Internal constants
+//
+
+// Invalid entry in the base64 decode table
+#define B64_INVALID 0xFF
+
+
+
+//
+// Variables
+//
+static uint8_t b64_table[256];
+
+
+
+//
+// Forward declarations for internal functions
+//
+static void b64_init();
+static Py_ssize_t b64_decoded_len(const char* src, Py_ssize_t len);
+static Py_ssize_t b64_decode(const char* src, Py_ssize_t len, uint8_t* dst);
+static bool find_string_value(const char* buf, Py_ssize_t len, const char* key, Py_ssize_t* start, Py_ssize_t* end);
+static PyObject* decode_value(const char* src, Py_ssize_t len, Py_buffer* out);
+
+
+
+//
+// Module functions
+//
+
+/**
+ * parse_image(packet, out=None) -> (json, radiometric, telemetry)
+ *
+ * Locate the base64 "radiometric" and "telemetry" strings in an image response and
+ * decode them.  The radiometric data is decoded into out (a writable buffer of the
+ * decoded length) if it is specified.  json is the response text with both strings
+ * emptied for the caller to parse.  Returns (None, None, None) if packet is not an
+ * image response.
+ */
+static PyObject* parse_image(PyObject* self, PyObject* args)
+{
+	const char* src;
+	Py_ssize_t rad_start, rad_end;
+	Py_ssize_t tel_start, tel_end;
+	Py_ssize_t len;
+	Py_buffer packet;
+	Py_buffer out;
+	PyObject* out_obj = Py_None;
+	PyObject* json = NULL;
+	PyObject* rad = NULL;
+	PyObject* tel = NULL;
+	PyObject* ret = NULL;
+	bool has_tel;
+	char* dst;
+
+	if (!PyArg_ParseTuple(args, "y*|O", &packet, &out_obj)) return NULL;
+	out.obj = NULL;
+
+	src = (const char*) packet.buf;
+	len = packet.len;
+
+	if (!find_string_value(src, len, "\"radiometric\"", &rad_start, &rad_end)) {
+		PyBuffer_Release(&packet);
+		return Py_BuildValue("(OOO)", Py_None, Py_None, Py_None);
+	}
+	has_tel = find_string_value(src, len, "\"telemetry\"", &tel_start, &tel_end);
+
+	if (out_obj != Py_None) {
+		if (PyObject_GetBuffer(out_obj, &out, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) != 0) goto done;
+	}
+
+	rad = decode_value(src + rad_start, rad_end - rad_start, (out.obj != NULL) ? &out : NULL);
+	if (rad == NULL) goto done;
+
+	if (has_tel) {
+		tel = decode_value(src + tel_start, tel_end - tel_start, NULL);
+		if (tel == NULL) goto done;
+	} else {
+		tel = Py_None;
+		Py_INCREF(tel);
+	}
+
+	// Copy the response without the base64 strings
+	json = PyBytes_FromStringAndSize(NULL, len - (rad_end - rad_start) - (has_tel ? (tel_end - tel_start) : 0));
+	if (json == NULL) goto done;
+	dst = PyBytes_AS_STRING(json);
+	if (has_tel && (tel_start < rad_start)) {
+		memcpy(dst, src, tel_start);
+		dst += tel_start;
+		memcpy(dst, src + tel_end, rad_start - tel_end);
+		dst += rad_start - tel_end;
+		memcpy(dst, src + rad_end, len - rad_end);
+	} else if (has_tel) {
+		memcpy(dst, src, rad_start);
+		dst += rad_start;
+		memcpy(dst, src + rad_end, tel_start - rad_end);
+		dst += tel_start - rad_end;
+		memcpy(dst, src + tel_end, len - tel_end);
+	} else {
+		memcpy(dst, src, rad_start);
+		dst += rad_start;
+		memcpy(dst, src + rad_end, len - rad_end);
+	}
+
+	ret = Py_BuildValue("(OOO)", json, rad, tel);
+
+done:
+	Py_XDECREF(json);
+	Py_XDECREF(rad);
+	Py_XDECREF(tel);
+	if (out.obj != NULL) PyBuffer_Release(&out);
+	PyBuffer_Release(&packet);
+	return ret;
+}
+
+
+/**
+ * to_temp(src, res, unit, dst)
+ *
+ * Convert 16-bit radiometric pixels in src to float32 temperatures in dst.  res and unit
+ * are the temp_utilities TEMP_RES_x and TEMP_UNIT_x values.
+ */
+static PyObject* to_temp(PyObject* self, PyObject* args)
+{
+	int res, unit;
+	Py_buffer src;
+	Py_buffer dst;
+	temp_conv_t conv;
+
+	if (!PyArg_ParseTuple(args, "y*iiw*", &src, &res, &unit, &dst)) return NULL;
+
+	if (dst.len < (src.len / 2) * (Py_ssize_t) sizeof(float)) {
+		PyBuffer_Release(&src);
+		PyBuffer_Release(&dst);
+		PyErr_SetString(PyExc_ValueError, "dst too small");
+		return NULL;
+	}
+
+	temp_conv_init(&conv, res, unit);
+
+	Py_BEGIN_ALLOW_THREADS
+	temp_frame_to_temp(&conv, (const uint16_t*) src.buf, (float*) dst.buf, (int) (src.len / 2));
+	Py_END_ALLOW_THREADS
+
+	PyBuffer_Release(&src);
+	PyBuffer_Release(&dst);
+	Py_RETURN_NONE;
+}
+
+
+/**
+ * to_rgb(src, palette, dst, vmin=-1, vmax=-1) -> (vmin, vmax)
+ *
+ * Linearly map 16-bit pixels in src between vmin and vmax to 24-bit colors in dst using
+ * a 768 byte palette.  The image's own range is used if vmin or vmax is negative.
+ */
+static PyObject* to_rgb(PyObject* self, PyObject* args)
+{
+	int i, n, v;
+	int vmin = -1;
+	int vmax = -1;
+	int delta;
+	const uint16_t* sP;
+	const uint8_t* pP;
+	uint8_t* dP;
+	Py_buffer src;
+	Py_buffer palette;
+	Py_buffer dst;
+
+	if (!PyArg_ParseTuple(args, "y*y*w*|ii", &src, &palette, &dst, &vmin, &vmax)) return NULL;
+
+	n = (int) (src.len / 2);
+	if ((palette.len < 768) || (dst.len < (Py_ssize_t) n * 3)) {
+		PyBuffer_Release(&src);
+		PyBuffer_Release(&palette);
+		PyBuffer_Release(&dst);
+		PyErr_SetString(PyExc_ValueError, "palette or dst too small");
+		return NULL;
+	}
+
+	sP = (const uint16_t*) src.buf;
+	pP = (const uint8_t*) palette.buf;
+	dP = (uint8_t*) dst.buf;
+
+	Py_BEGIN_ALLOW_THREADS
+	if ((vmin < 0) || (vmax < 0)) {
+		vmin = 65535;
+		vmax = 0;
+		for (i=0; i<n; i++) {
+			if (sP[i] < vmin) vmin = sP[i];
+			if (sP[i] > vmax) vmax = sP[i];
+		}
+	}
+	delta = vmax - vmin;
+	if (delta < 1) delta = 1;
+
+	for (i=0; i<n; i++) {
+		v = (((int) sP[i] - vmin) * 255) / delta;
+		if (v < 0) v = 0;
+		if (v > 255) v = 255;
+		*dP++ = pP[v*3];
+		*dP++ = pP[v*3 + 1];
+		*dP++ = pP[v*3 + 2];
+	}
+	Py_END_ALLOW_THREADS
+
+	PyBuffer_Release(&src);
+	PyBuffer_Release(&palette);
+	PyBuffer_Release(&dst);
+	return Py_BuildValue("(ii)", vmin, vmax);
+}
+
+
+
+//
+// Module definition
+//
+static PyMethodDef tcam_methods[] = {
+	{"parse_image", parse_image, METH_VARARGS, "Decode the base64 strings in an image response"},
+	{"to_temp", to_temp, METH_VARARGS, "Convert radiometric pixels to float32 temperatures"},
+	{"to_rgb", to_rgb, METH_VARARGS, "Map pixels to 24-bit palette colors"},
+	{NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef tcam_module = {
+	PyModuleDef_HEAD_INIT,
+	"_tcam",
+	"tCam python driver native helpers",
+	-1,
+	tcam_methods
+};
+
+PyMODINIT_FUNC PyInit__tcam(void)
+{
+	PyObject* m;
+
+	b64_init();
+
+	m = PyModule_Create(&tcam_module);
+	if (m == NULL) return NULL;
+
+	PyModule_AddIntConstant(m, "TEMP_RES_LOW", TEMP_RES_LOW);
+	PyModule_AddIntConstant(m, "TEMP_RES_HIGH", TEMP_RES_HIGH);
+	PyModule_AddIntConstant(m, "TEMP_UNIT_C", TEMP_UNIT_C);
+	PyModule_AddIntConstant(m, "TEMP_UNIT_F", TEMP_UNIT_F);
+	PyModule_AddIntConstant(m, "TEMP_UNIT_K", TEMP_UNIT_K);
+
+	return m;
+}
+
+
+
+//
+// Internal functions
+//
+
+static void b64_init()
+{
+	int i;
+	const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	memset(b64_table, B64_INVALID, sizeof(b64_table));
+	for (i=0; i<64; i++) {
+		b64_table[(uint8_t) alphabet[i]] = i;
+	}
+}
+
+
+/**
+ * Return the number of bytes a base64 string decodes to.  Characters outside the
+ * alphabet (json escapes, padding) are ignored.
+ */
+static Py_ssize_t b64_decoded_len(const char* src, Py_ssize_t len)
+{
+	Py_ssize_t i;
+	Py_ssize_t n = 0;
+
+	for (i=0; i<len; i++) {
+		if (b64_table[(uint8_t) src[i]] != B64_INVALID) n++;
+	}
+
+	return (n * 3) / 4;
+}
+
+
+/**
+ * Decode a base64 string into dst, which must hold b64_decoded_len() bytes.  Returns
+ * the number of bytes decoded.
+ */
+static Py_ssize_t b64_decode(const char* src, Py_ssize_t len, uint8_t* dst)
+{
+	int bits = 0;
+	uint32_t acc = 0;
+	uint8_t v;
+	uint8_t* dP = dst;
+
+	while (len--) {
+		v = b64_table[(uint8_t) *src++];
+		if (v == B64_INVALID) continue;
+		acc = (acc << 6) | v;
+		bits += 6;
+		if (bits >= 8) {
+			bits -= 8;
+			*dP++ = (uint8_t) (acc >> bits);
+		}
+	}
+
+	return dP - dst;
+}
+
+
+/**
+ * Find the string value for key (including its quotes) in json text.  Loads the
+ * offsets of the first and one past the last character of the value.
+ */
+static bool find_string_value(const char* buf, Py_ssize_t len, const char* key, Py_ssize_t* start, Py_ssize_t* end)
+{
+	const char* cP;
+	const char* eP = buf + len;
+	Py_ssize_t key_len = strlen(key);
+
+	cP = buf;
+	while ((cP = memchr(cP, '"', eP - cP)) != NULL) {
+		if (((eP - cP) > key_len) && (memcmp(cP, key, key_len) == 0)) {
+			// Skip to the opening quote of the value
+			cP += key_len;
+			while ((cP < eP) && ((*cP == ' ') || (*cP == ':'))) cP++;
+			if ((cP >= eP) || (*cP != '"')) return false;
+			*start = ++cP - buf;
+
+			// Base64 strings do not contain escaped quotes
+			cP = memchr(cP, '"', eP - cP);
+			if (cP == NULL) return false;
+			*end = cP - buf;
+			return true;
+		}
+		cP++;
+	}
+
+	return false;
+}
+
+
+/**
+ * Decode a base64 value into out if specified (a new reference to its object is
+ * returned) or into a new bytearray
+ */
+static PyObject* decode_value(const char* src, Py_ssize_t len, Py_buffer* out)
+{
+	Py_ssize_t n;
+	PyObject* obj;
+
+	n = b64_decoded_len(src, len);
+
+	if (out != NULL) {
+		if (out->len != n) {
+			PyErr_Format(PyExc_ValueError, "out holds %zd bytes, image is %zd bytes", out->len, n);
+			return NULL;
+		}
+		Py_BEGIN_ALLOW_THREADS
+		b64_decode(src, len, (uint8_t*) out->buf);
+		Py_END_ALLOW_THREADS
+		Py_INCREF(out->obj);
+		return out->obj;
+	}
+
+	obj = PyByteArray_FromStringAndSize(NULL, n);
+	if (obj == NULL) return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	b64_decode(src, len, (uint8_t*) PyByteArray_AS_STRING(obj));
+	Py_END_ALLOW_THREADS
+
+	return obj;
+}
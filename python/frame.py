@@ -0,0 +1,241 @@
+"""
+  tCam image decoding
+
+  Converts image responses to numpy arrays.  Radiometric data is decoded from
+  base64 with a single C call and viewed as a 120x160 uint16 array without
+  further copies.  Telemetry is viewed as a structured array with named fields
+  for the commonly used Lepton telemetry words while all 240 words remain
+  available through the "words" field.
+
+  The optional _tcam native module (see setup.py) decodes image responses without
+  building the base64 strings as python objects and converts images to temperatures
+  and palette colors.  The same functions fall back to numpy when it is not built.
+
+  Copyright 2020-2022 Dan Julio
+
+  This file is part of tCam.
+
+  tCam is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  tCam is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+"""
+
+import json
+import struct
+import binascii
+import numpy as np
+
+try:
+    import _tcam
+except ImportError:
+    _tcam = None
+
+HAVE_EXT = _tcam is not None
+
+IMG_WIDTH = 160
+IMG_HEIGHT = 120
+IMG_LEN = IMG_WIDTH * IMG_HEIGHT * 2
+TEL_WORDS = 240
+
+# Binary image frame header: magic, version, meta_len, img_len, tel_len
+IMAGE_HEADER = struct.Struct("<4sHHII")
+IMAGE_MAGIC = b"TCIF"
+
+# Lepton telemetry (see the Lepton Engineering Datasheet).  Row A is words 0-79, row B
+# words 80-159 and row C words 160-239.  32-bit values are stored low word first so they
+# are read as little-endian uint32.
+_TEL_FIELDS = [
+    # name, word, format
+    ("words", 0, ("<u2", (TEL_WORDS,))),
+    ("revision", 0, "<u2"),
+    ("time_counter", 1, "<u4"),
+    ("status", 3, "<u4"),
+    ("serial_number", 5, ("<u2", (8,))),
+    ("software_rev", 13, ("<u2", (4,))),
+    ("frame_counter", 20, "<u4"),
+    ("frame_mean", 22, "<u2"),
+    ("fpa_temp_counts", 23, "<u2"),
+    ("fpa_temp_k100", 24, "<u2"),
+    ("housing_temp_counts", 25, "<u2"),
+    ("housing_temp_k100", 26, "<u2"),
+    ("last_ffc_fpa_temp_k100", 29, "<u2"),
+    ("last_ffc_time_counter", 30, "<u4"),
+    ("last_ffc_housing_temp_k100", 32, "<u2"),
+    ("agc_roi", 34, ("<u2", (4,))),
+    ("agc_clip_high", 38, "<u2"),
+    ("agc_clip_low", 39, "<u2"),
+    ("video_format", 72, "<u4"),
+    ("ffc_frames_log2", 74, "<u2"),
+    ("emissivity", 99, "<u2"),
+    ("background_temp_k100", 100, "<u2"),
+    ("atm_transmission", 101, "<u2"),
+    ("atm_temp_k100", 102, "<u2"),
+    ("window_transmission", 103, "<u2"),
+    ("window_reflection", 104, "<u2"),
+    ("window_temp_k100", 105, "<u2"),
+    ("window_refl_temp_k100", 106, "<u2"),
+    ("gain_mode", 165, "<u2"),
+    ("effective_gain_mode", 166, "<u2"),
+    ("gain_mode_desired", 167, "<u2"),
+    ("gain_th_h2l_c", 168, "<u2"),
+    ("gain_th_l2h_c", 169, "<u2"),
+    ("gain_th_h2l_k", 170, "<u2"),
+    ("gain_th_l2h_k", 171, "<u2"),
+    ("gain_pop_h2l", 174, "<u2"),
+    ("gain_pop_l2h", 175, "<u2"),
+    ("gain_mode_roi", 182, ("<u2", (4,))),
+    ("tlinear_enable", 208, "<u2"),
+    ("tlinear_res", 209, "<u2"),
+    ("spot_mean", 210, "<u2"),
+    ("spot_max", 211, "<u2"),
+    ("spot_min", 212, "<u2"),
+    ("spot_population", 213, "<u2"),
+    ("spot_roi", 214, ("<u2", (4,))),   # y1, x1, y2, x2
+]
+
+TELEMETRY_DTYPE = np.dtype({
+    "names": [f[0] for f in _TEL_FIELDS],
+    "formats": [f[2] for f in _TEL_FIELDS],
+    "offsets": [f[1] * 2 for f in _TEL_FIELDS],
+    "itemsize": TEL_WORDS * 2,
+})
+
+
+def decode_image(b64, out=None):
+    """
+    Decode base64 radiometric (or AGC) data to a (120, 160) uint16 array.  The array is a view
+    of the decoded bytes.  If out is given the pixels are copied into it instead.
+    """
+    img = np.frombuffer(binascii.a2b_base64(b64), dtype="<u2", count=IMG_WIDTH * IMG_HEIGHT)
+    img = img.reshape(IMG_HEIGHT, IMG_WIDTH)
+    if out is None:
+        return img
+    np.copyto(out, img)
+    return out
+
+
+def decode_telemetry(b64):
+    """Decode base64 telemetry to a TELEMETRY_DTYPE record"""
+    return np.frombuffer(binascii.a2b_base64(b64), dtype=TELEMETRY_DTYPE, count=1)[0]
+
+
+def decode_frame(frameObj, out=None):
+    """
+    Replace the base64 "radiometric" and "telemetry" strings in an image response with a
+    (120, 160) uint16 array and a TELEMETRY_DTYPE record.  Returns the response.
+    """
+    frameObj["radiometric"] = decode_image(frameObj["radiometric"], out)
+    if "telemetry" in frameObj:
+        frameObj["telemetry"] = decode_telemetry(frameObj["telemetry"])
+    return frameObj
+
+
+def decode_binary_frame(data):
+    """
+    Convert a binary image frame into an image response with a (120, 160) uint16 array and a
+    TELEMETRY_DTYPE record.  Both are views of data.
+    """
+    magic, version, meta_len, img_len, tel_len = IMAGE_HEADER.unpack_from(data)
+    if magic != IMAGE_MAGIC or img_len != IMG_LEN or tel_len != TEL_WORDS * 2:
+        raise ValueError("not a binary image frame")
+    offset = IMAGE_HEADER.size
+    meta = bytes(data[offset : offset + meta_len]).rstrip(b"\x00")
+    offset += meta_len
+    img = np.frombuffer(data, dtype="<u2", count=IMG_WIDTH * IMG_HEIGHT, offset=offset)
+    offset += img_len
+    tel = np.frombuffer(data, dtype=TELEMETRY_DTYPE, count=1, offset=offset)[0]
+    return {
+        "metadata": json.loads(meta),
+        "radiometric": img.reshape(IMG_HEIGHT, IMG_WIDTH),
+        "telemetry": tel,
+    }
+
+
+def normalize(img):
+    """Linearly scale an image to a (120, 160) uint8 array using its full range"""
+    imin = int(img.min())
+    delta = max(int(img.max()) - imin, 1)
+    return ((img.astype(np.uint32) - imin) * 255 // delta).astype(np.uint8)
+
+
+def parse_packet(packet, out=None):
+    """
+    Convert a json image response (bytes-like, without delimiters) into a decoded response as
+    returned by decode_frame.  If out is given the pixels are decoded directly into it.  Other responses
+    are returned as parsed.
+    """
+    if _tcam is not None:
+        skeleton, rad, tel = _tcam.parse_image(packet, out)
+        if skeleton is not None:
+            frameObj = json.loads(skeleton)
+            if out is None:
+                rad = np.frombuffer(rad, dtype="<u2").reshape(IMG_HEIGHT, IMG_WIDTH)
+            frameObj["radiometric"] = rad
+            if tel is not None:
+                frameObj["telemetry"] = np.frombuffer(tel, dtype=TELEMETRY_DTYPE, count=1)[0]
+            return frameObj
+        return json.loads(bytes(packet))
+    frameObj = json.loads(bytes(packet))
+    if "radiometric" in frameObj:
+        decode_frame(frameObj, out)
+    return frameObj
+
+
+def to_temp(img, res, unit="C", out=None):
+    """
+    Convert 16-bit radiometric pixels to a float32 array of temperatures for a TLinear
+    resolution (0 = low, 1 = high) and unit ("C", "F" or "K")
+    """
+    img = np.ascontiguousarray(img, dtype=np.uint16)
+    if out is None:
+        out = np.empty(img.shape, dtype=np.float32)
+    if _tcam is not None:
+        _tcam.to_temp(img, 1 if res else 0, _TEMP_UNITS[unit], out)
+    else:
+        np.copyto(out, _temp_converter(res, unit).frame_to_temp(img))
+    return out
+
+
+def to_rgb(img, palette, vmin=None, vmax=None, out=None):
+    """
+    Linearly map 16-bit pixels between vmin and vmax (the image's range by default) to a
+    (120, 160, 3) uint8 array using a 256 entry palette.  Returns (rgb, vmin, vmax).
+    """
+    img = np.ascontiguousarray(img, dtype=np.uint16)
+    palette = np.ascontiguousarray(palette, dtype=np.uint8)
+    if out is None:
+        out = np.empty(img.shape + (3,), dtype=np.uint8)
+    if vmin is None or vmax is None:
+        vmin = vmax = -1
+    if _tcam is not None:
+        vmin, vmax = _tcam.to_rgb(img, palette, out, vmin, vmax)
+    else:
+        if vmin < 0 or vmax < 0:
+            vmin, vmax = int(img.min()), int(img.max())
+        delta = max(vmax - vmin, 1)
+        idx = (img.astype(np.int32) - vmin) * 255 // delta
+        np.take(palette.reshape(256, 3), np.clip(idx, 0, 255), axis=0, out=out)
+    return out, vmin, vmax
+
+
+_TEMP_UNITS = {"C": 0, "F": 1, "K": 2}
+_temp_conv = None
+
+
+def _temp_converter(res, unit):
+    global _temp_conv
+    if _temp_conv is None:
+        from temperature import TempConverter
+        _temp_conv = TempConverter(res, unit)
+    else:
+        _temp_conv.set(res, unit)
+    return _temp_conv
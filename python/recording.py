@@ -0,0 +1,474 @@
+"""
+  tCam host recording and playback
+
+  Recorder writes images to a chunked binary recording file (.tcrec) with an index
+  so any image can be read directly.  Images are stored as raw pixels and telemetry
+  (about 39 KB per image instead of 53 KB of json text).  Chunks of images may be
+  compressed with zlib.  Uncompressed recordings are memory mapped and decoded
+  images are numpy views of the file.
+
+  open_recording returns a reader for .tcrec files or the camera's .tjsn and .tmjsn
+  files.  Readers support len(), reader[k], iteration and searching by timestamp.
+  TCamPlayer replays a recording into a frameQueue with the same get_frame API as
+  TCam so programs can be run against recorded data.
+
+  File layout (little-endian)
+
+    File header   "TCRF", version (u16), flags (u16), chunk_frames (u32), reserved (u32)
+    Chunk         "TCCH", stored_len (u32), raw_len (u32), num_records (u32), data
+    Record        timestamp (f64), meta_len (u32), img_len (u32), tel_len (u32),
+                  reserved (u32), json (padded to 8 bytes), image, telemetry
+    Index         "TCRX", num_frames (u32), num_chunks (u32), reserved (u32),
+                  CHUNK_DTYPE table, FRAME_DTYPE table
+    Trailer       index offset (u64), "TCRE", reserved (u32)
+
+  The record json holds everything in the image response except the pixels and
+  telemetry.  A recording that was not closed has no index.  It is rebuilt by
+  scanning the chunks when opened.
+
+  Copyright 2020-2022 Dan Julio
+
+  This file is part of tCam.
+
+  tCam is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  tCam is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+"""
+import re
+import json
+import mmap
+import time
+import zlib
+import base64
+import struct
+import binascii
+from datetime import datetime
+from queue import Queue, Full
+from threading import Thread, Event
+
+import numpy as np
+import frame
+
+FILE_HEADER = struct.Struct("<4sHHII")
+FILE_MAGIC = b"TCRF"
+FILE_VERSION = 1
+FLAG_ZLIB = 0x0001
+
+CHUNK_HEADER = struct.Struct("<4sIII")
+CHUNK_MAGIC = b"TCCH"
+
+RECORD_HEADER = struct.Struct("<dIIII")
+
+INDEX_HEADER = struct.Struct("<4sIII")
+INDEX_MAGIC = b"TCRX"
+
+TRAILER = struct.Struct("<Q4sI")
+TRAILER_MAGIC = b"TCRE"
+
+CHUNK_DTYPE = np.dtype([("offset", "<u8"), ("stored_len", "<u4"), ("raw_len", "<u4")])
+FRAME_DTYPE = np.dtype([("time", "<f8"), ("chunk", "<u4"), ("offset", "<u4")])
+
+DEF_CHUNK_FRAMES = 64
+
+
+def _to_bytes(data):
+    """Pixels or telemetry from an image response as bytes"""
+    if isinstance(data, str):
+        return binascii.a2b_base64(data)
+    if isinstance(data, (np.ndarray, np.void)):
+        return data.tobytes()
+    return bytes(data)
+
+
+def metadata_time(meta):
+    """
+    Convert the camera's metadata "Date" (M/D/YY) and "Time" (HH:MM:SS.MSEC) to a local time
+    in seconds since the epoch.  Returns NaN if they are missing.
+    """
+    try:
+        mon, day, year = (int(v) for v in meta["Date"].split("/"))
+        hms, _, msec = meta["Time"].partition(".")
+        hour, minute, sec = (int(v) for v in hms.split(":"))
+        t = datetime(2000 + year % 100, mon, day, hour, minute, sec).timestamp()
+        return t + (int(msec) / 1000 if msec else 0)
+    except (KeyError, ValueError, AttributeError):
+        return float("nan")
+
+
+################################################################################
+class Recorder:
+    """
+    Recorder - write images to a recording file
+
+        with Recorder("walk.tcrec", compress=True) as rec:
+            rec.write(cam.get_frame())
+    """
+
+    def __init__(self, path, compress=False, chunk_frames=DEF_CHUNK_FRAMES, level=1):
+        """
+        compress enables zlib compression of each chunk of chunk_frames images (level 1 is fast and
+        usually removes about a third of the size).  Compressed recordings are not memory mapped.
+        """
+        self.path = path
+        self.compress = compress
+        self.chunk_frames = chunk_frames
+        self.level = level
+        self.f = open(path, "wb")
+        self.f.write(FILE_HEADER.pack(FILE_MAGIC, FILE_VERSION, FLAG_ZLIB if compress else 0, chunk_frames, 0))
+        self.chunk = bytearray()
+        self.chunk_count = 0
+        self.chunks = []
+        self.frames = []
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __len__(self):
+        return len(self.frames)
+
+    def write(self, frameObj, timestamp=None):
+        """
+        Add an image response.  Pixels and telemetry may be base64 strings (TCam default) or arrays
+        (decode=True).  timestamp defaults to the current time.
+        """
+        img = _to_bytes(frameObj["radiometric"])
+        tel = _to_bytes(frameObj["telemetry"]) if "telemetry" in frameObj else b""
+        meta = json.dumps({k: v for k, v in frameObj.items() if k not in ("radiometric", "telemetry")},
+                          separators=(",", ":")).encode()
+        meta += b"\x00" * (-len(meta) % 8)
+        if timestamp is None:
+            timestamp = time.time()
+
+        self.frames.append((timestamp, len(self.chunks), len(self.chunk)))
+        self.chunk += RECORD_HEADER.pack(timestamp, len(meta), len(img), len(tel), 0)
+        self.chunk += meta
+        self.chunk += img
+        self.chunk += tel
+        self.chunk_count += 1
+        if self.chunk_count == self.chunk_frames:
+            self.flush()
+
+    def flush(self):
+        """Write the current chunk"""
+        if self.chunk_count == 0:
+            return
+        data = zlib.compress(self.chunk, self.level) if self.compress else self.chunk
+        self.chunks.append((self.f.tell() + CHUNK_HEADER.size, len(data), len(self.chunk)))
+        self.f.write(CHUNK_HEADER.pack(CHUNK_MAGIC, len(data), len(self.chunk), self.chunk_count))
+        self.f.write(data)
+        self.f.flush()
+        self.chunk = bytearray()
+        self.chunk_count = 0
+
+    def close(self):
+        """Write the last chunk and the index"""
+        if self.f is None:
+            return
+        self.flush()
+        index_offset = self.f.tell()
+        self.f.write(INDEX_HEADER.pack(INDEX_MAGIC, len(self.frames), len(self.chunks), 0))
+        self.f.write(np.array(self.chunks, dtype=CHUNK_DTYPE).tobytes())
+        self.f.write(np.array(self.frames, dtype=FRAME_DTYPE).tobytes())
+        self.f.write(TRAILER.pack(index_offset, TRAILER_MAGIC, 0))
+        self.f.close()
+        self.f = None
+
+
+################################################################################
+class RecordingReaderBase:
+    """
+    RecordingReaderBase - common reader API.  Subclasses load self.timestamps and implement
+    read_frame.  Images are returned as image responses with base64 strings, or with numpy arrays
+    if decode is set.
+    """
+
+    def __init__(self, path, decode=False):
+        self.path = path
+        self.decode = decode
+        self.timestamps = np.zeros(0)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __len__(self):
+        return len(self.timestamps)
+
+    def __getitem__(self, k):
+        if k < 0:
+            k += len(self)
+        if k < 0 or k >= len(self):
+            raise IndexError("frame index out of range")
+        return self.read_frame(k)
+
+    def __iter__(self):
+        for k in range(len(self)):
+            yield self.read_frame(k)
+
+    def find(self, timestamp):
+        """Return the index of the first image at or after timestamp"""
+        return int(np.searchsorted(self.timestamps, timestamp))
+
+    def read_frame(self, k):
+        raise NotImplementedError
+
+    def close(self):
+        pass
+
+
+class RecordingReader(RecordingReaderBase):
+    """
+    RecordingReader - read a recording written by Recorder.  Uncompressed recordings are memory
+    mapped and decoded images are views of the file (copy them to keep them after close()).
+    """
+
+    def __init__(self, path, decode=False):
+        super().__init__(path, decode)
+        self.f = open(path, "rb")
+        self.mm = mmap.mmap(self.f.fileno(), 0, access=mmap.ACCESS_READ)
+        self.buf = memoryview(self.mm)
+        self.cache_chunk = -1
+        self.cache_data = None
+        magic, version, self.flags, self.chunk_frames, _ = FILE_HEADER.unpack_from(self.buf)
+        if magic != FILE_MAGIC or version > FILE_VERSION:
+            self.close()
+            raise ValueError(f"{path} is not a tCam recording")
+        if not self._load_index():
+            self._scan_chunks()
+        self.timestamps = self.frames["time"]
+
+    def _load_index(self):
+        if len(self.buf) < FILE_HEADER.size + TRAILER.size:
+            return False
+        index_offset, magic, _ = TRAILER.unpack_from(self.buf, len(self.buf) - TRAILER.size)
+        if magic != TRAILER_MAGIC:
+            return False
+        magic, num_frames, num_chunks, _ = INDEX_HEADER.unpack_from(self.buf, index_offset)
+        if magic != INDEX_MAGIC:
+            return False
+        offset = index_offset + INDEX_HEADER.size
+        self.chunks = np.frombuffer(self.buf, dtype=CHUNK_DTYPE, count=num_chunks, offset=offset)
+        offset += num_chunks * CHUNK_DTYPE.itemsize
+        self.frames = np.frombuffer(self.buf, dtype=FRAME_DTYPE, count=num_frames, offset=offset)
+        return True
+
+    def _scan_chunks(self):
+        """Rebuild the index of a recording that was not closed, ignoring an incomplete last chunk"""
+        chunks = []
+        frames = []
+        offset = FILE_HEADER.size
+        while offset + CHUNK_HEADER.size <= len(self.buf):
+            magic, stored_len, raw_len, count = CHUNK_HEADER.unpack_from(self.buf, offset)
+            offset += CHUNK_HEADER.size
+            if magic != CHUNK_MAGIC or offset + stored_len > len(self.buf):
+                break
+            chunks.append((offset, stored_len, raw_len))
+            data = self._chunk_data(len(chunks) - 1, chunks[-1])
+            pos = 0
+            for i in range(count):
+                timestamp, meta_len, img_len, tel_len, _ = RECORD_HEADER.unpack_from(data, pos)
+                frames.append((timestamp, len(chunks) - 1, pos))
+                pos += RECORD_HEADER.size + meta_len + img_len + tel_len
+            offset += stored_len
+        self.chunks = np.array(chunks, dtype=CHUNK_DTYPE)
+        self.frames = np.array(frames, dtype=FRAME_DTYPE)
+
+    def _chunk_data(self, n, chunk):
+        offset, stored_len, raw_len = (int(v) for v in chunk)
+        if not self.flags & FLAG_ZLIB:
+            return self.buf[offset : offset + stored_len]
+        if n != self.cache_chunk:
+            # Compressed chunks are decompressed once for sequential access
+            self.cache_chunk = n
+            self.cache_data = zlib.decompress(self.buf[offset : offset + stored_len])
+        return self.cache_data
+
+    def read_raw(self, k):
+        """Return (timestamp, json dict, image bytes, telemetry bytes) for image k"""
+        n = int(self.frames[k]["chunk"])
+        data = self._chunk_data(n, self.chunks[n])
+        pos = int(self.frames[k]["offset"])
+        timestamp, meta_len, img_len, tel_len, _ = RECORD_HEADER.unpack_from(data, pos)
+        pos += RECORD_HEADER.size
+        meta = json.loads(bytes(data[pos : pos + meta_len]).rstrip(b"\x00"))
+        pos += meta_len
+        img = data[pos : pos + img_len]
+        pos += img_len
+        tel = data[pos : pos + tel_len]
+        return timestamp, meta, img, tel
+
+    def read_frame(self, k):
+        timestamp, frameObj, img, tel = self.read_raw(k)
+        if self.decode:
+            frameObj["radiometric"] = np.frombuffer(img, dtype="<u2").reshape(frame.IMG_HEIGHT, frame.IMG_WIDTH)
+            if len(tel):
+                frameObj["telemetry"] = np.frombuffer(tel, dtype=frame.TELEMETRY_DTYPE, count=1)[0]
+        else:
+            frameObj["radiometric"] = base64.b64encode(img).decode()
+            if len(tel):
+                frameObj["telemetry"] = base64.b64encode(tel).decode()
+        return frameObj
+
+    def close(self):
+        self.timestamps = np.zeros(0)
+        self.frames = None
+        self.chunks = None
+        self.cache_data = None
+        if self.buf is not None:
+            self.buf.release()
+            self.buf = None
+            try:
+                self.mm.close()
+            except BufferError:
+                # Decoded images still reference the file, it is unmapped when they are released
+                pass
+            self.f.close()
+
+
+class TjsnReader(RecordingReaderBase):
+    """
+    TjsnReader - read the camera's image (.tjsn) and movie (.tmjsn) files.  Movies are json image
+    strings separated by 0x03 followed by a "video_info" string.  The files are indexed when opened
+    and only the requested image is parsed.
+    """
+
+    TIME_RE = re.compile(rb'"Time"\s*:\s*"([^"]*)"')
+    DATE_RE = re.compile(rb'"Date"\s*:\s*"([^"]*)"')
+
+    def __init__(self, path, decode=False):
+        super().__init__(path, decode)
+        with open(path, "rb") as f:
+            self.data = f.read()
+        self.video_info = None
+        self.offsets = []
+        start = 0
+        while start < len(self.data):
+            end = self.data.find(b"\x03", start)
+            if end == -1:
+                end = len(self.data)
+            s = self.data[start:end].strip()
+            if s.startswith(b'{"video_info"'):
+                self.video_info = json.loads(s)["video_info"]
+            elif s:
+                self.offsets.append((start, end))
+            start = end + 1
+        self.timestamps = np.array([self._time(s, e) for s, e in self.offsets], dtype=np.float64)
+
+    def _time(self, start, end):
+        # Metadata comes first in the image json string
+        head = self.data[start : min(end, start + 512)]
+        t = self.TIME_RE.search(head)
+        d = self.DATE_RE.search(head)
+        if t is None or d is None:
+            return float("nan")
+        return metadata_time({"Time": t.group(1).decode(), "Date": d.group(1).decode()})
+
+    def read_frame(self, k):
+        start, end = self.offsets[k]
+        packet = memoryview(self.data)[start:end]
+        if self.decode:
+            return frame.parse_packet(packet)
+        return json.loads(bytes(packet))
+
+    def close(self):
+        self.data = b""
+
+
+def open_recording(path, decode=False):
+    """Return a reader for a .tcrec recording or a .tjsn/.tmjsn file"""
+    with open(path, "rb") as f:
+        magic = f.read(4)
+    if magic == FILE_MAGIC:
+        return RecordingReader(path, decode)
+    return TjsnReader(path, decode)
+
+
+def convert(src, dst, compress=False):
+    """Convert a .tjsn/.tmjsn file (or another recording) to a .tcrec recording"""
+    with open_recording(src) as reader, Recorder(dst, compress) as rec:
+        for k in range(len(reader)):
+            t = reader.timestamps[k]
+            rec.write(reader[k], None if np.isnan(t) else float(t))
+    return len(rec)
+
+
+################################################################################
+class TCamPlayer(Thread):
+    """
+    TCamPlayer - replay a recording into a frameQueue at the recorded rate (scaled by speed, 0 for
+    as fast as the queue is emptied).  get_frame, frame_count and shutdown work like TCam.
+    """
+
+    def __init__(self, recording, speed=1.0, loop=False, start=0, decode=False, maxsize=16):
+        super().__init__(daemon=True)
+        if isinstance(recording, str):
+            recording = open_recording(recording, decode)
+        self.reader = recording
+        self.speed = speed
+        self.loop = loop
+        self.startIndex = start
+        self.frameQueue = Queue(maxsize)
+        self.event = Event()
+        self.position = start
+        self.finished = False
+
+    def run(self):
+        while not self.event.is_set():
+            t0 = None
+            for k in range(self.startIndex, len(self.reader)):
+                if self.event.is_set():
+                    return
+                t = float(self.reader.timestamps[k])
+                if self.speed > 0 and not np.isnan(t):
+                    if t0 is None:
+                        t0 = t
+                        wall0 = time.monotonic()
+                    delay = (t - t0) / self.speed - (time.monotonic() - wall0)
+                    if delay > 0 and self.event.wait(delay):
+                        return
+                self.position = k
+                self._put(self.reader[k])
+            if not self.loop:
+                break
+            self.startIndex = 0
+        self.finished = True
+
+    def _put(self, frameObj):
+        while not self.event.is_set():
+            try:
+                self.frameQueue.put(frameObj, timeout=0.1)
+                return
+            except Full:
+                pass
+
+    def get_frame(self):
+        """
+        get_frame()
+        Returns the next image or None if none are waiting
+        """
+        if not self.frameQueue.empty():
+            return self.frameQueue.get()
+        return None
+
+    def frame_count(self):
+        return self.frameQueue.qsize()
+
+    def shutdown(self):
+        self.event.set()
+        if self.is_alive():
+            self.join()
+        self.reader.close()
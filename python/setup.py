@@ -0,0 +1,42 @@
+"""
+  Build the optional _tcam native module used by frame.py
+
+    python3 setup.py build_ext --inplace
+
+  Temperature conversion is compiled from the tCam-Mini firmware sources so the
+  host and camera use the same code.  frame.py falls back to numpy if the module
+  is not built.
+
+  Copyright 2020-2022 Dan Julio
+
+  This file is part of tCam.
+
+  tCam is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  tCam is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+"""
+
+from setuptools import setup, Extension
+
+LEPTON_DIR = "../tCam-Mini/firmware/components/lepton"
+
+setup(
+    name="tcam",
+    ext_modules=[
+        Extension(
+            "_tcam",
+            sources=["ext/_tcam.c", LEPTON_DIR + "/temp_utilities.c"],
+            include_dirs=[LEPTON_DIR],
+            extra_compile_args=["-O2"],
+        )
+    ],
+)
@@ -25,6 +25,7 @@ import json
 import array
 import base64
 import socket
+import struct
 from queue import Queue
 from json import JSONDecodeError
 from threading import Thread, Event
@@ -32,6 +33,12 @@ from threading import Thread, Event
 from fcntl import ioctl
 from ioctl_numbers import *
 
+try:
+    import frame
+except ImportError:
+    # numpy is only required to decode images
+    frame = None
+
 
 class TCamManagerThreadBase(Thread, metaclass=abc.ABCMeta):
     """
@@ -44,12 +51,13 @@ class TCamManagerThreadBase(Thread, metaclass=abc.ABCMeta):
     wake up the code that is sleeping by setting the event with self.event.set().
     """
 
-    def __init__(self, cmdQueue, responseQueue, frameQueue, timeout):
+    def __init__(self, cmdQueue, responseQueue, frameQueue, timeout, decode=False):
         self.cmdQueue = cmdQueue
         self.responseQueue = responseQueue
         self.frameQueue = frameQueue
         self.internalQueue = Queue()
         self.timeout = timeout
+        self.decode = decode
         self.connected = False
         self.running = False
         self.event = Event()
@@ -70,7 +78,7 @@ class TCamManagerThreadBase(Thread, metaclass=abc.ABCMeta):
         data into responses and deserialize them into python objects from JSON.
         """
         self.interface = None
-        scratch = b""
+        scratch = bytearray()
 
         while self.running:
             # The send part of the cycle
@@ -110,24 +118,33 @@ class TCamManagerThreadBase(Thread, metaclass=abc.ABCMeta):
         and you have a high enough frame rate, you may end up with more than one response in your buffer.  You may
         also have one stretched across reads.  This function attempts to extract complete ones and returns the
         remainder to be added to by the next read.
+
+        buf is a bytearray.  Responses are located with a cursor and parsed from a memoryview so the remainder is
+        only moved once, after all complete responses have been extracted.
         """
-        pkts = []
-        idx = buf.find(3)
-        while idx != -1:
-            pkts.append(buf[: idx + 1])
-            buf = buf[idx + 1 :]
+        start = 0
+        with memoryview(buf) as mv:
             idx = buf.find(3)
-
-        for response in pkts:
-            try:
-                respObj = json.loads(response.strip(b"\x02\x03").decode())
-                self.internalQueue.put(respObj)
-            except JSONDecodeError:
-                respObj = {
-                    "error": "malformed json payload, json parser threw exception processing it",
-                    "payload": response.decode(),
-                }
-                self.responseQueue.put(respObj)
+            while idx != -1:
+                # Skip anything before the start delimiter
+                s = buf.find(2, start, idx)
+                s = start if s == -1 else s + 1
+                with mv[s:idx] as response:
+                    try:
+                        if self.decode:
+                            respObj = frame.parse_packet(response)
+                        else:
+                            respObj = json.loads(response.tobytes())
+                        self.internalQueue.put(respObj)
+                    except (ValueError, UnicodeDecodeError):
+                        respObj = {
+                            "error": "malformed json payload, json parser threw exception processing it",
+                            "payload": response.tobytes().decode(errors="replace"),
+                        }
+                        self.responseQueue.put(respObj)
+                start = idx + 1
+                idx = buf.find(3, start)
+        del buf[:start]
         return buf
 
     @abc.abstractmethod
@@ -230,6 +247,8 @@ class TCamManagerThread(TCamManagerThreadBase):
 
     def post_process(self, msg):
         if "radiometric" in msg:
+            if self.decode and isinstance(msg["radiometric"], str):
+                frame.decode_frame(msg)
             self.frameQueue.put(msg)
         else:
             self.responseQueue.put(msg)
@@ -289,7 +308,10 @@ class TCamHwManagerThread(TCamManagerThreadBase):
         
     def post_process(self, msg):
         if "image_ready" in msg:
-            self.frameQueue.put(self.get_spi_frame(msg['image_ready']))
+            frameObj = self.get_spi_frame(msg['image_ready'])
+            if self.decode and isinstance(frameObj, dict):
+                frame.decode_frame(frameObj)
+            self.frameQueue.put(frameObj)
         else:
             self.responseQueue.put(msg)
 
@@ -311,13 +333,148 @@ class TCamHwManagerThread(TCamManagerThreadBase):
 
 
 
+################################################################################
+class TCamUdpReceiver(Thread):
+    """
+    TCamUdpReceiver - The background thread that receives images streamed over UDP (usually to a
+    multicast group) and puts complete images on a frameQueue.
+
+    Each datagram carries a fragment header followed by part of an image.  Fragments are
+    reassembled by image number.  Images missing any fragments are dropped when a newer image
+    completes or when too many images are incomplete.  Any number of receivers may listen to a
+    multicast group while one TCam object controls the camera over its TCP connection.
+    """
+    HEADER = struct.Struct("<4sIHHI")   # magic, frame, frag, num, len
+    MAGIC = b"TCUF"
+    IMAGE_HEADER = struct.Struct("<4sHHII")   # binary image frame: magic, version, meta_len, img_len, tel_len
+    IMAGE_MAGIC = b"TCIF"
+    MAX_PENDING = 4
+
+    def __init__(self, frameQueue, udp_addr, udp_port=5002, iface="0.0.0.0", timeout=1, decode=False):
+        self.frameQueue = frameQueue
+        self.decode = decode
+        self.udp_addr = udp_addr
+        self.udp_port = udp_port
+        self.iface = iface
+        self.timeout = timeout
+        self.running = False
+        self.pending = {}      # frame number -> [num, len, fragments, received]
+        self.frames = 0
+        self.dropped = 0
+        super().__init__(daemon=True)
+
+    def start(self):
+        self.sock = self.open_socket()
+        self.running = True
+        super().start()
+
+    def stop(self):
+        self.running = False
+
+    def open_socket(self):
+        sock = socket.socket(family=socket.AF_INET, type=socket.SOCK_DGRAM)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        if hasattr(socket, "SO_REUSEPORT"):
+            # Allow several viewers on one computer
+            sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+        sock.bind(("", self.udp_port))
+        if 224 <= int(self.udp_addr.split(".")[0]) <= 239:
+            mreq = struct.pack("4s4s", socket.inet_aton(self.udp_addr), socket.inet_aton(self.iface))
+            sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, mreq)
+        sock.settimeout(self.timeout)
+        return sock
+
+    def run(self):
+        while self.running:
+            try:
+                pkt = self.sock.recv(65536)
+            except socket.timeout:
+                continue
+            self.process_datagram(pkt)
+        self.sock.close()
+
+    def process_datagram(self, pkt):
+        """
+        process_datagram()
+
+        Add a fragment to its image and queue the image when it is complete.
+        """
+        if len(pkt) < self.HEADER.size:
+            return
+        magic, frame_num, frag, num, length = self.HEADER.unpack_from(pkt)
+        if magic != self.MAGIC or frag >= num:
+            return
+
+        entry = self.pending.get(frame_num)
+        if entry is None:
+            if len(self.pending) >= self.MAX_PENDING:
+                # Drop the oldest incomplete image (images are kept in arrival order)
+                del self.pending[next(iter(self.pending))]
+                self.dropped += 1
+            entry = [num, length, [None] * num, 0]
+            self.pending[frame_num] = entry
+        if entry[2][frag] is None:
+            entry[2][frag] = pkt[self.HEADER.size:]
+            entry[3] += 1
+        if entry[3] < entry[0]:
+            return
+
+        # Complete: older incomplete images will never be shown
+        del self.pending[frame_num]
+        for f in [f for f in self.pending if f < frame_num]:
+            del self.pending[f]
+            self.dropped += 1
+
+        data = b"".join(entry[2])
+        frameObj = self.decode_image(data) if len(data) == entry[1] else None
+        if frameObj is None:
+            self.dropped += 1
+        else:
+            self.frames += 1
+            self.frameQueue.put(frameObj)
+
+    def decode_image(self, data):
+        """
+        decode_image()
+
+        Convert a json image string or a binary image frame into the same dictionary returned for
+        images received over the TCP connection.
+        """
+        try:
+            if self.decode:
+                if data[:4] == self.IMAGE_MAGIC:
+                    # Pixels and telemetry are views of the received data
+                    return frame.decode_binary_frame(data)
+                return frame.parse_packet(data.strip(b"\x02\x03"))
+            if data[:4] == self.IMAGE_MAGIC:
+                magic, version, meta_len, img_len, tel_len = self.IMAGE_HEADER.unpack_from(data)
+                offset = self.IMAGE_HEADER.size
+                frameObj = {"metadata": json.loads(data[offset : offset + meta_len].rstrip(b"\x00").decode())}
+                offset += meta_len
+                frameObj["radiometric"] = base64.b64encode(data[offset : offset + img_len]).decode()
+                offset += img_len
+                frameObj["telemetry"] = base64.b64encode(data[offset : offset + tel_len]).decode()
+                return frameObj
+            return json.loads(data.strip(b"\x02\x03").decode())
+        except (JSONDecodeError, UnicodeDecodeError, struct.error, ValueError):
+            return None
+
+
+
 ################################################################################
 class TCam:
     """
     TCam - Interface object for managing a tCam device.
     """
 
-    def __init__(self, timeout=1, responseTimeout=10, is_hw=False):
+    def __init__(self, timeout=1, responseTimeout=10, is_hw=False, decode=False):
+        """
+        Set decode to have images returned with numpy arrays instead of base64 strings (requires numpy).
+        "radiometric" is a (120, 160) uint16 array and "telemetry" a frame.TELEMETRY_DTYPE record.
+        """
+        if decode and frame is None:
+            raise ImportError("decode requires numpy")
+        self.decode = decode
         self.frameQueue = Queue()
         self.cmdQueue = Queue()
         self.responseQueue = Queue()
@@ -332,6 +489,7 @@ class TCam:
                 cmdQueue=self.cmdQueue,
                 frameQueue=self.frameQueue,
                 timeout=self.timeout,
+                decode=decode,
             )
         else:
             self.managerThread = TCamManagerThread(
@@ -339,9 +497,11 @@ class TCam:
                 cmdQueue=self.cmdQueue,
                 frameQueue=self.frameQueue,
                 timeout=self.timeout,
+                decode=decode,
             )
 
         self.managerThread.start()
+        self.udpReceiver = None
         
 
     def hwChecks(self):
@@ -405,21 +565,61 @@ class TCam:
         because the manager thread is still alive in the background.  Calling stop and join on it will clean it up.
         """
         self.disconnect()
+        self.stop_udp_receiver()
         self.managerThread.stop()
         self.managerThread.join()
 
     ##########################################################################################
     # Image/sensor array commands
-    def start_stream(self, delay_msec=0, num_frames=0, timeout=None):
+    def start_stream(self, delay_msec=0, num_frames=0, timeout=None, udp_addr=None, udp_port=5002, binary=False):
+        """
+        start_stream()
+        Images are streamed over the connection unless udp_addr is specified.  Then they are sent to
+        that (usually multicast) address and received into the frame queue by a TCamUdpReceiver.
+        """
         if not timeout:
             timeout = self.responseTimeout
         cmd = {
             "cmd": "stream_on",
             "args": {"delay_msec": delay_msec, "num_frames": num_frames},
         }
+        if udp_addr:
+            self.start_udp_receiver(udp_addr, udp_port)
+            cmd["args"]["udp_addr"] = udp_addr
+            cmd["args"]["udp_port"] = udp_port
+            if binary:
+                cmd["args"]["binary"] = 1
         self.cmdQueue.put(cmd)
         return self.responseQueue.get(block=True, timeout=timeout)
 
+    def start_udp_receiver(self, udp_addr, udp_port=5002, iface="0.0.0.0"):
+        """
+        start_udp_receiver()
+        Receive images streamed over UDP into the frame queue.  Used directly by viewers that do not
+        control the camera.
+        """
+        if self.udpReceiver:
+            if self.udpReceiver.udp_addr == udp_addr and self.udpReceiver.udp_port == udp_port:
+                return
+            self.stop_udp_receiver()
+        self.udpReceiver = TCamUdpReceiver(self.frameQueue, udp_addr, udp_port, iface, self.timeout, self.decode)
+        self.udpReceiver.start()
+
+    def stop_udp_receiver(self):
+        if self.udpReceiver:
+            self.udpReceiver.stop()
+            self.udpReceiver.join()
+            self.udpReceiver = None
+
+    def udp_stats(self):
+        """
+        udp_stats()
+        Returns the number of images received and dropped by the UDP receiver
+        """
+        if self.udpReceiver:
+            return {"frames": self.udpReceiver.frames, "dropped": self.udpReceiver.dropped}
+        return {"frames": 0, "dropped": 0}
+
     def stop_stream(self, timeout=None):
         if not timeout:
             timeout = self.responseTimeout
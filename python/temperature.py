@@ -0,0 +1,94 @@
+"""
+  tCam radiometric temperature conversion
+
+  Converts Lepton TLinear pixel counts to temperatures in degrees C, F or K for
+  both TLinear resolutions.  A 65536 entry lookup table is built once for the
+  current resolution and unit and whole images are converted by indexing it.
+
+  Copyright 2020-2022 Dan Julio
+
+  This file is part of tCam.
+
+  tCam is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  tCam is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+"""
+
+import numpy as np
+
+# TLinear resolution (telemetry row C word 49, RAD 0x0EC4)
+RES_LOW = 0     # 0.1 K per count
+RES_HIGH = 1    # 0.01 K per count
+
+# Temperature units
+UNIT_C = "C"
+UNIT_F = "F"
+UNIT_K = "K"
+
+# Telemetry word holding the TLinear resolution (row C, word 49)
+TELEM_TLIN_RES = 209
+
+
+class TempConverter:
+    def __init__(self, res=RES_HIGH, unit=UNIT_C):
+        self.res = None
+        self.unit = None
+        self.scale = 0.0
+        self.offset = 0.0
+        self.lut = None
+        self.set(res, unit)
+
+    def set(self, res, unit=None):
+        """Select the resolution and unit.  The lookup table is only rebuilt when one changes."""
+        if unit is None:
+            unit = self.unit
+        if unit not in (UNIT_C, UNIT_F, UNIT_K):
+            raise ValueError(f"unknown unit {unit}")
+        res = RES_HIGH if res else RES_LOW
+        if res == self.res and unit == self.unit:
+            return False
+
+        k_per_count = 0.01 if res == RES_HIGH else 0.1
+        if unit == UNIT_F:
+            self.scale = k_per_count * 9.0 / 5.0
+            self.offset = -459.67
+        elif unit == UNIT_K:
+            self.scale = k_per_count
+            self.offset = 0.0
+        else:
+            self.scale = k_per_count
+            self.offset = -273.15
+        self.res = res
+        self.unit = unit
+        self.lut = (np.arange(65536, dtype=np.float32) * np.float32(self.scale) +
+                    np.float32(self.offset))
+        return True
+
+    def set_from_telemetry(self, telemetry):
+        """Select the resolution indicated by a decoded telemetry array"""
+        return self.set(telemetry[TELEM_TLIN_RES])
+
+    def to_temp(self, counts):
+        """Convert a single (possibly fractional, e.g. mean) count value"""
+        return counts * self.scale + self.offset
+
+    def delta_to_temp(self, delta_counts):
+        """Convert a count difference (e.g. standard deviation)"""
+        return delta_counts * self.scale
+
+    def to_counts(self, temp):
+        """Convert a temperature to the nearest count value"""
+        return int(min(max(round((temp - self.offset) / self.scale), 0), 65535))
+
+    def frame_to_temp(self, frame):
+        """Convert an array of 16-bit radiometric pixels to a float32 array of temperatures"""
+        return self.lut[np.asarray(frame, dtype=np.uint16)]
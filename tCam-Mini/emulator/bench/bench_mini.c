@@ -0,0 +1,404 @@
+/*
+ * tCam-Mini Benchmarks
+ *
+ * Times the tCam-Mini firmware's frame path on Linux: VoSPI segment reassembly,
+ * frame copy with min/max, temporal filtering, base64 encoding and decoding and json
+ * and binary image generation.  The firmware sources are compiled unmodified against the emulator's
+ * shim.  VoSPI packets are generated from each corpus frame and fed to the vospi
+ * module through the shim's SPI driver.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "bench_utilities.h"
+#include "emu_config.h"
+#include "emu_sys_utilities.h"
+#include "filter_utilities.h"
+#include "json_utilities.h"
+#include "lepton_utilities.h"
+#include "sys_utilities.h"
+#include "vospi.h"
+#include "driver/spi_master.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "mbedtls/base64.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+//
+// tCam-Mini Benchmark constants
+//
+
+// VoSPI stream for one frame with telemetry: 4 segments of 61 packets
+#define VOSPI_SEGMENTS      4
+#define VOSPI_PKTS_PER_FRAME (VOSPI_SEGMENTS * LEP_TEL_PKTS_PER_SEG)
+#define VOSPI_FRAME_BYTES   (VOSPI_PKTS_PER_FRAME * LEP_PKT_LENGTH)
+
+// Base64 encoded image length (with null)
+#define B64_IMG_LEN         (((LEP_NUM_PIXELS * 2 + 2) / 3) * 4 + 1)
+
+// Temporal filter settings timed
+#define NUM_FILTER_SETTINGS 5
+
+
+
+//
+// tCam-Mini Benchmark variables
+//
+
+// Per-frame data prepared from the corpus
+static lep_buffer_t* lep_bufs;
+static uint8_t** vospi_streams;
+static char** b64_imgs;
+
+// VoSPI packet source for the SPI shim
+static uint8_t* vospi_pktP;
+static uint8_t* vospi_endP;
+
+// Temporal filter settings (strength, motion)
+static const int filter_settings[NUM_FILTER_SETTINGS][2] = {
+	{1, 100}, {2, 100}, {4, 100}, {2, 10}, {2, 1000}
+};
+
+// Output buffers
+static char* b64_buf;
+static uint16_t* img_buf;
+static lep_buffer_t out_buf;
+
+
+
+//
+// tCam-Mini Benchmark Forward Declarations for internal functions
+//
+static bool prepare_corpus(bench_corpus_t* corpus);
+static void free_corpus(bench_corpus_t* corpus);
+static void gen_vospi_stream(uint8_t* pkts, const uint16_t* img, const uint16_t* tel);
+static uint32_t bench_vospi_reassemble(bench_corpus_t* corpus, int n);
+static uint32_t bench_vospi_get_frame(bench_corpus_t* corpus, int n);
+static uint32_t bench_base64_encode(bench_corpus_t* corpus, int n);
+static uint32_t bench_base64_decode(bench_corpus_t* corpus, int n);
+static uint32_t bench_json_image_build(bench_corpus_t* corpus, int n);
+static uint32_t bench_binary_image_build(bench_corpus_t* corpus, int n);
+static void run_filter_benchmarks(bench_corpus_t* corpus);
+static uint32_t bench_filter_prime(bench_corpus_t* corpus, int n);
+static uint32_t bench_filter_steady(bench_corpus_t* corpus, int n);
+
+
+
+//
+// Main
+//
+int main(int argc, char** argv)
+{
+	bench_corpus_t corpus;
+	int i;
+	
+	if (!bench_init("tcam-mini", BENCH_MINI_VERSION, argc, argv, &i)) {
+		return 1;
+	}
+	
+	// Setup the firmware modules like the emulator
+	emu_config.lep_type = LEP_TYPE_3_5;
+	strcpy(emu_config.name, "tCam-Mini-BENCH");
+	system_emu_init();
+	if (!system_buffer_init()) return 1;
+	
+	vospi_init(0);
+	vospi_include_telem(true);
+	
+	b64_buf = malloc(B64_IMG_LEN);
+	img_buf = malloc(LEP_NUM_PIXELS * 2);
+	out_buf.lep_bufferP = malloc(LEP_NUM_PIXELS * 2);
+	out_buf.lep_telemP = malloc(LEP_TEL_WORDS * 2);
+	if ((b64_buf == NULL) || (img_buf == NULL) || (out_buf.lep_bufferP == NULL) || (out_buf.lep_telemP == NULL)) {
+		fprintf(stderr, "Could not allocate output buffers\n");
+		return 1;
+	}
+	
+	for (; i<argc; i++) {
+		if (!bench_load_corpus(argv[i], &corpus)) return 1;
+		if (!prepare_corpus(&corpus)) return 1;
+		
+		bench_run("vospi_reassemble", &corpus, bench_vospi_reassemble);
+		bench_vospi_reassemble(&corpus, 0);
+		bench_run("vospi_get_frame", &corpus, bench_vospi_get_frame);
+		run_filter_benchmarks(&corpus);
+		bench_run("base64_encode", &corpus, bench_base64_encode);
+		bench_run("base64_decode", &corpus, bench_base64_decode);
+		bench_run("json_image_build", &corpus, bench_json_image_build);
+		bench_run("binary_image_build", &corpus, bench_binary_image_build);
+		
+		free_corpus(&corpus);
+		bench_free_corpus(&corpus);
+	}
+	
+	return bench_exit_status();
+}
+
+
+
+//
+// SPI driver shim
+//
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t* dev_config, spi_device_handle_t* handle)
+{
+	*handle = NULL;
+	return ESP_OK;
+}
+
+
+/**
+ * Return the next packet from the current VoSPI stream or a discard packet when the
+ * stream is exhausted
+ */
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t* trans_desc)
+{
+	uint8_t* rxP = (uint8_t*) trans_desc->rx_buffer;
+	
+	if (vospi_pktP < vospi_endP) {
+		memcpy(rxP, vospi_pktP, LEP_PKT_LENGTH);
+		vospi_pktP += LEP_PKT_LENGTH;
+	} else {
+		rxP[0] = 0x0F;
+		rxP[1] = 0xFF;
+	}
+	
+	return ESP_OK;
+}
+
+
+
+//
+// tCam-Mini Benchmark internal functions
+//
+static bool prepare_corpus(bench_corpus_t* corpus)
+{
+	bench_frame_t* f;
+	char* cp;
+	char* ep;
+	int i;
+	
+	lep_bufs = calloc(corpus->num_frames, sizeof(lep_buffer_t));
+	vospi_streams = calloc(corpus->num_frames, sizeof(uint8_t*));
+	b64_imgs = calloc(corpus->num_frames, sizeof(char*));
+	if ((lep_bufs == NULL) || (vospi_streams == NULL) || (b64_imgs == NULL)) return false;
+	
+	for (i=0; i<corpus->num_frames; i++) {
+		f = &corpus->frames[i];
+		
+		lep_bufs[i].telem_valid = true;
+		lep_bufs[i].lep_bufferP = f->img;
+		lep_bufs[i].lep_telemP = f->tel;
+		
+		vospi_streams[i] = malloc(VOSPI_FRAME_BYTES);
+		if (vospi_streams[i] == NULL) return false;
+		gen_vospi_stream(vospi_streams[i], f->img, f->tel);
+		
+		// Extract the encoded image string
+		cp = strstr(f->json, "\"radiometric\"");
+		if (cp != NULL) cp = strchr(cp + 13, '"');
+		ep = (cp != NULL) ? strchr(cp + 1, '"') : NULL;
+		if (ep == NULL) {
+			fprintf(stderr, "Could not find radiometric string in %s\n", corpus->name);
+			return false;
+		}
+		cp++;
+		b64_imgs[i] = strndup(cp, ep - cp);
+	}
+	
+	return true;
+}
+
+
+static void free_corpus(bench_corpus_t* corpus)
+{
+	int i;
+	
+	for (i=0; i<corpus->num_frames; i++) {
+		free(vospi_streams[i]);
+		free(b64_imgs[i]);
+	}
+	free(lep_bufs);
+	free(vospi_streams);
+	free(b64_imgs);
+}
+
+
+/**
+ * Generate the packets the Lepton sends for a frame with telemetry as a footer.  The
+ * 240 image packets are split across the four segments followed by the three telemetry
+ * packets and an unused packet.  The segment number is carried in packet 20.
+ */
+static void gen_vospi_stream(uint8_t* pkts, const uint16_t* img, const uint16_t* tel)
+{
+	const uint16_t* srcP;
+	int seg, line, i;
+	int pkt_num;
+	
+	for (seg=1; seg<=VOSPI_SEGMENTS; seg++) {
+		for (line=0; line<LEP_TEL_PKTS_PER_SEG; line++) {
+			pkt_num = (seg - 1) * LEP_TEL_PKTS_PER_SEG + line;
+			if (pkt_num < LEP_HEIGHT * 2) {
+				srcP = &img[pkt_num * (LEP_WIDTH / 2)];
+			} else if (pkt_num < LEP_HEIGHT * 2 + LEP_TEL_PACKETS) {
+				srcP = &tel[(pkt_num - LEP_HEIGHT * 2) * (LEP_WIDTH / 2)];
+			} else {
+				srcP = NULL;
+			}
+			
+			pkts[0] = (line == 20) ? (seg << 4) : 0;
+			pkts[1] = line;
+			pkts[2] = 0;
+			pkts[3] = 0;
+			for (i=0; i<LEP_WIDTH/2; i++) {
+				pkts[4 + i*2] = (srcP != NULL) ? (srcP[i] >> 8) : 0;
+				pkts[5 + i*2] = (srcP != NULL) ? (srcP[i] & 0xFF) : 0;
+			}
+			pkts += LEP_PKT_LENGTH;
+		}
+	}
+}
+
+
+static uint32_t bench_vospi_reassemble(bench_corpus_t* corpus, int n)
+{
+	int i;
+	
+	vospi_pktP = vospi_streams[n];
+	vospi_endP = vospi_pktP + VOSPI_FRAME_BYTES;
+	
+	for (i=0; i<VOSPI_SEGMENTS-1; i++) {
+		if (vospi_transfer_segment(esp_timer_get_time())) return 0;
+	}
+	if (!vospi_transfer_segment(esp_timer_get_time())) return 0;
+	
+	return VOSPI_FRAME_BYTES;
+}
+
+
+/**
+ * Copy the most recently reassembled frame (the corpus' first frame) and find its
+ * min/max values
+ */
+static uint32_t bench_vospi_get_frame(bench_corpus_t* corpus, int n)
+{
+	vospi_get_frame(&out_buf);
+	
+	return (out_buf.lep_max_val >= out_buf.lep_min_val) ? (LEP_NUM_PIXELS + LEP_TEL_WORDS) * 2 : 0;
+}
+
+
+static uint32_t bench_base64_encode(bench_corpus_t* corpus, int n)
+{
+	size_t len;
+	
+	if (mbedtls_base64_encode((unsigned char*) b64_buf, B64_IMG_LEN, &len,
+	                          (const unsigned char*) corpus->frames[n].img, LEP_NUM_PIXELS * 2) != 0) {
+		return 0;
+	}
+	
+	return LEP_NUM_PIXELS * 2;
+}
+
+
+static uint32_t bench_base64_decode(bench_corpus_t* corpus, int n)
+{
+	size_t len;
+	
+	if (mbedtls_base64_decode((unsigned char*) img_buf, LEP_NUM_PIXELS * 2, &len,
+	                          (const unsigned char*) b64_imgs[n], strlen(b64_imgs[n])) != 0) {
+		return 0;
+	}
+	
+	return (uint32_t) len;
+}
+
+
+static uint32_t bench_json_image_build(bench_corpus_t* corpus, int n)
+{
+	return json_get_image_file_string(sys_image_rsp_buffer.bufferP + 1, &lep_bufs[n]);
+}
+
+
+static uint32_t bench_binary_image_build(bench_corpus_t* corpus, int n)
+{
+	return json_get_image_frame(sys_image_rsp_buffer.bufferP, &lep_bufs[n]);
+}
+
+
+/**
+ * Time the stream consumer's temporal filter at each setting, both restarting with
+ * every frame (priming) and running continuously over the corpus
+ */
+static void run_filter_benchmarks(bench_corpus_t* corpus)
+{
+	char name[40];
+	filter_config_t config;
+	int i;
+	
+	config.enable = true;
+	for (i=0; i<NUM_FILTER_SETTINGS; i++) {
+		config.strength = filter_settings[i][0];
+		config.motion = filter_settings[i][1];
+		if (!filter_set_config(FILTER_CONSUMER_STREAM, &config)) {
+			fprintf(stderr, "Could not configure filter\n");
+			return;
+		}
+		
+		sprintf(name, "filter_prime_s%d_m%d", config.strength, config.motion);
+		bench_run(name, corpus, bench_filter_prime);
+		
+		filter_reset(FILTER_CONSUMER_STREAM);
+		sprintf(name, "filter_steady_s%d_m%d", config.strength, config.motion);
+		bench_run(name, corpus, bench_filter_steady);
+	}
+	
+	config.enable = false;
+	(void) filter_set_config(FILTER_CONSUMER_STREAM, &config);
+}
+
+
+/**
+ * Filter a frame into a copy as the first image after a reset, like lep_task does for
+ * the stream consumer
+ */
+static uint32_t bench_filter_prime(bench_corpus_t* corpus, int n)
+{
+	int min_index, max_index;
+	
+	filter_reset(FILTER_CONSUMER_STREAM);
+	if (!filter_apply_copy(FILTER_CONSUMER_STREAM, corpus->frames[n].img, img_buf, &min_index, &max_index)) return 0;
+	
+	return LEP_NUM_PIXELS * 2;
+}
+
+
+/**
+ * Filter a frame into a copy with the state left by the previous frame
+ */
+static uint32_t bench_filter_steady(bench_corpus_t* corpus, int n)
+{
+	int min_index, max_index;
+	
+	if (!filter_apply_copy(FILTER_CONSUMER_STREAM, corpus->frames[n].img, img_buf, &min_index, &max_index)) return 0;
+	
+	return LEP_NUM_PIXELS * 2;
+}
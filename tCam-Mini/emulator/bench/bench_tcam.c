@@ -0,0 +1,287 @@
+/*
+ * tCam Benchmarks
+ *
+ * Times the tCam firmware's receive and display path on Linux: json and binary image
+ * parsing (base64 decoding and min/max location) and the image render kernels.  The
+ * firmware sources are compiled unmodified against the emulator's shim.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "bench_utilities.h"
+#include "json_utilities.h"
+#include "gui_utilities.h"
+#include "lepton_utilities.h"
+#include "palettes.h"
+#include "render.h"
+#include "sys_utilities.h"
+#include "cJSON.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+//
+// tCam Benchmark variables
+//
+
+// Render buffer used by the interpolating renderers (normally allocated by sys_utilities)
+uint16_t* gui_render_buffer;
+
+// Per-frame data prepared from the corpus
+static lep_buffer_t* lep_bufs;
+static char** bin_frames;
+static int* bin_frame_lens;
+
+// Output buffers
+static lep_buffer_t out_buf;
+static uint16_t* img_buf;
+static gui_state_t render_st;
+
+
+
+//
+// tCam Benchmark Forward Declarations for internal functions
+//
+static bool prepare_corpus(bench_corpus_t* corpus);
+static void free_corpus(bench_corpus_t* corpus);
+static bool gen_binary_frame(bench_frame_t* f, char** frame, int* len);
+static uint32_t bench_json_parse_image_string(bench_corpus_t* corpus, int n);
+static uint32_t bench_json_parse_image(bench_corpus_t* corpus, int n);
+static uint32_t bench_json_parse_image_frame(bench_corpus_t* corpus, int n);
+static uint32_t render(bench_corpus_t* corpus, int n, bool interp, bool heq);
+static uint32_t bench_render_double(bench_corpus_t* corpus, int n);
+static uint32_t bench_render_interp(bench_corpus_t* corpus, int n);
+static uint32_t bench_render_double_heq(bench_corpus_t* corpus, int n);
+static uint32_t bench_render_interp_heq(bench_corpus_t* corpus, int n);
+static uint32_t bench_render_markers(bench_corpus_t* corpus, int n);
+
+
+
+//
+// Main
+//
+int main(int argc, char** argv)
+{
+	bench_corpus_t corpus;
+	int i;
+	
+	if (!bench_init("tcam", BENCH_TCAM_VERSION, argc, argv, &i)) {
+		return 1;
+	}
+	
+	gui_render_buffer = malloc(LEP_IMG_PIXELS * 2);
+	img_buf = malloc(IMG_BUF_WIDTH * IMG_BUF_HEIGHT * 2);
+	out_buf.lep_bufferP = malloc(LEP_NUM_PIXELS * 2);
+	out_buf.lep_telemP = malloc(LEP_TEL_WORDS * 2);
+	if ((gui_render_buffer == NULL) || (img_buf == NULL) || (out_buf.lep_bufferP == NULL) ||
+	    (out_buf.lep_telemP == NULL)) {
+		fprintf(stderr, "Could not allocate output buffers\n");
+		return 1;
+	}
+	set_palette(0);
+	
+	for (; i<argc; i++) {
+		if (!bench_load_corpus(argv[i], &corpus)) return 1;
+		if (!prepare_corpus(&corpus)) return 1;
+		
+		bench_run("json_parse_image_string", &corpus, bench_json_parse_image_string);
+		bench_run("json_parse_image", &corpus, bench_json_parse_image);
+		bench_run("json_parse_image_frame", &corpus, bench_json_parse_image_frame);
+		bench_run("render_double", &corpus, bench_render_double);
+		bench_run("render_interp", &corpus, bench_render_interp);
+		if (!corpus.frames[0].agc) {
+			// Histogram equalization only applies to radiometric images
+			bench_run("render_double_heq", &corpus, bench_render_double_heq);
+			bench_run("render_interp_heq", &corpus, bench_render_interp_heq);
+		}
+		bench_run("render_markers", &corpus, bench_render_markers);
+		
+		free_corpus(&corpus);
+		bench_free_corpus(&corpus);
+	}
+	
+	return bench_exit_status();
+}
+
+
+
+//
+// tCam Benchmark internal functions
+//
+static bool prepare_corpus(bench_corpus_t* corpus)
+{
+	int i;
+	
+	lep_bufs = calloc(corpus->num_frames, sizeof(lep_buffer_t));
+	bin_frames = calloc(corpus->num_frames, sizeof(char*));
+	bin_frame_lens = calloc(corpus->num_frames, sizeof(int));
+	if ((lep_bufs == NULL) || (bin_frames == NULL) || (bin_frame_lens == NULL)) return false;
+	
+	for (i=0; i<corpus->num_frames; i++) {
+		// Parsed image used by the renderers (also validates the firmware's parser)
+		lep_bufs[i].lep_bufferP = malloc(LEP_NUM_PIXELS * 2);
+		lep_bufs[i].lep_telemP = malloc(LEP_TEL_WORDS * 2);
+		if ((lep_bufs[i].lep_bufferP == NULL) || (lep_bufs[i].lep_telemP == NULL)) return false;
+		if (!json_parse_image_string(corpus->frames[i].json, &lep_bufs[i]) ||
+		    (memcmp(lep_bufs[i].lep_bufferP, corpus->frames[i].img, LEP_NUM_PIXELS * 2) != 0)) {
+			fprintf(stderr, "Image %d in %s does not parse\n", i, corpus->name);
+			return false;
+		}
+		
+		if (!gen_binary_frame(&corpus->frames[i], &bin_frames[i], &bin_frame_lens[i])) {
+			fprintf(stderr, "Could not create binary frame %d for %s\n", i, corpus->name);
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+
+static void free_corpus(bench_corpus_t* corpus)
+{
+	int i;
+	
+	for (i=0; i<corpus->num_frames; i++) {
+		free(lep_bufs[i].lep_bufferP);
+		free(lep_bufs[i].lep_telemP);
+		free(bin_frames[i]);
+	}
+	free(lep_bufs);
+	free(bin_frames);
+	free(bin_frame_lens);
+}
+
+
+/**
+ * Create the binary image frame tCam-Mini would send for a corpus frame
+ */
+static bool gen_binary_frame(bench_frame_t* f, char** frame, int* len)
+{
+	char* meta;
+	char* cp;
+	cJSON* obj;
+	int meta_len;
+	json_img_frame_hdr_t* hdrP;
+	
+	obj = json_get_object(f->json);
+	if (obj == NULL) return false;
+	meta = cJSON_PrintUnformatted(cJSON_GetObjectItem(obj, "metadata"));
+	json_free_object(obj);
+	if (meta == NULL) return false;
+	
+	meta_len = (strlen(meta) + 1 + 3) & ~3;
+	*len = sizeof(json_img_frame_hdr_t) + meta_len + (LEP_NUM_PIXELS + LEP_TEL_WORDS) * 2;
+	*frame = calloc(1, *len);
+	if (*frame == NULL) {
+		free(meta);
+		return false;
+	}
+	
+	hdrP = (json_img_frame_hdr_t*) *frame;
+	hdrP->magic = JSON_IMG_FRAME_MAGIC;
+	hdrP->version = JSON_IMG_FRAME_VERSION;
+	hdrP->meta_len = meta_len;
+	hdrP->img_len = LEP_NUM_PIXELS * 2;
+	hdrP->tel_len = LEP_TEL_WORDS * 2;
+	cp = *frame + sizeof(json_img_frame_hdr_t);
+	strcpy(cp, meta);
+	cp += meta_len;
+	memcpy(cp, f->img, LEP_NUM_PIXELS * 2);
+	memcpy(cp + LEP_NUM_PIXELS * 2, f->tel, LEP_TEL_WORDS * 2);
+	free(meta);
+	
+	return true;
+}
+
+
+static uint32_t bench_json_parse_image_string(bench_corpus_t* corpus, int n)
+{
+	if (!json_parse_image_string(corpus->frames[n].json, &out_buf)) return 0;
+	
+	return corpus->frames[n].json_len;
+}
+
+
+static uint32_t bench_json_parse_image(bench_corpus_t* corpus, int n)
+{
+	bool success;
+	cJSON* obj;
+	uint64_t ts_msec;
+	
+	obj = json_get_object(corpus->frames[n].json);
+	if (obj == NULL) return 0;
+	success = json_parse_image(obj, &ts_msec, &out_buf);
+	json_free_object(obj);
+	
+	return success ? corpus->frames[n].json_len : 0;
+}
+
+
+static uint32_t bench_json_parse_image_frame(bench_corpus_t* corpus, int n)
+{
+	if (!json_parse_image_frame(bin_frames[n], bin_frame_lens[n], &out_buf)) return 0;
+	
+	return bin_frame_lens[n];
+}
+
+
+static uint32_t render(bench_corpus_t* corpus, int n, bool interp, bool heq)
+{
+	render_st.agc_enabled = corpus->frames[n].agc;
+	render_st.display_interp_enable = interp;
+	render_st.hist_eq_enable = heq;
+	render_lep_data(&lep_bufs[n], img_buf, &render_st);
+	
+	return IMG_BUF_WIDTH * IMG_BUF_HEIGHT * 2;
+}
+
+
+static uint32_t bench_render_double(bench_corpus_t* corpus, int n)
+{
+	return render(corpus, n, false, false);
+}
+
+
+static uint32_t bench_render_interp(bench_corpus_t* corpus, int n)
+{
+	return render(corpus, n, true, false);
+}
+
+
+static uint32_t bench_render_double_heq(bench_corpus_t* corpus, int n)
+{
+	return render(corpus, n, false, true);
+}
+
+
+static uint32_t bench_render_interp_heq(bench_corpus_t* corpus, int n)
+{
+	return render(corpus, n, true, true);
+}
+
+
+static uint32_t bench_render_markers(bench_corpus_t* corpus, int n)
+{
+	render_spotmeter(&lep_bufs[n], img_buf);
+	render_min_max_markers(&lep_bufs[n], img_buf);
+	
+	return IMG_BUF_WIDTH * IMG_BUF_HEIGHT * 2;
+}
@@ -0,0 +1,391 @@
+/*
+ * Benchmark Utilities
+ *
+ * Timing harness and frame corpus loader shared by the benchmark programs.  Each
+ * benchmark is run over every frame of a corpus (a .tjsn or .tmjsn file) and the
+ * results are printed as one json object per line.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "bench_utilities.h"
+#include "esp_log.h"
+#include "mbedtls/base64.h"
+#include "cJSON.h"
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+
+//
+// Benchmark Utilities constants
+//
+
+// Telemetry status word (low) AGC state bit
+#define BENCH_TEL_STATUS_LOW     3
+#define BENCH_TEL_STATUS_AGC     0x1000
+
+
+
+//
+// Benchmark Utilities variables
+//
+static const char* TAG = "bench";
+
+static const char* suite_name;
+static const char* suite_version;
+static char* bench_filter = NULL;
+static int bench_min_msec = BENCH_DEF_MIN_MSEC;
+static int bench_runs = BENCH_DEF_RUNS;
+static FILE* out_fp;
+static int exit_status = 0;
+
+// Accumulates benchmark return values so the compiler can't discard the work
+static volatile uint64_t bench_sink;
+
+
+
+//
+// Benchmark Utilities Forward Declarations for internal functions
+//
+static void usage(const char* prog);
+static bool load_record(char* s, bench_frame_t* frame);
+static uint16_t* decode_array(cJSON* obj, const char* name, int words);
+static uint64_t get_nsec();
+static uint64_t run_frames(bench_corpus_t* corpus, bench_fcn_t fcn, int num, uint64_t* bytes);
+static int cmp_uint64(const void* a, const void* b);
+
+
+
+//
+// Benchmark Utilities API
+//
+
+/**
+ * Process command line options.  first_file is set to the index of the first corpus file.
+ */
+bool bench_init(const char* suite, const char* version, int argc, char** argv, int* first_file)
+{
+	char* out_file = NULL;
+	int c;
+	
+	suite_name = suite;
+	suite_version = version;
+	out_fp = stdout;
+	
+	while ((c = getopt(argc, argv, "b:o:r:t:h")) != -1) {
+		switch (c) {
+			case 'b':
+				bench_filter = optarg;
+				break;
+			case 'o':
+				out_file = optarg;
+				break;
+			case 'r':
+				bench_runs = atoi(optarg);
+				if ((bench_runs < 1) || (bench_runs > BENCH_MAX_RUNS)) {
+					fprintf(stderr, "Runs must be 1 - %d\n", BENCH_MAX_RUNS);
+					return false;
+				}
+				break;
+			case 't':
+				bench_min_msec = atoi(optarg);
+				if (bench_min_msec < 1) {
+					fprintf(stderr, "Illegal time %s\n", optarg);
+					return false;
+				}
+				break;
+			default:
+				usage(argv[0]);
+				return false;
+		}
+	}
+	
+	if (optind >= argc) {
+		usage(argv[0]);
+		return false;
+	}
+	*first_file = optind;
+	
+	if (out_file != NULL) {
+		out_fp = fopen(out_file, "a");
+		if (out_fp == NULL) {
+			fprintf(stderr, "Could not open %s\n", out_file);
+			return false;
+		}
+	}
+	
+	emu_log_set_level(ESP_LOG_WARN);
+	
+	return true;
+}
+
+
+/**
+ * Load and decode all image records in a .tjsn or .tmjsn file
+ */
+bool bench_load_corpus(const char* file, bench_corpus_t* corpus)
+{
+	char* buf;
+	char* cp;
+	char* s;
+	const char* name;
+	FILE* fp;
+	long len;
+	
+	memset(corpus, 0, sizeof(bench_corpus_t));
+	name = strrchr(file, '/');
+	name = (name == NULL) ? file : name + 1;
+	strncpy(corpus->name, name, sizeof(corpus->name) - 1);
+	
+	fp = fopen(file, "r");
+	if (fp == NULL) {
+		ESP_LOGE(TAG, "Could not open %s", file);
+		return false;
+	}
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	buf = malloc(len + 1);
+	if (buf == NULL) {
+		fclose(fp);
+		ESP_LOGE(TAG, "Could not allocate %ld bytes for %s", len, file);
+		return false;
+	}
+	len = fread(buf, 1, len, fp);
+	buf[len] = 0;
+	fclose(fp);
+	
+	// Records are delimited by 0x03 (.tmjsn files also start each record with 0x02)
+	s = buf;
+	while (*s != 0) {
+		cp = strchr(s, 0x03);
+		if (cp != NULL) *cp = 0;
+		if (*s == 0x02) s++;
+		if (strstr(s, "radiometric") != NULL) {
+			corpus->frames = realloc(corpus->frames, (corpus->num_frames + 1) * sizeof(bench_frame_t));
+			if (load_record(s, &corpus->frames[corpus->num_frames])) {
+				corpus->num_frames++;
+			}
+		}
+		if (cp == NULL) break;
+		s = cp + 1;
+	}
+	free(buf);
+	
+	if (corpus->num_frames == 0) {
+		ESP_LOGE(TAG, "No images found in %s", file);
+		return false;
+	}
+	
+	return true;
+}
+
+
+void bench_free_corpus(bench_corpus_t* corpus)
+{
+	int i;
+	
+	for (i=0; i<corpus->num_frames; i++) {
+		free(corpus->frames[i].json);
+		free(corpus->frames[i].img);
+		free(corpus->frames[i].tel);
+	}
+	free(corpus->frames);
+	corpus->frames = NULL;
+	corpus->num_frames = 0;
+}
+
+
+/**
+ * Time fcn over the corpus and print the result.  Each run processes the corpus
+ * enough times to take at least 1/runs of the minimum time.  The median run is reported
+ * along with the fastest.
+ */
+void bench_run(const char* name, bench_corpus_t* corpus, bench_fcn_t fcn)
+{
+	int i;
+	int num;
+	uint32_t frame_bytes;
+	uint64_t pass_bytes;
+	uint64_t bytes;
+	uint64_t t;
+	uint64_t ns_per_frame[BENCH_MAX_RUNS];
+	uint64_t run_nsec;
+	double median;
+	
+	if ((bench_filter != NULL) && (strstr(name, bench_filter) == NULL)) return;
+	
+	// Validate and warm up with one pass through the corpus
+	t = run_frames(corpus, fcn, corpus->num_frames, &pass_bytes);
+	if (t == 0) {
+		fprintf(out_fp, "{\"suite\":\"%s\",\"bench\":\"%s\",\"corpus\":\"%s\",\"error\":\"failed\"}\n",
+		        suite_name, name, corpus->name);
+		fflush(out_fp);
+		exit_status = 1;
+		return;
+	}
+	
+	// Size each run from a second (warm) pass
+	t = run_frames(corpus, fcn, corpus->num_frames, &bytes);
+	run_nsec = ((uint64_t) bench_min_msec * 1000000) / bench_runs;
+	num = corpus->num_frames * (int) ((run_nsec + t - 1) / t);
+	if (num < corpus->num_frames) num = corpus->num_frames;
+	frame_bytes = (uint32_t) (pass_bytes / corpus->num_frames);
+	
+	for (i=0; i<bench_runs; i++) {
+		ns_per_frame[i] = run_frames(corpus, fcn, num, &bytes) / num;
+	}
+	qsort(ns_per_frame, bench_runs, sizeof(uint64_t), cmp_uint64);
+	if (bench_runs & 1) {
+		median = ns_per_frame[bench_runs/2];
+	} else {
+		median = (ns_per_frame[bench_runs/2 - 1] + ns_per_frame[bench_runs/2]) / 2.0;
+	}
+	if (median < 1) median = 1;
+	
+	fprintf(out_fp, "{\"suite\":\"%s\",\"version\":\"%s\",\"rev\":\"%s\",\"bench\":\"%s\",\"corpus\":\"%s\","
+	        "\"frames\":%d,\"iterations\":%d,\"runs\":%d,\"ns_per_frame\":%.0f,\"ns_per_frame_min\":%llu,"
+	        "\"bytes_per_frame\":%u,\"bytes_per_sec\":%.0f}\n",
+	        suite_name, suite_version, BENCH_REV, name, corpus->name,
+	        corpus->num_frames, num, bench_runs, median, (unsigned long long) ns_per_frame[0],
+	        frame_bytes, frame_bytes * 1.0e9 / median);
+	fflush(out_fp);
+}
+
+
+int bench_exit_status()
+{
+	return exit_status;
+}
+
+
+
+//
+// Benchmark Utilities internal functions
+//
+static void usage(const char* prog)
+{
+	fprintf(stderr, "Usage: %s [options] <corpus file>...\n", prog);
+	fprintf(stderr, "  -b <name>  Only run benchmarks whose name contains <name>\n");
+	fprintf(stderr, "  -o <file>  Append results to <file> (default stdout)\n");
+	fprintf(stderr, "  -r <runs>  Timed runs per benchmark (default %d, max %d)\n", BENCH_DEF_RUNS, BENCH_MAX_RUNS);
+	fprintf(stderr, "  -t <msec>  Minimum time per benchmark (default %d)\n", BENCH_DEF_MIN_MSEC);
+	fprintf(stderr, "Corpus files are .tjsn or .tmjsn files\n");
+}
+
+
+static bool load_record(char* s, bench_frame_t* frame)
+{
+	cJSON* obj;
+	
+	memset(frame, 0, sizeof(bench_frame_t));
+	
+	obj = cJSON_Parse(s);
+	if (obj == NULL) {
+		ESP_LOGE(TAG, "Could not parse image record");
+		return false;
+	}
+	frame->img = decode_array(obj, "radiometric", BENCH_PIXELS);
+	frame->tel = decode_array(obj, "telemetry", BENCH_TEL_WORDS);
+	cJSON_Delete(obj);
+	if ((frame->img == NULL) || (frame->tel == NULL)) {
+		free(frame->img);
+		free(frame->tel);
+		return false;
+	}
+	
+	frame->json = strdup(s);
+	frame->json_len = strlen(s);
+	frame->agc = (frame->tel[BENCH_TEL_STATUS_LOW] & BENCH_TEL_STATUS_AGC) != 0;
+	
+	return true;
+}
+
+
+static uint16_t* decode_array(cJSON* obj, const char* name, int words)
+{
+	char* s;
+	size_t len;
+	uint16_t* buf;
+	
+	s = cJSON_GetStringValue(cJSON_GetObjectItem(obj, name));
+	if (s == NULL) {
+		ESP_LOGE(TAG, "Image record missing %s", name);
+		return NULL;
+	}
+	
+	buf = malloc(words * 2);
+	if (buf == NULL) return NULL;
+	if ((mbedtls_base64_decode((unsigned char*) buf, words * 2, &len, (const unsigned char*) s, strlen(s)) != 0) ||
+	    (len != words * 2)) {
+		ESP_LOGE(TAG, "Could not decode %s", name);
+		free(buf);
+		return NULL;
+	}
+	
+	return buf;
+}
+
+
+static uint64_t get_nsec()
+{
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/**
+ * Process num frames, cycling through the corpus.  Returns elapsed nSec or 0 if fcn
+ * failed.
+ */
+static uint64_t run_frames(bench_corpus_t* corpus, bench_fcn_t fcn, int num, uint64_t* bytes)
+{
+	int i;
+	int n = 0;
+	uint32_t r;
+	uint64_t t0;
+	uint64_t t1;
+	
+	*bytes = 0;
+	t0 = get_nsec();
+	for (i=0; i<num; i++) {
+		r = (*fcn)(corpus, n);
+		if (r == 0) return 0;
+		*bytes += r;
+		if (++n == corpus->num_frames) n = 0;
+	}
+	t1 = get_nsec();
+	bench_sink += *bytes;
+	
+	return (t1 > t0) ? (t1 - t0) : 1;
+}
+
+
+static int cmp_uint64(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*) a;
+	uint64_t y = *(const uint64_t*) b;
+	
+	return (x > y) - (x < y);
+}
@@ -0,0 +1,83 @@
+/*
+ * Benchmark Utilities
+ *
+ * Timing harness and frame corpus loader shared by the benchmark programs.  Each
+ * benchmark is run over every frame of a corpus (a .tjsn or .tmjsn file) and the
+ * results are printed as one json object per line.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef BENCH_UTILITIES_H
+#define BENCH_UTILITIES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Benchmark Utilities Constants
+//
+
+// Lepton 3 geometry (matches both firmware trees)
+#define BENCH_WIDTH      160
+#define BENCH_HEIGHT     120
+#define BENCH_PIXELS     (BENCH_WIDTH * BENCH_HEIGHT)
+#define BENCH_TEL_WORDS  240
+
+// Defaults
+#define BENCH_DEF_MIN_MSEC 500
+#define BENCH_DEF_RUNS     5
+#define BENCH_MAX_RUNS     25
+
+
+
+//
+// Benchmark Utilities typedefs
+//
+
+// One frame from a corpus
+typedef struct {
+	char* json;              // Image json text without delimiters, null terminated
+	int json_len;
+	uint16_t* img;           // Decoded radiometric (or AGC) data
+	uint16_t* tel;           // Decoded telemetry
+	bool agc;                // Telemetry indicates AGC was enabled
+} bench_frame_t;
+
+typedef struct {
+	char name[64];           // File name without path
+	int num_frames;
+	bench_frame_t* frames;
+} bench_corpus_t;
+
+// Process one frame, returning the number of bytes processed or 0 for failure
+typedef uint32_t (*bench_fcn_t)(bench_corpus_t* corpus, int n);
+
+
+
+//
+// Benchmark Utilities API
+//
+bool bench_init(const char* suite, const char* version, int argc, char** argv, int* first_file);
+bool bench_load_corpus(const char* file, bench_corpus_t* corpus);
+void bench_free_corpus(bench_corpus_t* corpus);
+void bench_run(const char* name, bench_corpus_t* corpus, bench_fcn_t fcn);
+int bench_exit_status();
+
+#endif /* BENCH_UTILITIES_H */
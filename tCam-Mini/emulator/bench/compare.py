@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""
+  tCam benchmark comparison
+
+  Compares two benchmark result files (one json object per line, as written by
+  bench-mini and bench-tcam) and reports the change in ns_per_frame for each
+  benchmark and corpus found in both.  Exits with status 1 if any benchmark is slower
+  than the baseline by more than the threshold so it can be used to catch regressions
+  for each commit.
+
+    compare.py [-t percent] baseline.json results.json
+
+  Copyright 2020-2022 Dan Julio
+
+  This file is part of tCam.
+
+  tCam is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  tCam is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load_results(path):
+    """Return a dict of results keyed by (suite, bench, corpus)"""
+    results = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line:
+                continue
+            r = json.loads(line)
+            results[(r["suite"], r["bench"], r["corpus"])] = r
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare tCam benchmark results")
+    parser.add_argument("-t", "--threshold", type=float, default=10.0,
+                        help="percent slowdown reported as a regression (default 10)")
+    parser.add_argument("baseline")
+    parser.add_argument("results")
+    args = parser.parse_args()
+
+    base = load_results(args.baseline)
+    new = load_results(args.results)
+
+    regressions = 0
+    print("%-10s %-24s %-16s %12s %12s %8s" % ("suite", "bench", "corpus", "base ns", "new ns", "change"))
+    for key in sorted(new):
+        r = new[key]
+        if "error" in r:
+            print("%-10s %-24s %-16s %12s %12s %8s" % (key + ("", "", "FAILED")))
+            regressions += 1
+            continue
+        if key not in base or "error" in base[key]:
+            continue
+        b = base[key]["ns_per_frame"]
+        n = r["ns_per_frame"]
+        change = 100.0 * (n - b) / b if b else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  <-- regression"
+            regressions += 1
+        print("%-10s %-24s %-16s %12d %12d %+7.1f%%%s" % (key + (b, n, change, flag)))
+
+    missing = sorted(set(base) - set(new))
+    for key in missing:
+        print("%-10s %-24s %-16s missing from results" % key)
+
+    sys.exit(1 if regressions else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,79 @@
+/*
+ * Emulator Configuration File
+ *
+ * Contains the emulator's command line configurable items.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef EMU_CONFIG_H
+#define EMU_CONFIG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+
+//
+// Emulator constants
+//
+
+// Defaults
+#define EMU_DEF_PORT        5001
+#define EMU_DEF_NUM_CAMS    1
+#define EMU_DEF_FPS         8.7
+#define EMU_DEF_NAME        "tCam-Mini-EM"
+
+// Maximum number of emulated cameras (each listens on its own port)
+#define EMU_MAX_CAMS        256
+
+// Maximum supported frame rate (rsp_task evaluates streaming every RSP_TASK_EVAL_FAST_MSEC)
+#define EMU_MAX_FPS         100.0
+
+// Exit code a camera process uses to ask to be restarted (esp_restart)
+#define EMU_EXIT_RESTART    3
+
+// Emulated sensor temperatures (K * 100)
+#define EMU_FPA_TEMP_K100   30315
+#define EMU_HSE_TEMP_K100   30015
+
+
+
+//
+// Emulator typedefs
+//
+typedef struct {
+	int index;                  // Camera number 0 - (num_cams-1)
+	int port;                   // Command port
+	double fps;                 // Lepton frame rate
+	int lep_type;               // Emulated Lepton (LEP_TYPE_3_5 / LEP_TYPE_3_0 / LEP_TYPE_3_1)
+	bool eth;                   // Emulate the Ethernet board (otherwise WiFi)
+	char* replay_file;          // Optional .tjsn/.tmjsn file to replay instead of synthetic images
+	char* fw_file;              // Optional file to store firmware updates in
+	char name[33];              // Camera name (AP SSID)
+	uint8_t mac[6];
+} emu_config_t;
+
+
+
+//
+// Emulator configuration
+//
+extern emu_config_t emu_config;
+
+#endif /* EMU_CONFIG_H */
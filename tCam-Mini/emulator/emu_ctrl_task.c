@@ -0,0 +1,113 @@
+/*
+ * Emulator Control Task
+ *
+ * Replaces the firmware's ctrl_task.  There are no LEDs or button so state changes
+ * are logged and a firmware update request is confirmed on the user's behalf.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "emu_config.h"
+#include "ctrl_task.h"
+#include "rsp_task.h"
+#include "sys_utilities.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+
+
+//
+// Control Task constants
+//
+
+// Delay before the emulated user presses the button to allow a firmware update
+#define CTRL_FW_UPD_CONFIRM_MSEC 500
+
+
+
+//
+// Control Task variables
+//
+static const char* TAG = "ctrl_task";
+
+static int ctrl_fault_type = CTRL_FAULT_NONE;
+
+
+
+//
+// Control Task API
+//
+void ctrl_task()
+{
+	uint32_t notification_value;
+	
+	ESP_LOGI(TAG, "Start task");
+	
+	while (1) {
+		if (xTaskNotifyWait(0x00, 0xFFFFFFFF, &notification_value, portMAX_DELAY)) {
+			if (Notification(notification_value, CTRL_NOTIFY_FAULT)) {
+				ESP_LOGE(TAG, "Fault %d", ctrl_fault_type);
+			}
+			
+			if (Notification(notification_value, CTRL_NOTIFY_FAULT_CLEAR)) {
+				ESP_LOGI(TAG, "Fault cleared");
+			}
+			
+			if (Notification(notification_value, CTRL_NOTIFY_FW_UPD_REQ)) {
+				// Emulate the user authorizing the update
+				vTaskDelay(pdMS_TO_TICKS(CTRL_FW_UPD_CONFIRM_MSEC));
+				ESP_LOGI(TAG, "Firmware update authorized");
+				xTaskNotify(task_handle_rsp, RSP_NOTIFY_FW_UPD_EN_MASK, eSetBits);
+			}
+			
+			if (Notification(notification_value, CTRL_NOTIFY_FW_UPD_DONE)) {
+				ESP_LOGI(TAG, "Firmware update done");
+			}
+			
+			if (Notification(notification_value, CTRL_NOTIFY_FW_UPD_REBOOT)) {
+				// Delay a bit to allow any final communication to occur and then reboot
+				vTaskDelay(pdMS_TO_TICKS(500));
+				esp_restart();
+			}
+		}
+	}
+}
+
+
+/**
+ * The emulator always uses the network interface of the emulated board
+ */
+void ctrl_get_if_mode(int* brd, int* iface)
+{
+	*brd = emu_config.eth ? CTRL_BRD_ETH_TYPE : CTRL_BRD_WIFI_TYPE;
+	*iface = emu_config.eth ? CTRL_IF_MODE_ETH : CTRL_IF_MODE_WIFI;
+}
+
+
+void ctrl_set_fault_type(int f)
+{
+	ctrl_fault_type = f;
+	
+	if (f == CTRL_FAULT_NONE) {
+		xTaskNotify(task_handle_ctrl, CTRL_NOTIFY_FAULT_CLEAR, eSetBits);
+	} else {
+		xTaskNotify(task_handle_ctrl, CTRL_NOTIFY_FAULT, eSetBits);
+	}
+}
@@ -0,0 +1,118 @@
+/*
+ * Emulator Lepton Task
+ *
+ * Replaces the firmware's lep_task.  Loads emulated Lepton frames into the shared
+ * ping-pong buffer at the configured frame rate and notifies rsp_task exactly like
+ * the firmware so the response path is exercised unchanged.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "emu_config.h"
+#include "emu_lep_utilities.h"
+#include "lep_task.h"
+#include "rsp_task.h"
+#include "alarm_utilities.h"
+#include "filter_utilities.h"
+#include "perf_utilities.h"
+#include "sys_utilities.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <time.h>
+
+
+
+//
+// LEP Task variables
+//
+static const char* TAG = "lep_task";
+
+static alarm_event_t alarm_events[ALARM_MAX_RULES];
+
+
+
+//
+// LEP Task API
+//
+void lep_task()
+{
+	int rsp_buf_index = 0;
+	int num_alarm_events;
+	int min_index, max_index;
+	int i;
+	int64_t frame_usec;
+	int64_t next_usec;
+	int64_t now_usec;
+	struct timespec ts;
+	
+	ESP_LOGI(TAG, "Start task (%1.1f fps)", emu_config.fps);
+	
+	emu_lep_init();
+	
+	frame_usec = (int64_t) (1000000.0 / emu_config.fps);
+	next_usec = esp_timer_get_time();
+	
+	while (true) {
+		// Wait for the next frame time (catching up without bursts if we fell behind)
+		now_usec = esp_timer_get_time();
+		if (next_usec > now_usec) {
+			ts.tv_sec = (next_usec - now_usec) / 1000000;
+			ts.tv_nsec = ((next_usec - now_usec) % 1000000) * 1000;
+			nanosleep(&ts, NULL);
+		} else if ((now_usec - next_usec) > frame_usec) {
+			next_usec = now_usec;
+		}
+		next_usec += frame_usec;
+		
+		// Load the frame into the current half of the shared buffer and let rsp_task know
+		now_usec = esp_timer_get_time();
+		xSemaphoreTake(rsp_lep_buffer[rsp_buf_index].lep_mutex, portMAX_DELAY);
+		emu_lep_get_frame(&rsp_lep_buffer[rsp_buf_index]);
+		num_alarm_events = alarm_eval(&rsp_lep_buffer[rsp_buf_index], alarm_events);
+		
+		// Optionally reduce temporal noise in a copy of the image for streaming.  Alarms,
+		// roi_stats and get_image use the unfiltered data.
+		rsp_filt_valid[rsp_buf_index] = filter_apply_copy(FILTER_CONSUMER_STREAM, rsp_lep_buffer[rsp_buf_index].lep_bufferP,
+		                                                  rsp_filt_buffer[rsp_buf_index].lep_bufferP, &min_index, &max_index);
+		if (rsp_filt_valid[rsp_buf_index]) {
+			rsp_filt_buffer[rsp_buf_index].telem_valid = rsp_lep_buffer[rsp_buf_index].telem_valid;
+			rsp_filt_buffer[rsp_buf_index].lep_min_val = rsp_filt_buffer[rsp_buf_index].lep_bufferP[min_index];
+			rsp_filt_buffer[rsp_buf_index].lep_max_val = rsp_filt_buffer[rsp_buf_index].lep_bufferP[max_index];
+		}
+		xSemaphoreGive(rsp_lep_buffer[rsp_buf_index].lep_mutex);
+		perf_count(PERF_CNT_PRODUCED);
+		perf_record(PERF_STAGE_CAPTURE, (uint32_t) (esp_timer_get_time() - now_usec));
+		
+		// Report any alarm state transitions
+		for (i=0; i<num_alarm_events; i++) {
+			rsp_set_alarm_msg(&alarm_events[i]);
+		}
+		
+		if (rsp_buf_index == 0) {
+			xTaskNotify(task_handle_rsp, RSP_NOTIFY_LEP_FRAME_MASK_0, eSetBits);
+			rsp_buf_index = 1;
+		} else {
+			xTaskNotify(task_handle_rsp, RSP_NOTIFY_LEP_FRAME_MASK_1, eSetBits);
+			rsp_buf_index = 0;
+		}
+	}
+}
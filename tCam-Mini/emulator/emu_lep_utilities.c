@@ -0,0 +1,612 @@
+/*
+ * Emulator Lepton Utilities
+ *
+ * Replaces the firmware's lepton_utilities, cci and vospi modules.  Frames are
+ * either synthesized (a warm target moving across a room temperature scene) or
+ * replayed from a camera image (.tjsn) or movie (.tmjsn) file.  Lepton settings
+ * from the command interface are reflected in the telemetry.  CCI registers are
+ * emulated as memory.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "emu_config.h"
+#include "emu_lep_utilities.h"
+#include "lepton_utilities.h"
+#include "sys_utilities.h"
+#include "vospi.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "mbedtls/base64.h"
+#include "cJSON.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+//
+// Emulator Lepton Utilities constants
+//
+
+// Synthetic scene (TLinear high resolution: K * 100)
+#define SYN_BG_K100          29515    // 22 C
+#define SYN_BG_GRADIENT      150      // Top to bottom
+#define SYN_TARGET_K100      1400     // Target peak above background (36 C)
+#define SYN_TARGET_RADIUS    14
+#define SYN_NOISE            8        // Peak-to-peak pixel noise
+
+// Lepton outputs each unique frame 3 times (27 Hz VoSPI rate)
+#define LEP_FRAME_COUNT_INC  3
+
+// Emulated FFC duration
+#define EMU_FFC_USEC         200000
+
+// CCI register memory
+#define CCI_MAX_REGS         32
+#define CCI_MAX_REG_WORDS    512
+
+// Telemetry revision reported by the Lepton 3.5
+#define EMU_TEL_REVISION     0x000E
+
+
+
+//
+// Emulator Lepton Utilities typedefs
+//
+typedef struct {
+	uint16_t cmd_base;
+	uint16_t len;
+	uint16_t* data;
+} cci_reg_t;
+
+typedef struct {
+	uint16_t* imgP;
+	uint16_t* telP;          // NULL if the file had no telemetry
+} replay_frame_t;
+
+
+
+//
+// Emulator Lepton Utilities variables
+//
+static const char* TAG = "lep_utilities";
+
+// Lepton state set by the command interface
+static SemaphoreHandle_t lep_mutex;
+static bool lep_agc_en;
+static uint16_t lep_emissivity;
+static uint8_t lep_gain_mode;
+static uint16_t lep_spot[4] = {59, 79, 60, 80};   // r1, c1, r2, c2
+static int64_t lep_ffc_usec;
+
+// Frame generation
+static uint32_t frame_count;
+static uint32_t noise_seed = 1;
+
+// Replay frames
+static int replay_num_frames;
+static int replay_index;
+static replay_frame_t* replay_frames;
+
+// CCI register memory
+static int cci_num_regs;
+static cci_reg_t cci_regs[CCI_MAX_REGS];
+
+
+
+//
+// Emulator Lepton Utilities Forward Declarations for internal functions
+//
+static void gen_synthetic_image(uint16_t* img, int64_t usec);
+static void gen_agc_image(uint16_t* img, uint16_t min, uint16_t max);
+static void gen_telemetry(uint16_t* tel, const uint16_t* img, int64_t usec, bool tlinear, bool agc);
+static bool load_replay_record(char* s);
+static uint16_t* decode_replay_array(cJSON* obj, const char* name, int words);
+static cci_reg_t* cci_find_reg(uint16_t cmd, bool create);
+static uint32_t noise_next();
+
+
+
+//
+// Emulator Lepton Utilities API
+//
+
+/**
+ * Load frames to replay.  Called before the camera processes are started so they
+ * share the decoded frames.
+ */
+bool emu_lep_load_replay(const char* file)
+{
+	char* buf;
+	char* s;
+	char* e;
+	FILE* fp;
+	long len;
+	
+	fp = fopen(file, "rb");
+	if (fp == NULL) {
+		ESP_LOGE(TAG, "Could not open %s", file);
+		return false;
+	}
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	buf = malloc(len + 1);
+	if (buf == NULL) {
+		ESP_LOGE(TAG, "Could not allocate %ld bytes for %s", len, file);
+		fclose(fp);
+		return false;
+	}
+	if (fread(buf, 1, len, fp) != (size_t) len) {
+		ESP_LOGE(TAG, "Could not read %s", file);
+		free(buf);
+		fclose(fp);
+		return false;
+	}
+	fclose(fp);
+	buf[len] = 0;
+	
+	// Movies are image json strings separated by 0x03 followed by a video_info string
+	s = buf;
+	while (s < buf + len) {
+		e = strchr(s, 0x03);
+		if (e != NULL) *e = 0;
+		while ((*s == 0x02) || (*s == ' ') || (*s == '\r') || (*s == '\n')) s++;
+		if ((*s != 0) && (strstr(s, "\"radiometric\"") != NULL)) {
+			if (!load_replay_record(s)) {
+				ESP_LOGE(TAG, "Skipping bad image %d in %s", replay_num_frames, file);
+			}
+		}
+		if (e == NULL) break;
+		s = e + 1;
+	}
+	free(buf);
+	
+	if (replay_num_frames == 0) {
+		ESP_LOGE(TAG, "No images found in %s", file);
+		return false;
+	}
+	ESP_LOGI(TAG, "Loaded %d images from %s", replay_num_frames, file);
+	return true;
+}
+
+
+void emu_lep_init()
+{
+	lep_mutex = xSemaphoreCreateMutex();
+	lep_agc_en = false;
+	lep_emissivity = 100;
+	lep_gain_mode = SYS_GAIN_HIGH;
+	noise_seed = 1 + emu_config.index;
+}
+
+
+/**
+ * Load the next frame and its telemetry into a shared buffer like vospi_get_frame()
+ */
+void emu_lep_get_frame(lep_buffer_t* sys_bufP)
+{
+	bool agc;
+	bool tlinear;
+	int i;
+	int64_t usec;
+	uint16_t min = 0xFFFF;
+	uint16_t max = 0x0000;
+	uint16_t* sptr;
+	replay_frame_t* rf = NULL;
+	
+	usec = esp_timer_get_time();
+	frame_count += LEP_FRAME_COUNT_INC;
+	
+	xSemaphoreTake(lep_mutex, portMAX_DELAY);
+	agc = lep_agc_en || (emu_config.lep_type == LEP_TYPE_3_0);
+	xSemaphoreGive(lep_mutex);
+	tlinear = !agc;
+	
+	if (replay_num_frames != 0) {
+		rf = &replay_frames[replay_index];
+		if (++replay_index >= replay_num_frames) replay_index = 0;
+		memcpy(sys_bufP->lep_bufferP, rf->imgP, LEP_NUM_PIXELS*2);
+		if (rf->telP != NULL) {
+			tlinear = (rf->telP[LEP_TEL_TLIN_ENABLE] != 0);
+			agc = (lepton_get_tel_status(rf->telP) & LEP_STATUS_AGC_STATE) != 0;
+		}
+	} else {
+		gen_synthetic_image(sys_bufP->lep_bufferP, usec);
+	}
+	
+	sptr = sys_bufP->lep_bufferP;
+	for (i=0; i<LEP_NUM_PIXELS; i++) {
+		if (sptr[i] < min) min = sptr[i];
+		if (sptr[i] > max) max = sptr[i];
+	}
+	
+	if (agc && (replay_num_frames == 0)) {
+		gen_agc_image(sys_bufP->lep_bufferP, min, max);
+		min = 0;
+		max = 255;
+	}
+	sys_bufP->lep_min_val = min;
+	sys_bufP->lep_max_val = max;
+	
+	// Telemetry is always included by the tCam-Mini
+	if ((rf != NULL) && (rf->telP != NULL)) {
+		// Replayed telemetry with advancing counters
+		memcpy(sys_bufP->lep_telemP, rf->telP, LEP_TEL_WORDS*2);
+		sys_bufP->lep_telemP[LEP_TEL_TC_LOW] = (uint16_t) ((usec / 1000) & 0xFFFF);
+		sys_bufP->lep_telemP[LEP_TEL_TC_HIGH] = (uint16_t) ((usec / 1000) >> 16);
+		sys_bufP->lep_telemP[LEP_TEL_FC_LOW] = (uint16_t) (frame_count & 0xFFFF);
+		sys_bufP->lep_telemP[LEP_TEL_FC_HIGH] = (uint16_t) (frame_count >> 16);
+	} else {
+		gen_telemetry(sys_bufP->lep_telemP, sys_bufP->lep_bufferP, usec, tlinear, agc);
+	}
+	sys_bufP->telem_valid = true;
+}
+
+
+
+//
+// Lepton Utilities API
+//
+bool lepton_is_radiometric()
+{
+	return (emu_config.lep_type == LEP_TYPE_3_5);
+}
+
+
+int lepton_get_model()
+{
+	return emu_config.lep_type;
+}
+
+
+void lepton_agc(bool en)
+{
+	xSemaphoreTake(lep_mutex, portMAX_DELAY);
+	lep_agc_en = en;
+	xSemaphoreGive(lep_mutex);
+}
+
+
+void lepton_ffc()
+{
+	xSemaphoreTake(lep_mutex, portMAX_DELAY);
+	lep_ffc_usec = esp_timer_get_time();
+	xSemaphoreGive(lep_mutex);
+}
+
+
+void lepton_gain_mode(uint8_t mode)
+{
+	if (lepton_is_radiometric()) {
+		xSemaphoreTake(lep_mutex, portMAX_DELAY);
+		lep_gain_mode = mode;
+		xSemaphoreGive(lep_mutex);
+	}
+}
+
+
+void lepton_spotmeter(uint16_t r1, uint16_t c1, uint16_t r2, uint16_t c2)
+{
+	if (lepton_is_radiometric()) {
+		xSemaphoreTake(lep_mutex, portMAX_DELAY);
+		lep_spot[0] = r1;
+		lep_spot[1] = c1;
+		lep_spot[2] = r2;
+		lep_spot[3] = c2;
+		xSemaphoreGive(lep_mutex);
+	}
+}
+
+
+void lepton_emissivity(uint16_t e)
+{
+	if (lepton_is_radiometric()) {
+		xSemaphoreTake(lep_mutex, portMAX_DELAY);
+		lep_emissivity = e;
+		xSemaphoreGive(lep_mutex);
+	}
+}
+
+
+uint32_t lepton_get_tel_status(uint16_t* tel_buf)
+{
+	return (tel_buf[LEP_TEL_STATUS_HIGH] << 16) | tel_buf[LEP_TEL_STATUS_LOW];
+}
+
+
+
+//
+// CCI API
+//
+
+/**
+ * Store a SET command's data for the corresponding GET command
+ */
+void cci_set_reg(uint16_t cmd, int len, uint16_t* buf)
+{
+	cci_reg_t* reg;
+	
+	if (len > CCI_MAX_REG_WORDS) len = CCI_MAX_REG_WORDS;
+	
+	reg = cci_find_reg(cmd, true);
+	if (reg != NULL) {
+		memcpy(reg->data, buf, len * 2);
+		reg->len = len;
+	}
+}
+
+
+/**
+ * Return the data last set for a command (zeros if it was never set)
+ */
+void cci_get_reg(uint16_t cmd, int len, uint16_t* buf)
+{
+	cci_reg_t* reg;
+	
+	memset(buf, 0, len * 2);
+	reg = cci_find_reg(cmd, false);
+	if (reg != NULL) {
+		memcpy(buf, reg->data, ((len < reg->len) ? len : reg->len) * 2);
+	}
+}
+
+
+bool cci_command_success(uint16_t* status)
+{
+	// Boot mode and boot status set, not busy, LEP_OK
+	*status = 0x0006;
+	return true;
+}
+
+
+
+//
+// Emulator Lepton Utilities internal functions
+//
+
+/**
+ * Room temperature scene with a vertical gradient and a warm target moving in a
+ * Lissajous pattern
+ */
+static void gen_synthetic_image(uint16_t* img, int64_t usec)
+{
+	double t;
+	int r, c;
+	int dr, dc, d2;
+	int tr, tc;
+	int r2 = SYN_TARGET_RADIUS * SYN_TARGET_RADIUS;
+	uint16_t row_val;
+	
+	t = (double) usec / 1000000.0;
+	tr = LEP_HEIGHT/2 + (int) ((LEP_HEIGHT/2 - SYN_TARGET_RADIUS) * sin(t * 0.9));
+	tc = LEP_WIDTH/2 + (int) ((LEP_WIDTH/2 - SYN_TARGET_RADIUS) * sin(t * 0.6 + emu_config.index));
+	
+	for (r=0; r<LEP_HEIGHT; r++) {
+		row_val = SYN_BG_K100 + SYN_BG_GRADIENT/2 - (r * SYN_BG_GRADIENT) / LEP_HEIGHT;
+		dr = r - tr;
+		for (c=0; c<LEP_WIDTH; c++) {
+			*img = row_val + (uint16_t) (noise_next() % SYN_NOISE);
+			dc = c - tc;
+			d2 = dr*dr + dc*dc;
+			if (d2 < r2) {
+				*img += (uint16_t) ((SYN_TARGET_K100 * (r2 - d2)) / r2);
+			}
+			img++;
+		}
+	}
+}
+
+
+/**
+ * Linear 8-bit scaling standing in for the Lepton's histogram AGC
+ */
+static void gen_agc_image(uint16_t* img, uint16_t min, uint16_t max)
+{
+	int i;
+	uint32_t delta;
+	
+	delta = (max > min) ? (max - min) : 1;
+	for (i=0; i<LEP_NUM_PIXELS; i++) {
+		img[i] = (uint16_t) (((uint32_t) (img[i] - min) * 255) / delta);
+	}
+}
+
+
+static void gen_telemetry(uint16_t* tel, const uint16_t* img, int64_t usec, bool tlinear, bool agc)
+{
+	bool ffc_running;
+	int r, c;
+	uint8_t gain_mode;
+	uint16_t spot[4];
+	uint16_t emissivity;
+	uint16_t min = 0xFFFF;
+	uint16_t max = 0;
+	uint32_t msec;
+	uint32_t status;
+	uint32_t sum = 0;
+	uint64_t frame_sum = 0;
+	int i;
+	
+	xSemaphoreTake(lep_mutex, portMAX_DELAY);
+	ffc_running = (lep_ffc_usec != 0) && ((usec - lep_ffc_usec) < EMU_FFC_USEC);
+	gain_mode = lep_gain_mode;
+	emissivity = lep_emissivity;
+	memcpy(spot, lep_spot, sizeof(spot));
+	xSemaphoreGive(lep_mutex);
+	
+	memset(tel, 0, LEP_TEL_WORDS*2);
+	msec = (uint32_t) (usec / 1000);
+	
+	// Row A
+	tel[LEP_TEL_REV] = EMU_TEL_REVISION;
+	tel[LEP_TEL_TC_LOW] = (uint16_t) (msec & 0xFFFF);
+	tel[LEP_TEL_TC_HIGH] = (uint16_t) (msec >> 16);
+	status = ffc_running ? LEP_FFC_STATE_RUN : LEP_FFC_STATE_CMPL;
+	if (agc) status |= LEP_STATUS_AGC_STATE;
+	tel[LEP_TEL_STATUS_LOW] = (uint16_t) (status & 0xFFFF);
+	tel[LEP_TEL_STATUS_HIGH] = (uint16_t) (status >> 16);
+	tel[LEP_TEL_SN_0] = 0x454D;   // "EM"
+	tel[LEP_TEL_SN_1] = (uint16_t) emu_config.index;
+	tel[LEP_TEL_REV_0] = 0x0300;
+	tel[LEP_TEL_FC_LOW] = (uint16_t) (frame_count & 0xFFFF);
+	tel[LEP_TEL_FC_HIGH] = (uint16_t) (frame_count >> 16);
+	for (i=0; i<LEP_NUM_PIXELS; i++) {
+		frame_sum += img[i];
+	}
+	tel[LEP_TEL_FRAME_MEAN] = (uint16_t) (frame_sum / LEP_NUM_PIXELS);
+	tel[LEP_TEL_FPA_T_K100] = EMU_FPA_TEMP_K100;
+	tel[LEP_TEL_HSE_T_K100] = EMU_HSE_TEMP_K100;
+	tel[LEP_TEL_LAST_FPA_T] = EMU_FPA_TEMP_K100;
+	tel[LEP_TEL_LAST_HST_T] = EMU_HSE_TEMP_K100;
+	
+	// Row B (emissivity and transmissions are scaled by 8192)
+	tel[LEP_TEL_EMISSIVITY] = (uint16_t) ((emissivity * 8192 + 50) / 100);
+	tel[LEP_TEL_BG_T_K100] = SYN_BG_K100;
+	tel[LEP_TEL_ATM_TRANS] = 8192;
+	tel[LEP_TEL_ATM_T_K100] = SYN_BG_K100;
+	tel[LEP_TEL_WND_TRANS] = 8192;
+	tel[LEP_TEL_WND_T_K100] = SYN_BG_K100;
+	tel[LEP_TEL_WND_REFL_T_K100] = SYN_BG_K100;
+	
+	// Row C
+	tel[LEP_TEL_GAIN_MODE] = gain_mode;
+	tel[LEP_TEL_EFF_GAIN_MODE] = (gain_mode == SYS_GAIN_LOW) ? SYS_GAIN_LOW : SYS_GAIN_HIGH;
+	tel[LEP_TEL_GAIN_MODE_DES] = tel[LEP_TEL_EFF_GAIN_MODE];
+	tel[LEP_TEL_TLIN_ENABLE] = tlinear ? 1 : 0;
+	tel[LEP_TEL_TLIN_RES] = 1;
+	
+	// Spotmeter
+	if (tlinear && (spot[0] <= spot[2]) && (spot[1] <= spot[3]) &&
+	    (spot[2] < LEP_HEIGHT) && (spot[3] < LEP_WIDTH)) {
+		for (r=spot[0]; r<=spot[2]; r++) {
+			for (c=spot[1]; c<=spot[3]; c++) {
+				i = r*LEP_WIDTH + c;
+				sum += img[i];
+				if (img[i] < min) min = img[i];
+				if (img[i] > max) max = img[i];
+			}
+		}
+		i = (spot[2] - spot[0] + 1) * (spot[3] - spot[1] + 1);
+		tel[LEP_TEL_SPOT_MEAN] = (uint16_t) (sum / i);
+		tel[LEP_TEL_SPOT_MAX] = max;
+		tel[LEP_TEL_SPOT_MIN] = min;
+		tel[LEP_TEL_SPOT_POP] = (uint16_t) i;
+	}
+	tel[LEP_TEL_SPOT_Y1] = spot[0];
+	tel[LEP_TEL_SPOT_X1] = spot[1];
+	tel[LEP_TEL_SPOT_Y2] = spot[2];
+	tel[LEP_TEL_SPOT_X2] = spot[3];
+}
+
+
+/**
+ * Decode one image json string into a replay frame
+ */
+static bool load_replay_record(char* s)
+{
+	cJSON* root;
+	replay_frame_t* newP;
+	replay_frame_t rf;
+	
+	root = cJSON_Parse(s);
+	if (root == NULL) return false;
+	
+	rf.imgP = decode_replay_array(root, "radiometric", LEP_NUM_PIXELS);
+	rf.telP = decode_replay_array(root, "telemetry", LEP_TEL_WORDS);
+	cJSON_Delete(root);
+	if (rf.imgP == NULL) {
+		free(rf.telP);
+		return false;
+	}
+	
+	newP = realloc(replay_frames, (replay_num_frames + 1) * sizeof(replay_frame_t));
+	if (newP == NULL) {
+		free(rf.imgP);
+		free(rf.telP);
+		return false;
+	}
+	replay_frames = newP;
+	replay_frames[replay_num_frames++] = rf;
+	
+	return true;
+}
+
+
+static uint16_t* decode_replay_array(cJSON* obj, const char* name, int words)
+{
+	char* data;
+	size_t dec_len;
+	uint16_t* buf;
+	
+	data = cJSON_GetStringValue(cJSON_GetObjectItem(obj, name));
+	if (data == NULL) return NULL;
+	
+	buf = malloc(words * 2);
+	if (buf == NULL) return NULL;
+	
+	if ((mbedtls_base64_decode((unsigned char*) buf, words * 2, &dec_len, (const unsigned char*) data, strlen(data)) != 0) ||
+	    (dec_len != (size_t) (words * 2))) {
+		free(buf);
+		return NULL;
+	}
+	
+	return buf;
+}
+
+
+/**
+ * Get the register memory for a command.  GET, SET and RUN commands for a
+ * Lepton module function share the upper 14 bits.
+ */
+static cci_reg_t* cci_find_reg(uint16_t cmd, bool create)
+{
+	int i;
+	uint16_t base = cmd & 0xFFFC;
+	
+	for (i=0; i<cci_num_regs; i++) {
+		if (cci_regs[i].cmd_base == base) {
+			return &cci_regs[i];
+		}
+	}
+	
+	if (!create || (cci_num_regs == CCI_MAX_REGS)) return NULL;
+	
+	cci_regs[cci_num_regs].data = calloc(CCI_MAX_REG_WORDS, 2);
+	if (cci_regs[cci_num_regs].data == NULL) return NULL;
+	cci_regs[cci_num_regs].cmd_base = base;
+	cci_regs[cci_num_regs].len = 0;
+	
+	return &cci_regs[cci_num_regs++];
+}
+
+
+/**
+ * Small LCG for pixel noise
+ */
+static uint32_t noise_next()
+{
+	noise_seed = noise_seed * 1103515245 + 12345;
+	return (noise_seed >> 16) & 0x7FFF;
+}
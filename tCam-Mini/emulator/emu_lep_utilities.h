@@ -0,0 +1,40 @@
+/*
+ * Emulator Lepton Utilities
+ *
+ * Replaces the firmware's lepton_utilities, cci and vospi modules.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef EMU_LEP_UTILITIES_H
+#define EMU_LEP_UTILITIES_H
+
+#include "sys_utilities.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+
+
+//
+// Emulator Lepton Utilities API
+//
+bool emu_lep_load_replay(const char* file);
+void emu_lep_init();
+void emu_lep_get_frame(lep_buffer_t* sys_bufP);
+
+#endif /* EMU_LEP_UTILITIES_H */
@@ -0,0 +1,258 @@
+/*
+ * tCam-Mini Emulator
+ *
+ * Runs the tCam-Mini firmware's command processor, json encoders and response task
+ * on Linux with emulated Lepton frames so host software can be developed and load
+ * tested without hardware.  Each emulated camera is a separate process listening on
+ * its own port.  Cameras that reboot (for example after a firmware update) are
+ * restarted.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "emu_config.h"
+#include "emu_lep_utilities.h"
+#include "emu_sys_utilities.h"
+#include "ctrl_task.h"
+#include "lep_task.h"
+#include "net_cmd_task.h"
+#include "rsp_task.h"
+#include "lepton_utilities.h"
+#include "sys_utilities.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+
+//
+// Emulator variables
+//
+static const char* TAG = "main";
+
+static int num_cams = EMU_DEF_NUM_CAMS;
+static const char* name_base = EMU_DEF_NAME;
+static pid_t cam_pids[EMU_MAX_CAMS];
+
+
+
+//
+// Emulator Forward Declarations for internal functions
+//
+static void usage(const char* prog);
+static pid_t start_camera(int index);
+static void run_camera(int index);
+static void stop_cameras(int sig);
+
+
+
+//
+// Emulator entry point
+//
+int main(int argc, char** argv)
+{
+	int c;
+	int i;
+	int num_running;
+	int status;
+	pid_t pid;
+	
+	// Defaults
+	emu_config.port = EMU_DEF_PORT;
+	emu_config.fps = EMU_DEF_FPS;
+	emu_config.eth = false;
+	emu_config.lep_type = LEP_TYPE_3_5;
+	emu_config.replay_file = NULL;
+	emu_config.fw_file = NULL;
+	
+	while ((c = getopt(argc, argv, "p:n:r:f:l:w:N:eqvh")) != -1) {
+		switch (c) {
+			case 'p':
+				emu_config.port = atoi(optarg);
+				break;
+			case 'n':
+				num_cams = atoi(optarg);
+				break;
+			case 'r':
+				emu_config.fps = atof(optarg);
+				break;
+			case 'f':
+				emu_config.replay_file = optarg;
+				break;
+			case 'l':
+				if (strcmp(optarg, "3.5") == 0) {
+					emu_config.lep_type = LEP_TYPE_3_5;
+				} else if (strcmp(optarg, "3.0") == 0) {
+					emu_config.lep_type = LEP_TYPE_3_0;
+				} else if (strcmp(optarg, "3.1") == 0) {
+					emu_config.lep_type = LEP_TYPE_3_1;
+				} else {
+					usage(argv[0]);
+				}
+				break;
+			case 'w':
+				emu_config.fw_file = optarg;
+				break;
+			case 'N':
+				name_base = optarg;
+				break;
+			case 'e':
+				emu_config.eth = true;
+				break;
+			case 'q':
+				emu_log_set_level(ESP_LOG_ERROR);
+				break;
+			case 'v':
+				emu_log_set_level(ESP_LOG_DEBUG);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if ((num_cams < 1) || (num_cams > EMU_MAX_CAMS) ||
+	    (emu_config.fps <= 0) || (emu_config.fps > EMU_MAX_FPS) ||
+	    (emu_config.port < 1) || ((emu_config.port + num_cams - 1) > 65535)) {
+		usage(argv[0]);
+	}
+	if ((emu_config.fw_file != NULL) && (num_cams > 1)) {
+		ESP_LOGE(TAG, "-w can only be used with one camera");
+		exit(1);
+	}
+	
+	// Load replay frames once so all cameras share them
+	if (emu_config.replay_file != NULL) {
+		if (!emu_lep_load_replay(emu_config.replay_file)) {
+			exit(1);
+		}
+	}
+	
+	// Broken connections are reported by send() instead of a signal as in lwIP
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, stop_cameras);
+	signal(SIGTERM, stop_cameras);
+	
+	for (i=0; i<num_cams; i++) {
+		cam_pids[i] = start_camera(i);
+	}
+	num_running = num_cams;
+	
+	// Supervise the cameras, restarting any that reboot
+	while (num_running > 0) {
+		pid = wait(&status);
+		if (pid < 0) break;
+		
+		for (i=0; i<num_cams; i++) {
+			if (cam_pids[i] == pid) break;
+		}
+		if (i == num_cams) continue;
+		
+		if (WIFEXITED(status) && (WEXITSTATUS(status) == EMU_EXIT_RESTART)) {
+			cam_pids[i] = start_camera(i);
+		} else {
+			cam_pids[i] = 0;
+			num_running--;
+		}
+	}
+	
+	return 0;
+}
+
+
+
+//
+// Emulator internal functions
+//
+static void usage(const char* prog)
+{
+	fprintf(stderr, "Usage: %s [options]\n", prog);
+	fprintf(stderr, "  -p <port>  Command port of the first camera (default %d)\n", EMU_DEF_PORT);
+	fprintf(stderr, "  -n <num>   Number of cameras on consecutive ports (default %d, max %d)\n", EMU_DEF_NUM_CAMS, EMU_MAX_CAMS);
+	fprintf(stderr, "  -r <fps>   Lepton frame rate (default %1.1f, max %1.0f)\n", EMU_DEF_FPS, EMU_MAX_FPS);
+	fprintf(stderr, "  -f <file>  Replay images from a .tjsn or .tmjsn file instead of a synthetic scene\n");
+	fprintf(stderr, "  -l <type>  Lepton type: 3.5 (radiometric, default), 3.1 or 3.0\n");
+	fprintf(stderr, "  -e         Emulate the Ethernet board (default WiFi)\n");
+	fprintf(stderr, "  -w <file>  Write firmware received by a firmware update to a file\n");
+	fprintf(stderr, "  -N <name>  Camera name prefix (default %s); the camera number is appended\n", EMU_DEF_NAME);
+	fprintf(stderr, "  -q / -v    Log only errors / log debug messages\n");
+	exit(1);
+}
+
+
+static pid_t start_camera(int index)
+{
+	pid_t pid;
+	
+	pid = fork();
+	if (pid < 0) {
+		ESP_LOGE(TAG, "Could not start camera %d", index);
+	} else if (pid == 0) {
+		signal(SIGINT, SIG_DFL);
+		signal(SIGTERM, SIG_DFL);
+		run_camera(index);
+	}
+	
+	return pid;
+}
+
+
+static void run_camera(int index)
+{
+	emu_config.index = index;
+	emu_config.port += index;
+	snprintf(emu_config.name, sizeof(emu_config.name), "%s%02X", name_base, index);
+	emu_log_set_prefix(emu_config.name);
+	
+	system_emu_init();
+	if (!system_buffer_init()) {
+		ESP_LOGE(TAG, "Memory allocate failed");
+		exit(1);
+	}
+	
+	// Start tasks.  rsp_task must initialize before commands are accepted.
+	xTaskCreatePinnedToCore(&ctrl_task, "ctrl_task", 2176, NULL, 1, &task_handle_ctrl, 0);
+	xTaskCreatePinnedToCore(&rsp_task, "rsp_task", 2816, NULL, 19, &task_handle_rsp, 0);
+	xTaskCreatePinnedToCore(&lep_task, "lep_task", 2304, NULL, 19, &task_handle_lep, 1);
+	vTaskDelay(pdMS_TO_TICKS(50));
+	xTaskCreatePinnedToCore(&net_cmd_task, "net_cmd_task", 3072, NULL, 1, &task_handle_cmd, 0);
+	
+	while (1) {
+		pause();
+	}
+}
+
+
+static void stop_cameras(int sig)
+{
+	int i;
+	
+	for (i=0; i<num_cams; i++) {
+		if (cam_pids[i] > 0) {
+			kill(cam_pids[i], SIGTERM);
+		}
+	}
+	_exit(0);
+}
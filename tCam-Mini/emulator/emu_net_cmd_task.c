@@ -0,0 +1,169 @@
+/*
+ * Emulator Network Command Task
+ *
+ * Replaces the firmware's net_cmd_task.  Accepts one client at a time on the
+ * emulated camera's port and feeds received data to the firmware's command
+ * processor.  mDNS is not emulated.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "emu_config.h"
+#include "net_cmd_task.h"
+#include "ctrl_task.h"
+#include "rsp_task.h"
+#include "cmd_utilities.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+
+
+
+//
+// Network CMD Task variables
+//
+static const char* TAG = "net_cmd_task";
+
+// Client socket
+static int client_sock = -1;
+
+// Connected status
+static volatile bool connected = false;
+
+
+
+//
+// Network CMD Task API
+//
+void net_cmd_task()
+{
+	char rx_buffer[256];
+	char addr_str[16];
+	int err;
+	int flag;
+	int len;
+	int listen_sock;
+	struct sockaddr_in destAddr;
+	struct sockaddr_in sourceAddr;
+	socklen_t addrLen;
+	
+	ESP_LOGI(TAG, "Start task");
+	
+	destAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+	destAddr.sin_family = AF_INET;
+	destAddr.sin_port = htons(emu_config.port);
+	
+	// socket - bind - listen - accept
+	listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+	if (listen_sock < 0) {
+		ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+		goto error;
+	}
+	
+	flag = 1;
+	setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+	err = bind(listen_sock, (struct sockaddr *)&destAddr, sizeof(destAddr));
+	if (err != 0) {
+		ESP_LOGE(TAG, "Socket unable to bind to port %d: errno %d", emu_config.port, errno);
+		goto error;
+	}
+	
+	err = listen(listen_sock, 1);
+	if (err != 0) {
+		ESP_LOGE(TAG, "Error occured during listen: errno %d", errno);
+		goto error;
+	}
+	ESP_LOGI(TAG, "Listening on port %d", emu_config.port);
+	
+	while (1) {
+		init_command_processor();
+		
+		addrLen = sizeof(sourceAddr);
+		client_sock = accept(listen_sock, (struct sockaddr *)&sourceAddr, &addrLen);
+		if (client_sock < 0) {
+			ESP_LOGE(TAG, "Unable to accept connection: errno %d", errno);
+			break;
+		}
+		inet_ntoa_r(sourceAddr.sin_addr, addr_str, sizeof(addr_str));
+		ESP_LOGI(TAG, "Connection from %s", addr_str);
+		connected = true;
+		
+		// Handle communication with client
+		while (1) {
+			len = recv(client_sock, rx_buffer, sizeof(rx_buffer), MSG_DONTWAIT);
+			// Error occured during receiving
+			if (len < 0) {
+				if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+					// Nothing there to receive, so just wait before calling recv again
+					vTaskDelay(pdMS_TO_TICKS(50));
+				} else {
+					ESP_LOGE(TAG, "recv failed: errno %d", errno);
+					break;
+				}
+			}
+			// Connection closed
+			else if (len == 0) {
+				ESP_LOGI(TAG, "Connection closed");
+				break;
+			}
+			// Data received
+			else {
+				// Store new data
+				push_rx_data(rx_buffer, len);
+				
+				// Look for and handle commands
+				while (process_rx_data()) {}
+			}
+		}
+		
+		// Close this session (rsp_task stops using the socket when it sees we are
+		// disconnected)
+		connected = false;
+		vTaskDelay(pdMS_TO_TICKS(RSP_TASK_EVAL_NORM_MSEC * 2));
+		shutdown(client_sock, SHUT_RDWR);
+		close(client_sock);
+		client_sock = -1;
+	}
+
+error:
+	ESP_LOGE(TAG, "Something went seriously wrong with networking handling - bailing");
+	ctrl_set_fault_type(CTRL_FAULT_NETWORK);
+	vTaskDelete(NULL);
+}
+
+
+/**
+ * True when connected to a client
+ */
+bool net_cmd_connected()
+{
+	return connected;
+}
+
+
+/**
+ * Return socket descriptor
+ */
+int net_cmd_get_socket()
+{
+	return client_sock;
+}
@@ -0,0 +1,430 @@
+/*
+ * Emulator System Utilities
+ *
+ * Replaces the firmware's sys_utilities, ps_utilities, net_utilities and time_utilities
+ * modules and the ESP32 identity calls.  Settings are held in memory for the life
+ * of the camera process.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "emu_config.h"
+#include "emu_sys_utilities.h"
+#include "ctrl_task.h"
+#include "json_utilities.h"
+#include "net_utilities.h"
+#include "ps_utilities.h"
+#include "sif_utilities.h"
+#include "sys_utilities.h"
+#include "time_utilities.h"
+#include "alarm_utilities.h"
+#include "filter_utilities.h"
+#include "perf_utilities.h"
+#include "roi_utilities.h"
+#include "vospi.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_ota_ops.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+
+
+//
+// System Utilities variables
+//
+static const char* TAG = "sys";
+
+// Emulator configuration
+emu_config_t emu_config;
+
+// Emulated network and time state
+static char net_ap_ssid[PS_SSID_MAX_LEN+1];
+static char net_sta_ssid[PS_SSID_MAX_LEN+1];
+static char net_ap_pw[PS_PW_MAX_LEN+1];
+static char net_sta_pw[PS_PW_MAX_LEN+1];
+static net_info_t net_info = {
+	net_ap_ssid,
+	net_sta_ssid,
+	net_ap_pw,
+	net_sta_pw,
+	0,
+	{1, 4, 168, 192},
+	{1, 0, 0, 127},
+	{0, 0, 0, 255},
+	{1, 0, 0, 127}
+};
+static int64_t time_offset_usec;           // Set time minus host time
+
+static esp_app_desc_t app_desc;
+
+
+//
+// Task handle externs for use by tasks to communicate with each other
+//
+TaskHandle_t task_handle_cmd;
+TaskHandle_t task_handle_ctrl;
+TaskHandle_t task_handle_lep;
+TaskHandle_t task_handle_rsp;
+
+
+//
+// Lepton configuration state
+//
+json_config_t lep_st;
+
+
+//
+// Global buffer pointers for allocated memory
+//
+
+// Shared memory data structures
+lep_buffer_t rsp_lep_buffer[2];
+lep_buffer_t rsp_filt_buffer[2];
+bool rsp_filt_valid[2];
+
+// Big buffers
+char* rx_circular_buffer;
+char* json_cmd_string;
+image_rsp_t sys_image_rsp_buffer;
+json_cmd_response_queue_t sys_cmd_response_buffer;
+
+// Firmware update segment
+uint8_t fw_upd_segment[FM_UPD_CHUNK_MAX_LEN];
+
+
+
+//
+// Network Utilities function pointers
+//
+static bool emu_net_reinit();
+static bool emu_net_is_connected();
+static net_info_t* emu_net_get_info();
+
+bool (*net_reinit)() = &emu_net_reinit;
+bool (*net_is_connected)() = &emu_net_is_connected;
+net_info_t* (*net_get_info)() = &emu_net_get_info;
+
+
+
+//
+// System Utilities API
+//
+
+/**
+ * Initialize the emulated camera's state (matches the firmware's defaults)
+ */
+void system_emu_init()
+{
+	int i;
+	
+	lep_st.agc_set_enabled = false;
+	lep_st.emissivity = 100;
+	lep_st.gain_mode = SYS_GAIN_HIGH;
+	
+	strncpy(net_ap_ssid, emu_config.name, PS_SSID_MAX_LEN);
+	net_ap_ssid[PS_SSID_MAX_LEN] = 0;
+	net_ap_pw[0] = 0;
+	net_sta_ssid[0] = 0;
+	net_sta_pw[0] = 0;
+	net_info.flags = NET_INFO_FLAG_STARTUP_ENABLE | NET_INFO_FLAG_INITIALIZED |
+	                 NET_INFO_FLAG_ENABLED | NET_INFO_FLAG_CONNECTED;
+	if (!emu_config.eth) {
+		net_info.flags |= NET_INFO_FLAG_CLIENT_MODE;
+	}
+	
+	for (i=0; i<6; i++) {
+		emu_config.mac[i] = (i < 4) ? 0x02 : 0;
+	}
+	emu_config.mac[4] = (emu_config.index >> 8) & 0xFF;
+	emu_config.mac[5] = emu_config.index & 0xFF;
+	
+	app_desc.magic_word = 0xABCD5432;
+	strncpy(app_desc.version, EMU_VERSION, sizeof(app_desc.version) - 1);
+	strncpy(app_desc.project_name, "tCamMini", sizeof(app_desc.project_name) - 1);
+	strncpy(app_desc.time, __TIME__, sizeof(app_desc.time) - 1);
+	strncpy(app_desc.date, __DATE__, sizeof(app_desc.date) - 1);
+	strncpy(app_desc.idf_ver, "emulator", sizeof(app_desc.idf_ver) - 1);
+}
+
+
+bool system_buffer_init()
+{
+	int i;
+	
+	ESP_LOGI(TAG, "Buffer Allocation");
+	
+	// Allocate the LEP/RSP task lepton frame and telemetry ping-pong buffers
+	rsp_lep_buffer[0].lep_bufferP = heap_caps_malloc(LEP_NUM_PIXELS*2, MALLOC_CAP_SPIRAM);
+	rsp_lep_buffer[0].lep_telemP = heap_caps_malloc(LEP_TEL_WORDS*2, MALLOC_CAP_SPIRAM);
+	rsp_lep_buffer[1].lep_bufferP = heap_caps_malloc(LEP_NUM_PIXELS*2, MALLOC_CAP_SPIRAM);
+	rsp_lep_buffer[1].lep_telemP = heap_caps_malloc(LEP_TEL_WORDS*2, MALLOC_CAP_SPIRAM);
+	if ((rsp_lep_buffer[0].lep_bufferP == NULL) || (rsp_lep_buffer[0].lep_telemP == NULL) ||
+	    (rsp_lep_buffer[1].lep_bufferP == NULL) || (rsp_lep_buffer[1].lep_telemP == NULL)) {
+		ESP_LOGE(TAG, "malloc RSP lepton shared buffers failed");
+		return false;
+	}
+	rsp_lep_buffer[0].lep_mutex = xSemaphoreCreateMutex();
+	rsp_lep_buffer[1].lep_mutex = xSemaphoreCreateMutex();
+	for (i=0; i<2; i++) {
+		rsp_filt_buffer[i].lep_bufferP = heap_caps_malloc(LEP_NUM_PIXELS*2, MALLOC_CAP_SPIRAM);
+		if (rsp_filt_buffer[i].lep_bufferP == NULL) {
+			ESP_LOGE(TAG, "malloc RSP lepton filtered image buffers failed");
+			return false;
+		}
+		rsp_filt_buffer[i].lep_telemP = rsp_lep_buffer[i].lep_telemP;
+		rsp_filt_buffer[i].lep_mutex = rsp_lep_buffer[i].lep_mutex;
+		rsp_filt_valid[i] = false;
+	}
+	
+	// Allocate the json buffers
+	if (!json_init()) {
+		ESP_LOGE(TAG, "malloc json buffers failed");
+		return false;
+	}
+	
+	// Allocate the region of interest statistics buffers
+	if (!roi_init()) {
+		ESP_LOGE(TAG, "malloc roi buffers failed");
+		return false;
+	}
+	
+	// Initialize the temperature alarm rules
+	if (!alarm_init()) {
+		ESP_LOGE(TAG, "alarm initialization failed");
+		return false;
+	}
+	
+	// Initialize the temporal noise filter
+	if (!filter_init()) {
+		ESP_LOGE(TAG, "filter initialization failed");
+		return false;
+	}
+	
+	// Initialize performance accounting
+	if (!perf_init()) {
+		ESP_LOGE(TAG, "perf initialization failed");
+		return false;
+	}
+	
+	// Allocate the incoming command buffers
+	rx_circular_buffer = heap_caps_malloc(JSON_MAX_CMD_TEXT_LEN, MALLOC_CAP_SPIRAM);
+	json_cmd_string = heap_caps_malloc(JSON_MAX_CMD_TEXT_LEN, MALLOC_CAP_SPIRAM);
+	if ((rx_circular_buffer == NULL) || (json_cmd_string == NULL)) {
+		ESP_LOGE(TAG, "malloc command buffers failed");
+		return false;
+	}
+	
+	// Allocate the outgoing command response json buffer
+	sys_cmd_response_buffer.mutex = xSemaphoreCreateMutex();
+	sys_cmd_response_buffer.bufferP = heap_caps_malloc(CMD_RESPONSE_BUFFER_LEN, MALLOC_CAP_SPIRAM);
+	if (sys_cmd_response_buffer.bufferP == NULL) {
+		ESP_LOGE(TAG, "malloc cmd response buffer failed");
+		return false;
+	}
+	sys_cmd_response_buffer.pushP = sys_cmd_response_buffer.bufferP;
+	sys_cmd_response_buffer.popP = sys_cmd_response_buffer.bufferP;
+	sys_cmd_response_buffer.length = 0;
+	
+	// Allocate the json image text buffer (with room for the header and trailer segments)
+	sys_image_rsp_buffer.bufferP = heap_caps_malloc(JSON_MAX_IMAGE_TEXT_LEN + IMG_RSP_MAX_HDR_LEN + IMG_RSP_MAX_TRL_LEN, MALLOC_CAP_DMA);
+	if (sys_image_rsp_buffer.bufferP == NULL) {
+		ESP_LOGE(TAG, "malloc shared json image text response buffer failed");
+		return false;
+	}
+	
+	return true;
+}
+
+
+/**
+ * The serial/SPI interface is not emulated
+ */
+bool system_config_spi_slave(char* buf, int len)
+{
+	return false;
+}
+
+
+bool system_spi_slave_busy()
+{
+	return false;
+}
+
+
+bool system_spi_wait_done()
+{
+	return false;
+}
+
+
+void sif_send(const char* s, int len)
+{
+}
+
+
+
+//
+// PS Utilities API
+//
+void ps_set_lep_state(const json_config_t* state)
+{
+	ESP_LOGI(TAG, "Lepton state: agc %d, emissivity %d, gain %d", state->agc_set_enabled,
+		state->emissivity, state->gain_mode);
+}
+
+
+void ps_set_net_info(const net_info_t* info)
+{
+	int i;
+	
+	strncpy(net_ap_ssid, info->ap_ssid, PS_SSID_MAX_LEN);
+	strncpy(net_ap_pw, info->ap_pw, PS_PW_MAX_LEN);
+	strncpy(net_sta_ssid, info->sta_ssid, PS_SSID_MAX_LEN);
+	strncpy(net_sta_pw, info->sta_pw, PS_PW_MAX_LEN);
+	net_info.flags = info->flags | NET_INFO_FLAG_INITIALIZED | NET_INFO_FLAG_CONNECTED;
+	for (i=0; i<4; i++) {
+		net_info.ap_ip_addr[i] = info->ap_ip_addr[i];
+		net_info.sta_ip_addr[i] = info->sta_ip_addr[i];
+		net_info.sta_netmask[i] = info->sta_netmask[i];
+	}
+}
+
+
+bool ps_has_new_cam_name(const net_info_t* info)
+{
+	return (strncmp(net_ap_ssid, info->ap_ssid, PS_SSID_MAX_LEN) != 0);
+}
+
+
+char ps_nibble_to_ascii(uint8_t n)
+{
+	n = n & 0x0F;
+	
+	if (n < 10) {
+		return '0' + n;
+	} else {
+		return 'A' + n - 10;
+	}
+}
+
+
+
+//
+// Time Utilities API
+//
+
+/**
+ * The host clock is not changed.  Instead the difference to the requested time is
+ * applied to subsequent reads.
+ */
+void time_set(tmElements_t te)
+{
+	struct timeval tv;
+	struct tm timeinfo;
+	time_t secs;
+	
+	memset(&timeinfo, 0, sizeof(timeinfo));
+	timeinfo.tm_sec = te.Second;
+	timeinfo.tm_min = te.Minute;
+	timeinfo.tm_hour = te.Hour;
+	timeinfo.tm_mday = te.Day;
+	timeinfo.tm_mon = te.Month - 1;      // January is 1 in our tmElements structure
+	timeinfo.tm_year = te.Year + 70;     // tmElements starts at 1970
+	timeinfo.tm_isdst = -1;
+	secs = mktime(&timeinfo);
+	
+	(void) gettimeofday(&tv, NULL);
+	time_offset_usec = ((int64_t) secs - (int64_t) tv.tv_sec) * 1000000LL - tv.tv_usec;
+}
+
+
+void time_get(tmElements_t* te)
+{
+	int64_t usec;
+	time_t now;
+	struct timeval tv;
+	struct tm timeinfo;
+	
+	(void) gettimeofday(&tv, NULL);
+	usec = (int64_t) tv.tv_sec * 1000000LL + tv.tv_usec + time_offset_usec;
+	now = (time_t) (usec / 1000000LL);
+	localtime_r(&now, &timeinfo);
+	te->Millisecond = (uint16_t) ((usec % 1000000LL) / 1000);
+	te->Second = (uint8_t) timeinfo.tm_sec;
+	te->Minute = (uint8_t) timeinfo.tm_min;
+	te->Hour = (uint8_t) timeinfo.tm_hour;
+	te->Wday = (uint8_t) timeinfo.tm_wday + 1; // Sunday is 1 in our tmElements structure
+	te->Day = (uint8_t) timeinfo.tm_mday;
+	te->Month = (uint8_t) timeinfo.tm_mon + 1; // January is 1 in our tmElements structure
+	te->Year = (uint8_t) (timeinfo.tm_year - 70); // tmElements starts at 1970
+}
+
+
+
+//
+// ESP32 identity
+//
+esp_err_t esp_efuse_mac_get_default(uint8_t* mac)
+{
+	memcpy(mac, emu_config.mac, 6);
+	return ESP_OK;
+}
+
+
+const esp_app_desc_t* esp_ota_get_app_description()
+{
+	return &app_desc;
+}
+
+
+/**
+ * The camera process exits and is restarted by the emulator's supervisor
+ */
+void esp_restart()
+{
+	ESP_LOGI(TAG, "Restart");
+	fflush(stderr);
+	exit(EMU_EXIT_RESTART);
+}
+
+
+
+//
+// Network Utilities internal functions
+//
+static bool emu_net_reinit()
+{
+	ESP_LOGI(TAG, "Network reinit: %s", net_ap_ssid);
+	return true;
+}
+
+
+static bool emu_net_is_connected()
+{
+	return true;
+}
+
+
+static net_info_t* emu_net_get_info()
+{
+	return &net_info;
+}
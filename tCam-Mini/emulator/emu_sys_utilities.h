@@ -0,0 +1,38 @@
+/*
+ * Emulator System Utilities
+ *
+ * Replaces the firmware's sys_utilities, ps_utilities, net_utilities and time_utilities
+ * modules and the ESP32 identity calls.  Settings are held in memory for the life
+ * of the camera process.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef EMU_SYS_UTILITIES_H
+#define EMU_SYS_UTILITIES_H
+
+#include <stdbool.h>
+
+
+
+//
+// Emulator System Utilities API
+//
+void system_emu_init();
+
+#endif /* EMU_SYS_UTILITIES_H */
@@ -0,0 +1,121 @@
+/*
+ * Emulator Update Utilities
+ *
+ * Replaces the firmware's upd_utilities.  Firmware is not validated.  It is counted
+ * and optionally written to a file so the host's update process can be exercised.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "emu_config.h"
+#include "upd_utilities.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+
+
+
+//
+// Update Utilities variables
+//
+static const char* TAG = "upd_utilities";
+
+// State
+static char exp_version[UPD_MAX_VER_LEN+1];
+static uint32_t total_len;
+static uint32_t cur_len;
+static FILE* upd_fp;
+
+
+
+//
+// Update Utilities API
+//
+bool upd_init(uint32_t len, char* version)
+{
+	if (emu_config.fw_file != NULL) {
+		upd_fp = fopen(emu_config.fw_file, "wb");
+		if (upd_fp == NULL) {
+			ESP_LOGE(TAG, "Could not open %s", emu_config.fw_file);
+			return false;
+		}
+	}
+	
+	// Save information about the update
+	total_len = len;
+	cur_len = 0;
+	memset(exp_version, 0, sizeof(exp_version));
+	strncpy(exp_version, version, UPD_MAX_VER_LEN);
+	
+	ESP_LOGI(TAG, "Update to %s: %u bytes", exp_version, total_len);
+	return true;
+}
+
+
+bool upd_complete()
+{
+	bool success = (cur_len == total_len);
+	
+	if (upd_fp != NULL) {
+		if (fclose(upd_fp) != 0) {
+			ESP_LOGE(TAG, "Could not write %s", emu_config.fw_file);
+			success = false;
+		}
+		upd_fp = NULL;
+	}
+	
+	return success;
+}
+
+
+void upd_early_terminate()
+{
+	if (upd_fp != NULL) {
+		fclose(upd_fp);
+		upd_fp = NULL;
+	}
+}
+
+
+bool upd_process_bytes(uint32_t start, uint32_t len, uint8_t* buf)
+{
+	bool success = true;
+	
+	// Validate incoming arguments
+	if (start != cur_len) {
+		ESP_LOGE(TAG, "upd_process_bytes exp %u does not match start %u", cur_len, start);
+		return false;
+	}
+	
+	if (upd_fp != NULL) {
+		if (fwrite(buf, 1, len, upd_fp) != len) {
+			ESP_LOGE(TAG, "Write failed at %u for %u bytes", start, len);
+			success = false;
+		}
+	}
+	
+	if (!success) {
+		upd_early_terminate();
+	}
+	
+	// Keep track of downloaded bytes
+	cur_len += len;
+	
+	return success;
+}
@@ -0,0 +1,71 @@
+/*
+ * ESP-IDF SPI master shim
+ *
+ * Linux replacement for driver/spi_master.h.  The emulator does not use the SPI
+ * bus.  The benchmarks supply spi_device_polling_transmit to feed recorded VoSPI
+ * packets to the firmware's vospi module.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef SPI_MASTER_H
+#define SPI_MASTER_H
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define HSPI_HOST 1
+#define VSPI_HOST 2
+
+#define SPI_DEVICE_HALFDUPLEX (1 << 4)
+
+typedef int spi_host_device_t;
+
+typedef struct spi_device_t* spi_device_handle_t;
+
+typedef struct {
+	uint8_t command_bits;
+	uint8_t address_bits;
+	uint8_t dummy_bits;
+	uint8_t mode;
+	uint16_t duty_cycle_pos;
+	uint16_t cs_ena_pretrans;
+	uint8_t cs_ena_posttrans;
+	int clock_speed_hz;
+	int input_delay_ns;
+	int spics_io_num;
+	uint32_t flags;
+	int queue_size;
+} spi_device_interface_config_t;
+
+typedef struct {
+	uint32_t flags;
+	uint16_t cmd;
+	uint64_t addr;
+	size_t length;
+	size_t rxlength;
+	void* user;
+	const void* tx_buffer;
+	void* rx_buffer;
+} spi_transaction_t;
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t* dev_config, spi_device_handle_t* handle);
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t* trans_desc);
+
+#endif /* SPI_MASTER_H */
@@ -0,0 +1,77 @@
+/*
+ * ESP-IDF heap shim
+ *
+ * Linux replacement for esp_heap_caps.h.  All capabilities are satisfied by malloc.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ESP_HEAP_CAPS_H
+#define ESP_HEAP_CAPS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+
+//
+// ESP Heap shim constants
+//
+#define MALLOC_CAP_EXEC     (1<<0)
+#define MALLOC_CAP_32BIT    (1<<1)
+#define MALLOC_CAP_8BIT     (1<<2)
+#define MALLOC_CAP_DMA      (1<<3)
+#define MALLOC_CAP_SPIRAM   (1<<10)
+#define MALLOC_CAP_INTERNAL (1<<11)
+#define MALLOC_CAP_DEFAULT  (1<<12)
+
+
+
+//
+// ESP Heap shim API
+//
+static inline void* heap_caps_malloc(size_t size, uint32_t caps)
+{
+	(void) caps;
+	return malloc(size);
+}
+
+static inline void heap_caps_free(void* ptr)
+{
+	free(ptr);
+}
+
+// Heap usage is not tracked on the host
+static inline size_t heap_caps_get_free_size(uint32_t caps)
+{
+	(void) caps;
+	return 0;
+}
+
+static inline size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+	(void) caps;
+	return 0;
+}
+
+static inline size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+	(void) caps;
+	return 0;
+}
+
+#endif /* ESP_HEAP_CAPS_H */
@@ -0,0 +1,56 @@
+/*
+ * ESP-IDF logging shim
+ *
+ * Linux replacement for esp_log.h.  Messages are written to stderr prefixed
+ * with the emulated camera's name.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ESP_LOG_H
+#define ESP_LOG_H
+
+#include <stdint.h>
+
+
+//
+// ESP Log shim constants
+//
+#define ESP_LOG_NONE    0
+#define ESP_LOG_ERROR   1
+#define ESP_LOG_WARN    2
+#define ESP_LOG_INFO    3
+#define ESP_LOG_DEBUG   4
+#define ESP_LOG_VERBOSE 5
+
+
+
+//
+// ESP Log shim API
+//
+void emu_log_set_level(int level);
+void emu_log_set_prefix(const char* prefix);
+void emu_log(int level, const char* tag, const char* fmt, ...) __attribute__ ((format (printf, 3, 4)));
+
+#define ESP_LOGE(tag, fmt, ...) emu_log(ESP_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) emu_log(ESP_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) emu_log(ESP_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) emu_log(ESP_LOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) emu_log(ESP_LOG_VERBOSE, tag, fmt, ##__VA_ARGS__)
+
+#endif /* ESP_LOG_H */
@@ -0,0 +1,251 @@
+/*
+ * ESP-IDF shim
+ *
+ * Implements the timer, logging and base64 calls used by the firmware sources
+ * on Linux.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mbedtls/base64.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+
+
+
+//
+// ESP shim variables
+//
+static int log_level = ESP_LOG_INFO;
+static char log_prefix[32] = "tcam";
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Timer reference
+static pthread_once_t timer_once = PTHREAD_ONCE_INIT;
+static struct timespec timer_start;
+
+static const char base64_enc_map[64] = {
+	'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J',
+	'K', 'L', 'M', 'N', 'O', 'P', 'Q', 'R', 'S', 'T',
+	'U', 'V', 'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd',
+	'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n',
+	'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x',
+	'y', 'z', '0', '1', '2', '3', '4', '5', '6', '7',
+	'8', '9', '+', '/'
+};
+
+
+
+//
+// ESP shim Forward Declarations for internal functions
+//
+static void timer_init();
+static int base64_dec_char(unsigned char c);
+
+
+
+//
+// Timer API
+//
+int64_t esp_timer_get_time()
+{
+	struct timespec ts;
+	
+	pthread_once(&timer_once, timer_init);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((int64_t) (ts.tv_sec - timer_start.tv_sec) * 1000000LL) +
+	       ((int64_t) (ts.tv_nsec - timer_start.tv_nsec) / 1000LL);
+}
+
+
+
+//
+// Logging API
+//
+void emu_log_set_level(int level)
+{
+	log_level = level;
+}
+
+
+void emu_log_set_prefix(const char* prefix)
+{
+	snprintf(log_prefix, sizeof(log_prefix), "%s", prefix);
+}
+
+
+void emu_log(int level, const char* tag, const char* fmt, ...)
+{
+	static const char level_char[] = "NEWIDV";
+	va_list args;
+	
+	if ((level > log_level) || (level < ESP_LOG_ERROR)) return;
+	
+	pthread_mutex_lock(&log_mutex);
+	fprintf(stderr, "%c (%lld) %s %s: ", level_char[level], (long long) (esp_timer_get_time() / 1000), log_prefix, tag);
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fputc('\n', stderr);
+	pthread_mutex_unlock(&log_mutex);
+}
+
+
+
+//
+// mbedTLS base64 API
+//
+
+/**
+ * Encode slen bytes.  Like mbedTLS, a buffer that is too small (including a zero
+ * length buffer) returns the required length, including a terminating null, in olen.
+ */
+int mbedtls_base64_encode(unsigned char* dst, size_t dlen, size_t* olen, const unsigned char* src, size_t slen)
+{
+	size_t i, n;
+	uint32_t v;
+	unsigned char* p;
+	
+	if (slen == 0) {
+		*olen = 0;
+		return 0;
+	}
+	
+	n = ((slen + 2) / 3) * 4;
+	if ((dst == NULL) || (dlen < n + 1)) {
+		*olen = n + 1;
+		return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+	}
+	
+	p = dst;
+	for (i=0; i + 2 < slen; i += 3) {
+		v = ((uint32_t) src[i] << 16) | ((uint32_t) src[i+1] << 8) | (uint32_t) src[i+2];
+		*p++ = base64_enc_map[(v >> 18) & 0x3F];
+		*p++ = base64_enc_map[(v >> 12) & 0x3F];
+		*p++ = base64_enc_map[(v >> 6) & 0x3F];
+		*p++ = base64_enc_map[v & 0x3F];
+	}
+	if (i < slen) {
+		v = (uint32_t) src[i] << 16;
+		if (i + 1 < slen) v |= (uint32_t) src[i+1] << 8;
+		*p++ = base64_enc_map[(v >> 18) & 0x3F];
+		*p++ = base64_enc_map[(v >> 12) & 0x3F];
+		*p++ = (i + 1 < slen) ? base64_enc_map[(v >> 6) & 0x3F] : '=';
+		*p++ = '=';
+	}
+	*p = 0;
+	*olen = p - dst;
+	
+	return 0;
+}
+
+
+/**
+ * Decode slen characters, ignoring line breaks.  Like mbedTLS, a buffer that is too
+ * small returns the required length in olen.
+ */
+int mbedtls_base64_decode(unsigned char* dst, size_t dlen, size_t* olen, const unsigned char* src, size_t slen)
+{
+	size_t i, n, x;
+	int c;
+	int pad;
+	uint32_t v;
+	unsigned char* p;
+	
+	// Validate and count the encoded characters
+	n = 0;
+	pad = 0;
+	for (i=0; i<slen; i++) {
+		if ((src[i] == '\r') || (src[i] == '\n') || (src[i] == ' ')) continue;
+		if (src[i] == '=') {
+			if (++pad > 2) return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+		} else if ((pad != 0) || (base64_dec_char(src[i]) < 0)) {
+			return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+		}
+		n++;
+	}
+	
+	if (n == 0) {
+		*olen = 0;
+		return 0;
+	}
+	if ((n % 4) != 0) {
+		return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+	}
+	
+	n = ((n * 6) + 7) >> 3;
+	n -= pad;
+	if ((dst == NULL) || (dlen < n)) {
+		*olen = n;
+		return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+	}
+	
+	// Decode
+	p = dst;
+	v = 0;
+	x = 0;
+	for (i=0; i<slen; i++) {
+		if ((src[i] == '\r') || (src[i] == '\n') || (src[i] == ' ') || (src[i] == '=')) continue;
+		c = base64_dec_char(src[i]);
+		v = (v << 6) | (uint32_t) c;
+		if (++x == 4) {
+			*p++ = (unsigned char) (v >> 16);
+			*p++ = (unsigned char) (v >> 8);
+			*p++ = (unsigned char) v;
+			v = 0;
+			x = 0;
+		}
+	}
+	if (x == 3) {
+		v <<= 6;
+		*p++ = (unsigned char) (v >> 16);
+		*p++ = (unsigned char) (v >> 8);
+	} else if (x == 2) {
+		v <<= 12;
+		*p++ = (unsigned char) (v >> 16);
+	}
+	*olen = p - dst;
+	
+	return 0;
+}
+
+
+
+//
+// ESP shim internal functions
+//
+static void timer_init()
+{
+	clock_gettime(CLOCK_MONOTONIC, &timer_start);
+}
+
+
+static int base64_dec_char(unsigned char c)
+{
+	if ((c >= 'A') && (c <= 'Z')) return c - 'A';
+	if ((c >= 'a') && (c <= 'z')) return c - 'a' + 26;
+	if ((c >= '0') && (c <= '9')) return c - '0' + 52;
+	if (c == '+') return 62;
+	if (c == '/') return 63;
+	return -1;
+}
@@ -0,0 +1,58 @@
+/*
+ * FreeRTOS shim
+ *
+ * Linux replacement for the FreeRTOS kernel types used by the firmware sources.
+ * Tasks run as pthreads.  The tick rate matches the firmware's CONFIG_FREERTOS_HZ.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+// ESP-IDF's portmacro.h makes the heap capability functions available
+#include "esp_heap_caps.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// FreeRTOS shim constants
+//
+#define configTICK_RATE_HZ  100
+
+#define pdFALSE             ((BaseType_t) 0)
+#define pdTRUE              ((BaseType_t) 1)
+#define pdFAIL              pdFALSE
+#define pdPASS              pdTRUE
+
+#define portMAX_DELAY       ((TickType_t) 0xFFFFFFFF)
+#define portTICK_PERIOD_MS  ((TickType_t) 1000 / configTICK_RATE_HZ)
+
+#define pdMS_TO_TICKS(ms)   ((TickType_t) (((TickType_t) (ms) * configTICK_RATE_HZ) / 1000))
+
+
+
+//
+// FreeRTOS shim typedefs
+//
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#endif /* FREERTOS_H */
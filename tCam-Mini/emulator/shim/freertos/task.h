@@ -0,0 +1,63 @@
+/*
+ * FreeRTOS task shim
+ *
+ * Linux replacement for freertos/task.h.  Each task is a pthread with its own
+ * notification value.  Only the eSetBits notification action is used by the firmware.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef TASK_H
+#define TASK_H
+
+#include "freertos/FreeRTOS.h"
+#include <stdint.h>
+
+
+//
+// FreeRTOS task shim typedefs
+//
+typedef struct emu_task* TaskHandle_t;
+
+typedef void (*TaskFunction_t)(void*);
+
+typedef enum {
+	eNoAction = 0,
+	eSetBits,
+	eIncrement,
+	eSetValueWithOverwrite,
+	eSetValueWithoutOverwrite
+} eNotifyAction;
+
+
+
+//
+// FreeRTOS task shim API
+//
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stack_depth, void* param, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+void vTaskDelete(TaskHandle_t handle);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+BaseType_t xTaskNotify(TaskHandle_t handle, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t ticks);
+
+#define xTaskCreate(task, name, stack_depth, param, priority, handle) \
+	xTaskCreatePinnedToCore(task, name, stack_depth, param, priority, handle, 0)
+
+#endif /* TASK_H */
@@ -0,0 +1,321 @@
+/*
+ * FreeRTOS shim
+ *
+ * Implements the FreeRTOS task, notification and mutex calls used by the firmware
+ * sources with pthreads so they run unchanged on Linux.  Task priorities and core
+ * affinity are ignored.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+
+//
+// FreeRTOS shim typedefs
+//
+struct emu_task {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint32_t notify_value;
+	bool notify_pending;
+	TaskFunction_t func;
+	void* param;
+	char name[16];
+};
+
+struct emu_mutex {
+	pthread_mutex_t lock;
+};
+
+
+
+//
+// FreeRTOS shim variables
+//
+static const char* TAG = "freertos_shim";
+
+// Task running on this thread (created on demand for threads not started by xTaskCreate)
+static __thread struct emu_task* cur_task;
+
+
+
+//
+// FreeRTOS shim Forward Declarations for internal functions
+//
+static struct emu_task* task_alloc(const char* name);
+static void* task_entry(void* arg);
+static void ticks_to_abstime(TickType_t ticks, struct timespec* ts);
+
+
+
+//
+// FreeRTOS shim API
+//
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stack_depth, void* param, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core)
+{
+	pthread_attr_t attr;
+	struct emu_task* t;
+	
+	(void) stack_depth;
+	(void) priority;
+	(void) core;
+	
+	t = task_alloc(name);
+	if (t == NULL) {
+		return pdFAIL;
+	}
+	t->func = task;
+	t->param = param;
+	
+	// The handle must be valid before the task runs since tasks notify each other immediately
+	if (handle != NULL) {
+		*handle = t;
+	}
+	
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (pthread_create(&t->thread, &attr, task_entry, t) != 0) {
+		ESP_LOGE(TAG, "Could not create %s", name);
+		pthread_attr_destroy(&attr);
+		return pdFAIL;
+	}
+	pthread_attr_destroy(&attr);
+	
+	return pdPASS;
+}
+
+
+/**
+ * Only a task deleting itself is supported
+ */
+void vTaskDelete(TaskHandle_t handle)
+{
+	if ((handle == NULL) || (handle == cur_task)) {
+		pthread_exit(NULL);
+	}
+	ESP_LOGE(TAG, "vTaskDelete of another task is not supported");
+}
+
+
+void vTaskDelay(TickType_t ticks)
+{
+	struct timespec ts;
+	
+	if (ticks == 0) {
+		sched_yield();
+		return;
+	}
+	
+	ts.tv_sec = ticks / configTICK_RATE_HZ;
+	ts.tv_nsec = (long) (ticks % configTICK_RATE_HZ) * (1000000000L / configTICK_RATE_HZ);
+	while ((nanosleep(&ts, &ts) != 0) && (errno == EINTR)) {}
+}
+
+
+TickType_t xTaskGetTickCount()
+{
+	return (TickType_t) (esp_timer_get_time() / (1000 * portTICK_PERIOD_MS));
+}
+
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+	if (cur_task == NULL) {
+		cur_task = task_alloc("thread");
+	}
+	return cur_task;
+}
+
+
+BaseType_t xTaskNotify(TaskHandle_t handle, uint32_t value, eNotifyAction action)
+{
+	BaseType_t ret = pdPASS;
+	
+	if (handle == NULL) return pdFAIL;
+	
+	pthread_mutex_lock(&handle->lock);
+	switch (action) {
+		case eNoAction:
+			break;
+		case eSetBits:
+			handle->notify_value |= value;
+			break;
+		case eIncrement:
+			handle->notify_value++;
+			break;
+		case eSetValueWithOverwrite:
+			handle->notify_value = value;
+			break;
+		case eSetValueWithoutOverwrite:
+			if (handle->notify_pending) {
+				ret = pdFAIL;
+			} else {
+				handle->notify_value = value;
+			}
+			break;
+	}
+	if (ret == pdPASS) {
+		handle->notify_pending = true;
+		pthread_cond_signal(&handle->cond);
+	}
+	pthread_mutex_unlock(&handle->lock);
+	
+	return ret;
+}
+
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t ticks)
+{
+	BaseType_t ret;
+	struct emu_task* t;
+	struct timespec ts;
+	
+	t = xTaskGetCurrentTaskHandle();
+	if (t == NULL) return pdFALSE;
+	
+	pthread_mutex_lock(&t->lock);
+	if (!t->notify_pending) {
+		t->notify_value &= ~clear_on_entry;
+		
+		if (ticks == portMAX_DELAY) {
+			while (!t->notify_pending) {
+				pthread_cond_wait(&t->cond, &t->lock);
+			}
+		} else if (ticks != 0) {
+			ticks_to_abstime(ticks, &ts);
+			while (!t->notify_pending) {
+				if (pthread_cond_timedwait(&t->cond, &t->lock, &ts) == ETIMEDOUT) break;
+			}
+		}
+	}
+	
+	if (value != NULL) {
+		*value = t->notify_value;
+	}
+	if (t->notify_pending) {
+		t->notify_value &= ~clear_on_exit;
+		t->notify_pending = false;
+		ret = pdTRUE;
+	} else {
+		ret = pdFALSE;
+	}
+	pthread_mutex_unlock(&t->lock);
+	
+	return ret;
+}
+
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+	struct emu_mutex* m;
+	
+	m = malloc(sizeof(struct emu_mutex));
+	if (m != NULL) {
+		pthread_mutex_init(&m->lock, NULL);
+	}
+	return m;
+}
+
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks)
+{
+	struct timespec ts;
+	
+	if (ticks == portMAX_DELAY) {
+		return (pthread_mutex_lock(&mutex->lock) == 0) ? pdTRUE : pdFALSE;
+	} else if (ticks == 0) {
+		return (pthread_mutex_trylock(&mutex->lock) == 0) ? pdTRUE : pdFALSE;
+	}
+	
+	ticks_to_abstime(ticks, &ts);
+	return (pthread_mutex_timedlock(&mutex->lock, &ts) == 0) ? pdTRUE : pdFALSE;
+}
+
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex)
+{
+	return (pthread_mutex_unlock(&mutex->lock) == 0) ? pdTRUE : pdFALSE;
+}
+
+
+void vSemaphoreDelete(SemaphoreHandle_t mutex)
+{
+	pthread_mutex_destroy(&mutex->lock);
+	free(mutex);
+}
+
+
+
+//
+// FreeRTOS shim internal functions
+//
+static struct emu_task* task_alloc(const char* name)
+{
+	struct emu_task* t;
+	
+	t = calloc(1, sizeof(struct emu_task));
+	if (t == NULL) {
+		ESP_LOGE(TAG, "Could not allocate task %s", name);
+		return NULL;
+	}
+	pthread_mutex_init(&t->lock, NULL);
+	pthread_cond_init(&t->cond, NULL);
+	strncpy(t->name, name, sizeof(t->name) - 1);
+	
+	return t;
+}
+
+
+static void* task_entry(void* arg)
+{
+	struct emu_task* t = (struct emu_task*) arg;
+	
+	cur_task = t;
+	pthread_setname_np(pthread_self(), t->name);
+	t->func(t->param);
+	
+	return NULL;
+}
+
+
+/**
+ * Convert a timeout in ticks to an absolute CLOCK_REALTIME time for the pthread
+ * timed waits
+ */
+static void ticks_to_abstime(TickType_t ticks, struct timespec* ts)
+{
+	int64_t nsec;
+	
+	clock_gettime(CLOCK_REALTIME, ts);
+	nsec = (int64_t) ts->tv_nsec + (int64_t) ticks * (1000000000LL / configTICK_RATE_HZ);
+	ts->tv_sec += nsec / 1000000000LL;
+	ts->tv_nsec = nsec % 1000000000LL;
+}
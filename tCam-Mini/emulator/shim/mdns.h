@@ -0,0 +1,36 @@
+/*
+ * mDNS shim
+ *
+ * Linux replacement for mdns.h.  The emulator does not advertise itself.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef MDNS_H
+#define MDNS_H
+
+#include "esp_err.h"
+#include <stdint.h>
+
+static inline esp_err_t mdns_hostname_set(const char* hostname)
+{
+	(void) hostname;
+	return ESP_OK;
+}
+
+#endif /* MDNS_H */
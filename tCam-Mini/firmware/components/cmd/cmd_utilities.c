@@ -27,8 +27,11 @@
 #include "rsp_task.h"
 #include "json_utilities.h"
 #include "lepton_utilities.h"
+#include "alarm_utilities.h"
+#include "filter_utilities.h"
 #include "net_utilities.h"
 #include "ps_utilities.h"
+#include "roi_utilities.h"
 #include "sys_utilities.h"
 #include "time_utilities.h"
 #include "upd_utilities.h"
@@ -67,6 +70,10 @@ static void process_rx_packet();
 static void push_response(char* buf, uint32_t len);
 static bool process_set_config(cJSON* cmd_args);
 static bool process_set_spotmeter(cJSON* cmd_args);
+static bool process_set_roi(cJSON* cmd_args);
+static bool process_set_alarm(cJSON* cmd_args);
+static bool process_set_filter(cJSON* cmd_args);
+static bool process_get_perf(cJSON* cmd_args);
 static bool process_stream_on(cJSON* cmd_args);
 static bool process_set_time(cJSON* cmd_args);
 static bool process_set_wifi(cJSON* cmd_args);
@@ -250,6 +257,67 @@ static void process_rx_packet()
 					}
 					break;
 				
+				case CMD_SET_ROI:
+					if (process_set_roi(cmd_args)) {
+						cmd_success = 1;
+					} else {
+						cmd_success = 2;
+					}
+					break;
+				
+				case CMD_GET_ROI:
+					response_buffer = json_get_roi(&response_length);
+					if (response_length != 0) {
+						push_response(response_buffer, response_length);
+					} else {
+						cmd_success = 2;
+					}
+					break;
+				
+				case CMD_GET_ROI_STATS:
+					xTaskNotify(task_handle_rsp, RSP_NOTIFY_CMD_GET_ROI_MASK, eSetBits);
+					break;
+				
+				case CMD_SET_ALARM:
+					if (process_set_alarm(cmd_args)) {
+						cmd_success = 1;
+					} else {
+						cmd_success = 2;
+					}
+					break;
+				
+				case CMD_GET_ALARM:
+					response_buffer = json_get_alarm(&response_length);
+					if (response_length != 0) {
+						push_response(response_buffer, response_length);
+					} else {
+						cmd_success = 2;
+					}
+					break;
+				
+				case CMD_SET_FILTER:
+					if (process_set_filter(cmd_args)) {
+						cmd_success = 1;
+					} else {
+						cmd_success = 2;
+					}
+					break;
+				
+				case CMD_GET_FILTER:
+					response_buffer = json_get_filter(FILTER_CONSUMER_STREAM, &response_length);
+					if (response_length != 0) {
+						push_response(response_buffer, response_length);
+					} else {
+						cmd_success = 2;
+					}
+					break;
+				
+				case CMD_GET_PERF:
+					if (!process_get_perf(cmd_args)) {
+						cmd_success = 2;
+					}
+					break;
+				
 				case CMD_STREAM_ON:
 					if (process_stream_on(cmd_args)) {
 						cmd_success = 1;
@@ -264,7 +332,7 @@ static void process_rx_packet()
 					break;
 				
 				case CMD_RUN_FFC:
-					cci_run_ffc();
+					lepton_ffc();
 					cmd_success = 1;
 					break;
 				
@@ -423,12 +491,72 @@ static bool process_set_spotmeter(cJSON* cmd_args)
 }
 
 
+static bool process_set_roi(cJSON* cmd_args)
+{
+	int n;
+	roi_region_t region;
+	
+	if (json_parse_set_roi(cmd_args, &n, &region)) {
+		return roi_set_region(n, &region);
+	}
+	
+	return false;
+}
+
+
+static bool process_set_alarm(cJSON* cmd_args)
+{
+	int n;
+	alarm_rule_t rule;
+	
+	if (json_parse_set_alarm(cmd_args, &n, &rule)) {
+		return alarm_set_rule(n, &rule);
+	}
+	
+	return false;
+}
+
+
+static bool process_set_filter(cJSON* cmd_args)
+{
+	int consumer;
+	filter_config_t config;
+	
+	// tCam-Mini only filters the images it streams
+	if (json_parse_set_filter(cmd_args, &consumer, &config)) {
+		if (consumer == FILTER_CONSUMER_STREAM) {
+			return filter_set_config(consumer, &config);
+		}
+	}
+	
+	return false;
+}
+
+
+static bool process_get_perf(cJSON* cmd_args)
+{
+	bool reset;
+	uint32_t push_msec;
+	
+	if (json_parse_get_perf(cmd_args, &push_msec, &reset)) {
+		rsp_set_perf_parameters(push_msec, reset);
+		xTaskNotify(task_handle_rsp, RSP_NOTIFY_CMD_GET_PERF_MASK, eSetBits);
+		return true;
+	}
+	
+	return false;
+}
+
+
 static bool process_stream_on(cJSON* cmd_args)
 {
+	bool binary, roi_stats, udp;
+	uint8_t udp_addr[4];
+	uint16_t udp_port;
 	uint32_t delay_ms, num_frames;
 	
-	if (json_parse_stream_on(cmd_args, &delay_ms, &num_frames)) {
-		rsp_set_stream_parameters(delay_ms, num_frames);
+	if (json_parse_stream_on(cmd_args, &delay_ms, &num_frames, &binary, &roi_stats, &udp, udp_addr, &udp_port)) {
+		rsp_set_stream_parameters(delay_ms, num_frames, binary, roi_stats, udp, udp_addr, udp_port);
 		xTaskNotify(task_handle_rsp, RSP_NOTIFY_CMD_STREAM_ON_MASK, eSetBits);
 		return true;
 	}
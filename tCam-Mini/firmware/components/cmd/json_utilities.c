@@ -33,11 +33,15 @@
 #include "json_utilities.h"
 #include "ps_utilities.h"
 #include "lepton_utilities.h"
+#include "alarm_utilities.h"
+#include "perf_utilities.h"
+#include "roi_utilities.h"
 #include "time_utilities.h"
 #include "cmd_utilities.h"
 #include "ps_utilities.h"
 #include "upd_utilities.h"
 #include "ctrl_task.h"
+#include "rsp_task.h"
 #include "system_config.h"
 #include "vospi.h"
 #include "mbedtls/base64.h"
@@ -45,6 +49,8 @@
 #include "esp_ota_ops.h"
 #include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include <math.h>
 #include <string.h>
 
 
@@ -86,9 +92,23 @@ const cmd_name_t command_list[CMD_NUM] = {
 	{CMD_SET_LEP_CCI_S, CMD_SET_LEP_CCI},
 	{CMD_FW_UPD_REQ_S, CMD_FW_UPD_REQ},
 	{CMD_FW_UPD_SEG_S, CMD_FW_UPD_SEG},
-	{CMD_DUMP_SCREEN_S, CMD_DUMP_SCREEN}
+	{CMD_DUMP_SCREEN_S, CMD_DUMP_SCREEN},
+	{CMD_SET_ROI_S, CMD_SET_ROI},
+	{CMD_GET_ROI_S, CMD_GET_ROI},
+	{CMD_GET_ROI_STATS_S, CMD_GET_ROI_STATS},
+	{CMD_SET_ALARM_S, CMD_SET_ALARM},
+	{CMD_GET_ALARM_S, CMD_GET_ALARM},
+	{CMD_SET_FILTER_S, CMD_SET_FILTER},
+	{CMD_GET_FILTER_S, CMD_GET_FILTER},
+	{CMD_GET_PERF_S, CMD_GET_PERF}
 };
 
+// Alarm rule statistic names (indexed by ALARM_STAT_x)
+static const char* alarm_stat_names[] = {"min", "max", "mean"};
+
+// Temporal filter consumer names (indexed by FILTER_CONSUMER_x)
+static const char* filter_consumer_names[] = {"stream", "display", "record"};
+
 
 
 //
@@ -118,6 +138,7 @@ static void json_free_cci_reg_base64_data();
 static bool json_add_metadata_object(cJSON* parent);
 static uint32_t json_generate_response_string(cJSON* root, char* json_string);
 static bool json_ip_string_to_array(uint8_t* ip_array, char* ip_string);
+static cJSON* json_create_roi_value(float v);
 
 
 
@@ -216,6 +237,55 @@ uint32_t json_get_image_file_string(char* json_image_text, lep_buffer_t* lep_buf
 }
 
 
+/**
+ * Load a binary image frame into a pre-allocated buffer for a lepton image buffer.  The
+ * metadata is included as json text so the host can recreate the same image json string
+ * generated by json_get_image_file_string when it needs it.  Returns a non-zero length for
+ * a successful operation.
+ */
+uint32_t json_get_image_frame(char* frame, lep_buffer_t* lep_buffer)
+{
+	char* metaP;
+	cJSON* root;
+	int max_meta_len;
+	int meta_len;
+	json_img_frame_hdr_t* hdrP;
+	
+	root = cJSON_CreateObject();
+	if (root == NULL) return 0;
+	
+	// Print just the metadata object following the header
+	(void) json_add_metadata_object(root);
+	hdrP = (json_img_frame_hdr_t*) frame;
+	metaP = frame + sizeof(json_img_frame_hdr_t);
+	max_meta_len = JSON_MAX_IMAGE_TEXT_LEN - sizeof(json_img_frame_hdr_t) - LEP_NUM_PIXELS*2 - LEP_TEL_WORDS*2 - 8;
+	if (cJSON_PrintPreallocated(cJSON_GetObjectItem(root, "metadata"), metaP, max_meta_len, false) == 0) {
+		ESP_LOGE(TAG, "failed to create image frame metadata");
+		cJSON_Delete(root);
+		return 0;
+	}
+	cJSON_Delete(root);
+	
+	// Include the null terminator and pad to keep the image data word aligned
+	meta_len = strlen(metaP) + 1;
+	while (meta_len & 0x3) {
+		*(metaP + meta_len++) = 0;
+	}
+	
+	// Load the image and telemetry
+	memcpy(metaP + meta_len, lep_buffer->lep_bufferP, LEP_NUM_PIXELS*2);
+	memcpy(metaP + meta_len + LEP_NUM_PIXELS*2, lep_buffer->lep_telemP, LEP_TEL_WORDS*2);
+	
+	hdrP->magic = JSON_IMG_FRAME_MAGIC;
+	hdrP->version = JSON_IMG_FRAME_VERSION;
+	hdrP->meta_len = meta_len;
+	hdrP->img_len = LEP_NUM_PIXELS*2;
+	hdrP->tel_len = LEP_TEL_WORDS*2;
+	
+	return sizeof(json_img_frame_hdr_t) + meta_len + LEP_NUM_PIXELS*2 + LEP_TEL_WORDS*2;
+}
+
+
 /**
  * Return a formatted json string containing the camera's operating parameters in
  * response to the get_config commmand.  Include the delimitors since this string
@@ -493,6 +563,322 @@ int json_get_cam_info(char* json_string, uint32_t info_value, char* info_string)
 }
 
 
+/**
+ * Return a formatted json string containing the currently defined regions of interest
+ * in response to the get_roi command.  Include the delimiters since this string will
+ * be sent via the socket interface.
+ */
+char* json_get_roi(uint32_t* len)
+{
+	cJSON* root;
+	cJSON* roi;
+	cJSON* region;
+	cJSON* points;
+	int i, j;
+	int pt[2];
+	roi_region_t r;
+	
+	root = cJSON_CreateObject();
+	if (root == NULL) return NULL;
+	
+	cJSON_AddItemToObject(root, "roi", roi=cJSON_CreateArray());
+	
+	for (i=0; i<ROI_MAX_REGIONS; i++) {
+		if (roi_get_region(i, &r)) {
+			cJSON_AddItemToArray(roi, region=cJSON_CreateObject());
+			cJSON_AddNumberToObject(region, "index", i);
+			if (r.type == ROI_TYPE_RECT) {
+				cJSON_AddNumberToObject(region, "r1", r.r[0]);
+				cJSON_AddNumberToObject(region, "c1", r.c[0]);
+				cJSON_AddNumberToObject(region, "r2", r.r[1]);
+				cJSON_AddNumberToObject(region, "c2", r.c[1]);
+			} else {
+				cJSON_AddItemToObject(region, "points", points=cJSON_CreateArray());
+				for (j=0; j<r.num_points; j++) {
+					pt[0] = r.r[j];
+					pt[1] = r.c[j];
+					cJSON_AddItemToArray(points, cJSON_CreateIntArray(pt, 2));
+				}
+			}
+		}
+	}
+	
+	// Tightly print the object into our buffer with delimiters
+	*len = json_generate_response_string(root, json_response_text);
+	
+	cJSON_Delete(root);
+	
+	return json_response_text;
+}
+
+
+/**
+ * Generate a compact formatted json string containing the statistics for each valid
+ * region.  Add delimiters for transmission over the network.  Returns string length.
+ *
+ * Each region is an array: [index, count, min, max, mean, stddev, pct...]
+ *
+ * Note: Because this function is designed to be used by rsp_task, a valid buffer
+ *       must be passed in for json_string.
+ */
+int json_get_roi_stats(char* json_string, bool radiometric, roi_stats_t* stats)
+{
+	cJSON* root;
+	cJSON* roi_stats;
+	cJSON* regions;
+	cJSON* region;
+	int i, j;
+	uint32_t len = 0;
+	
+	root = cJSON_CreateObject();
+	if (root != NULL) {
+		cJSON_AddItemToObject(root, "roi_stats", roi_stats=cJSON_CreateObject());
+		
+		cJSON_AddNumberToObject(roi_stats, "msec", (double) (esp_timer_get_time() / 1000));
+		cJSON_AddStringToObject(roi_stats, "units", radiometric ? "C" : "raw");
+		cJSON_AddItemToObject(roi_stats, "regions", regions=cJSON_CreateArray());
+		
+		for (i=0; i<ROI_MAX_REGIONS; i++) {
+			if (stats[i].valid) {
+				cJSON_AddItemToArray(regions, region=cJSON_CreateArray());
+				cJSON_AddItemToArray(region, cJSON_CreateNumber(i));
+				cJSON_AddItemToArray(region, cJSON_CreateNumber(stats[i].count));
+				cJSON_AddItemToArray(region, json_create_roi_value(stats[i].min));
+				cJSON_AddItemToArray(region, json_create_roi_value(stats[i].max));
+				cJSON_AddItemToArray(region, json_create_roi_value(stats[i].mean));
+				cJSON_AddItemToArray(region, json_create_roi_value(stats[i].stddev));
+				for (j=0; j<ROI_NUM_PCT; j++) {
+					cJSON_AddItemToArray(region, json_create_roi_value(stats[i].pct[j]));
+				}
+			}
+		}
+		
+		// Tightly print the object into the buffer with delimiters
+		len = json_generate_response_string(root, json_string);
+		
+		cJSON_Delete(root);
+	}
+	
+	return (int) len;
+}
+
+
+/**
+ * Return a formatted json string containing the enabled alarm rules and their current
+ * state in response to the get_alarm command.  Include the delimiters since this
+ * string will be sent via the socket interface.
+ */
+char* json_get_alarm(uint32_t* len)
+{
+	bool active;
+	cJSON* root;
+	cJSON* rules;
+	cJSON* rule;
+	int i;
+	alarm_rule_t r;
+	
+	root = cJSON_CreateObject();
+	if (root == NULL) return NULL;
+	
+	cJSON_AddItemToObject(root, "alarm_rules", rules=cJSON_CreateArray());
+	
+	for (i=0; i<ALARM_MAX_RULES; i++) {
+		if (alarm_get_rule(i, &r, &active)) {
+			cJSON_AddItemToArray(rules, rule=cJSON_CreateObject());
+			cJSON_AddNumberToObject(rule, "index", i);
+			cJSON_AddNumberToObject(rule, "region", r.region);
+			cJSON_AddStringToObject(rule, "stat", alarm_stat_names[r.stat]);
+			cJSON_AddNumberToObject(rule, "below", r.below ? 1 : 0);
+			cJSON_AddItemToObject(rule, "threshold", json_create_roi_value(r.threshold));
+			cJSON_AddItemToObject(rule, "hysteresis", json_create_roi_value(r.hysteresis));
+			cJSON_AddNumberToObject(rule, "duration", r.duration_msec);
+			cJSON_AddNumberToObject(rule, "record", r.record ? 1 : 0);
+			cJSON_AddNumberToObject(rule, "active", active ? 1 : 0);
+		}
+	}
+	
+	// Tightly print the object into our buffer with delimiters
+	*len = json_generate_response_string(root, json_response_text);
+	
+	cJSON_Delete(root);
+	
+	return json_response_text;
+}
+
+
+/**
+ * Generate a formatted json string describing an alarm state transition.  Add
+ * delimiters for transmission over the network.  Returns string length.
+ *
+ * Note: Because this function is designed to be used by rsp_task, a valid buffer
+ *       must be passed in for json_string.
+ */
+int json_get_alarm_msg(char* json_string, alarm_event_t* event)
+{
+	cJSON* root;
+	cJSON* alarm;
+	uint32_t len = 0;
+	
+	root = cJSON_CreateObject();
+	if (root != NULL) {
+		cJSON_AddItemToObject(root, "alarm", alarm=cJSON_CreateObject());
+		
+		cJSON_AddNumberToObject(alarm, "index", event->rule);
+		cJSON_AddNumberToObject(alarm, "active", event->active ? 1 : 0);
+		cJSON_AddItemToObject(alarm, "value", json_create_roi_value(event->value));
+		cJSON_AddNumberToObject(alarm, "record", event->record ? 1 : 0);
+		cJSON_AddNumberToObject(alarm, "msec", (double) (esp_timer_get_time() / 1000));
+		
+		// Tightly print the object into the buffer with delimiters
+		len = json_generate_response_string(root, json_string);
+		
+		cJSON_Delete(root);
+	}
+	
+	return (int) len;
+}
+
+/**
+ * Return a formatted json string containing a consumer's temporal filter configuration
+ * in response to the get_filter command.  Include the delimiters since this string
+ * will be sent via the socket interface.
+ */
+char* json_get_filter(int consumer, uint32_t* len)
+{
+	cJSON* root;
+	cJSON* filter;
+	filter_config_t config;
+	
+	*len = 0;
+	if (!filter_get_config(consumer, &config)) return NULL;
+	
+	root = cJSON_CreateObject();
+	if (root == NULL) return NULL;
+	
+	cJSON_AddItemToObject(root, "filter", filter=cJSON_CreateObject());
+	cJSON_AddStringToObject(filter, "consumer", filter_consumer_names[consumer]);
+	cJSON_AddNumberToObject(filter, "enable", config.enable ? 1 : 0);
+	cJSON_AddNumberToObject(filter, "strength", config.strength);
+	cJSON_AddNumberToObject(filter, "motion", config.motion);
+	
+	// Tightly print the object into our buffer with delimiters
+	*len = json_generate_response_string(root, json_response_text);
+	
+	cJSON_Delete(root);
+	
+	return json_response_text;
+}
+
+
+/**
+ * Return a formatted json string containing the performance counters, stage latency
+ * statistics (uSec), network transmit statistics, heap usage and task CPU usage in
+ * response to the get_perf command.  Include the delimiters since this string will
+ * be sent via the socket interface.
+ */
+int json_get_perf(char* json_string)
+{
+	cJSON* root;
+	cJSON* perf;
+	cJSON* counters;
+	cJSON* stages;
+	cJSON* stage;
+	cJSON* tx;
+	cJSON* heap;
+	cJSON* tasks;
+	int i, j;
+	int len = 0;
+	int num_tasks;
+	int hist[PERF_HIST_BINS];
+	int task_info[2];
+	perf_heap_t heap_info;
+	perf_stats_t* statsP;
+	perf_task_t* tasksP;
+	rsp_tx_stats_t tx_stats;
+	
+	// Statistics are too large for the stack
+	statsP = heap_caps_malloc(sizeof(perf_stats_t), MALLOC_CAP_SPIRAM);
+	tasksP = heap_caps_malloc(sizeof(perf_task_t) * PERF_MAX_TASKS, MALLOC_CAP_SPIRAM);
+	if ((statsP == NULL) || (tasksP == NULL)) {
+		free(statsP);
+		free(tasksP);
+		return 0;
+	}
+	perf_get(statsP);
+	num_tasks = perf_get_tasks(tasksP, PERF_MAX_TASKS);
+	perf_get_heap(&heap_info);
+	rsp_get_tx_stats(&tx_stats);
+	
+	root=cJSON_CreateObject();
+	if (root == NULL) {
+		free(statsP);
+		free(tasksP);
+		return 0;
+	}
+	
+	cJSON_AddItemToObject(root, "perf", perf=cJSON_CreateObject());
+	
+	cJSON_AddNumberToObject(perf, "msec", (double) ((esp_timer_get_time() - statsP->start_usec) / 1000));
+	
+	cJSON_AddItemToObject(perf, "counters", counters=cJSON_CreateObject());
+	for (i=0; i<PERF_NUM_COUNTERS; i++) {
+		cJSON_AddNumberToObject(counters, perf_counter_names[i], statsP->counter[i]);
+	}
+	
+	for (i=0; i<PERF_HIST_BINS-1; i++) {
+		hist[i] = perf_hist_limits[i];
+	}
+	cJSON_AddItemToObject(perf, "hist_limits", cJSON_CreateIntArray(hist, PERF_HIST_BINS-1));
+	
+	cJSON_AddItemToObject(perf, "stages", stages=cJSON_CreateObject());
+	for (i=0; i<PERF_NUM_STAGES; i++) {
+		cJSON_AddItemToObject(stages, perf_stage_names[i], stage=cJSON_CreateObject());
+		cJSON_AddNumberToObject(stage, "count", statsP->stage[i].count);
+		cJSON_AddNumberToObject(stage, "min", (statsP->stage[i].count == 0) ? 0 : statsP->stage[i].min_usec);
+		cJSON_AddNumberToObject(stage, "avg", perf_stage_avg(&statsP->stage[i]));
+		cJSON_AddNumberToObject(stage, "max", statsP->stage[i].max_usec);
+		for (j=0; j<PERF_HIST_BINS; j++) {
+			hist[j] = statsP->stage[i].hist[j];
+		}
+		cJSON_AddItemToObject(stage, "hist", cJSON_CreateIntArray(hist, PERF_HIST_BINS));
+	}
+	
+	cJSON_AddItemToObject(perf, "tx", tx=cJSON_CreateObject());
+	cJSON_AddNumberToObject(tx, "msgs", tx_stats.num_msgs);
+	cJSON_AddNumberToObject(tx, "aborts", tx_stats.num_aborts);
+	cJSON_AddNumberToObject(tx, "bytes", (double) tx_stats.bytes);
+	cJSON_AddNumberToObject(tx, "stall_usec", (double) tx_stats.stall_usec);
+	cJSON_AddNumberToObject(tx, "max_stall_usec", tx_stats.max_stall_usec);
+	cJSON_AddNumberToObject(tx, "bytes_per_sec", tx_stats.bytes_per_sec);
+	cJSON_AddNumberToObject(tx, "udp_frames", tx_stats.udp_frames);
+	cJSON_AddNumberToObject(tx, "udp_drops", tx_stats.udp_drops);
+	
+	cJSON_AddItemToObject(perf, "heap", heap=cJSON_CreateObject());
+	cJSON_AddNumberToObject(heap, "int_free", heap_info.int_free);
+	cJSON_AddNumberToObject(heap, "int_min", heap_info.int_min_free);
+	cJSON_AddNumberToObject(heap, "int_largest", heap_info.int_largest);
+	cJSON_AddNumberToObject(heap, "spiram_free", heap_info.spiram_free);
+	cJSON_AddNumberToObject(heap, "spiram_min", heap_info.spiram_min_free);
+	
+	// Each task is [CPU share (0.1%), minimum free stack bytes] to keep the response small
+	cJSON_AddItemToObject(perf, "tasks", tasks=cJSON_CreateObject());
+	for (i=0; i<num_tasks; i++) {
+		task_info[0] = tasksP[i].cpu_permille;
+		task_info[1] = tasksP[i].stack_min;
+		cJSON_AddItemToObject(tasks, tasksP[i].name, cJSON_CreateIntArray(task_info, 2));
+	}
+	
+	// Tightly print the object into the buffer with delimiters
+	len = json_generate_response_string(root, json_string);
+	
+	cJSON_Delete(root);
+	free(statsP);
+	free(tasksP);
+	
+	return len;
+}
+
+
 /**
  * Parse a top level command object, returning the command number and a pointer to 
  * a json object containing "args".  The pointer is set to NULL if there are no args.
@@ -615,6 +1001,170 @@ bool json_parse_set_spotmeter(cJSON* cmd_args, uint16_t* r1, uint16_t* c1, uint1
 }
 
 
+/**
+ * Get the set_roi arguments.  A region with "points" is a polygon, otherwise it is a
+ * rectangle specified like the spotmeter.  Setting "enable" to 0 clears the region.
+ */
+bool json_parse_set_roi(cJSON* cmd_args, int* n, roi_region_t* region)
+{
+	cJSON* points;
+	cJSON* point;
+	int i;
+	
+	if (cmd_args == NULL) return false;
+	
+	if (!cJSON_HasObjectItem(cmd_args, "index")) return false;
+	*n = cJSON_GetObjectItem(cmd_args, "index")->valueint;
+	if ((*n < 0) || (*n >= ROI_MAX_REGIONS)) return false;
+	
+	region->type = ROI_TYPE_NONE;
+	region->num_points = 0;
+	
+	if (cJSON_HasObjectItem(cmd_args, "enable")) {
+		if (cJSON_GetObjectItem(cmd_args, "enable")->valueint == 0) {
+			return true;
+		}
+	}
+	
+	if (cJSON_HasObjectItem(cmd_args, "points")) {
+		points = cJSON_GetObjectItem(cmd_args, "points");
+		if (!cJSON_IsArray(points)) return false;
+		
+		i = cJSON_GetArraySize(points);
+		if ((i < 3) || (i > ROI_MAX_POINTS)) return false;
+		
+		i = 0;
+		cJSON_ArrayForEach(point, points) {
+			if (!cJSON_IsArray(point) || (cJSON_GetArraySize(point) != 2)) return false;
+			region->r[i] = (uint16_t) cJSON_GetArrayItem(point, 0)->valueint;
+			region->c[i] = (uint16_t) cJSON_GetArrayItem(point, 1)->valueint;
+			if (region->r[i] > (LEP_HEIGHT-1)) region->r[i] = LEP_HEIGHT - 1;
+			if (region->c[i] > (LEP_WIDTH-1)) region->c[i] = LEP_WIDTH - 1;
+			i++;
+		}
+		region->type = ROI_TYPE_POLY;
+		region->num_points = i;
+		return true;
+	}
+	
+	if (json_parse_set_spotmeter(cmd_args, &region->r[0], &region->c[0], &region->r[1], &region->c[1])) {
+		region->type = ROI_TYPE_RECT;
+		region->num_points = 2;
+		return true;
+	}
+	
+	return false;
+}
+
+
+/**
+ * Get the set_alarm arguments.  Setting "enable" to 0 disables the rule.  A rule
+ * without "region" (or with region -1) evaluates the whole frame.
+ */
+bool json_parse_set_alarm(cJSON* cmd_args, int* n, alarm_rule_t* rule)
+{
+	char* stat_name;
+	int i;
+	
+	if (cmd_args == NULL) return false;
+	
+	if (!cJSON_HasObjectItem(cmd_args, "index")) return false;
+	*n = cJSON_GetObjectItem(cmd_args, "index")->valueint;
+	if ((*n < 0) || (*n >= ALARM_MAX_RULES)) return false;
+	
+	rule->enable = false;
+	rule->region = ALARM_REGION_FRAME;
+	rule->stat = ALARM_STAT_MAX;
+	rule->below = false;
+	rule->threshold = 0;
+	rule->hysteresis = 0;
+	rule->duration_msec = 0;
+	rule->record = false;
+	
+	if (cJSON_HasObjectItem(cmd_args, "enable")) {
+		if (cJSON_GetObjectItem(cmd_args, "enable")->valueint == 0) {
+			return true;
+		}
+	}
+	
+	// A threshold is required for an enabled rule
+	if (!cJSON_HasObjectItem(cmd_args, "threshold")) return false;
+	rule->threshold = (float) cJSON_GetObjectItem(cmd_args, "threshold")->valuedouble;
+	
+	if (cJSON_HasObjectItem(cmd_args, "region")) {
+		rule->region = cJSON_GetObjectItem(cmd_args, "region")->valueint;
+	}
+	
+	if (cJSON_HasObjectItem(cmd_args, "stat")) {
+		stat_name = cJSON_GetStringValue(cJSON_GetObjectItem(cmd_args, "stat"));
+		if (stat_name == NULL) return false;
+		for (i=0; i<=ALARM_STAT_MEAN; i++) {
+			if (strcmp(stat_name, alarm_stat_names[i]) == 0) break;
+		}
+		if (i > ALARM_STAT_MEAN) return false;
+		rule->stat = i;
+	}
+	
+	if (cJSON_HasObjectItem(cmd_args, "below")) {
+		rule->below = (cJSON_GetObjectItem(cmd_args, "below")->valueint != 0);
+	}
+	
+	if (cJSON_HasObjectItem(cmd_args, "hysteresis")) {
+		rule->hysteresis = (float) cJSON_GetObjectItem(cmd_args, "hysteresis")->valuedouble;
+	}
+	
+	if (cJSON_HasObjectItem(cmd_args, "duration")) {
+		rule->duration_msec = (uint32_t) cJSON_GetObjectItem(cmd_args, "duration")->valueint;
+	}
+	
+	if (cJSON_HasObjectItem(cmd_args, "record")) {
+		rule->record = (cJSON_GetObjectItem(cmd_args, "record")->valueint != 0);
+	}
+	
+	rule->enable = true;
+	
+	return true;
+}
+
+/**
+ * Get the set_filter arguments.  Items not included are set to their defaults.
+ */
+bool json_parse_set_filter(cJSON* cmd_args, int* consumer, filter_config_t* config)
+{
+	char* consumer_name;
+	int i;
+	
+	if (cmd_args == NULL) return false;
+	
+	if (!cJSON_HasObjectItem(cmd_args, "consumer")) return false;
+	consumer_name = cJSON_GetStringValue(cJSON_GetObjectItem(cmd_args, "consumer"));
+	if (consumer_name == NULL) return false;
+	for (i=0; i<FILTER_NUM_CONSUMERS; i++) {
+		if (strcmp(consumer_name, filter_consumer_names[i]) == 0) break;
+	}
+	if (i == FILTER_NUM_CONSUMERS) return false;
+	*consumer = i;
+	
+	config->enable = false;
+	config->strength = FILTER_DEF_STRENGTH;
+	config->motion = FILTER_DEF_MOTION;
+	
+	if (cJSON_HasObjectItem(cmd_args, "enable")) {
+		config->enable = (cJSON_GetObjectItem(cmd_args, "enable")->valueint != 0);
+	}
+	
+	if (cJSON_HasObjectItem(cmd_args, "strength")) {
+		config->strength = cJSON_GetObjectItem(cmd_args, "strength")->valueint;
+	}
+	
+	if (cJSON_HasObjectItem(cmd_args, "motion")) {
+		config->motion = cJSON_GetObjectItem(cmd_args, "motion")->valueint;
+	}
+	
+	return true;
+}
+
+
 /**
  * Fill in a tmElements object with arguments from a set_time command
  */
@@ -796,12 +1346,48 @@ bool json_parse_set_wifi(cJSON* cmd_args, net_info_t* new_net_info)
 
 
 /**
- * Get the stream_on arguments
+ * Get the optional get_perf arguments.  A non-zero push_msec requests a perf record
+ * be sent periodically until the host disconnects or sends another get_perf.  Reset
+ * clears all counters and statistics after each perf record is generated.
  */
-bool json_parse_stream_on(cJSON* cmd_args, uint32_t* delay_ms, uint32_t* num_frames)
+bool json_parse_get_perf(cJSON* cmd_args, uint32_t* push_msec, bool* reset)
 {
 	int i;
 	
+	*push_msec = 0;
+	*reset = false;
+	
+	if (cmd_args != NULL) {
+		if (cJSON_HasObjectItem(cmd_args, "push_msec")) {
+			i = cJSON_GetObjectItem(cmd_args, "push_msec")->valueint;
+			if (i < 0) {
+				ESP_LOGE(TAG, "Illegal get_perf push_msec %d", i);
+				return false;
+			}
+			*push_msec = i;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "reset")) {
+			*reset = (cJSON_GetObjectItem(cmd_args, "reset")->valueint != 0);
+		}
+	}
+	
+	return true;
+}
+
+
+/**
+ * Get the stream_on arguments.  Images are streamed over UDP to udp_addr (stored like
+ * net_info_t addresses) when the udp_addr argument is included.
+ */
+bool json_parse_stream_on(cJSON* cmd_args, uint32_t* delay_ms, uint32_t* num_frames, bool* binary, bool* roi_stats, bool* udp, uint8_t* udp_addr, uint16_t* udp_port)
+{
+	char* s;
+	int i;
+	
+	*udp = false;
+	*udp_port = RSP_UDP_DEF_PORT;
+	
 	if (cmd_args != NULL) {
 		if (cJSON_HasObjectItem(cmd_args, "delay_msec")) {
 			i = cJSON_GetObjectItem(cmd_args, "delay_msec")->valueint;
@@ -818,10 +1404,42 @@ bool json_parse_stream_on(cJSON* cmd_args, uint32_t* delay_ms, uint32_t* num_fra
 		} else {
 			*num_frames = 0;
 		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "binary")) {
+			*binary = cJSON_GetObjectItem(cmd_args, "binary")->valueint != 0;
+		} else {
+			*binary = false;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "roi_stats")) {
+			*roi_stats = cJSON_GetObjectItem(cmd_args, "roi_stats")->valueint != 0;
+		} else {
+			*roi_stats = false;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "udp_addr")) {
+			s = cJSON_GetObjectItem(cmd_args, "udp_addr")->valuestring;
+			if ((s == NULL) || !json_ip_string_to_array(udp_addr, s)) {
+				ESP_LOGE(TAG, "Illegal stream_on udp_addr");
+				return false;
+			}
+			*udp = true;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "udp_port")) {
+			i = cJSON_GetObjectItem(cmd_args, "udp_port")->valueint;
+			if ((i < 1) || (i > 65535)) {
+				ESP_LOGE(TAG, "Illegal stream_on udp_port %d", i);
+				return false;
+			}
+			*udp_port = i;
+		}
 	} else {
 		// Assume old-style command and setup fastest possible streaming
 		*delay_ms = 0;
 		*num_frames = 0;
+		*binary = false;
+		*roi_stats = false;
 	}
 	
 	return true;
@@ -1249,6 +1867,15 @@ static uint32_t json_generate_response_string(cJSON* root, char* json_string)
 }
 
 
+/**
+ * Create a number rounded to 2 decimal places so it prints compactly
+ */
+static cJSON* json_create_roi_value(float v)
+{
+	return cJSON_CreateNumber(round(v * 100.0) / 100.0);
+}
+
+
 /**
  * Convert a string in the form of "XXX.XXX.XXX.XXX" into a 4-byte array for net_info_t
  */
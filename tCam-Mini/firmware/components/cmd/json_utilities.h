@@ -33,8 +33,11 @@
 #ifndef JSON_UTILITIES_H
 #define JSON_UTILITIES_H
 
+#include "alarm_utilities.h"
 #include "ds3232.h"
+#include "filter_utilities.h"
 #include "net_utilities.h"
+#include "roi_utilities.h"
 #include "sys_utilities.h"
 #include <stdbool.h>
 #include <stdint.h>
@@ -42,24 +45,62 @@
 
 
 
+//
+// JSON Utilities Constants
+//
+
+// Binary image frame sent through the SPI interface when requested by stream_on
+//   Header (json_img_frame_hdr_t)
+//   Metadata json text, null terminated and padded to a 4-byte boundary (meta_len bytes)
+//   Lepton image (img_len bytes)
+//   Lepton telemetry (tel_len bytes)
+#define JSON_IMG_FRAME_MAGIC    0x46494354
+#define JSON_IMG_FRAME_VERSION  1
+
+
+
+//
+// JSON Utilities typedefs
+//
+typedef struct {
+	uint32_t magic;          // "TCIF" - Can never be confused with CMD_JSON_STRING_START
+	uint16_t version;
+	uint16_t meta_len;
+	uint32_t img_len;
+	uint32_t tel_len;
+} json_img_frame_hdr_t;
+
+
+
 //
 // JSON Utilities API
 //
 bool json_init();
 cJSON* json_get_cmd_object(char* json_string);
 uint32_t json_get_image_file_string(char* json_image_text, lep_buffer_t* lep_buffer);
+uint32_t json_get_image_frame(char* frame, lep_buffer_t* lep_buffer);
 char* json_get_config(uint32_t* len);
 char* json_get_status(uint32_t* len);
 char* json_get_wifi(uint32_t* len);
 char* json_get_cci_response(uint16_t cmd, int cci_len, uint16_t status, uint16_t* buf, uint32_t* len);
 char* json_get_get_fw(uint32_t fw_start, uint32_t fw_len, uint32_t* len);
 int json_get_cam_info(char* json_string, uint32_t info_value, char* info_string);
+char* json_get_roi(uint32_t* len);
+int json_get_roi_stats(char* json_string, bool radiometric, roi_stats_t* stats);
+char* json_get_alarm(uint32_t* len);
+int json_get_alarm_msg(char* json_string, alarm_event_t* event);
+char* json_get_filter(int consumer, uint32_t* len);
+int json_get_perf(char* json_string);
 bool json_parse_cmd(cJSON* cmd_obj, int* cmd, cJSON** cmd_args);
 bool json_parse_set_config(cJSON* cmd_args, json_config_t* new_st);
 bool json_parse_set_spotmeter(cJSON* cmd_args, uint16_t* r1, uint16_t* c1, uint16_t* r2, uint16_t* c2);
+bool json_parse_set_roi(cJSON* cmd_args, int* n, roi_region_t* region);
+bool json_parse_set_alarm(cJSON* cmd_args, int* n, alarm_rule_t* rule);
+bool json_parse_set_filter(cJSON* cmd_args, int* consumer, filter_config_t* config);
 bool json_parse_set_time(cJSON* cmd_args, tmElements_t* te);
 bool json_parse_set_wifi(cJSON* cmd_args, net_info_t* new_net_info);
-bool json_parse_stream_on(cJSON* cmd_args, uint32_t* delay_ms, uint32_t* num_frames);
+bool json_parse_get_perf(cJSON* cmd_args, uint32_t* push_msec, bool* reset);
+bool json_parse_stream_on(cJSON* cmd_args, uint32_t* delay_ms, uint32_t* num_frames, bool* binary, bool* roi_stats, bool* udp, uint8_t* udp_addr, uint16_t* udp_port);
 bool json_parse_get_lep_cci(cJSON* cmd_args, uint16_t* cmd, int* len, uint16_t** buf);
 bool json_parse_set_lep_cci(cJSON* cmd_args, uint16_t* cmd, int* len, uint16_t** buf);
 bool json_parse_fw_upd_request(cJSON* cmd_args, uint32_t* len, char* ver);
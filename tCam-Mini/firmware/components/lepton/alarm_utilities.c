@@ -0,0 +1,306 @@
+/*
+ * Temperature threshold alarms
+ *
+ * Maintains a set of alarm rules that compare the whole-frame or a region of
+ * interest's minimum, maximum or mean temperature against a threshold.  Each rule
+ * has hysteresis and a minimum duration the condition must persist before the alarm
+ * state changes.  Rules are evaluated against each radiometric Lepton frame.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "alarm_utilities.h"
+#include "lepton_utilities.h"
+#include "roi_utilities.h"
+#include "temp_utilities.h"
+#include "vospi.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+
+
+//
+// Alarm Utilities internal typedefs
+//
+
+// Per-rule evaluation state
+typedef struct {
+	bool active;
+	bool pending;            // Condition to change state is currently true
+	int64_t pending_usec;    // Time the condition became true
+} alarm_state_t;
+
+
+
+//
+// Alarm Utilities variables
+//
+static const char* TAG = "alarm_utilities";
+
+static SemaphoreHandle_t alarm_mutex;
+
+static alarm_rule_t alarm_rules[ALARM_MAX_RULES];
+static alarm_state_t alarm_state[ALARM_MAX_RULES];
+
+static roi_stats_t alarm_roi_stats[ROI_MAX_REGIONS];
+
+static temp_conv_t alarm_conv;
+
+
+
+//
+// Alarm Utilities forward declarations for internal functions
+//
+static void alarm_frame_stats(lep_buffer_t* lep_buffer, float* min, float* max, float* mean);
+static float alarm_get_stat(int stat, float min, float max, float mean);
+static bool alarm_update_state(int n, float value, int64_t t);
+
+
+
+//
+// Alarm Utilities API
+//
+
+/**
+ * Initialize with no rules
+ */
+bool alarm_init()
+{
+	int i;
+
+	alarm_mutex = xSemaphoreCreateMutex();
+	if (alarm_mutex == NULL) {
+		ESP_LOGE(TAG, "create alarm_mutex failed");
+		return false;
+	}
+
+	temp_conv_init(&alarm_conv, TEMP_RES_HIGH, TEMP_UNIT_C);
+
+	for (i=0; i<ALARM_MAX_RULES; i++) {
+		alarm_rules[i].enable = false;
+		alarm_state[i].active = false;
+		alarm_state[i].pending = false;
+	}
+
+	return true;
+}
+
+
+/**
+ * Set (or disable) rule n.  Changing a rule resets its alarm state.
+ */
+bool alarm_set_rule(int n, const alarm_rule_t* rule)
+{
+	if ((n < 0) || (n >= ALARM_MAX_RULES)) return false;
+
+	// Validate the rule
+	if (rule->enable) {
+		if ((rule->region < ALARM_REGION_FRAME) || (rule->region >= ROI_MAX_REGIONS)) return false;
+		if ((rule->stat < ALARM_STAT_MIN) || (rule->stat > ALARM_STAT_MEAN)) return false;
+		if (rule->hysteresis < 0) return false;
+		if (rule->duration_msec > ALARM_MAX_DURATION_MSEC) return false;
+	}
+
+	xSemaphoreTake(alarm_mutex, portMAX_DELAY);
+	alarm_rules[n] = *rule;
+	alarm_state[n].active = false;
+	alarm_state[n].pending = false;
+	xSemaphoreGive(alarm_mutex);
+
+	return true;
+}
+
+
+/**
+ * Get rule n and its current alarm state.  Returns false if the rule is not enabled.
+ */
+bool alarm_get_rule(int n, alarm_rule_t* rule, bool* active)
+{
+	if ((n < 0) || (n >= ALARM_MAX_RULES)) return false;
+
+	xSemaphoreTake(alarm_mutex, portMAX_DELAY);
+	*rule = alarm_rules[n];
+	*active = alarm_state[n].active;
+	xSemaphoreGive(alarm_mutex);
+
+	return rule->enable;
+}
+
+
+/**
+ * Evaluate all enabled rules against an image.  Loads events with state transitions
+ * (up to ALARM_MAX_RULES entries) and returns the number of transitions.  Images
+ * without radiometric data are ignored and leave the alarm state unchanged.
+ */
+int alarm_eval(lep_buffer_t* lep_buffer, alarm_event_t* events)
+{
+	bool need_frame = false;
+	bool need_roi = false;
+	float frame_min = 0;
+	float frame_max = 0;
+	float frame_mean = 0;
+	float value;
+	int i;
+	int num_events = 0;
+	int64_t t;
+	alarm_rule_t* ruleP;
+	roi_stats_t* statsP;
+
+	// Alarms are only evaluated with temperature data
+	if (!lep_buffer->telem_valid || (lep_buffer->lep_telemP[LEP_TEL_TLIN_ENABLE] == 0)) {
+		return 0;
+	}
+	t = esp_timer_get_time();
+
+	xSemaphoreTake(alarm_mutex, portMAX_DELAY);
+
+	(void) temp_conv_set(&alarm_conv, temp_get_res(lep_buffer->lep_telemP), TEMP_UNIT_C);
+
+	// Determine what statistics are required
+	for (i=0; i<ALARM_MAX_RULES; i++) {
+		if (alarm_rules[i].enable) {
+			if (alarm_rules[i].region == ALARM_REGION_FRAME) {
+				need_frame = true;
+			} else {
+				need_roi = true;
+			}
+		}
+	}
+
+	if (need_frame) {
+		alarm_frame_stats(lep_buffer, &frame_min, &frame_max, &frame_mean);
+	}
+	if (need_roi) {
+		(void) roi_compute(lep_buffer, alarm_roi_stats);
+	}
+
+	for (i=0; i<ALARM_MAX_RULES; i++) {
+		ruleP = &alarm_rules[i];
+		if (!ruleP->enable) continue;
+
+		if (ruleP->region == ALARM_REGION_FRAME) {
+			value = alarm_get_stat(ruleP->stat, frame_min, frame_max, frame_mean);
+		} else {
+			statsP = &alarm_roi_stats[ruleP->region];
+			if (!statsP->valid) continue;
+			value = alarm_get_stat(ruleP->stat, statsP->min, statsP->max, statsP->mean);
+		}
+
+		if (alarm_update_state(i, value, t)) {
+			events[num_events].rule = i;
+			events[num_events].active = alarm_state[i].active;
+			events[num_events].record = ruleP->record;
+			events[num_events].value = value;
+			num_events++;
+		}
+	}
+
+	xSemaphoreGive(alarm_mutex);
+
+	return num_events;
+}
+
+
+
+//
+// Alarm Utilities internal functions
+//
+
+/**
+ * Compute the whole-frame min, max and mean in degrees C
+ */
+static void alarm_frame_stats(lep_buffer_t* lep_buffer, float* min, float* max, float* mean)
+{
+	int i;
+	uint16_t v;
+	uint16_t vmin = 0xFFFF;
+	uint16_t vmax = 0;
+	uint32_t sum = 0;
+	uint16_t* imgP = lep_buffer->lep_bufferP;
+
+	for (i=0; i<LEP_NUM_PIXELS; i++) {
+		v = *imgP++;
+		if (v < vmin) vmin = v;
+		if (v > vmax) vmax = v;
+		sum += v;
+	}
+
+	*min = temp_counts_to_temp(&alarm_conv, vmin);
+	*max = temp_counts_to_temp(&alarm_conv, vmax);
+	*mean = temp_counts_to_temp(&alarm_conv, (float) sum / LEP_NUM_PIXELS);
+}
+
+
+static float alarm_get_stat(int stat, float min, float max, float mean)
+{
+	switch (stat) {
+		case ALARM_STAT_MIN:
+			return min;
+		case ALARM_STAT_MAX:
+			return max;
+		default:
+			return mean;
+	}
+}
+
+
+/**
+ * Run rule n's hysteresis and duration state machine.  Returns true if the alarm
+ * state changed.  Assumes alarm_mutex is held.
+ */
+static bool alarm_update_state(int n, float value, int64_t t)
+{
+	bool change_cond;
+	alarm_rule_t* ruleP = &alarm_rules[n];
+	alarm_state_t* stateP = &alarm_state[n];
+
+	if (!stateP->active) {
+		if (ruleP->below) {
+			change_cond = (value <= ruleP->threshold);
+		} else {
+			change_cond = (value >= ruleP->threshold);
+		}
+	} else {
+		if (ruleP->below) {
+			change_cond = (value > (ruleP->threshold + ruleP->hysteresis));
+		} else {
+			change_cond = (value < (ruleP->threshold - ruleP->hysteresis));
+		}
+	}
+
+	if (!change_cond) {
+		stateP->pending = false;
+		return false;
+	}
+
+	if (!stateP->pending) {
+		stateP->pending = true;
+		stateP->pending_usec = t;
+	}
+
+	if ((t - stateP->pending_usec) >= ((int64_t) ruleP->duration_msec * 1000)) {
+		stateP->active = !stateP->active;
+		stateP->pending = false;
+		return true;
+	}
+
+	return false;
+}
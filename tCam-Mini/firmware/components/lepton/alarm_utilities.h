@@ -0,0 +1,92 @@
+/*
+ * Temperature threshold alarms
+ *
+ * Maintains a set of alarm rules that compare the whole-frame or a region of
+ * interest's minimum, maximum or mean temperature against a threshold.  Each rule
+ * has hysteresis and a minimum duration the condition must persist before the alarm
+ * state changes.  Rules are evaluated against each radiometric Lepton frame.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ALARM_UTILITIES_H
+#define ALARM_UTILITIES_H
+
+#include "sys_utilities.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Alarm Utilities Constants
+//
+
+// Maximum number of rules
+#define ALARM_MAX_RULES    8
+
+// Rule region value for the whole frame (otherwise a ROI index)
+#define ALARM_REGION_FRAME -1
+
+// Rule statistic
+#define ALARM_STAT_MIN     0
+#define ALARM_STAT_MAX     1
+#define ALARM_STAT_MEAN    2
+
+// Maximum minimum duration
+#define ALARM_MAX_DURATION_MSEC 3600000
+
+
+
+//
+// Alarm Utilities typedefs
+//
+
+// Rule definition.  Temperatures are in degrees C.  An "above" rule asserts when the
+// statistic is >= threshold and clears when it is < (threshold - hysteresis).  A
+// "below" rule asserts when the statistic is <= threshold and clears when it is
+// > (threshold + hysteresis).  Both conditions must persist for duration_msec.
+typedef struct {
+	bool enable;
+	int region;
+	int stat;
+	bool below;
+	float threshold;
+	float hysteresis;
+	uint32_t duration_msec;
+	bool record;               // Host should record while the alarm is active
+} alarm_rule_t;
+
+// Alarm state transition
+typedef struct {
+	int rule;
+	bool active;
+	bool record;
+	float value;
+} alarm_event_t;
+
+
+
+//
+// Alarm Utilities API
+//
+bool alarm_init();
+bool alarm_set_rule(int n, const alarm_rule_t* rule);
+bool alarm_get_rule(int n, alarm_rule_t* rule, bool* active);
+int alarm_eval(lep_buffer_t* lep_buffer, alarm_event_t* events);
+
+#endif /* ALARM_UTILITIES_H */
@@ -24,11 +24,29 @@
 #include "cci.h"
 #include "i2c.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "freertos/semphr.h"
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+
+
+
+//
+// CCI typedefs
+//
+
+// Queued asynchronous RUN/SET command
+typedef struct {
+	uint16_t cmd;
+	int len;
+	uint16_t buf[16];
+	TaskHandle_t task;     // Task to notify on completion (NULL for none)
+	uint32_t mask;         // Notification bits
+} cci_async_cmd_t;
 
 
 
@@ -42,6 +60,9 @@ static uint16_t cci_last_status;
 // Mutex to protect control routines for multi-task access
 static SemaphoreHandle_t cci_mutex;
 
+// Asynchronous command queue
+static QueueHandle_t cci_cmd_queue;
+
 // Statically allocated burst read/write I2C buffer sized for up to 512 16-bit words
 // plus register starting address
 static uint8_t burst_buf[1026];
@@ -57,6 +78,10 @@ static uint16_t cci_read_register(uint16_t reg);
 static int cci_read_burst(uint16_t start, uint16_t word_len, uint16_t* buf);
 static uint32_t cci_wait_busy_clear();
 static void cci_wait_busy_clear_check(char* cmd);
+static void cci_task(void* args);
+static bool cci_script_set(cci_script_step_t* step, uint16_t* data);
+static bool cci_script_verify(cci_script_step_t* step, uint16_t* data);
+static bool cci_script_cmd_success(const char* name);
 
 
 
@@ -70,8 +95,13 @@ static void cci_wait_busy_clear_check(char* cmd);
 bool cci_init()
 {
 	cci_mutex = xSemaphoreCreateMutex();
+	if (cci_mutex == NULL) return false;
+	
+	// Create the asynchronous command queue and the task that executes commands from it
+	cci_cmd_queue = xQueueCreate(CCI_QUEUE_LEN, sizeof(cci_async_cmd_t));
+	if (cci_cmd_queue == NULL) return false;
 	
-	return (cci_mutex != NULL);
+	return (xTaskCreatePinnedToCore(&cci_task, "cci_task", CCI_TASK_STACK, NULL, CCI_TASK_PRIORITY, NULL, CCI_TASK_CORE) == pdPASS);
 }
 
 
@@ -150,6 +180,89 @@ bool cci_command_success(uint16_t* status)
 }
 
 
+/**
+ * Queue a RUN (len = 0) or SET (up to 16 16-bit words) command for asynchronous
+ * execution so the caller doesn't block for long running commands such as FFC.  The
+ * optional task is notified with mask when the command has completed.  Returns false
+ * if the command could not be queued.
+ */
+bool cci_queue_cmd(uint16_t cmd, int len, uint16_t* buf, TaskHandle_t task, uint32_t mask)
+{
+	cci_async_cmd_t req;
+	
+	if ((len < 0) || (len > 16)) return false;
+	
+	req.cmd = cmd;
+	req.len = len;
+	if (len != 0) {
+		memcpy(req.buf, buf, len*2);
+	}
+	req.task = task;
+	req.mask = mask;
+	
+	if (xQueueSend(cci_cmd_queue, &req, 0) != pdTRUE) {
+		ESP_LOGE(TAG, "CCI command queue full - dropping 0x%4x", cmd);
+		return false;
+	}
+	
+	return true;
+}
+
+
+/**
+ * Execute a sequence of attribute SET commands, optionally verifying each, while holding
+ * the CCI for the entire sequence.  Each step is attempted up to CCI_SCRIPT_ATTEMPTS times.
+ * Returns the number of steps successfully executed (n if the entire script succeeded).
+ */
+int cci_run_script(cci_script_step_t* steps, int n)
+{
+	bool success = true;
+	int attempt;
+	int i;
+	uint16_t data[16];
+	
+	xSemaphoreTake(cci_mutex, portMAX_DELAY);
+	
+	// Busy wait once up front.  Subsequent commands are started after the previous
+	// command's completion has been detected.
+	cci_wait_busy_clear();
+	
+	for (i=0; i<n; i++) {
+		// Get the attribute data
+		if (steps[i].buf == NULL) {
+			steps[i].len = 2;
+			data[0] = steps[i].value & 0xFFFF;
+			data[1] = steps[i].value >> 16;
+		} else {
+			memcpy(data, steps[i].buf, steps[i].len*2);
+		}
+		
+		for (attempt=0; attempt<CCI_SCRIPT_ATTEMPTS; attempt++) {
+			success = cci_script_set(&steps[i], data);
+			if (success && steps[i].verify) {
+				success = cci_script_verify(&steps[i], data);
+			}
+			if (success) break;
+			
+			ESP_LOGI(TAG, "Retry Set Lepton %s", steps[i].name);
+			vTaskDelay(pdMS_TO_TICKS(10));
+		}
+		
+		if (!success) {
+			ESP_LOGE(TAG, "Set Lepton %s failed", steps[i].name);
+			break;
+		}
+		if (steps[i].buf == NULL) {
+			ESP_LOGI(TAG, "Lepton %s = %d", steps[i].name, steps[i].value);
+		}
+	}
+	
+	xSemaphoreGive(cci_mutex);
+	
+	return i;
+}
+
+
 /**
  * Ping the camera.
  *   Returns 0 for a successful ping
@@ -800,6 +913,7 @@ static int cci_read_burst(uint16_t start, uint16_t word_len, uint16_t* buf)
 	
 	// Read
 	if (i2c_master_read_slave(CCI_ADDRESS, burst_buf, word_len*2) != ESP_OK) {
+		i2c_unlock();
 		ESP_LOGE(TAG, "failed to burst read from CCI register %02x with length %d", start, word_len);
 		return -1;
 	}
@@ -822,7 +936,11 @@ static int cci_read_burst(uint16_t start, uint16_t word_len, uint16_t* buf)
 static uint32_t cci_wait_busy_clear()
 {
 	bool err = false;
+	int64_t start_usec;
+	int64_t wait_usec;
 	uint8_t buf[2] = {0x00, 0x07};
+	
+	start_usec = esp_timer_get_time();
 
 	// Wait for booted, not busy
 	while (((buf[1] & 0x07) != 0x06) && !err) {
@@ -842,6 +960,18 @@ static uint32_t cci_wait_busy_clear()
 			err = true;
 		}
 		i2c_unlock();
+		
+		if (((buf[1] & 0x07) != 0x06) && !err) {
+			// Give up after the timeout, otherwise back off after spinning for a short
+			// period so other tasks and I2C users can run during long commands
+			wait_usec = esp_timer_get_time() - start_usec;
+			if (wait_usec > (CCI_BUSY_TIMEOUT_MSEC * 1000)) {
+				ESP_LOGE(TAG, "timeout waiting for STATUS busy clear");
+				err = true;
+			} else if (wait_usec > CCI_BUSY_SPIN_USEC) {
+				vTaskDelay(1);
+			}
+		}
 	}
 	
 	if (err) {
@@ -875,3 +1005,94 @@ static void cci_wait_busy_clear_check(char* cmd)
 		}
 	}
 }
+
+
+/**
+ * Execute queued asynchronous commands
+ */
+static void cci_task(void* args)
+{
+	cci_async_cmd_t req;
+	
+	while (true) {
+		if (xQueueReceive(cci_cmd_queue, &req, portMAX_DELAY) == pdTRUE) {
+			cci_set_reg(req.cmd, req.len, req.buf);
+			
+			if (req.task != NULL) {
+				xTaskNotify(req.task, req.mask, eSetBits);
+			}
+		}
+	}
+}
+
+
+/**
+ * Write a script step's attribute data and SET command.  DATA_LENGTH immediately precedes
+ * the DATA registers so both are loaded in a single burst.  Assumes the CCI is not busy.
+ */
+static bool cci_script_set(cci_script_step_t* step, uint16_t* data)
+{
+	uint16_t words[17];
+	
+	words[0] = step->len;
+	memcpy(&words[1], data, step->len*2);
+	if (cci_write_burst(CCI_REG_DATA_LENGTH, step->len + 1, words) != 1) {
+		return false;
+	}
+	if (cci_write_register(CCI_REG_COMMAND, step->cmd + 1) != 1) {
+		return false;
+	}
+	
+	return cci_script_cmd_success(step->name);
+}
+
+
+/**
+ * Read back a script step's attribute and compare it with the data that was set.  Assumes
+ * the CCI is not busy.
+ */
+static bool cci_script_verify(cci_script_step_t* step, uint16_t* data)
+{
+	uint16_t rd_data[16];
+	
+	if (cci_write_register(CCI_REG_DATA_LENGTH, step->len) != 1) {
+		return false;
+	}
+	if (cci_write_register(CCI_REG_COMMAND, step->cmd) != 1) {
+		return false;
+	}
+	if (!cci_script_cmd_success(step->name)) {
+		return false;
+	}
+	if (cci_read_burst(CCI_REG_DATA_0, step->len, rd_data) != 1) {
+		return false;
+	}
+	
+	return (memcmp(rd_data, data, step->len*2) == 0);
+}
+
+
+/**
+ * Wait for the current command to complete and return true if it succeeded
+ */
+static bool cci_script_cmd_success(const char* name)
+{
+	int8_t response;
+	uint32_t t32;
+	
+	t32 = cci_wait_busy_clear();
+	cci_last_status = t32 & 0xFFFF;
+	cci_last_status_error = (t32 == 0x00010000);
+	if (cci_last_status_error) {
+		ESP_LOGE(TAG, "%s failed wait_busy_clear", name);
+		return false;
+	}
+	
+	response = (int8_t) ((t32 & 0x0000FF00) >> 8);
+	if (response < 0) {
+		ESP_LOGE(TAG, "%s returned %d", name, response);
+		return false;
+	}
+	
+	return true;
+}
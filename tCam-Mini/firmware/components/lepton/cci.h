@@ -27,6 +27,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 
 //
@@ -60,7 +62,21 @@
 #define CCI_BLOCK_BUF_0 0xF800
 #define CCI_BLOCK_BUF_1 0xFC00
 
-// Commands
+// Busy wait polling - poll continuously for a short period (most commands complete
+// quickly) and then yield between polls until the timeout
+#define CCI_BUSY_SPIN_USEC    2000
+#define CCI_BUSY_TIMEOUT_MSEC 5000
+
+// Asynchronous command engine
+#define CCI_QUEUE_LEN     8
+#define CCI_TASK_STACK    2048
+#define CCI_TASK_PRIORITY 2
+#define CCI_TASK_CORE     0
+
+// Script execution - attempts for each step before giving up
+#define CCI_SCRIPT_ATTEMPTS 2
+
+// Commands (the SET command for a module attribute is its GET command + 1)
 #define CCI_CMD_SYS_RUN_PING 0x0202
 #define CCI_CMD_SYS_GET_UPTIME 0x020C
 #define CCI_CMD_SYS_GET_AUX_TEMP 0x0210
@@ -169,6 +185,16 @@ typedef struct {
 	uint16_t TReflK;
 } cci_rad_flux_linear_params_t;
 
+// Script step: SET a module attribute, optionally reading it back to verify it
+typedef struct {
+	uint16_t cmd;         // GET command for the attribute
+	int len;              // Attribute length in 16-bit words (1-16)
+	uint16_t* buf;        // Attribute data or NULL to use value (2 words)
+	uint32_t value;       // 32-bit enum value
+	bool verify;          // Set to read back and compare after setting
+	const char* name;     // Attribute name for logging
+} cci_script_step_t;
+
 
 
 //
@@ -183,6 +209,10 @@ void cci_set_reg(uint16_t cmd, int len, uint16_t* buf);
 void cci_get_reg(uint16_t cmd, int len, uint16_t* buf);
 bool cci_command_success(uint16_t* status);
 
+// Asynchronous/batched access
+bool cci_queue_cmd(uint16_t cmd, int len, uint16_t* buf, TaskHandle_t task, uint32_t mask);
+int cci_run_script(cci_script_step_t* steps, int n);
+
 // Module: SYS
 uint32_t cci_run_ping();
 void cci_run_ffc();
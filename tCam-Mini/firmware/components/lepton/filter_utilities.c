@@ -0,0 +1,292 @@
+/*
+ * Temporal noise reduction filter
+ *
+ * Per-pixel IIR running average with a motion-adaptive weight operating on 16-bit
+ * Lepton images, in place or into a copy.  Each consumer of images (stream, display,
+ * record) has its own configuration and filter state.
+ *
+ * The filtered value for each pixel is held with 8 fractional bits.  For each new
+ * pixel value the weight w (8-bit fraction) is computed from the absolute change d
+ * since the filtered value:
+ *
+ *   w = 2^(8-strength) + (256 - 2^(8-strength)) * d / motion     d < motion
+ *   w = 256                                                      d >= motion
+ *
+ * and the filtered value is updated as s += w * (pixel - s).  Static scene noise is
+ * averaged over about 2^strength frames while moving objects follow immediately.
+ * Only multiplies and shifts are used per pixel.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "filter_utilities.h"
+#include "vospi.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+
+
+//
+// Filter Utilities internal constants
+//
+
+// Fractional bits in the filtered pixel values and weights
+#define FILTER_FRAC_BITS   8
+#define FILTER_ONE         (1 << FILTER_FRAC_BITS)
+
+
+
+//
+// Filter Utilities internal typedefs
+//
+typedef struct {
+	filter_config_t config;
+	bool primed;             // Set when stateP holds a filtered image
+	uint32_t* stateP;        // Filtered image with FILTER_FRAC_BITS fractional bits
+} filter_state_t;
+
+
+
+//
+// Filter Utilities variables
+//
+static const char* TAG = "filter_utilities";
+
+static SemaphoreHandle_t filter_mutex;
+
+static filter_state_t filter_state[FILTER_NUM_CONSUMERS];
+
+
+
+//
+// Filter Utilities forward declarations for internal functions
+//
+static void filter_prime(filter_state_t* f, const uint16_t* src, uint16_t* dst, int* min_index, int* max_index);
+static void filter_run(filter_state_t* f, const uint16_t* src, uint16_t* dst, int* min_index, int* max_index);
+
+
+
+//
+// Filter Utilities API
+//
+
+/**
+ * Initialize with all consumers disabled.  Filter state memory is allocated when a
+ * consumer is first enabled.
+ */
+bool filter_init()
+{
+	int i;
+
+	filter_mutex = xSemaphoreCreateMutex();
+	if (filter_mutex == NULL) {
+		ESP_LOGE(TAG, "create filter_mutex failed");
+		return false;
+	}
+
+	for (i=0; i<FILTER_NUM_CONSUMERS; i++) {
+		filter_state[i].config.enable = false;
+		filter_state[i].config.strength = FILTER_DEF_STRENGTH;
+		filter_state[i].config.motion = FILTER_DEF_MOTION;
+		filter_state[i].primed = false;
+		filter_state[i].stateP = NULL;
+	}
+
+	return true;
+}
+
+
+/**
+ * Configure a consumer's filter.  Any change restarts filtering with the next image.
+ */
+bool filter_set_config(int consumer, const filter_config_t* config)
+{
+	filter_state_t* f;
+
+	if ((consumer < 0) || (consumer >= FILTER_NUM_CONSUMERS)) return false;
+	if ((config->strength < FILTER_MIN_STRENGTH) || (config->strength > FILTER_MAX_STRENGTH)) return false;
+	if ((config->motion < FILTER_MIN_MOTION) || (config->motion > FILTER_MAX_MOTION)) return false;
+
+	f = &filter_state[consumer];
+
+	xSemaphoreTake(filter_mutex, portMAX_DELAY);
+	if (config->enable && (f->stateP == NULL)) {
+		f->stateP = heap_caps_malloc(LEP_NUM_PIXELS*sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+		if (f->stateP == NULL) {
+			xSemaphoreGive(filter_mutex);
+			ESP_LOGE(TAG, "malloc filter state failed");
+			return false;
+		}
+	}
+	f->config = *config;
+	f->primed = false;
+	xSemaphoreGive(filter_mutex);
+
+	return true;
+}
+
+
+bool filter_get_config(int consumer, filter_config_t* config)
+{
+	if ((consumer < 0) || (consumer >= FILTER_NUM_CONSUMERS)) return false;
+
+	xSemaphoreTake(filter_mutex, portMAX_DELAY);
+	*config = filter_state[consumer].config;
+	xSemaphoreGive(filter_mutex);
+
+	return true;
+}
+
+
+/**
+ * Restart filtering with the next image.  Called when a consumer skips images.
+ */
+void filter_reset(int consumer)
+{
+	if ((consumer < 0) || (consumer >= FILTER_NUM_CONSUMERS)) return;
+
+	xSemaphoreTake(filter_mutex, portMAX_DELAY);
+	filter_state[consumer].primed = false;
+	xSemaphoreGive(filter_mutex);
+}
+
+
+/**
+ * Filter a LEP_NUM_PIXELS image in place for a consumer.  Returns false, leaving the
+ * image unchanged, if the consumer's filter is disabled.  Otherwise loads the indices
+ * of the (filtered) minimum and maximum pixel values.
+ */
+bool filter_apply(int consumer, uint16_t* buf, int* min_index, int* max_index)
+{
+	return filter_apply_copy(consumer, buf, buf, min_index, max_index);
+}
+
+
+/**
+ * Filter a LEP_NUM_PIXELS image from src into dst for a consumer, leaving src for other
+ * consumers.  Returns false, without writing dst, if the consumer's filter is disabled.
+ */
+bool filter_apply_copy(int consumer, const uint16_t* src, uint16_t* dst, int* min_index, int* max_index)
+{
+	filter_state_t* f;
+
+	if ((consumer < 0) || (consumer >= FILTER_NUM_CONSUMERS)) return false;
+
+	f = &filter_state[consumer];
+
+	xSemaphoreTake(filter_mutex, portMAX_DELAY);
+	if (!f->config.enable || (f->stateP == NULL)) {
+		xSemaphoreGive(filter_mutex);
+		return false;
+	}
+
+	if (f->primed) {
+		filter_run(f, src, dst, min_index, max_index);
+	} else {
+		filter_prime(f, src, dst, min_index, max_index);
+		f->primed = true;
+	}
+	xSemaphoreGive(filter_mutex);
+
+	return true;
+}
+
+
+
+//
+// Filter Utilities internal functions
+//
+
+/**
+ * Load the filter state from an image, passing the image through unchanged
+ */
+static void filter_prime(filter_state_t* f, const uint16_t* src, uint16_t* dst, int* min_index, int* max_index)
+{
+	int i;
+	uint16_t v;
+	uint16_t min = 0xFFFF;
+	uint16_t max = 0;
+	uint32_t* sP = f->stateP;
+
+	*min_index = 0;
+	*max_index = 0;
+	for (i=0; i<LEP_NUM_PIXELS; i++) {
+		v = src[i];
+		dst[i] = v;
+		*sP++ = (uint32_t) v << FILTER_FRAC_BITS;
+		if (v < min) {
+			min = v;
+			*min_index = i;
+		}
+		if (v > max) {
+			max = v;
+			*max_index = i;
+		}
+	}
+}
+
+
+/**
+ * Update the filter state from an image and write the filtered values (src and dst
+ * may be the same)
+ */
+static void filter_run(filter_state_t* f, const uint16_t* src, uint16_t* dst, int* min_index, int* max_index)
+{
+	int i;
+	int32_t s, d, ad, w;
+	int32_t base = FILTER_ONE >> f->config.strength;
+	int32_t span = FILTER_ONE - base;
+	int32_t motion = f->config.motion;
+	uint32_t recip = 65536 / motion;   // 1/motion with 16 fractional bits
+	uint16_t v;
+	uint16_t min = 0xFFFF;
+	uint16_t max = 0;
+	uint32_t* sP = f->stateP;
+
+	*min_index = 0;
+	*max_index = 0;
+	for (i=0; i<LEP_NUM_PIXELS; i++) {
+		s = (int32_t) *sP;
+		d = ((int32_t) src[i] << FILTER_FRAC_BITS) - s;
+		ad = ((d < 0) ? -d : d) >> FILTER_FRAC_BITS;
+
+		if (ad >= motion) {
+			// Motion: follow the new value
+			s += d;
+		} else {
+			// (ad * recip) < 65536 so the products fit in 32 bits
+			w = base + ((span * (int32_t) (((uint32_t) ad * recip) >> 8)) >> 8);
+			s += (d * w) >> FILTER_FRAC_BITS;
+		}
+		*sP++ = (uint32_t) s;
+
+		v = (uint16_t) ((s + (FILTER_ONE/2)) >> FILTER_FRAC_BITS);
+		dst[i] = v;
+		if (v < min) {
+			min = v;
+			*min_index = i;
+		}
+		if (v > max) {
+			max = v;
+			*max_index = i;
+		}
+	}
+}
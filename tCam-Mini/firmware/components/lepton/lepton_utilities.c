@@ -30,6 +30,9 @@
 #include "i2c.h"
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "ps_utilities.h"
 #include "sys_utilities.h"
 #include "vospi.h"
 #include "system_config.h"
@@ -37,16 +40,66 @@
 
 
 
+//
+// Lepton Utilities internal constants and types
+//
+
+// Init table attribute value sources
+#define LEP_INIT_SRC_CONST   0
+#define LEP_INIT_SRC_TLINEAR 1
+#define LEP_INIT_SRC_AGC     2
+#define LEP_INIT_SRC_GAIN    3
+#define LEP_INIT_SRC_FLUX    4
+
+// Init table entry
+typedef struct {
+	uint16_t cmd;               // GET command for the attribute
+	int src;                    // Where the value comes from
+	uint32_t value;             // Value for LEP_INIT_SRC_CONST
+	bool radiometric_only;
+	bool verify;                // Read back after setting (unless cached config matches)
+	const char* name;
+} lep_init_entry_t;
+
+
+
 //
 // Lepton Utilities variables
 //
 static const char* TAG = "lepton_utilities";
 
+// Lepton initialization table, executed in order as a single CCI script
+static const lep_init_entry_t lep_init_table[] = {
+	// Configure Radiometry for TLinear enabled (depends on AGC), auto-resolution
+	{CCI_CMD_RAD_GET_RADIOMETRY_ENABLE_STATE, LEP_INIT_SRC_CONST, CCI_RADIOMETRY_ENABLED, true, true, "Radiometry"},
+	{CCI_CMD_RAD_GET_RADIOMETRY_TLINEAR_ENABLE_STATE, LEP_INIT_SRC_TLINEAR, 0, true, true, "Radiometry TLinear"},
+	{CCI_CMD_RAD_GET_RADIOMETRY_TLINEAR_AUTO_RES, LEP_INIT_SRC_CONST, CCI_RADIOMETRY_AUTO_RES_ENABLED, true, true, "Radiometry Auto Resolution"},
+	// Enable AGC calcs for a smooth transition between modes
+	{CCI_CMD_AGC_GET_CALC_ENABLE_STATE, LEP_INIT_SRC_CONST, CCI_AGC_ENABLED, false, true, "AGC Calcs"},
+	{CCI_CMD_AGC_GET_AGC_ENABLE_STATE, LEP_INIT_SRC_AGC, 0, false, true, "AGC"},
+	{CCI_CMD_SYS_GET_TELEMETRY_ENABLE_STATE, LEP_INIT_SRC_CONST, CCI_TELEMETRY_ENABLED, false, true, "Telemetry"},
+	{CCI_CMD_SYS_GET_GAIN_MODE, LEP_INIT_SRC_GAIN, 0, false, true, "Gain Mode"},
+	// Emissivity (never verified)
+	{CCI_CMD_RAD_GET_RADIOMETRY_FLUX_LINEAR_PARAMS, LEP_INIT_SRC_FLUX, 0, true, false, "Emissivity"},
+	// Finally enable VSYNC on Lepton GPIO3
+	{CCI_CMD_OEM_GET_GPIO_MODE, LEP_INIT_SRC_CONST, LEP_OEM_GPIO_MODE_VSYNC, false, true, "GPIO Mode"}
+};
+
+#define LEP_INIT_TABLE_LEN ((int) (sizeof(lep_init_table) / sizeof(lep_init_entry_t)))
+
 static bool lep_is_radiometric = false;
 static int lep_type;
 
 
 
+//
+// Lepton Utilities forward declarations for internal functions
+//
+static uint32_t get_init_value(const lep_init_entry_t* entry, json_config_t* lep_stP);
+static void get_flux_params(uint16_t e, cci_rad_flux_linear_params_t* params);
+
+
+
 //
 // Lepton Utilities API
 //
@@ -54,9 +107,18 @@ static int lep_type;
 bool lepton_init()
 {
 	char pn[33];
-	uint32_t val, rsp;
+	int i;
+	int n = 0;
+	int64_t start_usec;
+	uint32_t crc, rsp;
+	bool read_back;
+	bool step_verify[LEP_INIT_SCRIPT_MAX_STEPS];
+	cci_rad_flux_linear_params_t flux_params;
+	cci_script_step_t init_script[LEP_INIT_SCRIPT_MAX_STEPS];
 	json_config_t* lep_stP = system_get_lep_st();
   
+  	start_usec = esp_timer_get_time();
+  	
   	// Attempt to ping the Lepton to validate communication
   	// If this is successful, we assume further communication will be successful
   	rsp = cci_run_ping();
@@ -86,105 +148,72 @@ bool lepton_init()
 		lep_type = LEP_TYPE_UNK;
 	}
 	
-	if (lep_is_radiometric) {
-		// Configure Radiometry for TLinear enabled, auto-resolution
-		cci_set_radiometry_enable_state(CCI_RADIOMETRY_ENABLED);
-		rsp = cci_get_radiometry_enable_state();
-		ESP_LOGI(TAG, "Lepton Radiometry = %d", rsp);
-		if (rsp != CCI_RADIOMETRY_ENABLED) {
-			// Make one more effort
-			vTaskDelay(pdMS_TO_TICKS(10));
-			ESP_LOGI(TAG, "Retry Set Lepton Radiometry");
-			cci_set_radiometry_enable_state(CCI_RADIOMETRY_ENABLED);
-			rsp = cci_get_radiometry_enable_state();
-			ESP_LOGI(TAG, "Lepton Radiometry = %d", rsp);
-			if (rsp != CCI_RADIOMETRY_ENABLED) {
-				ESP_LOGE(TAG, "Lepton communication failed (%d)", rsp);
-				return false;
-			}
-		}
-	
-		// TLinear depends on AGC
-		val = (lep_stP->agc_set_enabled) ? CCI_RADIOMETRY_TLINEAR_DISABLED : CCI_RADIOMETRY_TLINEAR_ENABLED;
-		cci_set_radiometry_tlinear_enable_state(val);
-		rsp = cci_get_radiometry_tlinear_enable_state();
-		ESP_LOGI(TAG, "Lepton Radiometry TLinear = %d", rsp);
-		if (rsp != val) {
-			ESP_LOGE(TAG, "Lepton communication failed (%d)", rsp);
-	  		return false;
-		}
+	// Build the configuration script from the init table and our current settings.
+	// The CRC covers the part number and every attribute written so a different
+	// Lepton or changed setting forces a verified initialization.
+	get_flux_params(lep_stP->emissivity, &flux_params);
+	crc = esp_rom_crc32_le(0, (uint8_t*) pn, strlen(pn));
+	for (i=0; i<LEP_INIT_TABLE_LEN; i++) {
+		if (lep_init_table[i].radiometric_only && !lep_is_radiometric) continue;
 		
-		cci_set_radiometry_tlinear_auto_res(CCI_RADIOMETRY_AUTO_RES_ENABLED);
-		rsp = cci_get_radiometry_tlinear_auto_res();
-		ESP_LOGI(TAG, "Lepton Radiometry Auto Resolution = %d", rsp);
-		if (rsp != CCI_RADIOMETRY_AUTO_RES_ENABLED) {
-			ESP_LOGE(TAG, "Lepton communication failed (%d)", rsp);
-	  		return false;
+		init_script[n].cmd = lep_init_table[i].cmd;
+		step_verify[n] = lep_init_table[i].verify;
+		init_script[n].verify = step_verify[n];
+		init_script[n].name = lep_init_table[i].name;
+		if (lep_init_table[i].src == LEP_INIT_SRC_FLUX) {
+			init_script[n].len = sizeof(cci_rad_flux_linear_params_t) / 2;
+			init_script[n].buf = (uint16_t*) &flux_params;
+			crc = esp_rom_crc32_le(crc, (uint8_t*) &flux_params, sizeof(flux_params));
+		} else {
+			init_script[n].len = 2;
+			init_script[n].buf = NULL;
+			init_script[n].value = get_init_value(&lep_init_table[i], lep_stP);
+			crc = esp_rom_crc32_le(crc, (uint8_t*) &init_script[n].value, sizeof(uint32_t));
 		}
+		crc = esp_rom_crc32_le(crc, (uint8_t*) &init_script[n].cmd, sizeof(uint16_t));
+		n++;
 	}
+	if (crc == 0) crc = 1;   // 0 is reserved to mean no stored configuration
 	
-	// Enable AGC calcs for a smooth transition between modes
-	cci_set_agc_calc_enable_state(CCI_AGC_ENABLED);
-	rsp = cci_get_agc_calc_enable_state();
-	ESP_LOGI(TAG, "Lepton AGC Calcs = %d", rsp);
-	if (rsp != CCI_AGC_ENABLED) {
-		ESP_LOGE(TAG, "Lepton communication failed (%d)", rsp);
-  		return false;
+	// Skip read-backs if this exact configuration was previously verified.  Each SET is
+	// still checked for a successful Lepton response code.
+	read_back = (crc != ps_get_lep_init_crc());
+	if (!read_back) {
+		ESP_LOGI(TAG, "Lepton configuration matches last verified, skipping read-back");
+		for (i=0; i<n; i++) {
+			init_script[i].verify = false;
+		}
 	}
 	
-	// AGC
-	val = (lep_stP->agc_set_enabled) ? CCI_AGC_ENABLED : CCI_AGC_DISABLED;
-	cci_set_agc_enable_state(val);
-	rsp = cci_get_agc_enable_state();
-	ESP_LOGI(TAG, "Lepton AGC = %d", rsp);
-	if (rsp != val) {
-		ESP_LOGE(TAG, "Lepton communication failed (%d)", rsp);
-  		return false;
+	// Configure the Lepton
+	if (cci_run_script(init_script, n) != n) {
+		if (read_back) {
+			ps_set_lep_init_crc(0);
+			ESP_LOGE(TAG, "Lepton communication failed");
+			return false;
+		}
+		
+		// Fall back to a fully verified initialization
+		ESP_LOGI(TAG, "Unverified Lepton initialization failed - retrying with read-back");
+		ps_set_lep_init_crc(0);
+		for (i=0; i<n; i++) {
+			init_script[i].verify = step_verify[i];
+		}
+		if (cci_run_script(init_script, n) != n) {
+			ESP_LOGE(TAG, "Lepton communication failed");
+			return false;
+		}
+		read_back = true;
 	}
-	
-	// Enable telemetry
-	cci_set_telemetry_enable_state(CCI_TELEMETRY_ENABLED);
-	rsp = cci_get_telemetry_enable_state();
-	ESP_LOGI(TAG, "Lepton Telemetry = %d", rsp);
-	if (rsp != CCI_TELEMETRY_ENABLED) {
-		ESP_LOGE(TAG, "Lepton communication failed (%d)", rsp);
-  		return false;
+	if (read_back) {
+		ps_set_lep_init_crc(crc);
 	}
 	vospi_include_telem(true);
-	
-	// GAIN
-	switch (lep_stP->gain_mode) {
-		case SYS_GAIN_HIGH:
-			val = LEP_SYS_GAIN_MODE_HIGH;
-			break;
-		case SYS_GAIN_LOW:
-			val = LEP_SYS_GAIN_MODE_LOW;
-			break;
-		default:
-			val = LEP_SYS_GAIN_MODE_AUTO;
-	}
-	cci_set_gain_mode(val);
-	rsp = cci_get_gain_mode();
-	ESP_LOGI(TAG, "Lepton Gain Mode = %d", rsp);
-	if (rsp != val) {
-		ESP_LOGE(TAG, "Lepton communication failed (%d)", rsp);
-  		return false;
-	}
-	
-	// Emissivity
 	if (lep_is_radiometric) {
-		lepton_emissivity(lep_stP->emissivity);
 		ESP_LOGI(TAG, "Lepton Emissivity = %d%%", lep_stP->emissivity);
 	}
-  	
-	// Finally enable VSYNC on Lepton GPIO3
-	cci_set_gpio_mode(LEP_OEM_GPIO_MODE_VSYNC);
-	rsp = cci_get_gpio_mode();
-	ESP_LOGI(TAG, "Lepton GPIO Mode = %d", rsp);
-	if (rsp != LEP_OEM_GPIO_MODE_VSYNC) {
-		ESP_LOGE(TAG, "Lepton communication failed (%d)", rsp);
-  		return false;
-	}
+	
+	ESP_LOGI(TAG, "Lepton initialization took %d mSec", (int) ((esp_timer_get_time() - start_usec) / 1000));
 	
 	return true;
 }
@@ -220,7 +249,10 @@ void lepton_agc(bool en)
 
 void lepton_ffc()
 {
-	cci_run_ffc();
+	// Run FFC asynchronously since it takes a long time
+	if (!cci_queue_cmd(CCI_CMD_SYS_RUN_FFC, 0, NULL, NULL, 0)) {
+		cci_run_ffc();
+	}
 }
 
 
@@ -257,20 +289,7 @@ void lepton_emissivity(uint16_t e)
 	cci_rad_flux_linear_params_t set_flux_values;
 	
 	if (lep_is_radiometric) {
-		// Scale percentage e into Lepton scene emissivity values (1-100% -> 82-8192)
-		if (e < 1) e = 1;
-		if (e > 100) e = 100;
-		set_flux_values.sceneEmissivity = e * 8192 / 100;
-		
-		// Set default (no lens) values for the remaining parameters
-		set_flux_values.TBkgK      = 29515;
-		set_flux_values.tauWindow  = 8192;
-		set_flux_values.TWindowK   = 29515;
-		set_flux_values.tauAtm     = 8192;
-		set_flux_values.TAtmK      = 29515;
-		set_flux_values.reflWindow = 0;
-		set_flux_values.TReflK     = 29515;
-		
+		get_flux_params(e, &set_flux_values);
 		cci_set_radiometry_flux_linear_params(&set_flux_values);
 	}
 }
@@ -289,3 +308,58 @@ float lepton_kelvin_to_C(uint32_t k, float lep_res)
 {
 	return (((float) k) * lep_res) - 273.15;
 }
+
+
+
+//
+// Lepton Utilities internal functions
+//
+
+/**
+ * Return the value to write for a 32-bit enum init table entry
+ */
+static uint32_t get_init_value(const lep_init_entry_t* entry, json_config_t* lep_stP)
+{
+	switch (entry->src) {
+		case LEP_INIT_SRC_TLINEAR:
+			return (lep_stP->agc_set_enabled) ? CCI_RADIOMETRY_TLINEAR_DISABLED : CCI_RADIOMETRY_TLINEAR_ENABLED;
+		
+		case LEP_INIT_SRC_AGC:
+			return (lep_stP->agc_set_enabled) ? CCI_AGC_ENABLED : CCI_AGC_DISABLED;
+		
+		case LEP_INIT_SRC_GAIN:
+			switch (lep_stP->gain_mode) {
+				case SYS_GAIN_HIGH:
+					return LEP_SYS_GAIN_MODE_HIGH;
+				case SYS_GAIN_LOW:
+					return LEP_SYS_GAIN_MODE_LOW;
+				default:
+					return LEP_SYS_GAIN_MODE_AUTO;
+			}
+		
+		default:
+			return entry->value;
+	}
+}
+
+
+/**
+ * Compute the radiometry flux parameters for emissivity e (percent) with default values
+ * for the remaining parameters
+ */
+static void get_flux_params(uint16_t e, cci_rad_flux_linear_params_t* params)
+{
+	// Scale percentage e into Lepton scene emissivity values (1-100% -> 82-8192)
+	if (e < 1) e = 1;
+	if (e > 100) e = 100;
+	params->sceneEmissivity = e * 8192 / 100;
+	
+	// Set default (no lens) values for the remaining parameters
+	params->TBkgK      = 29515;
+	params->tauWindow  = 8192;
+	params->TWindowK   = 29515;
+	params->tauAtm     = 8192;
+	params->TAtmK      = 29515;
+	params->reflWindow = 0;
+	params->TReflK     = 29515;
+}
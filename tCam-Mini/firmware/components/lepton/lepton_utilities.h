@@ -135,6 +135,11 @@
 #define LEP_TYPE_3_1           2
 #define LEP_TYPE_UNK           3
 
+//
+// Maximum number of steps in the lepton_init CCI script
+//
+#define LEP_INIT_SCRIPT_MAX_STEPS 10
+
 
 
 //
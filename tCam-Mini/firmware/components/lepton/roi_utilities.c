@@ -0,0 +1,417 @@
+/*
+ * Region of interest statistics
+ *
+ * Maintains a set of rectangular or polygonal regions of interest and computes
+ * statistics (count, min, max, mean, standard deviation and percentiles) for all of
+ * them with two passes over a Lepton image.
+ *
+ * Each pixel has an entry in a membership map with one bit set for each region that
+ * contains it.  The map is rebuilt when a region changes so that computing statistics
+ * only visits the pixels covered by a region.
+ *
+ * Min, max, mean and standard deviation are exact and computed in the first pass.
+ * Percentiles are taken from a histogram built in the second pass with its range set
+ * from the region's min/max values in the current image.  They are exact when a
+ * region's range is less than ROI_HIST_BINS pixel counts and are otherwise accurate
+ * to a histogram bin width.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "roi_utilities.h"
+#include "lepton_utilities.h"
+#include "temp_utilities.h"
+#include "vospi.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <math.h>
+#include <string.h>
+
+
+
+//
+// ROI Utilities internal typedefs
+//
+
+// Per-region accumulators
+typedef struct {
+	uint32_t count;
+	uint16_t min;
+	uint16_t max;
+	uint32_t sum;
+	uint64_t sum_sq;
+	uint16_t hist_base;
+	int hist_shift;
+	uint16_t hist[ROI_HIST_BINS];
+} roi_acc_t;
+
+
+
+//
+// ROI Utilities variables
+//
+static const char* TAG = "roi_utilities";
+
+static SemaphoreHandle_t roi_mutex;
+
+static roi_region_t roi_regions[ROI_MAX_REGIONS];
+static roi_acc_t roi_acc[ROI_MAX_REGIONS];
+
+// Pixel membership map (allocated in external RAM) and the range of pixels it covers
+static uint8_t* roi_map;
+static int roi_map_first;
+static int roi_map_last;
+
+static const uint8_t roi_pct_list[ROI_NUM_PCT] = ROI_PCT_LIST;
+
+static temp_conv_t roi_conv;
+
+
+
+//
+// ROI Utilities forward declarations for internal functions
+//
+static void roi_build_map(int n);
+static bool roi_in_poly(const roi_region_t* region, int r, int c);
+static void roi_set_hist(int n);
+static uint16_t roi_get_pct(int n, int pct);
+
+
+
+//
+// ROI Utilities API
+//
+
+/**
+ * Allocate the membership map and initialize with no regions
+ */
+bool roi_init()
+{
+	int i;
+
+	roi_map = heap_caps_malloc(LEP_NUM_PIXELS, MALLOC_CAP_SPIRAM);
+	if (roi_map == NULL) {
+		ESP_LOGE(TAG, "malloc roi_map failed");
+		return false;
+	}
+	memset(roi_map, 0, LEP_NUM_PIXELS);
+	roi_map_first = LEP_NUM_PIXELS;
+	roi_map_last = -1;
+
+	temp_conv_init(&roi_conv, TEMP_RES_HIGH, TEMP_UNIT_C);
+
+	roi_mutex = xSemaphoreCreateMutex();
+	if (roi_mutex == NULL) {
+		ESP_LOGE(TAG, "create roi_mutex failed");
+		return false;
+	}
+
+	for (i=0; i<ROI_MAX_REGIONS; i++) {
+		roi_regions[i].type = ROI_TYPE_NONE;
+		roi_regions[i].num_points = 0;
+	}
+
+	return true;
+}
+
+
+/**
+ * Set (or clear with type ROI_TYPE_NONE) region n.  Points must be within the image.
+ */
+bool roi_set_region(int n, const roi_region_t* region)
+{
+	int i;
+
+	if ((n < 0) || (n >= ROI_MAX_REGIONS)) return false;
+
+	// Validate the region
+	if (region->type == ROI_TYPE_RECT) {
+		if (region->num_points != 2) return false;
+	} else if (region->type == ROI_TYPE_POLY) {
+		if ((region->num_points < 3) || (region->num_points > ROI_MAX_POINTS)) return false;
+	} else if (region->type != ROI_TYPE_NONE) {
+		return false;
+	}
+	for (i=0; i<region->num_points; i++) {
+		if ((region->r[i] >= LEP_HEIGHT) || (region->c[i] >= LEP_WIDTH)) return false;
+	}
+
+	xSemaphoreTake(roi_mutex, portMAX_DELAY);
+	roi_regions[n] = *region;
+	roi_build_map(n);
+	xSemaphoreGive(roi_mutex);
+
+	return true;
+}
+
+
+/**
+ * Get region n.  Returns false if the region is not set.
+ */
+bool roi_get_region(int n, roi_region_t* region)
+{
+	if ((n < 0) || (n >= ROI_MAX_REGIONS)) return false;
+
+	xSemaphoreTake(roi_mutex, portMAX_DELAY);
+	*region = roi_regions[n];
+	xSemaphoreGive(roi_mutex);
+
+	return (region->type != ROI_TYPE_NONE);
+}
+
+
+/**
+ * Compute statistics for all regions in two passes over the image.  Loads stats with
+ * ROI_MAX_REGIONS entries (valid set for regions that contain pixels).  Returns true
+ * if the values are temperatures in degrees C (TLinear radiometric data), false if
+ * they are raw pixel values.
+ */
+bool roi_compute(lep_buffer_t* lep_buffer, roi_stats_t* stats)
+{
+	bool radiometric;
+	uint64_t var_n2;
+	int i, j, p;
+	int bin;
+	uint8_t m;
+	uint16_t v;
+	uint16_t* imgP;
+	roi_acc_t* accP;
+
+	// Determine pixel units
+	radiometric = lep_buffer->telem_valid && (lep_buffer->lep_telemP[LEP_TEL_TLIN_ENABLE] != 0);
+
+	xSemaphoreTake(roi_mutex, portMAX_DELAY);
+
+	if (radiometric) {
+		(void) temp_conv_set(&roi_conv, temp_get_res(lep_buffer->lep_telemP), TEMP_UNIT_C);
+	}
+
+	for (i=0; i<ROI_MAX_REGIONS; i++) {
+		accP = &roi_acc[i];
+		accP->count = 0;
+		accP->min = 0xFFFF;
+		accP->max = 0;
+		accP->sum = 0;
+		accP->sum_sq = 0;
+		memset(accP->hist, 0, sizeof(accP->hist));
+	}
+
+	// First pass over the pixels covered by any region for the exact statistics
+	imgP = lep_buffer->lep_bufferP;
+	for (p=roi_map_first; p<=roi_map_last; p++) {
+		m = roi_map[p];
+		if (m == 0) continue;
+
+		v = imgP[p];
+		for (i=0; m != 0; i++, m >>= 1) {
+			if ((m & 0x01) == 0) continue;
+
+			accP = &roi_acc[i];
+			accP->count++;
+			if (v < accP->min) accP->min = v;
+			if (v > accP->max) accP->max = v;
+			accP->sum += v;
+			accP->sum_sq += (uint32_t) v * v;
+		}
+	}
+
+	// Setup each histogram to cover its region's range in this image
+	for (i=0; i<ROI_MAX_REGIONS; i++) {
+		if (roi_acc[i].count != 0) roi_set_hist(i);
+	}
+
+	// Second pass to build the histograms
+	for (p=roi_map_first; p<=roi_map_last; p++) {
+		m = roi_map[p];
+		if (m == 0) continue;
+
+		v = imgP[p];
+		for (i=0; m != 0; i++, m >>= 1) {
+			if ((m & 0x01) == 0) continue;
+
+			accP = &roi_acc[i];
+			bin = (v - accP->hist_base) >> accP->hist_shift;
+			accP->hist[bin]++;
+		}
+	}
+
+	// Reduce the accumulators
+	for (i=0; i<ROI_MAX_REGIONS; i++) {
+		accP = &roi_acc[i];
+		stats[i].valid = (accP->count != 0);
+		stats[i].count = accP->count;
+		if (!stats[i].valid) continue;
+
+		// Variance scaled by count^2 is computed exactly in integer math (fits in 64 bits
+		// for a full 160x120 image of 16-bit pixels) to avoid float cancellation
+		stats[i].mean = (float) accP->sum / accP->count;
+		var_n2 = (uint64_t) accP->count * accP->sum_sq - (uint64_t) accP->sum * accP->sum;
+		stats[i].stddev = (float) (sqrt((double) var_n2) / accP->count);
+		stats[i].min = accP->min;
+		stats[i].max = accP->max;
+		for (j=0; j<ROI_NUM_PCT; j++) {
+			stats[i].pct[j] = roi_get_pct(i, roi_pct_list[j]);
+		}
+
+		if (radiometric) {
+			stats[i].min = temp_counts_to_temp(&roi_conv, stats[i].min);
+			stats[i].max = temp_counts_to_temp(&roi_conv, stats[i].max);
+			stats[i].mean = temp_counts_to_temp(&roi_conv, stats[i].mean);
+			stats[i].stddev = temp_delta_to_temp(&roi_conv, stats[i].stddev);
+			for (j=0; j<ROI_NUM_PCT; j++) {
+				stats[i].pct[j] = temp_counts_to_temp(&roi_conv, stats[i].pct[j]);
+			}
+		}
+	}
+
+	xSemaphoreGive(roi_mutex);
+
+	return radiometric;
+}
+
+
+/**
+ * Return the list of ROI_NUM_PCT percentiles reported in roi_stats_t
+ */
+const uint8_t* roi_get_pct_list()
+{
+	return roi_pct_list;
+}
+
+
+
+//
+// ROI Utilities internal functions
+//
+
+/**
+ * Rebuild region n's bit in the membership map and the range of pixels covered by
+ * all regions.  Assumes roi_mutex is held.
+ */
+static void roi_build_map(int n)
+{
+	int r, c, p;
+	int r1, c1, r2, c2;
+	int i;
+	uint8_t mask = 1 << n;
+	roi_region_t* regionP = &roi_regions[n];
+
+	for (p=0; p<LEP_NUM_PIXELS; p++) {
+		roi_map[p] &= ~mask;
+	}
+
+	if (regionP->type != ROI_TYPE_NONE) {
+		// Bounding box
+		r1 = r2 = regionP->r[0];
+		c1 = c2 = regionP->c[0];
+		for (i=1; i<regionP->num_points; i++) {
+			if (regionP->r[i] < r1) r1 = regionP->r[i];
+			if (regionP->r[i] > r2) r2 = regionP->r[i];
+			if (regionP->c[i] < c1) c1 = regionP->c[i];
+			if (regionP->c[i] > c2) c2 = regionP->c[i];
+		}
+
+		for (r=r1; r<=r2; r++) {
+			for (c=c1; c<=c2; c++) {
+				if ((regionP->type == ROI_TYPE_RECT) || roi_in_poly(regionP, r, c)) {
+					roi_map[r*LEP_WIDTH + c] |= mask;
+				}
+			}
+		}
+	}
+
+	// Update the covered range
+	roi_map_first = LEP_NUM_PIXELS;
+	roi_map_last = -1;
+	for (p=0; p<LEP_NUM_PIXELS; p++) {
+		if (roi_map[p] != 0) {
+			if (roi_map_first == LEP_NUM_PIXELS) roi_map_first = p;
+			roi_map_last = p;
+		}
+	}
+}
+
+
+/**
+ * Even-odd rule test of a pixel center against a polygon region
+ */
+static bool roi_in_poly(const roi_region_t* region, int r, int c)
+{
+	bool inside = false;
+	int i, j;
+	float ri, rj, ci, cj;
+
+	for (i=0, j=region->num_points-1; i<region->num_points; j=i++) {
+		ri = region->r[i];
+		ci = region->c[i];
+		rj = region->r[j];
+		cj = region->c[j];
+		if (((ri > r) != (rj > r)) && (c < ((cj - ci) * (r - ri) / (rj - ri) + ci))) {
+			inside = !inside;
+		}
+	}
+
+	return inside;
+}
+
+
+/**
+ * Set the histogram to cover region n's min/max range from the first pass.  Assumes
+ * the region contains pixels.
+ */
+static void roi_set_hist(int n)
+{
+	int shift = 0;
+	roi_acc_t* accP = &roi_acc[n];
+
+	while (((accP->max - accP->min) >> shift) >= ROI_HIST_BINS) {
+		shift++;
+	}
+
+	accP->hist_base = accP->min;
+	accP->hist_shift = shift;
+}
+
+
+/**
+ * Return the pixel value for the specified percentile from region n's histogram
+ */
+static uint16_t roi_get_pct(int n, int pct)
+{
+	int bin;
+	uint32_t sum = 0;
+	uint32_t target;
+	uint32_t v;
+	roi_acc_t* accP = &roi_acc[n];
+
+	target = (accP->count * pct + 99) / 100;
+	if (target == 0) target = 1;
+
+	for (bin=0; bin<ROI_HIST_BINS; bin++) {
+		sum += accP->hist[bin];
+		if (sum >= target) break;
+	}
+
+	// Use the center of the bin limited to the actual range
+	v = accP->hist_base + (bin << accP->hist_shift) + ((1 << accP->hist_shift) >> 1);
+	if (v < accP->min) v = accP->min;
+	if (v > accP->max) v = accP->max;
+
+	return (uint16_t) v;
+}
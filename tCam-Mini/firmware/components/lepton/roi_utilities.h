@@ -0,0 +1,94 @@
+/*
+ * Region of interest statistics
+ *
+ * Maintains a set of rectangular or polygonal regions of interest and computes
+ * statistics (count, min, max, mean, standard deviation and percentiles) for all of
+ * them in a single pass over a Lepton image.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ROI_UTILITIES_H
+#define ROI_UTILITIES_H
+
+#include "sys_utilities.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// ROI Utilities Constants
+//
+
+// Maximum number of regions (each region is one bit in the pixel membership map)
+#define ROI_MAX_REGIONS    8
+
+// Maximum number of polygon vertices
+#define ROI_MAX_POINTS     8
+
+// Region types
+#define ROI_TYPE_NONE      0
+#define ROI_TYPE_RECT      1
+#define ROI_TYPE_POLY      2
+
+// Reported percentiles
+#define ROI_NUM_PCT        3
+#define ROI_PCT_LIST       {5, 50, 95}
+
+// Histogram used to estimate percentiles
+#define ROI_HIST_BINS      256
+
+
+
+//
+// ROI Utilities typedefs
+//
+
+// Region definition.  A rectangle is specified by two points (r1,c1) and (r2,c2)
+// inclusive.  A polygon is specified by 3 - ROI_MAX_POINTS vertices.
+typedef struct {
+	int type;
+	int num_points;
+	uint16_t r[ROI_MAX_POINTS];
+	uint16_t c[ROI_MAX_POINTS];
+} roi_region_t;
+
+// Region statistics.  Units are degrees C when the image contains radiometric data,
+// otherwise raw pixel values.
+typedef struct {
+	bool valid;
+	uint32_t count;
+	float min;
+	float max;
+	float mean;
+	float stddev;
+	float pct[ROI_NUM_PCT];
+} roi_stats_t;
+
+
+
+//
+// ROI Utilities API
+//
+bool roi_init();
+bool roi_set_region(int n, const roi_region_t* region);
+bool roi_get_region(int n, roi_region_t* region);
+bool roi_compute(lep_buffer_t* lep_buffer, roi_stats_t* stats);
+const uint8_t* roi_get_pct_list();
+
+#endif /* ROI_UTILITIES_H */
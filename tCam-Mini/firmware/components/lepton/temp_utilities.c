@@ -0,0 +1,130 @@
+/*
+ * Radiometric temperature conversion
+ *
+ * Converts Lepton TLinear pixel counts to temperatures in degrees C, F or K for
+ * both TLinear resolutions.  The linear conversion coefficients for a resolution
+ * and unit are computed once when either changes and then applied to individual
+ * values or to a whole frame.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "temp_utilities.h"
+#include "lepton_utilities.h"
+#include <math.h>
+
+
+
+//
+// Temp Utilities API
+//
+
+/**
+ * Compute the conversion coefficients for a resolution and unit
+ */
+void temp_conv_init(temp_conv_t* conv, int res, int unit)
+{
+	float k_per_count;
+
+	k_per_count = (res == TEMP_RES_HIGH) ? 0.01 : 0.1;
+
+	conv->res = res;
+	conv->unit = unit;
+	switch (unit) {
+		case TEMP_UNIT_F:
+			conv->scale = k_per_count * 9.0 / 5.0;
+			conv->offset = -459.67;
+			break;
+		case TEMP_UNIT_K:
+			conv->scale = k_per_count;
+			conv->offset = 0;
+			break;
+		default:
+			conv->unit = TEMP_UNIT_C;
+			conv->scale = k_per_count;
+			conv->offset = -273.15;
+	}
+}
+
+
+/**
+ * Update the conversion coefficients (previously initialized with temp_conv_init) only
+ * if the resolution or unit has changed.  Returns true if they were recomputed.
+ */
+bool temp_conv_set(temp_conv_t* conv, int res, int unit)
+{
+	if ((conv->res == res) && (conv->unit == unit)) return false;
+
+	temp_conv_init(conv, res, unit);
+	return true;
+}
+
+
+/**
+ * Return the TLinear resolution indicated by a frame's telemetry
+ */
+int temp_get_res(uint16_t* telem)
+{
+	return (telem[LEP_TEL_TLIN_RES] != 0) ? TEMP_RES_HIGH : TEMP_RES_LOW;
+}
+
+
+/**
+ * Convert a (possibly fractional, e.g. mean) count value to a temperature
+ */
+float temp_counts_to_temp(const temp_conv_t* conv, float counts)
+{
+	return counts * conv->scale + conv->offset;
+}
+
+
+/**
+ * Convert a count difference (e.g. standard deviation) to a temperature difference
+ */
+float temp_delta_to_temp(const temp_conv_t* conv, float delta_counts)
+{
+	return delta_counts * conv->scale;
+}
+
+
+/**
+ * Convert a temperature to the nearest count value
+ */
+uint16_t temp_temp_to_counts(const temp_conv_t* conv, float t)
+{
+	float counts;
+
+	counts = roundf((t - conv->offset) / conv->scale);
+	if (counts < 0) return 0;
+	if (counts > 65535) return 65535;
+	return (uint16_t) counts;
+}
+
+
+/**
+ * Convert len pixels in src to temperatures in dst
+ */
+void temp_frame_to_temp(const temp_conv_t* conv, const uint16_t* src, float* dst, int len)
+{
+	float scale = conv->scale;
+	float offset = conv->offset;
+
+	while (len--) {
+		*dst++ = (float) *src++ * scale + offset;
+	}
+}
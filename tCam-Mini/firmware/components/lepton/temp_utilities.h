@@ -0,0 +1,74 @@
+/*
+ * Radiometric temperature conversion
+ *
+ * Converts Lepton TLinear pixel counts to temperatures in degrees C, F or K for
+ * both TLinear resolutions.  The linear conversion coefficients for a resolution
+ * and unit are computed once when either changes and then applied to individual
+ * values or to a whole frame.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef TEMP_UTILITIES_H
+#define TEMP_UTILITIES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Temp Utilities Constants
+//
+
+// TLinear resolution
+#define TEMP_RES_LOW       0
+#define TEMP_RES_HIGH      1
+
+// Temperature units
+#define TEMP_UNIT_C        0
+#define TEMP_UNIT_F        1
+#define TEMP_UNIT_K        2
+
+
+
+//
+// Temp Utilities typedefs
+//
+
+// Conversion for one resolution and unit: temp = counts * scale + offset
+typedef struct {
+	int res;
+	int unit;
+	float scale;
+	float offset;
+} temp_conv_t;
+
+
+
+//
+// Temp Utilities API
+//
+void temp_conv_init(temp_conv_t* conv, int res, int unit);
+bool temp_conv_set(temp_conv_t* conv, int res, int unit);
+int temp_get_res(uint16_t* telem);
+float temp_counts_to_temp(const temp_conv_t* conv, float counts);
+float temp_delta_to_temp(const temp_conv_t* conv, float delta_counts);
+uint16_t temp_temp_to_counts(const temp_conv_t* conv, float t);
+void temp_frame_to_temp(const temp_conv_t* conv, const uint16_t* src, float* dst, int len);
+
+#endif /* TEMP_UTILITIES_H */
@@ -0,0 +1,261 @@
+/*
+ * Performance accounting
+ *
+ * Counts images as they move through the camera and keeps latency statistics and
+ * histograms for each processing stage along with heap and task CPU usage so the
+ * pipeline can be monitored without rebuilding the firmware with debug logging.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "perf_utilities.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <string.h>
+
+
+
+//
+// Perf Utilities internal constants
+//
+
+// Task CPU usage requires the FreeRTOS trace facility and run time statistics
+#if (configUSE_TRACE_FACILITY == 1) && (configGENERATE_RUN_TIME_STATS == 1)
+#define PERF_TASK_STATS
+#endif
+
+
+
+//
+// Perf Utilities external variables
+//
+const char* perf_counter_names[PERF_NUM_COUNTERS] = {
+	"produced",
+	"encoded",
+	"sent",
+	"resync",
+	"drop_busy",
+	"drop_abort"
+};
+
+const char* perf_stage_names[PERF_NUM_STAGES] = {
+	"capture",
+	"encode",
+	"send",
+	"stall",
+	"total"
+};
+
+const uint32_t perf_hist_limits[PERF_HIST_BINS-1] = {
+	500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000
+};
+
+
+
+//
+// Perf Utilities variables
+//
+static const char* TAG = "perf_utilities";
+
+static SemaphoreHandle_t perf_mutex;
+
+static perf_stats_t perf_stats;
+
+#ifdef PERF_TASK_STATS
+// Task run time samples - the previous sample is the baseline for the next
+static TaskStatus_t* perf_task_prev;
+static TaskStatus_t* perf_task_cur;
+static UBaseType_t perf_task_prev_num;
+static uint32_t perf_task_prev_time;
+#endif
+
+
+
+//
+// Perf Utilities API
+//
+
+bool perf_init()
+{
+	perf_mutex = xSemaphoreCreateMutex();
+	if (perf_mutex == NULL) {
+		ESP_LOGE(TAG, "create perf_mutex failed");
+		return false;
+	}
+	
+#ifdef PERF_TASK_STATS
+	perf_task_prev = heap_caps_malloc(sizeof(TaskStatus_t) * PERF_MAX_TASKS, MALLOC_CAP_SPIRAM);
+	perf_task_cur = heap_caps_malloc(sizeof(TaskStatus_t) * PERF_MAX_TASKS, MALLOC_CAP_SPIRAM);
+	if ((perf_task_prev == NULL) || (perf_task_cur == NULL)) {
+		ESP_LOGE(TAG, "malloc task sample arrays failed");
+		return false;
+	}
+#endif
+	
+	perf_reset();
+	
+	return true;
+}
+
+
+/**
+ * Clear all counters and statistics and restart task CPU usage sampling
+ */
+void perf_reset()
+{
+	int i;
+	
+	xSemaphoreTake(perf_mutex, portMAX_DELAY);
+	memset(&perf_stats, 0, sizeof(perf_stats_t));
+	for (i=0; i<PERF_NUM_STAGES; i++) {
+		perf_stats.stage[i].min_usec = UINT32_MAX;
+	}
+	perf_stats.start_usec = esp_timer_get_time();
+#ifdef PERF_TASK_STATS
+	perf_task_prev_num = uxTaskGetSystemState(perf_task_prev, PERF_MAX_TASKS, &perf_task_prev_time);
+#endif
+	xSemaphoreGive(perf_mutex);
+}
+
+
+void perf_count(int counter)
+{
+	if ((counter < 0) || (counter >= PERF_NUM_COUNTERS)) return;
+	
+	xSemaphoreTake(perf_mutex, portMAX_DELAY);
+	perf_stats.counter[counter]++;
+	xSemaphoreGive(perf_mutex);
+}
+
+
+/**
+ * Add a stage latency measurement
+ */
+void perf_record(int stage, uint32_t usec)
+{
+	int bin = 0;
+	perf_stage_t* sP;
+	
+	if ((stage < 0) || (stage >= PERF_NUM_STAGES)) return;
+	
+	while ((bin < (PERF_HIST_BINS-1)) && (usec > perf_hist_limits[bin])) {
+		bin++;
+	}
+	
+	sP = &perf_stats.stage[stage];
+	
+	xSemaphoreTake(perf_mutex, portMAX_DELAY);
+	sP->count++;
+	sP->sum_usec += usec;
+	if (usec < sP->min_usec) sP->min_usec = usec;
+	if (usec > sP->max_usec) sP->max_usec = usec;
+	sP->hist[bin]++;
+	xSemaphoreGive(perf_mutex);
+}
+
+
+/**
+ * Get a consistent copy of all statistics
+ */
+void perf_get(perf_stats_t* stats)
+{
+	xSemaphoreTake(perf_mutex, portMAX_DELAY);
+	*stats = perf_stats;
+	xSemaphoreGive(perf_mutex);
+}
+
+
+/**
+ * Return the average latency for a stage (uSec)
+ */
+uint32_t perf_stage_avg(const perf_stage_t* stage)
+{
+	if (stage->count == 0) return 0;
+	
+	return (uint32_t) (stage->sum_usec / stage->count);
+}
+
+
+/**
+ * Get the current heap free sizes and low watermarks.  Watermarks are kept by the
+ * heap allocator since boot and are not cleared by perf_reset.
+ */
+void perf_get_heap(perf_heap_t* heap)
+{
+	heap->int_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+	heap->int_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+	heap->int_largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+	heap->spiram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+	heap->spiram_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM);
+}
+
+
+/**
+ * Load up to max entries with each task's share of CPU time since the previous call
+ * (or reset) and its stack high water mark.  The FreeRTOS run time counter is a 32-bit
+ * uSec count so calls must be less than about 71 minutes apart for accurate results.
+ * Returns the number of entries loaded (0 if task statistics are not available).
+ */
+int perf_get_tasks(perf_task_t* tasks, int max)
+{
+	int n = 0;
+#ifdef PERF_TASK_STATS
+	int i, j;
+	uint32_t cur_time;
+	uint32_t task_time;
+	uint64_t total_time;
+	UBaseType_t cur_num;
+	TaskStatus_t* tP;
+	
+	xSemaphoreTake(perf_mutex, portMAX_DELAY);
+	cur_num = uxTaskGetSystemState(perf_task_cur, PERF_MAX_TASKS, &cur_time);
+	total_time = (uint64_t) (cur_time - perf_task_prev_time) * portNUM_PROCESSORS;
+	
+	for (i=0; (i<cur_num) && (n<max); i++) {
+		// Tasks created since the previous sample count their entire run time
+		task_time = perf_task_cur[i].ulRunTimeCounter;
+		for (j=0; j<perf_task_prev_num; j++) {
+			if (perf_task_prev[j].xHandle == perf_task_cur[i].xHandle) {
+				task_time -= perf_task_prev[j].ulRunTimeCounter;
+				break;
+			}
+		}
+		
+		strncpy(tasks[n].name, perf_task_cur[i].pcTaskName, PERF_TASK_NAME_LEN-1);
+		tasks[n].name[PERF_TASK_NAME_LEN-1] = 0;
+		tasks[n].cpu_permille = (total_time == 0) ? 0 : (uint32_t) (((uint64_t) task_time * 1000) / total_time);
+		tasks[n].stack_min = perf_task_cur[i].usStackHighWaterMark;
+		n++;
+	}
+	
+	// The current sample becomes the baseline for the next call
+	tP = perf_task_prev;
+	perf_task_prev = perf_task_cur;
+	perf_task_cur = tP;
+	perf_task_prev_num = cur_num;
+	perf_task_prev_time = cur_time;
+	xSemaphoreGive(perf_mutex);
+#endif
+	
+	return n;
+}
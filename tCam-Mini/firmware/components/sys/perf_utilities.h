@@ -0,0 +1,118 @@
+/*
+ * Performance accounting
+ *
+ * Counts images as they move through the camera and keeps latency statistics and
+ * histograms for each processing stage along with heap and task CPU usage so the
+ * pipeline can be monitored without rebuilding the firmware with debug logging.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef PERF_UTILITIES_H
+#define PERF_UTILITIES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Perf Utilities Constants
+//
+
+// Image counters
+#define PERF_CNT_PRODUCED       0    // Frames read from the Lepton
+#define PERF_CNT_ENCODED        1    // Images converted into a json or binary response
+#define PERF_CNT_SENT           2    // Images completely sent to the host
+#define PERF_CNT_RESYNC         3    // VoSPI resynchronizations (no frame for 36 vsyncs)
+#define PERF_CNT_DROP_BUSY      4    // Images not sent because the SPI slave or UDP socket was busy
+#define PERF_CNT_DROP_ABORT     5    // Images abandoned part way through because of a socket error
+#define PERF_NUM_COUNTERS       6
+
+// Processing stages
+#define PERF_STAGE_CAPTURE      0    // Final VoSPI segment through filtering into the shared buffer
+#define PERF_STAGE_ENCODE       1    // Image conversion into a json or binary response
+#define PERF_STAGE_SEND         2    // Image write to the socket or SPI slave
+#define PERF_STAGE_STALL        3    // Time an image waited for room in the socket send buffer
+#define PERF_STAGE_TOTAL        4    // Image handed to rsp_task until completely sent
+#define PERF_NUM_STAGES         5
+
+// Latency histogram bins.  The upper limit of each bin (uSec) is in perf_hist_limits,
+// the last bin holds everything larger.
+#define PERF_HIST_BINS          10
+
+// Task statistics
+#define PERF_MAX_TASKS          24
+#define PERF_TASK_NAME_LEN      16
+
+
+
+//
+// Perf Utilities typedefs
+//
+typedef struct {
+	uint32_t count;
+	uint32_t min_usec;
+	uint32_t max_usec;
+	uint64_t sum_usec;
+	uint32_t hist[PERF_HIST_BINS];
+} perf_stage_t;
+
+typedef struct {
+	int64_t start_usec;                      // Time statistics were last reset
+	uint32_t counter[PERF_NUM_COUNTERS];
+	perf_stage_t stage[PERF_NUM_STAGES];
+} perf_stats_t;
+
+typedef struct {
+	uint32_t int_free;                       // Internal heap bytes free
+	uint32_t int_min_free;                   // Internal heap low watermark since boot
+	uint32_t int_largest;                    // Largest allocatable internal block
+	uint32_t spiram_free;                    // PSRAM heap bytes free
+	uint32_t spiram_min_free;                // PSRAM heap low watermark since boot
+} perf_heap_t;
+
+typedef struct {
+	char name[PERF_TASK_NAME_LEN];
+	uint32_t cpu_permille;                   // Share of total CPU time (both cores) since last sampled
+	uint32_t stack_min;                      // Stack high water mark (minimum bytes free)
+} perf_task_t;
+
+
+
+//
+// Perf Utilities external variables
+//
+extern const char* perf_counter_names[PERF_NUM_COUNTERS];
+extern const char* perf_stage_names[PERF_NUM_STAGES];
+extern const uint32_t perf_hist_limits[PERF_HIST_BINS-1];
+
+
+
+//
+// Perf Utilities API
+//
+bool perf_init();
+void perf_reset();
+void perf_count(int counter);
+void perf_record(int stage, uint32_t usec);
+void perf_get(perf_stats_t* stats);
+uint32_t perf_stage_avg(const perf_stage_t* stage);
+void perf_get_heap(perf_heap_t* heap);
+int perf_get_tasks(perf_task_t* tasks, int max);
+
+#endif /* PERF_UTILITIES_H */
@@ -115,11 +115,13 @@ static const char* TAG = "ps_utilities";
 static const char* lep_info_key = "lep_state";
 static const char* wifi_info_key = "wifi_info";
 static const char* eth_info_key = "eth_info";
+static const char* lep_init_crc_key = "lep_init_crc";
 
 // Local copies
 static ps_lep_state_t ps_lep_state;
 static ps_net_info_t ps_wifi_info;
 static ps_net_info_t ps_eth_info;
+static uint32_t ps_lep_init_crc;
 
 
 // NVS namespace handle
@@ -222,6 +224,15 @@ bool ps_init(int brd, int iface)
 		success &= ps_read_lep_info();
 	}
 	
+	// Last verified Lepton init configuration CRC (0 = none, not an error if missing)
+	err = nvs_get_u32(ps_handle, lep_init_crc_key, &ps_lep_init_crc);
+	if (err != ESP_OK) {
+		if (err != ESP_ERR_NVS_NOT_FOUND) {
+			ESP_LOGE(TAG, "NVS get_u32 lep init crc failed with err %d", err);
+		}
+		ps_lep_init_crc = 0;
+	}
+	
 	// WiFi Info (common to both board types)
 	err = nvs_get_blob(ps_handle, wifi_info_key, NULL, &required_size);
 	if ((err != ESP_OK) && (err != ESP_ERR_NVS_NOT_FOUND)) {
@@ -312,6 +323,39 @@ void ps_set_lep_state(const json_config_t* state)
 }
 
 
+/**
+ * Return the CRC of the last Lepton init configuration that was written and
+ * verified by reading back.  Returns 0 if there is none.
+ */
+uint32_t ps_get_lep_init_crc()
+{
+	return ps_lep_init_crc;
+}
+
+
+/**
+ * Store the CRC of a verified Lepton init configuration (0 invalidates it).  This
+ * describes the camera state rather than user configuration so it is stored in all
+ * interface modes.  NVS is only written when the value changes.
+ */
+void ps_set_lep_init_crc(uint32_t crc)
+{
+	esp_err_t err;
+	
+	if (crc != ps_lep_init_crc) {
+		ps_lep_init_crc = crc;
+		
+		err = nvs_set_u32(ps_handle, lep_init_crc_key, crc);
+		if (err == ESP_OK) {
+			err = nvs_commit(ps_handle);
+		}
+		if (err != ESP_OK) {
+			ESP_LOGE(TAG, "Failed to save lep init crc to NVS Storage - %d", err);
+		}
+	}
+}
+
+
 void ps_get_net_info(net_info_t* info)
 {
 	int i;
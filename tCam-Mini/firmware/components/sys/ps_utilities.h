@@ -58,6 +58,8 @@
 bool ps_init(int brd, int iface);
 void ps_get_lep_state(json_config_t* state);
 void ps_set_lep_state(const json_config_t* state);
+uint32_t ps_get_lep_init_crc();
+void ps_set_lep_init_crc(uint32_t crc);
 void ps_get_net_info(net_info_t* info);
 void ps_set_net_info(const net_info_t* info);
 bool ps_reinit_net();
@@ -34,6 +34,10 @@
 #include "json_utilities.h"
 #include "net_utilities.h"
 #include "ps_utilities.h"
+#include "alarm_utilities.h"
+#include "filter_utilities.h"
+#include "perf_utilities.h"
+#include "roi_utilities.h"
 #include "sys_utilities.h"
 #include "time_utilities.h"
 #include "i2c.h"
@@ -79,11 +83,13 @@ json_config_t lep_st;
 
 // Shared memory data structures
 lep_buffer_t rsp_lep_buffer[2];   // Ping-pong buffer loaded by lep_task for rsp_task
+lep_buffer_t rsp_filt_buffer[2];  // Stream filtered copy of rsp_lep_buffer images
+bool rsp_filt_valid[2];           // Set when rsp_filt_buffer holds the current image
 
 // Big buffers
 char* rx_circular_buffer;                          // Used by cmd_utilities for incoming json data
 char* json_cmd_string;                             // Used by cmd_utilities to hold a parsed incoming json command
-json_image_string_t sys_image_rsp_buffer;          // Used by rsp_task for json formatted image data
+image_rsp_t sys_image_rsp_buffer;                  // Used by rsp_task for json formatted image data
 json_cmd_response_queue_t sys_cmd_response_buffer; // Loaded by cmd_task with json formatted response data
 
 // Firmware update segment (located in internal DRAM)
@@ -221,6 +227,8 @@ bool system_peripheral_init(int brd_type, int if_mode)
  */
 bool system_buffer_init()
 {
+	int i;
+	
 	ESP_LOGI(TAG, "Buffer Allocation");
 	
 	// Allocate the LEP/RSP task lepton frame and telemetry ping-pong buffers
@@ -257,12 +265,49 @@ bool system_buffer_init()
 		return false;
 	}
 	
+	// Allocate the stream filtered images.  They share the telemetry and mutex of
+	// the corresponding rsp_lep_buffer.
+	for (i=0; i<2; i++) {
+		rsp_filt_buffer[i].lep_bufferP = heap_caps_malloc(LEP_NUM_PIXELS*2, MALLOC_CAP_SPIRAM);
+		if (rsp_filt_buffer[i].lep_bufferP == NULL) {
+			ESP_LOGE(TAG, "malloc RSP lepton filtered image buffer %d failed", i);
+			return false;
+		}
+		rsp_filt_buffer[i].lep_telemP = rsp_lep_buffer[i].lep_telemP;
+		rsp_filt_buffer[i].lep_mutex = rsp_lep_buffer[i].lep_mutex;
+		rsp_filt_valid[i] = false;
+	}
+	
 	// Allocate the json buffers
 	if (!json_init()) {
 		ESP_LOGE(TAG, "malloc json buffers failed");
 		return false;
 	}
 	
+	// Allocate the region of interest statistics buffers
+	if (!roi_init()) {
+		ESP_LOGE(TAG, "malloc roi buffers failed");
+		return false;
+	}
+	
+	// Initialize the temperature alarm rules
+	if (!alarm_init()) {
+		ESP_LOGE(TAG, "alarm initialization failed");
+		return false;
+	}
+	
+	// Initialize the temporal noise filter
+	if (!filter_init()) {
+		ESP_LOGE(TAG, "filter initialization failed");
+		return false;
+	}
+	
+	// Initialize performance accounting
+	if (!perf_init()) {
+		ESP_LOGE(TAG, "perf initialization failed");
+		return false;
+	}
+	
 	// Allocate the incoming command buffers
 	rx_circular_buffer = heap_caps_malloc(JSON_MAX_CMD_TEXT_LEN, MALLOC_CAP_SPIRAM);
 	if (rx_circular_buffer == NULL) {
@@ -286,8 +331,9 @@ bool system_buffer_init()
 	sys_cmd_response_buffer.popP = sys_cmd_response_buffer.bufferP;
 	sys_cmd_response_buffer.length = 0;
 	
-	// Allocate the json image text buffer in DMA capable internal memory           
-	sys_image_rsp_buffer.bufferP = heap_caps_malloc(JSON_MAX_IMAGE_TEXT_LEN, MALLOC_CAP_DMA);
+	// Allocate the json image text buffer in DMA capable internal memory (with room for
+	// the header and trailer segments)
+	sys_image_rsp_buffer.bufferP = heap_caps_malloc(JSON_MAX_IMAGE_TEXT_LEN + IMG_RSP_MAX_HDR_LEN + IMG_RSP_MAX_TRL_LEN, MALLOC_CAP_DMA);
 	if (sys_image_rsp_buffer.bufferP == NULL) {
 		ESP_LOGE(TAG, "malloc shared json image text response buffer failed");
 		return false;
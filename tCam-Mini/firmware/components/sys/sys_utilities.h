@@ -42,6 +42,11 @@
 #define SYS_GAIN_LOW  1
 #define SYS_GAIN_AUTO 2
 
+// Image response header and trailer segment sizes.  The trailer holds the json stop
+// delimiter and, for the SPI interface, a 4-byte checksum and up to 3 bytes of padding.
+#define IMG_RSP_MAX_HDR_LEN 4
+#define IMG_RSP_MAX_TRL_LEN 8
+
 
 
 //
@@ -56,10 +61,18 @@ typedef struct {
 	SemaphoreHandle_t lep_mutex;
 } lep_buffer_t;
 
+// Image response sent as separate header, payload and trailer segments so the encoded
+// image is never moved to add framing.  bufferP has room for the header before and the
+// trailer after the payload so the segments can be joined in place for the SPI slave.
 typedef struct {
-	uint32_t length;
+	uint32_t hdr_length;
+	uint32_t length;          // Payload length
+	uint32_t trl_length;
+	char hdr[IMG_RSP_MAX_HDR_LEN];
+	char trl[IMG_RSP_MAX_TRL_LEN];
+	char* payloadP;           // bufferP + hdr_length
 	char* bufferP;
-} json_image_string_t;
+} image_rsp_t;
 
 typedef struct {
 	int length;
@@ -108,11 +121,13 @@ extern json_config_t lep_st;
 
 // Shared memory data structures
 extern lep_buffer_t rsp_lep_buffer[2];   // Ping-pong buffer loaded by lep_task for rsp_task
+extern lep_buffer_t rsp_filt_buffer[2];  // Stream filtered copy of rsp_lep_buffer images
+extern bool rsp_filt_valid[2];           // Set when rsp_filt_buffer holds the current image
 
 // Big buffers
 extern char* rx_circular_buffer;                          // Used by cmd_utilities for incoming json data
 extern char* json_cmd_string;                             // Used by cmd_utilities to hold a parsed incoming json command
-extern json_image_string_t sys_image_rsp_buffer;          // Used by rsp_task for json formatted image data
+extern image_rsp_t sys_image_rsp_buffer;                  // Used by rsp_task for json formatted image data
 extern json_cmd_response_queue_t sys_cmd_response_buffer; // Loaded by cmd_task with json formatted response data
 
 // Firmware update segment
@@ -34,8 +34,11 @@
 #include "freertos/task.h"
 #include "lep_task.h"
 #include "rsp_task.h"
+#include "alarm_utilities.h"
+#include "filter_utilities.h"
 #include "lepton_utilities.h"
 #include "cci.h"
+#include "perf_utilities.h"
 #include "vospi.h"
 #include "sys_utilities.h"
 #include "system_config.h"
@@ -63,6 +66,8 @@ static const char* TAG = "lep_task";
 static int lep_brd_type;
 static int lep_if_type;
 
+static alarm_event_t alarm_events[ALARM_MAX_RULES];
+
 
 
 //
@@ -82,6 +87,9 @@ void lep_task()
 	int vsync_count = 0;
 	int sync_fail_count = 0;
 	int reset_fail_count = 0;
+	int num_alarm_events;
+	int min_index, max_index;
+	int i;
 	int64_t vsyncDetectedUsec;
 	
 	ESP_LOGI(TAG, "Start task");
@@ -138,7 +146,25 @@ void lep_task()
 					// Copy the frame to the current half of the shared buffer and let rsp_task know
 					xSemaphoreTake(rsp_lep_buffer[rsp_buf_index].lep_mutex, portMAX_DELAY);
 					vospi_get_frame(&rsp_lep_buffer[rsp_buf_index]);
+					num_alarm_events = alarm_eval(&rsp_lep_buffer[rsp_buf_index], alarm_events);
+					
+					// Optionally reduce temporal noise in a copy of the image for streaming.  Alarms,
+					// roi_stats and get_image use the unfiltered data.
+					rsp_filt_valid[rsp_buf_index] = filter_apply_copy(FILTER_CONSUMER_STREAM, rsp_lep_buffer[rsp_buf_index].lep_bufferP,
+					                                                  rsp_filt_buffer[rsp_buf_index].lep_bufferP, &min_index, &max_index);
+					if (rsp_filt_valid[rsp_buf_index]) {
+						rsp_filt_buffer[rsp_buf_index].telem_valid = rsp_lep_buffer[rsp_buf_index].telem_valid;
+						rsp_filt_buffer[rsp_buf_index].lep_min_val = rsp_filt_buffer[rsp_buf_index].lep_bufferP[min_index];
+						rsp_filt_buffer[rsp_buf_index].lep_max_val = rsp_filt_buffer[rsp_buf_index].lep_bufferP[max_index];
+					}
 					xSemaphoreGive(rsp_lep_buffer[rsp_buf_index].lep_mutex);
+					perf_count(PERF_CNT_PRODUCED);
+					perf_record(PERF_STAGE_CAPTURE, (uint32_t) (esp_timer_get_time() - vsyncDetectedUsec));
+					
+					// Report any alarm state transitions
+					for (i=0; i<num_alarm_events; i++) {
+						rsp_set_alarm_msg(&alarm_events[i]);
+					}
 #ifdef LOG_ACQ_TIMESTAMP
 					ESP_LOGI(TAG, "Push into buf %d", rsp_buf_index);
 #endif
@@ -168,6 +194,10 @@ void lep_task()
 					if (++vsync_count == 36) {
 						vsync_count = 0;
 						ESP_LOGI(TAG, "Could not get lepton image");
+						perf_count(PERF_CNT_RESYNC);
+						
+						// Images are lost so the stream filter restarts with the next one
+						filter_reset(FILTER_CONSUMER_STREAM);
 						
 						// Pause to allow resynchronization
 						// (Lepton 3.5 data sheet section 4.2.3.3.1 "Establishing/Re-Establishing Sync")
@@ -30,6 +30,8 @@
 #include "rsp_task.h"
 #include "cmd_utilities.h"
 #include "json_utilities.h"
+#include "perf_utilities.h"
+#include "roi_utilities.h"
 #include "sif_utilities.h"
 #include "sys_utilities.h"
 #include "upd_utilities.h"
@@ -61,6 +63,18 @@
 #define FW_UPD_REQUEST 1
 #define FW_UPD_PROCESS 2
 
+// Maximum socket write size
+#define RSP_MAX_TX_PKT_LEN CONFIG_LWIP_TCP_SND_BUF_DEFAULT
+
+// Maximum segments in a response (image response header, payload and trailer)
+#define RSP_TX_MAX_SEGS 3
+
+// Responses at least this long are used to compute transmit throughput (images)
+#define RSP_TX_RATE_MIN_LEN 10000
+
+// UDP fragment header magic "TCUF" (little-endian)
+#define RSP_UDP_MAGIC 0x46554354
+
 
 
 //
@@ -73,6 +87,8 @@ static bool connected;
 static bool stream_on;
 static bool image_pending;
 static bool got_image_0, got_image_1;
+static bool roi_pending;                        // Send a single roi_stats record for the next image
+static int64_t image_ready_usec;                // Time the image being sent was handed to us
 
 // Stream rate/duration control
 static uint32_t next_stream_frame_delay_msec;   // mSec between images; 0 = fast as possible
@@ -81,6 +97,32 @@ static uint32_t next_stream_frame_num;          // Number of frames to stream; 0
 static uint32_t cur_stream_frame_num;
 static uint32_t stream_remaining_frames;        // Remaining frames to stream
 static int64_t stream_ready_usec;               // Next ESP32 uSec timestamp to send image
+static bool next_stream_binary;                 // Host requested binary SPI image frames
+static bool cur_stream_binary;
+static bool next_stream_roi_stats;              // Host requested roi_stats records instead of images
+static bool cur_stream_roi_stats;
+static bool next_stream_udp;                    // Host requested images be streamed over UDP
+static bool cur_stream_udp;
+static uint8_t next_udp_addr[4];                // Stored like net_info_t addresses
+static uint16_t next_udp_port;
+
+// UDP streaming
+static int udp_sock = -1;
+static struct sockaddr_in udp_dest_addr;
+static uint32_t udp_frame_num;
+static uint32_t udp_hdr_buffer[RSP_UDP_HDR_LEN / 4];
+
+// Performance record control
+static bool perf_pending;                       // Send a perf record when nothing else is being sent
+static bool perf_reset_pending;                 // Clear statistics after the pending perf record
+static uint32_t next_perf_push_msec;            // mSec between periodic perf records; 0 = off
+static bool next_perf_reset;
+static uint32_t perf_push_msec;
+static bool perf_push_reset;                    // Clear statistics after each periodic perf record
+static int64_t perf_push_usec;                  // Next ESP32 uSec timestamp to push a perf record
+
+// Region of interest statistics for the current image
+static roi_stats_t roi_stats[ROI_MAX_REGIONS];
 
 // cam_info json string temporary buffer
 static SemaphoreHandle_t cam_info_mutex;
@@ -89,10 +131,27 @@ static char cam_info_string[JSON_MAX_RSP_TEXT_LEN];
 // Command Response buffer (holds single responses from the cmd_task)
 static char cmd_task_response_buffer[JSON_MAX_RSP_TEXT_LEN];
 
+// Network transmit state (one response at a time so responses are not interleaved on the socket)
+static bool tx_in_progress;
+static bool tx_stalled;                         // Last write found the send buffer full
+static bool tx_image;                           // Sending sys_image_rsp_buffer
+static struct iovec tx_segs[RSP_TX_MAX_SEGS];
+static int tx_num_segs;
+static int tx_length;
+static int tx_offset;
+static int tx_sock;                             // Socket configured for transmit
+static int64_t tx_start_usec;
+static int64_t tx_stall_start_usec;
+static uint32_t tx_msg_stall_usec;
+
+// Network transmit statistics
+static SemaphoreHandle_t tx_stats_mutex;
+static rsp_tx_stats_t tx_stats;
+
 // Firmware update control
 static char fw_update_version[UPD_MAX_VER_LEN+1];
 static int fw_update_state;
-static int fw_update_wait_timer;                // Counts down eval intervals waiting for some operation
+static int64_t fw_update_timeout_usec;         // ESP32 uSec timestamp when the current wait times out
 static int fw_req_length;
 static int fw_req_attempt_num;
 static int fw_cur_loc;
@@ -107,13 +166,26 @@ static int fw_seg_length;
 static void init_state();
 static void eval_stream_ready();
 static void handle_notifications();
-static int process_image(int n);
+static int process_image(int n, bool binary);
+static int process_roi_stats(int n);
+static int process_perf();
 static void send_response(char* rsp, int len, bool ser_mode);
+static void send_net_image(image_rsp_t* img);
+static int image_rsp_segments(image_rsp_t* img, struct iovec* segs);
+static int load_iov(struct iovec* iov, struct iovec* segs, int num_segs, int offset, int max_len);
+static void tx_start(struct iovec* segs, int num_segs, bool image);
+static void tx_progress();
+static void tx_wait(int msec);
+static void tx_end(bool success);
 static bool cmd_response_available();
 static int get_cmd_response();
 static char pop_cmd_response_buffer();
-static void send_spi_image(char* rsp, int rsp_length);
+static void send_spi_image(image_rsp_t* img);
+static bool udp_setup();
+static void udp_close();
+static bool send_udp_image(image_rsp_t* img);
 static void send_get_fw();
+static void push_cam_info_string(int len);
 
 
 
@@ -122,6 +194,8 @@ static void send_get_fw();
 //
 void rsp_task()
 {
+	bool binary;
+	bool stats;
 	int len;
 	int brd_type;
 	int if_type;
@@ -136,6 +210,7 @@ void rsp_task()
 	ctrl_get_if_mode(&brd_type, &if_type);
 	
 	cam_info_mutex = xSemaphoreCreateMutex();
+	tx_stats_mutex = xSemaphoreCreateMutex();
 	
 	//
 	// Task loop
@@ -162,33 +237,80 @@ void rsp_task()
 			}
 		}
 		
-		// Look for things to send
-		if (got_image_0 || got_image_1) {
+		// Continue sending a network response
+		if (tx_in_progress) {
+			tx_progress();
+		}
+		
+		// Command responses are sent ahead of images.  A new network response is
+		// started only when the previous one has been completely sent.
+		if (!tx_in_progress && cmd_response_available()) {
+			// Get the command response and send it if possible
+			len = get_cmd_response();
+			if (connected && (len != 0)) {
+				send_response(cmd_task_response_buffer, len, (if_type == CTRL_IF_MODE_SIF));
+			}
+		}
+		
+		// Performance records are sent on request or periodically
+		if (connected && (perf_push_msec != 0) && (esp_timer_get_time() >= perf_push_usec)) {
+			perf_push_usec = esp_timer_get_time() + (int64_t) perf_push_msec * 1000;
+			perf_pending = true;
+			perf_reset_pending = perf_push_reset;
+		}
+		if (!tx_in_progress && perf_pending) {
+			perf_pending = false;
+			len = process_perf();
+			if (connected && (len != 0)) {
+				send_response(cmd_task_response_buffer, len, (if_type == CTRL_IF_MODE_SIF));
+			}
+		}
+		
+		// Look for an image to send
+		if (!tx_in_progress && (got_image_0 || got_image_1)) {
 			if (connected) {
+				// The host may request only region of interest statistics instead of images
+				stats = roi_pending || (stream_on && cur_stream_roi_stats);
+				
+				// The host may request binary image frames for the SPI interface or UDP while streaming
+				binary = ((if_type == CTRL_IF_MODE_SIF) || cur_stream_udp) && stream_on && cur_stream_binary;
+				
 				if (got_image_0) {
-					len = process_image(0);
+					len = stats ? process_roi_stats(0) : process_image(0, binary);
 					got_image_0 = false;
 #ifdef LOG_IMG_TIMESTAMP
 					ESP_LOGI(TAG, "process image 0");
 #endif
 				} else {
-					len = process_image(1);
+					len = stats ? process_roi_stats(1) : process_image(1, binary);
 					got_image_1 = false;
 #ifdef LOG_IMG_TIMESTAMP
 					ESP_LOGI(TAG, "process image 1");
 #endif
 				}	
-					
-				// Send the image
-				if (len != 0) {
+				
+				if (stats) {
+					// Send the roi_stats record like a command response
+					roi_pending = false;
+					if (len != 0) {
+						send_response(cmd_task_response_buffer, len, (if_type == CTRL_IF_MODE_SIF));
+					}
+				} else if (len != 0) {
+					// Send the image
 					if (if_type == CTRL_IF_MODE_SIF) {
 						// Configure a SPI slave response if the slave is available,
 						// otherwise drop the response
 						if (!system_spi_slave_busy()) {
-							send_spi_image(sys_image_rsp_buffer.bufferP, sys_image_rsp_buffer.length);
+							send_spi_image(&sys_image_rsp_buffer);
+						} else {
+							perf_count(PERF_CNT_DROP_BUSY);
+						}
+					} else if (stream_on && cur_stream_udp) {
+						if (!send_udp_image(&sys_image_rsp_buffer)) {
+							perf_count(PERF_CNT_DROP_BUSY);
 						}
 					} else {
-						send_response(sys_image_rsp_buffer.bufferP, sys_image_rsp_buffer.length, false);
+						send_net_image(&sys_image_rsp_buffer);
 					}
 				}
 				
@@ -201,17 +323,9 @@ void rsp_task()
 			}
 		}
 		
-		if (cmd_response_available()) {
-			// Get the command response and send it if possible
-			len = get_cmd_response();
-			if (connected && (len != 0)) {
-				send_response(cmd_task_response_buffer, len, (if_type == CTRL_IF_MODE_SIF));
-			}
-		}
-		
 		if (fw_update_state != FW_UPD_IDLE) {
 			// Look for timeout
-			if (--fw_update_wait_timer == 0) {
+			if (esp_timer_get_time() >= fw_update_timeout_usec) {
 				if (fw_update_state == FW_UPD_REQUEST) {
 					// Request timed out without user confirming to start
 					xTaskNotify(task_handle_ctrl, CTRL_NOTIFY_FW_UPD_DONE, eSetBits);
@@ -222,7 +336,7 @@ void rsp_task()
 					if (++fw_req_attempt_num < FW_REQ_MAX_ATTEMPTS) {
 						// Request the segment again
 						send_get_fw();
-						fw_update_wait_timer = RSP_MAX_FW_UPD_GET_WAIT_MSEC / RSP_TASK_EVAL_NORM_MSEC;
+						fw_update_timeout_usec = esp_timer_get_time() + (int64_t) RSP_MAX_FW_UPD_GET_WAIT_MSEC * 1000;
 						ESP_LOGI(TAG, "Retry chunk request");
 					} else {
 						// Give up
@@ -236,8 +350,11 @@ void rsp_task()
 			}
 		}
 		
-		// Sleep task - less if we are streaming
-		if (stream_on) {
+		// Sleep task - until there is room to send more if a response is in progress,
+		// less if we are streaming
+		if (tx_in_progress) {
+			tx_wait(RSP_TX_WAIT_MSEC);
+		} else if (stream_on) {
 			vTaskDelay(pdMS_TO_TICKS(RSP_TASK_EVAL_FAST_MSEC));
 		} else {
 			vTaskDelay(pdMS_TO_TICKS(RSP_TASK_EVAL_NORM_MSEC));
@@ -247,42 +364,45 @@ void rsp_task()
 
 
 // Called before sending RSP_NOTIFY_CMD_STREAM_ON_MASK
-void rsp_set_stream_parameters(uint32_t delay_ms, uint32_t num_frames)
+void rsp_set_stream_parameters(uint32_t delay_ms, uint32_t num_frames, bool binary, bool roi_stats, bool udp, uint8_t* udp_addr, uint16_t udp_port)
 {
+	int i;
+	
 	next_stream_frame_delay_msec = delay_ms;
 	next_stream_frame_num = num_frames;
+	next_stream_binary = binary;
+	next_stream_roi_stats = roi_stats;
+	next_stream_udp = udp;
+	if (udp) {
+		for (i=0; i<4; i++) next_udp_addr[i] = udp_addr[i];
+		next_udp_port = udp_port;
+	}
 }
 
 
 void rsp_set_cam_info_msg(uint32_t info_value, char* info_string)
 {
-	int i;
 	int len;
 	
 	xSemaphoreTake(cam_info_mutex, portMAX_DELAY);
 	
 	// Create the cam_info json string
 	len = json_get_cam_info(cam_info_string, info_value, info_string);
+	push_cam_info_string(len);
 	
-	// Atomically load cmd_task_response_buffer
-	xSemaphoreTake(sys_cmd_response_buffer.mutex, portMAX_DELAY);
+	xSemaphoreGive(cam_info_mutex);
+}
+
+
+void rsp_set_alarm_msg(alarm_event_t* event)
+{
+	int len;
 	
-	// Only load if there's room for this response
-	if (len <= (CMD_RESPONSE_BUFFER_LEN - sys_cmd_response_buffer.length)) {
-		for (i=0; i<len; i++) {
-			// Push data
-			*sys_cmd_response_buffer.pushP = cam_info_string[i];
-			
-			// Increment push pointer
-			if (++sys_cmd_response_buffer.pushP >= (sys_cmd_response_buffer.bufferP + CMD_RESPONSE_BUFFER_LEN)) {
-				sys_cmd_response_buffer.pushP = sys_cmd_response_buffer.bufferP;
-			}
-		}
-		
-		sys_cmd_response_buffer.length += len;
-	}
+	xSemaphoreTake(cam_info_mutex, portMAX_DELAY);
 	
-	xSemaphoreGive(sys_cmd_response_buffer.mutex);
+	// Create the alarm json string
+	len = json_get_alarm_msg(cam_info_string, event);
+	push_cam_info_string(len);
 	
 	xSemaphoreGive(cam_info_mutex);
 }
@@ -305,6 +425,47 @@ void rsp_set_fw_upd_seg_info(uint32_t start, uint32_t length)
 
 
 
+// Called before sending RSP_NOTIFY_CMD_GET_PERF_MASK
+void rsp_set_perf_parameters(uint32_t push_msec, bool reset)
+{
+	if ((push_msec != 0) && (push_msec < RSP_PERF_MIN_PUSH_MSEC)) {
+		push_msec = RSP_PERF_MIN_PUSH_MSEC;
+	}
+	next_perf_push_msec = push_msec;
+	next_perf_reset = reset;
+}
+
+
+/**
+ * Get a copy of the network transmit statistics
+ */
+void rsp_get_tx_stats(rsp_tx_stats_t* stats)
+{
+	if (tx_stats_mutex == NULL) {
+		memset(stats, 0, sizeof(rsp_tx_stats_t));
+		return;
+	}
+	
+	xSemaphoreTake(tx_stats_mutex, portMAX_DELAY);
+	*stats = tx_stats;
+	xSemaphoreGive(tx_stats_mutex);
+}
+
+
+/**
+ * Clear the network transmit statistics
+ */
+void rsp_reset_tx_stats()
+{
+	if (tx_stats_mutex == NULL) return;
+	
+	xSemaphoreTake(tx_stats_mutex, portMAX_DELAY);
+	memset(&tx_stats, 0, sizeof(rsp_tx_stats_t));
+	xSemaphoreGive(tx_stats_mutex);
+}
+
+
+
 //
 // Internal functions
 //
@@ -318,11 +479,29 @@ static void init_state()
 	stream_on = false;
 	next_stream_frame_delay_msec = 0;
 	next_stream_frame_num = 0;
+	next_stream_binary = false;
+	cur_stream_binary = false;
+	next_stream_roi_stats = false;
+	cur_stream_roi_stats = false;
+	next_stream_udp = false;
+	cur_stream_udp = false;
 	image_pending = false;
+	roi_pending = false;
+	perf_pending = false;
+	perf_push_msec = 0;
 	got_image_0 = false;
 	got_image_1 = false;
 	fw_update_state = FW_UPD_IDLE;
 	
+	// Abandon any response being sent and configure the next connection's socket
+	if (tx_in_progress) {
+		tx_end(false);
+	}
+	tx_sock = -1;
+	
+	// UDP streaming ends with the connection that controls it
+	udp_close();
+	
 	// Flush the command response buffer
 	xSemaphoreTake(sys_cmd_response_buffer.mutex, portMAX_DELAY);
 	sys_cmd_response_buffer.length = 0;
@@ -364,6 +543,25 @@ static void handle_notifications()
 		if (Notification(notification_value, RSP_NOTIFY_CMD_GET_IMG_MASK)) {
 			// Note to process the next received image
 			image_pending = true;
+			roi_pending = false;
+			
+			// Stop any on-going streaming
+			stream_on = false;
+		}
+		
+		if (Notification(notification_value, RSP_NOTIFY_CMD_GET_PERF_MASK)) {
+			// Send a perf record now and then periodically if requested
+			perf_pending = true;
+			perf_reset_pending = next_perf_reset;
+			perf_push_msec = next_perf_push_msec;
+			perf_push_reset = next_perf_reset;
+			perf_push_usec = esp_timer_get_time() + (int64_t) perf_push_msec * 1000;
+		}
+		
+		if (Notification(notification_value, RSP_NOTIFY_CMD_GET_ROI_MASK)) {
+			// Note to compute region of interest statistics for the next received image
+			image_pending = true;
+			roi_pending = true;
 			
 			// Stop any on-going streaming
 			stream_on = false;
@@ -374,6 +572,19 @@ static void handle_notifications()
 			cur_stream_frame_delay_usec = next_stream_frame_delay_msec * 1000;
 			cur_stream_frame_num = next_stream_frame_num;
 			stream_remaining_frames = next_stream_frame_num;
+			cur_stream_binary = next_stream_binary;
+			cur_stream_roi_stats = next_stream_roi_stats;
+			
+			// Images are streamed over UDP if requested, otherwise fall back to the
+			// connection
+			cur_stream_udp = false;
+			if (next_stream_udp) {
+				if (udp_setup()) {
+					cur_stream_udp = true;
+				} else {
+					rsp_set_cam_info_msg(RSP_INFO_INT_ERROR, "Could not setup UDP stream");
+				}
+			}
 			
 			// First image is immediate
 			stream_ready_usec = esp_timer_get_time();
@@ -395,6 +606,7 @@ static void handle_notifications()
 			if (image_pending) {
 				got_image_0 = true;
 				image_pending = false;
+				image_ready_usec = esp_timer_get_time();
 			}
 		}
 		
@@ -402,6 +614,7 @@ static void handle_notifications()
 			if (image_pending) {
 				got_image_1 = true;
 				image_pending = false;
+				image_ready_usec = esp_timer_get_time();
 			}
 		}
 		
@@ -416,7 +629,7 @@ static void handle_notifications()
 			xTaskNotify(task_handle_ctrl, CTRL_NOTIFY_FW_UPD_REQ, eSetBits);
 			
 			// Set our state and a timer (for the user to allow the update)
-			fw_update_wait_timer = RSP_MAX_FW_UPD_REQ_WAIT_MSEC / RSP_TASK_EVAL_NORM_MSEC;
+			fw_update_timeout_usec = esp_timer_get_time() + (int64_t) RSP_MAX_FW_UPD_REQ_WAIT_MSEC * 1000;
 			fw_update_state = FW_UPD_REQUEST;
 			
 			ESP_LOGI(TAG, "Request update to v%s : %d bytes", fw_update_version, fw_req_length);
@@ -450,7 +663,7 @@ static void handle_notifications()
 							// Request the next segment
 							fw_req_attempt_num = 0;
 							send_get_fw();
-							fw_update_wait_timer = RSP_MAX_FW_UPD_GET_WAIT_MSEC / RSP_TASK_EVAL_NORM_MSEC;
+							fw_update_timeout_usec = esp_timer_get_time() + (int64_t) RSP_MAX_FW_UPD_GET_WAIT_MSEC * 1000;
 							ESP_LOGI(TAG, "Request fw chunk @ %d", fw_cur_loc);
 						}
 					} else {
@@ -477,7 +690,7 @@ static void handle_notifications()
 					fw_cur_loc = 0;
 					fw_req_attempt_num = 0;
 					send_get_fw();
-					fw_update_wait_timer = RSP_MAX_FW_UPD_GET_WAIT_MSEC / RSP_TASK_EVAL_NORM_MSEC;
+					fw_update_timeout_usec = esp_timer_get_time() + (int64_t) RSP_MAX_FW_UPD_GET_WAIT_MSEC * 1000;
 					fw_update_state = FW_UPD_PROCESS;
 					
 					ESP_LOGI(TAG, "Start update");
@@ -508,29 +721,65 @@ static void handle_notifications()
 
 /**
  * Convert lepton data in the specified half of the ping-pong buffer into a json record
- * with delimitors for transmission over the network
+ * with delimitor segments for transmission over the network or into a binary image frame
+ * for transmission over the SPI interface.  Streamed images use the stream filtered copy
+ * when the filter is running.  Returns the length of the image response.
  */
-static int process_image(int n)
+static int process_image(int n, bool binary)
 {
+	image_rsp_t* img = &sys_image_rsp_buffer;
+	lep_buffer_t* lep;
+	int64_t encode_start_usec;
 #ifdef LOG_PROC_TIMESTAMP
 	int64_t tb, te;
 	
 	tb = esp_timer_get_time();
 #endif
 	
-	// Convert the image into a json record
-	xSemaphoreTake(rsp_lep_buffer[n].lep_mutex, portMAX_DELAY);
-    sys_image_rsp_buffer.length = json_get_image_file_string(sys_image_rsp_buffer.bufferP+1, &rsp_lep_buffer[n]);
-    xSemaphoreGive(rsp_lep_buffer[n].lep_mutex);
-    
-    if ((sys_image_rsp_buffer.length > 0) && (sys_image_rsp_buffer.length < JSON_MAX_IMAGE_TEXT_LEN-2)) {
-        // Add the delimitors
-        *sys_image_rsp_buffer.bufferP = CMD_JSON_STRING_START;
-        *(sys_image_rsp_buffer.bufferP + sys_image_rsp_buffer.length + 1) = CMD_JSON_STRING_STOP;
-        sys_image_rsp_buffer.length = sys_image_rsp_buffer.length + 2;
-    } else {
-        ESP_LOGE(TAG, "Illegal image_json_text for sys_image_rsp_buffer (%d bytes)", sys_image_rsp_buffer.length);
-        sys_image_rsp_buffer.length = 0;
+	encode_start_usec = esp_timer_get_time();
+	
+	if (binary) {
+		// Binary frames carry their own framing
+		img->hdr_length = 0;
+		img->trl_length = 0;
+	} else {
+		// Json records are delimited by the header and trailer
+		img->hdr[0] = CMD_JSON_STRING_START;
+		img->hdr_length = 1;
+		img->trl[0] = CMD_JSON_STRING_STOP;
+		img->trl_length = 1;
+	}
+	
+	// The payload follows room for the header so the joined response starts at the
+	// (DMA aligned) start of the buffer
+	img->payloadP = img->bufferP + img->hdr_length;
+	
+	if (binary) {
+		// Load the image into a binary frame
+		xSemaphoreTake(rsp_lep_buffer[n].lep_mutex, portMAX_DELAY);
+		lep = (stream_on && rsp_filt_valid[n]) ? &rsp_filt_buffer[n] : &rsp_lep_buffer[n];
+		img->length = json_get_image_frame(img->payloadP, lep);
+		xSemaphoreGive(rsp_lep_buffer[n].lep_mutex);
+		
+		if (img->length == 0) {
+			ESP_LOGE(TAG, "Could not create binary image frame for sys_image_rsp_buffer");
+		}
+	} else {
+		// Convert the image into a json record
+		xSemaphoreTake(rsp_lep_buffer[n].lep_mutex, portMAX_DELAY);
+		lep = (stream_on && rsp_filt_valid[n]) ? &rsp_filt_buffer[n] : &rsp_lep_buffer[n];
+		img->length = json_get_image_file_string(img->payloadP, lep);
+		xSemaphoreGive(rsp_lep_buffer[n].lep_mutex);
+		
+		if ((img->length == 0) || (img->length >= JSON_MAX_IMAGE_TEXT_LEN)) {
+			ESP_LOGE(TAG, "Illegal image_json_text for sys_image_rsp_buffer (%d bytes)", img->length);
+			img->length = 0;
+		}
+	}
+	
+	if (img->length != 0) {
+		perf_count(PERF_CNT_ENCODED);
+		perf_record(PERF_STAGE_ENCODE, (uint32_t) (esp_timer_get_time() - encode_start_usec));
 	}
 	
 #ifdef LOG_PROC_TIMESTAMP
@@ -538,24 +787,57 @@ static int process_image(int n)
 	ESP_LOGI(TAG, "process_image took %d uSec", (int) (te - tb));
 #endif
 
-	return sys_image_rsp_buffer.length;
+	if (img->length == 0) return 0;
+	
+	return img->hdr_length + img->length + img->trl_length;
 }
 
 
 /**
- * Send a response
+ * Compute region of interest statistics for the lepton data in the specified half of
+ * the ping-pong buffer and load a roi_stats json record with delimiters into
+ * cmd_task_response_buffer
  */
-static void send_response(char* rsp, int rsp_length, bool ser_mode)
+static int process_roi_stats(int n)
+{
+	bool radiometric;
+	
+	xSemaphoreTake(rsp_lep_buffer[n].lep_mutex, portMAX_DELAY);
+	radiometric = roi_compute(&rsp_lep_buffer[n], roi_stats);
+	xSemaphoreGive(rsp_lep_buffer[n].lep_mutex);
+	
+	return json_get_roi_stats(cmd_task_response_buffer, radiometric, roi_stats);
+}
+
+
+/**
+ * Load a perf record with delimiters into cmd_task_response_buffer, clearing the
+ * statistics afterwards if requested
+ */
+static int process_perf()
 {
-	int byte_offset;
-	int err;
 	int len;
-	int sock;
-#ifdef LOG_SEND_TIMESTAMP
-	int64_t tb, te;
 	
-	tb = esp_timer_get_time();
-#endif
+	len = json_get_perf(cmd_task_response_buffer);
+	
+	if (perf_reset_pending) {
+		perf_reset_pending = false;
+		perf_reset();
+		rsp_reset_tx_stats();
+	}
+	
+	return len;
+}
+
+
+/**
+ * Send a response.  Serial responses are sent immediately.  Network responses are
+ * started here and completed by tx_progress() as room is available in the socket send
+ * buffer.
+ */
+static void send_response(char* rsp, int rsp_length, bool ser_mode)
+{
+	struct iovec seg;
 	
 	if (ser_mode) {
 #ifdef LOG_SIF_SEND
@@ -564,25 +846,229 @@ static void send_response(char* rsp, int rsp_length, bool ser_mode)
 #endif
 		sif_send(rsp, rsp_length);
 	} else {
-		sock = net_cmd_get_socket();
+		seg.iov_base = rsp;
+		seg.iov_len = rsp_length;
+		tx_start(&seg, 1, false);
+		if (tx_in_progress) {
+			tx_progress();
+		}
+	}
+}
+
+
+/**
+ * Start sending an image response over the network.  The segments are gathered by the
+ * socket so the payload is sent from where it was encoded.
+ */
+static void send_net_image(image_rsp_t* img)
+{
+	int num_segs;
+	struct iovec segs[RSP_TX_MAX_SEGS];
+	
+	num_segs = image_rsp_segments(img, segs);
+	tx_start(segs, num_segs, true);
+	if (tx_in_progress) {
+		tx_progress();
+	}
+}
+
+
+/**
+ * Load segs with the non-empty segments of an image response.  Returns the number
+ * of segments.
+ */
+static int image_rsp_segments(image_rsp_t* img, struct iovec* segs)
+{
+	int n = 0;
+	
+	if (img->hdr_length != 0) {
+		segs[n].iov_base = img->hdr;
+		segs[n++].iov_len = img->hdr_length;
+	}
+	segs[n].iov_base = img->payloadP;
+	segs[n++].iov_len = img->length;
+	if (img->trl_length != 0) {
+		segs[n].iov_base = img->trl;
+		segs[n++].iov_len = img->trl_length;
+	}
+	
+	return n;
+}
+
+
+/**
+ * Load iov with up to max_len bytes of the data described by segs starting offset bytes
+ * in.  Returns the number of iov entries used (at most num_segs).
+ */
+static int load_iov(struct iovec* iov, struct iovec* segs, int num_segs, int offset, int max_len)
+{
+	int i;
+	int len;
+	int n = 0;
+	
+	for (i=0; (i<num_segs) && (max_len > 0); i++) {
+		len = (int) segs[i].iov_len;
+		if (offset >= len) {
+			// Segment already sent
+			offset -= len;
+			continue;
+		}
+		
+		len -= offset;
+		if (len > max_len) len = max_len;
+		iov[n].iov_base = (char*) segs[i].iov_base + offset;
+		iov[n].iov_len = len;
+		n++;
 		
-		// Write our response to the socket
-    	byte_offset = 0;
-		while (byte_offset < rsp_length) {
-			len = rsp_length - byte_offset;
-			if (len > RSP_MAX_TX_PKT_LEN) len = RSP_MAX_TX_PKT_LEN;
-			err = send(sock, rsp + byte_offset, len, 0);
-			if (err < 0) {
+		max_len -= len;
+		offset = 0;
+	}
+	
+	return n;
+}
+
+
+/**
+ * Setup to send a network response made of one or more segments
+ */
+static void tx_start(struct iovec* segs, int num_segs, bool image)
+{
+	int flag;
+	int i;
+	int sock;
+	
+	sock = net_cmd_get_socket();
+	if (sock < 0) return;
+	
+	if (sock != tx_sock) {
+		// Configure a new connection's socket
+		flag = RSP_TX_NODELAY;
+		if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag)) != 0) {
+			ESP_LOGE(TAG, "Could not set TCP_NODELAY: errno %d", errno);
+		}
+		tx_sock = sock;
+	}
+	
+	tx_num_segs = num_segs;
+	tx_length = 0;
+	for (i=0; i<num_segs; i++) {
+		tx_segs[i] = segs[i];
+		tx_length += segs[i].iov_len;
+	}
+	tx_image = image;
+	tx_offset = 0;
+	tx_stalled = false;
+	tx_msg_stall_usec = 0;
+	tx_start_usec = esp_timer_get_time();
+	tx_in_progress = true;
+}
+
+
+/**
+ * Write as much of the current network response as the socket will take without
+ * blocking
+ */
+static void tx_progress()
+{
+	int err;
+	uint32_t stall_usec;
+	struct iovec iov[RSP_TX_MAX_SEGS];
+	struct msghdr msg;
+	
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	
+	while (tx_offset < tx_length) {
+		msg.msg_iovlen = load_iov(iov, tx_segs, tx_num_segs, tx_offset, RSP_MAX_TX_PKT_LEN);
+		err = sendmsg(tx_sock, &msg, MSG_DONTWAIT);
+		if (err < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				// Send buffer is full - try again when there is room
+				if (!tx_stalled) {
+					tx_stalled = true;
+					tx_stall_start_usec = esp_timer_get_time();
+				}
+			} else {
 				ESP_LOGE(TAG, "Error in socket send: errno %d", errno);
-				break;
+				tx_end(false);
 			}
-			byte_offset += err;
+			return;
+		}
+		
+		if (tx_stalled) {
+			tx_stalled = false;
+			stall_usec = (uint32_t) (esp_timer_get_time() - tx_stall_start_usec);
+			tx_msg_stall_usec += stall_usec;
+			
+			xSemaphoreTake(tx_stats_mutex, portMAX_DELAY);
+			tx_stats.stall_usec += stall_usec;
+			if (stall_usec > tx_stats.max_stall_usec) tx_stats.max_stall_usec = stall_usec;
+			xSemaphoreGive(tx_stats_mutex);
+		}
+		
+		tx_offset += err;
+	}
+	
+	tx_end(true);
+}
+
+
+/**
+ * Wait up to msec for room in the socket send buffer
+ */
+static void tx_wait(int msec)
+{
+	fd_set write_fds;
+	struct timeval tv;
+	
+	FD_ZERO(&write_fds);
+	FD_SET(tx_sock, &write_fds);
+	tv.tv_sec = 0;
+	tv.tv_usec = msec * 1000;
+	
+	if (select(tx_sock + 1, NULL, &write_fds, NULL, &tv) < 0) {
+		// Socket is probably being closed - don't spin
+		vTaskDelay(pdMS_TO_TICKS(msec));
+	}
+}
+
+
+/**
+ * Finish the current network response and update statistics
+ */
+static void tx_end(bool success)
+{
+	uint32_t tx_usec;
+	
+	tx_usec = (uint32_t) (esp_timer_get_time() - tx_start_usec);
+	tx_in_progress = false;
+	
+	xSemaphoreTake(tx_stats_mutex, portMAX_DELAY);
+	tx_stats.bytes += tx_offset;
+	tx_stats.active_usec += tx_usec;
+	if (success) {
+		tx_stats.num_msgs++;
+		if ((tx_length >= RSP_TX_RATE_MIN_LEN) && (tx_usec != 0)) {
+			tx_stats.bytes_per_sec = (uint32_t) (((uint64_t) tx_length * 1000000) / tx_usec);
+		}
+	} else {
+		tx_stats.num_aborts++;
+	}
+	xSemaphoreGive(tx_stats_mutex);
+	
+	if (tx_image) {
+		if (success) {
+			perf_count(PERF_CNT_SENT);
+			perf_record(PERF_STAGE_SEND, tx_usec);
+			perf_record(PERF_STAGE_STALL, tx_msg_stall_usec);
+			perf_record(PERF_STAGE_TOTAL, (uint32_t) (esp_timer_get_time() - image_ready_usec));
+		} else {
+			perf_count(PERF_CNT_DROP_ABORT);
 		}
 	}
 	
 #ifdef LOG_SEND_TIMESTAMP
-	te = esp_timer_get_time();
-	ESP_LOGI(TAG, "send_response took %d uSec", (int) (te - tb));
+	ESP_LOGI(TAG, "send_response %d bytes took %d uSec (stalled %d uSec)", tx_offset, tx_usec, tx_msg_stall_usec);
 #endif
 }
 
@@ -654,41 +1140,57 @@ static char pop_cmd_response_buffer()
 
 /**
  * Setup the SPI Slave to be read with the image and send an image ready message
- * via the serial interface.
+ * via the serial interface.  The SPI Slave driver transmits from one buffer so the
+ * image response segments are joined in the room reserved around the payload.
  */
-static void send_spi_image(char* rsp, int rsp_length)
+static void send_spi_image(image_rsp_t* img)
 {
 	char* cP;
 	char* eP;
+	char* rsp;
 	int dma_length;
+	int i;
+	int rsp_length;
+	int64_t send_start_usec;
 	uint32_t cs;
+	struct iovec segs[RSP_TX_MAX_SEGS];
+	int num_segs;
 	static bool enabled = true;
 	
 	// Skip sending any images if the SPI Slave is no longer running
 	if (!enabled) return;
 	
+	send_start_usec = esp_timer_get_time();
+	
 	// Compute a 32-bit checksum (32-bit sum of all bytes in the image string)
-	// and add it to the end of the image
-	cP  = rsp;
-	eP = rsp + rsp_length;
+	// and add it to the trailer
+	num_segs = image_rsp_segments(img, segs);
 	cs = 0;
-	while (cP < eP) {
-		cs += *cP++;
-	}
-	*(rsp + rsp_length + 0) = (cs >> 24) & 0xFF;
-	*(rsp + rsp_length + 1) = (cs >> 16) & 0xFF;
-	*(rsp + rsp_length + 2) = (cs >> 8) & 0xFF;
-	*(rsp + rsp_length + 3) = cs & 0xFF;
-	rsp_length += 4;
-	
-	// Length (for DMA) must be multiple of 4 bytes
-	if (rsp_length & 0x3) {
-		// Round up to next 4-byte boundary
-		dma_length = (rsp_length + 4) & 0xFFFFFFFC;
-	} else {
-		dma_length = rsp_length;
+	for (i=0; i<num_segs; i++) {
+		cP = segs[i].iov_base;
+		eP = cP + segs[i].iov_len;
+		while (cP < eP) {
+			cs += *cP++;
+		}
+	}
+	img->trl[img->trl_length++] = (cs >> 24) & 0xFF;
+	img->trl[img->trl_length++] = (cs >> 16) & 0xFF;
+	img->trl[img->trl_length++] = (cs >> 8) & 0xFF;
+	img->trl[img->trl_length++] = cs & 0xFF;
+	rsp_length = img->hdr_length + img->length + img->trl_length;
+	
+	// Length (for DMA) must be multiple of 4 bytes so pad the trailer
+	dma_length = rsp_length;
+	while (dma_length & 0x3) {
+		img->trl[img->trl_length++] = 0;
+		dma_length++;
 	}
 	
+	// Join the segments
+	rsp = img->payloadP - img->hdr_length;
+	memcpy(rsp, img->hdr, img->hdr_length);
+	memcpy(img->payloadP + img->length, img->trl, img->trl_length);
+	
 	// Create the image ready message
 	sprintf(cmd_task_response_buffer, "%c{\"image_ready\" : %d}%c", CMD_JSON_STRING_START, rsp_length, CMD_JSON_STRING_STOP);
 
@@ -700,7 +1202,11 @@ static void send_spi_image(char* rsp, int rsp_length)
 		send_response(cmd_task_response_buffer, strlen(cmd_task_response_buffer), true);
 		
 		// Wait for the SPI Slave to complete transferring the data
-		if (!system_spi_wait_done()) {
+		if (system_spi_wait_done()) {
+			perf_count(PERF_CNT_SENT);
+			perf_record(PERF_STAGE_SEND, (uint32_t) (esp_timer_get_time() - send_start_usec));
+			perf_record(PERF_STAGE_TOTAL, (uint32_t) (esp_timer_get_time() - image_ready_usec));
+		} else {
 			// Something went wrong with the SPI Slave - probably a timeout and
 			// we couldn't successfully reset it.  So we disable its use and
 			// attempt to let our user about the failure.
@@ -720,6 +1226,139 @@ static void send_spi_image(char* rsp, int rsp_length)
 }
 
 
+/**
+ * Create the UDP socket if necessary and set the destination for streamed images
+ */
+static bool udp_setup()
+{
+	uint8_t ttl = RSP_UDP_MCAST_TTL;
+	
+	if (udp_sock < 0) {
+		udp_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+		if (udp_sock < 0) {
+			ESP_LOGE(TAG, "Unable to create UDP socket: errno %d", errno);
+			return false;
+		}
+		
+		// Keep multicast images on the local network
+		if (setsockopt(udp_sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) != 0) {
+			ESP_LOGE(TAG, "Could not set IP_MULTICAST_TTL: errno %d", errno);
+		}
+	}
+	
+	memset(&udp_dest_addr, 0, sizeof(udp_dest_addr));
+	udp_dest_addr.sin_family = AF_INET;
+	udp_dest_addr.sin_port = htons(next_udp_port);
+	udp_dest_addr.sin_addr.s_addr = htonl(((uint32_t) next_udp_addr[3] << 24) |
+	                                      ((uint32_t) next_udp_addr[2] << 16) |
+	                                      ((uint32_t) next_udp_addr[1] << 8) |
+	                                      (uint32_t) next_udp_addr[0]);
+	
+	ESP_LOGI(TAG, "UDP stream to %d.%d.%d.%d:%d", next_udp_addr[3], next_udp_addr[2],
+		next_udp_addr[1], next_udp_addr[0], next_udp_port);
+	
+	return true;
+}
+
+
+static void udp_close()
+{
+	if (udp_sock >= 0) {
+		close(udp_sock);
+		udp_sock = -1;
+	}
+}
+
+
+/**
+ * Send an image as a series of UDP datagrams.  Each datagram starts with a little-endian
+ * header:
+ *   magic (4 bytes) - "TCUF"
+ *   frame (4 bytes) - image number, incremented for each image sent
+ *   frag  (2 bytes) - fragment number (0 - num-1)
+ *   num   (2 bytes) - number of fragments in the image
+ *   len   (4 bytes) - image length
+ * followed by up to RSP_UDP_MAX_PAYLOAD bytes of the image gathered from the image
+ * response segments.  Receivers discard images missing any fragments.  Returns false
+ * if the image could not be completely sent.
+ */
+static bool send_udp_image(image_rsp_t* img)
+{
+	int64_t send_start_usec;
+	int err;
+	int frag;
+	int img_length;
+	int len;
+	int num_frags;
+	int num_segs;
+	int offset;
+	int retries;
+	uint32_t* hdr32P = udp_hdr_buffer;
+	uint16_t* hdr16P = (uint16_t*) &udp_hdr_buffer[2];
+	struct iovec segs[RSP_TX_MAX_SEGS];
+	struct iovec iov[RSP_TX_MAX_SEGS + 1];
+	struct msghdr msg;
+	
+	send_start_usec = esp_timer_get_time();
+	num_segs = image_rsp_segments(img, segs);
+	img_length = img->hdr_length + img->length + img->trl_length;
+	num_frags = (img_length + RSP_UDP_MAX_PAYLOAD - 1) / RSP_UDP_MAX_PAYLOAD;
+	udp_frame_num++;
+	
+	// ESP32 is little-endian
+	hdr32P[0] = RSP_UDP_MAGIC;
+	hdr32P[1] = udp_frame_num;
+	hdr16P[1] = (uint16_t) num_frags;
+	hdr32P[3] = (uint32_t) img_length;
+	
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name = &udp_dest_addr;
+	msg.msg_namelen = sizeof(udp_dest_addr);
+	msg.msg_iov = iov;
+	iov[0].iov_base = udp_hdr_buffer;
+	iov[0].iov_len = RSP_UDP_HDR_LEN;
+	
+	offset = 0;
+	for (frag=0; frag<num_frags; frag++) {
+		len = img_length - offset;
+		if (len > RSP_UDP_MAX_PAYLOAD) len = RSP_UDP_MAX_PAYLOAD;
+		hdr16P[0] = (uint16_t) frag;
+		msg.msg_iovlen = 1 + load_iov(&iov[1], segs, num_segs, offset, len);
+		
+		retries = 0;
+		while ((err = sendmsg(udp_sock, &msg, 0)) < 0) {
+			if (((errno == ENOMEM) || (errno == EAGAIN)) && (++retries <= RSP_UDP_MAX_RETRIES)) {
+				// Wait for the WiFi stack to free buffers
+				vTaskDelay(1);
+			} else {
+				ESP_LOGE(TAG, "UDP send failed: errno %d", errno);
+				break;
+			}
+		}
+		if (err < 0) break;
+		
+		offset += len;
+	}
+	
+	xSemaphoreTake(tx_stats_mutex, portMAX_DELAY);
+	tx_stats.bytes += offset;
+	if (offset == img_length) {
+		tx_stats.udp_frames++;
+	} else {
+		tx_stats.udp_drops++;
+	}
+	xSemaphoreGive(tx_stats_mutex);
+	
+	if (offset != img_length) return false;
+	
+	perf_count(PERF_CNT_SENT);
+	perf_record(PERF_STAGE_SEND, (uint32_t) (esp_timer_get_time() - send_start_usec));
+	perf_record(PERF_STAGE_TOTAL, (uint32_t) (esp_timer_get_time() - image_ready_usec));
+	
+	return true;
+}
+
+
 /**
  * Push a get_fw packet into our own queue with the current segment to get
  */
@@ -760,3 +1399,32 @@ static void send_get_fw()
 	
 	xSemaphoreGive(sys_cmd_response_buffer.mutex);
 }
+
+
+/**
+ * Atomically load a cam_info style json string into the response buffer if there is
+ * room.  Assumes cam_info_mutex is held.
+ */
+static void push_cam_info_string(int len)
+{
+	int i;
+	
+	xSemaphoreTake(sys_cmd_response_buffer.mutex, portMAX_DELAY);
+	
+	// Only load if there's room for this response
+	if (len <= (CMD_RESPONSE_BUFFER_LEN - sys_cmd_response_buffer.length)) {
+		for (i=0; i<len; i++) {
+			// Push data
+			*sys_cmd_response_buffer.pushP = cam_info_string[i];
+			
+			// Increment push pointer
+			if (++sys_cmd_response_buffer.pushP >= (sys_cmd_response_buffer.bufferP + CMD_RESPONSE_BUFFER_LEN)) {
+				sys_cmd_response_buffer.pushP = sys_cmd_response_buffer.bufferP;
+			}
+		}
+		
+		sys_cmd_response_buffer.length += len;
+	}
+	
+	xSemaphoreGive(sys_cmd_response_buffer.mutex);
+}
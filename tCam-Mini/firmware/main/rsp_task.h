@@ -26,6 +26,8 @@
 #ifndef RSP_TASK_H
 #define RSP_TASK_H
 
+#include "alarm_utilities.h"
+#include <stdbool.h>
 #include <stdint.h>
 
 
@@ -46,8 +48,26 @@
 #define RSP_TASK_EVAL_NORM_MSEC 50
 #define RSP_TASK_EVAL_FAST_MSEC 10
 
-// Maximum send packet size (less than a MTU)
-#define RSP_MAX_TX_PKT_LEN 1280
+// Network transmit control.  Socket writes are sized to the lwIP TCP send buffer
+// (CONFIG_LWIP_TCP_SND_BUF_DEFAULT) and never block.  While a response is being sent
+// the task waits up to RSP_TX_WAIT_MSEC for room in the send buffer before servicing
+// other work.  Set RSP_TX_NODELAY to 0 to allow Nagle's algorithm to coalesce small
+// writes.
+#define RSP_TX_WAIT_MSEC   10
+#define RSP_TX_NODELAY     1
+
+// UDP image streaming.  Each image is split into datagrams that fit a 1500 byte MTU
+// (20 byte IP header, 8 byte UDP header), each starting with a fragment header.  A
+// datagram the WiFi stack has no room for is retried after a tick up to
+// RSP_UDP_MAX_RETRIES times before the rest of the image is dropped.
+#define RSP_UDP_DEF_PORT      5002
+#define RSP_UDP_HDR_LEN       16
+#define RSP_UDP_MAX_PAYLOAD   (1500 - 20 - 8 - RSP_UDP_HDR_LEN)
+#define RSP_UDP_MCAST_TTL     1
+#define RSP_UDP_MAX_RETRIES   10
+
+// Minimum interval between periodic perf records pushed to the host
+#define RSP_PERF_MIN_PUSH_MSEC 1000
 
 // Maximum cam_info string length
 #define RSP_MAX_CAM_INFO_LEN 128
@@ -65,8 +85,10 @@
 #define RSP_NOTIFY_CMD_GET_IMG_MASK    0x00000001
 #define RSP_NOTIFY_CMD_STREAM_ON_MASK  0x00000002
 #define RSP_NOTIFY_CMD_STREAM_OFF_MASK 0x00000004
+#define RSP_NOTIFY_CMD_GET_ROI_MASK    0x00000008
 #define RSP_NOTIFY_LEP_FRAME_MASK_0    0x00000010
 #define RSP_NOTIFY_LEP_FRAME_MASK_1    0x00000020
+#define RSP_NOTIFY_CMD_GET_PERF_MASK   0x00000040
 #define RSP_NOTIFY_FW_UPD_REQ_MASK     0x00000100
 #define RSP_NOTIFY_FW_UPD_SEG_MASK     0x00000200
 #define RSP_NOTIFY_FW_UPD_EN_MASK      0x00000400
@@ -74,13 +96,36 @@
 
 
 
+//
+// RSP Task typedefs
+//
+
+// Network transmit statistics
+typedef struct {
+	uint32_t num_msgs;          // Responses completely sent
+	uint32_t num_aborts;        // Responses abandoned because of a socket error or disconnect
+	uint64_t bytes;             // Bytes sent
+	uint64_t active_usec;       // Time with a response in progress
+	uint64_t stall_usec;        // Time waiting for room in the send buffer
+	uint32_t max_stall_usec;    // Longest single wait for room in the send buffer
+	uint32_t bytes_per_sec;     // Throughput of the most recent image response
+	uint32_t udp_frames;        // Images completely sent over UDP
+	uint32_t udp_drops;         // Images abandoned part way through because the WiFi stack was full
+} rsp_tx_stats_t;
+
+
+
 //
 // RSP Task API
 //
 void rsp_task();
-void rsp_set_stream_parameters(uint32_t delay_ms, uint32_t num_frames);
+void rsp_set_stream_parameters(uint32_t delay_ms, uint32_t num_frames, bool binary, bool roi_stats, bool udp, uint8_t* udp_addr, uint16_t udp_port);
 void rsp_set_cam_info_msg(uint32_t info_value, char* info_string);
+void rsp_set_alarm_msg(alarm_event_t* event);
 void rsp_set_fw_upd_req_info(uint32_t length, char* version);
 void rsp_set_fw_upd_seg_info(uint32_t start, uint32_t length);
+void rsp_set_perf_parameters(uint32_t push_msec, bool reset);
+void rsp_get_tx_stats(rsp_tx_stats_t* stats);
+void rsp_reset_tx_stats();
 
 #endif /* RSP_TASK_H */
\ No newline at end of file
@@ -36,6 +36,7 @@
 #include "file_utilities.h"
 #include "gui_utilities.h"
 #include "lepton_utilities.h"
+#include "perf_utilities.h"
 #include "power_utilities.h"
 #include "time_utilities.h"
 #include "upd_utilities.h"
@@ -46,6 +47,7 @@
 #include "esp_ota_ops.h"
 #include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/semphr.h"
 #include <string.h>
 
@@ -82,9 +84,21 @@ const cmd_name_t command_list[CMD_NUM] = {
 	{CMD_SET_LEP_CCI_S, CMD_SET_LEP_CCI},
 	{CMD_FW_UPD_REQ_S, CMD_FW_UPD_REQ},
 	{CMD_FW_UPD_SEG_S, CMD_FW_UPD_SEG},
-	{CMD_DUMP_SCREEN_S, CMD_DUMP_SCREEN}
+	{CMD_DUMP_SCREEN_S, CMD_DUMP_SCREEN},
+	{CMD_GET_FS_PAGE_S, CMD_GET_FS_PAGE},
+	{CMD_GET_FS_RAW_S, CMD_GET_FS_RAW},
+	{CMD_SET_ROI_S, CMD_SET_ROI},
+	{CMD_GET_ROI_S, CMD_GET_ROI},
+	{CMD_SET_ALARM_S, CMD_SET_ALARM},
+	{CMD_GET_ALARM_S, CMD_GET_ALARM},
+	{CMD_SET_FILTER_S, CMD_SET_FILTER},
+	{CMD_GET_FILTER_S, CMD_GET_FILTER},
+	{CMD_GET_PERF_S, CMD_GET_PERF}
 };
 
+// Temporal filter consumer names (indexed by FILTER_CONSUMER_x)
+static const char* filter_consumer_names[] = {"stream", "display", "record"};
+
 
 // Fast base64 decoder array
 static const int B64index[256] =
@@ -109,6 +123,7 @@ static const char* TAG = "json_utilities";
 static unsigned char* base64_lep_data;
 static unsigned char* base64_lep_telem_data;
 static unsigned char* base64_cci_reg_data;
+static unsigned char* base64_file_data;
 
 static uint16_t* cci_buf;           // Used to hold Lepton CCI data from cmd or for rsp
 
@@ -123,10 +138,14 @@ static bool json_add_lep_telem_object(cJSON* parent, lep_buffer_t* lep_buffer);
 static void json_free_lep_base64_telem();
 static bool json_add_cci_reg_base64_data(cJSON* parent, int len, uint16_t* buf);
 static void json_free_cci_reg_base64_data();
+static bool json_add_file_base64_data(cJSON* parent, int len, uint8_t* buf);
+static void json_free_file_base64_data();
 static bool json_add_metadata_object(cJSON* parent);
 static int json_generate_response_string(cJSON* root, char* json_string);
 static bool json_ip_string_to_array(uint8_t* ip_array, char* ip_string);
 static int fast_base64_decode(const unsigned char* data, const int len, unsigned char* dst);
+static void json_set_min_max(lep_buffer_t* lep_img);
+static bool json_image_frame_valid(char* frame, int len);
 
 
 
@@ -225,6 +244,71 @@ uint32_t json_get_image_file_string(char* json_image_text, lep_buffer_t* lep_buf
 }
 
 
+/**
+ * Load a delimited json image string from a binary image frame from tCam-Mini into a
+ * pre-allocated buffer.  The string is identical to the one tCam-Mini sends when it
+ * isn't sending binary frames.  Returns a non-zero length for a successful operation.
+ *
+ * This function handles its own memory management.
+ */
+int json_get_image_frame_string(char* json_string, char* frame, int len)
+{
+	bool success;
+	int json_len = 0;
+	cJSON* root;
+	cJSON* meta;
+	json_img_frame_hdr_t* hdrP;
+	lep_buffer_t frame_buffer;
+	
+	if (!json_image_frame_valid(frame, len)) return 0;
+	hdrP = (json_img_frame_hdr_t*) frame;
+	
+	root = cJSON_CreateObject();
+	if (root == NULL) return 0;
+	
+	// Recreate tCam-Mini's metadata object
+	meta = cJSON_Parse(frame + sizeof(json_img_frame_hdr_t));
+	if (meta == NULL) {
+		ESP_LOGE(TAG, "could not parse image frame metadata");
+		cJSON_Delete(root);
+		return 0;
+	}
+	cJSON_AddItemToObject(root, "metadata", meta);
+	
+	// Encode the image and telemetry directly from the frame
+	frame_buffer.lep_bufferP = (uint16_t*) (frame + sizeof(json_img_frame_hdr_t) + hdrP->meta_len);
+	frame_buffer.lep_telemP = frame_buffer.lep_bufferP + LEP_NUM_PIXELS;
+	success = json_add_lep_image_object(root, &frame_buffer);
+	if (success) {
+		success = json_add_lep_telem_object(root, &frame_buffer);
+		if (!success) {
+			// Free lep_image that was already allocated
+			json_free_lep_base64_image();
+		}
+	}
+	
+	// Tightly print the object to the buffer with delimiters
+	if (success) {
+		if (cJSON_PrintPreallocated(root, json_string+1, JSON_MAX_IMAGE_TEXT_LEN-2, false) != 0) {
+			json_len = strlen(json_string+1);
+			*json_string = CMD_JSON_STRING_START;
+			*(json_string + json_len + 1) = CMD_JSON_STRING_STOP;
+			json_len += 2;
+		}
+		
+		// Free the base-64 converted image strings
+		json_free_lep_base64_image();
+		json_free_lep_base64_telem();
+	} else {
+		ESP_LOGE(TAG, "failed to create json image text from frame");
+	}
+	
+	cJSON_Delete(root);
+	
+	return json_len;
+}
+
+
 /**
  * Return a formatted json string containing a get_config command.  Include the delimiters
  * since this string will be sent via the lepton serial interface.
@@ -283,6 +367,134 @@ int json_get_config(char* json_string)
 }
 
 
+/**
+ * Return a formatted json string containing a consumer's temporal filter configuration
+ * in response to the get_filter command.  Include the delimiters since this string
+ * will be sent via the socket interface.
+ */
+int json_get_filter(char* json_string, int consumer)
+{
+	cJSON* root;
+	cJSON* filter;
+	int len = 0;
+	filter_config_t config;
+	
+	if (!filter_get_config(consumer, &config)) return 0;
+	
+	root=cJSON_CreateObject();
+	if (root == NULL) return 0;
+	
+	cJSON_AddItemToObject(root, "filter", filter=cJSON_CreateObject());
+	
+	cJSON_AddStringToObject(filter, "consumer", filter_consumer_names[consumer]);
+	cJSON_AddNumberToObject(filter, "enable", config.enable ? 1 : 0);
+	cJSON_AddNumberToObject(filter, "strength", config.strength);
+	cJSON_AddNumberToObject(filter, "motion", config.motion);
+	
+	// Tightly print the object into the buffer with delimiters
+	len = json_generate_response_string(root, json_string);
+	
+	cJSON_Delete(root);
+	
+	return len;
+}
+
+
+/**
+ * Return a formatted json string containing the performance counters, stage latency
+ * statistics (uSec), heap usage and task CPU usage in response to the get_perf command.
+ * Include the delimiters since this string will be sent via the socket interface.
+ */
+int json_get_perf(char* json_string)
+{
+	cJSON* root;
+	cJSON* perf;
+	cJSON* counters;
+	cJSON* stages;
+	cJSON* stage;
+	cJSON* heap;
+	cJSON* tasks;
+	int i;
+	int len = 0;
+	int num_tasks;
+	int hist[PERF_HIST_BINS];
+	int task_info[2];
+	perf_heap_t heap_info;
+	perf_stats_t* statsP;
+	perf_task_t* tasksP;
+	
+	// Statistics are too large for the stack
+	statsP = heap_caps_malloc(sizeof(perf_stats_t), MALLOC_CAP_SPIRAM);
+	tasksP = heap_caps_malloc(sizeof(perf_task_t) * PERF_MAX_TASKS, MALLOC_CAP_SPIRAM);
+	if ((statsP == NULL) || (tasksP == NULL)) {
+		free(statsP);
+		free(tasksP);
+		return 0;
+	}
+	perf_get(statsP);
+	num_tasks = perf_get_tasks(tasksP, PERF_MAX_TASKS);
+	perf_get_heap(&heap_info);
+	
+	root=cJSON_CreateObject();
+	if (root == NULL) {
+		free(statsP);
+		free(tasksP);
+		return 0;
+	}
+	
+	cJSON_AddItemToObject(root, "perf", perf=cJSON_CreateObject());
+	
+	cJSON_AddNumberToObject(perf, "msec", (double) ((esp_timer_get_time() - statsP->start_usec) / 1000));
+	
+	cJSON_AddItemToObject(perf, "counters", counters=cJSON_CreateObject());
+	for (i=0; i<PERF_NUM_COUNTERS; i++) {
+		cJSON_AddNumberToObject(counters, perf_counter_names[i], statsP->counter[i]);
+	}
+	
+	for (i=0; i<PERF_HIST_BINS-1; i++) {
+		hist[i] = perf_hist_limits[i];
+	}
+	cJSON_AddItemToObject(perf, "hist_limits", cJSON_CreateIntArray(hist, PERF_HIST_BINS-1));
+	
+	cJSON_AddItemToObject(perf, "stages", stages=cJSON_CreateObject());
+	for (i=0; i<PERF_NUM_STAGES; i++) {
+		cJSON_AddItemToObject(stages, perf_stage_names[i], stage=cJSON_CreateObject());
+		cJSON_AddNumberToObject(stage, "count", statsP->stage[i].count);
+		cJSON_AddNumberToObject(stage, "min", (statsP->stage[i].count == 0) ? 0 : statsP->stage[i].min_usec);
+		cJSON_AddNumberToObject(stage, "avg", perf_stage_avg(&statsP->stage[i]));
+		cJSON_AddNumberToObject(stage, "max", statsP->stage[i].max_usec);
+		for (int j=0; j<PERF_HIST_BINS; j++) {
+			hist[j] = statsP->stage[i].hist[j];
+		}
+		cJSON_AddItemToObject(stage, "hist", cJSON_CreateIntArray(hist, PERF_HIST_BINS));
+	}
+	
+	cJSON_AddItemToObject(perf, "heap", heap=cJSON_CreateObject());
+	cJSON_AddNumberToObject(heap, "int_free", heap_info.int_free);
+	cJSON_AddNumberToObject(heap, "int_min", heap_info.int_min_free);
+	cJSON_AddNumberToObject(heap, "int_largest", heap_info.int_largest);
+	cJSON_AddNumberToObject(heap, "spiram_free", heap_info.spiram_free);
+	cJSON_AddNumberToObject(heap, "spiram_min", heap_info.spiram_min_free);
+	
+	// Each task is [CPU share (0.1%), minimum free stack bytes] to keep the response small
+	cJSON_AddItemToObject(perf, "tasks", tasks=cJSON_CreateObject());
+	for (i=0; i<num_tasks; i++) {
+		task_info[0] = tasksP[i].cpu_permille;
+		task_info[1] = tasksP[i].stack_min;
+		cJSON_AddItemToObject(tasks, tasksP[i].name, cJSON_CreateIntArray(task_info, 2));
+	}
+	
+	// Tightly print the object into the buffer with delimiters
+	len = json_generate_response_string(root, json_string);
+	
+	cJSON_Delete(root);
+	free(statsP);
+	free(tasksP);
+	
+	return len;
+}
+
+
 /**
  * Return a formatted json string containing a set_config command.  Include the delimiters
  * since this string will be sent via the lepton serial interface.
@@ -610,6 +822,52 @@ int json_get_filesystem_list_response(char* json_string, char* dir_name, char* n
 }
 
 
+/**
+ * Generate a formatted json string containing the get_filesystem_page response.  Each
+ * file is described by a compact array: [dir_name, file_name, size, num_frames,
+ * start_time, end_time].  Add delimiters for transmission over the network.  Returns
+ * string length.
+ */
+int json_get_filesystem_page_response(char* json_string, int offset, int total, int num, file_page_entry_t* entries)
+{
+	cJSON* root;
+	cJSON* response;
+	cJSON* list;
+	cJSON* entry;
+	int i;
+	int len = 0;
+	
+	// Create and add to the metadata object
+	root=cJSON_CreateObject();
+	if (root != NULL) {
+		// Create and add to the metadata object
+		cJSON_AddItemToObject(root, "filesystem_page", response=cJSON_CreateObject());
+		
+		cJSON_AddNumberToObject(response, "offset", offset);
+		cJSON_AddNumberToObject(response, "num", num);
+		cJSON_AddNumberToObject(response, "total", total);
+		cJSON_AddItemToObject(response, "entries", list=cJSON_CreateArray());
+		
+		for (i=0; i<num; i++) {
+			cJSON_AddItemToArray(list, entry=cJSON_CreateArray());
+			cJSON_AddItemToArray(entry, cJSON_CreateString(entries[i].dir_name));
+			cJSON_AddItemToArray(entry, cJSON_CreateString(entries[i].file_name));
+			cJSON_AddItemToArray(entry, cJSON_CreateNumber(entries[i].size));
+			cJSON_AddItemToArray(entry, cJSON_CreateNumber(entries[i].num_frames));
+			cJSON_AddItemToArray(entry, cJSON_CreateNumber(entries[i].start_secs));
+			cJSON_AddItemToArray(entry, cJSON_CreateNumber(entries[i].end_secs));
+		}
+		
+		// Tightly print the object into the buffer with delimiters
+		len = json_generate_response_string(root, json_string);
+		
+		cJSON_Delete(root);
+	}
+	
+	return len;
+}
+
+
 /**
  * Generate a formatted json string containing the "video_info" object.  Add
  * delimiters for transmission over the network.  Returns string length.
@@ -681,7 +939,7 @@ int json_get_run_ffc(char* json_string)
  * Return a formatted json string containing a stream_on command.  Include the delimiters
  * since this string will be sent via the lepton serial interface.
  */
-int json_get_stream_on_cmd(char* json_string, uint32_t delay_ms, uint32_t* num_frames)
+int json_get_stream_on_cmd(char* json_string, uint32_t delay_ms, uint32_t* num_frames, bool binary)
 {
 	cJSON* root;
 	cJSON* args;
@@ -696,6 +954,9 @@ int json_get_stream_on_cmd(char* json_string, uint32_t delay_ms, uint32_t* num_f
 	
 	cJSON_AddNumberToObject(args, "delay_msec", (int) delay_ms);
 	cJSON_AddNumberToObject(args, "num_frames", (int) num_frames);
+	if (binary) {
+		cJSON_AddNumberToObject(args, "binary", 1);
+	}
 	
 	// Tightly print the object into the buffer with delimiters
 	len = json_generate_response_string(root, json_string);
@@ -848,6 +1109,60 @@ int json_get_dump_screen_response(char* json_string, int start_loc, int num_byte
 }
 
 
+/**
+ * Return a formatted json string containing a file_chunk response with num_bytes of raw
+ * file data from buf.  crc is the CRC32 of the raw data.  Include the delimiters since this
+ * string will be sent over the network.  json_string must be JSON_MAX_IMAGE_TEXT_LEN bytes.
+ * Returns string length.
+ */
+int json_get_file_chunk_response(char* json_string, char* dir_name, char* file_name, uint32_t size, uint32_t start, int num_bytes, uint32_t crc, uint8_t* buf)
+{
+	bool success = true;
+	int len = 0;
+	cJSON* root;
+	cJSON* chunk;
+	
+	// Create and add to the file_chunk object
+	root = cJSON_CreateObject();
+	if (root == NULL) return 0;
+	
+	cJSON_AddItemToObject(root, "file_chunk", chunk=cJSON_CreateObject());
+	
+	cJSON_AddStringToObject(chunk, "dir_name", dir_name);
+	cJSON_AddStringToObject(chunk, "file_name", file_name);
+	cJSON_AddNumberToObject(chunk, "size", size);
+	cJSON_AddNumberToObject(chunk, "start", start);
+	cJSON_AddNumberToObject(chunk, "length", num_bytes);
+	cJSON_AddNumberToObject(chunk, "crc", crc);
+	
+	if (num_bytes != 0) {
+		success = json_add_file_base64_data(chunk, num_bytes, buf);
+	} else {
+		cJSON_AddStringToObject(chunk, "data", "");
+	}
+	
+	// Tightly print the object into our buffer with delimiters
+	if (success) {
+		json_string[0] = CMD_JSON_STRING_START;
+		if (cJSON_PrintPreallocated(root, &json_string[1], JSON_MAX_IMAGE_TEXT_LEN - 2, false) == 0) {
+			len = 0;
+		} else {
+			len = strlen(json_string);
+			json_string[len] = CMD_JSON_STRING_STOP;
+			json_string[len+1] = 0;
+			len += 1;
+		}
+		
+		if (num_bytes != 0) {
+			json_free_file_base64_data();
+		}
+	}
+	cJSON_Delete(root);
+	
+	return len;
+}
+
+
 /**
  * Parse a top level command object, returning the command number and a pointer to 
  * a json object containing "args".  The pointer is set to NULL if there are no args.
@@ -1221,6 +1536,125 @@ bool json_parse_file_cmd_args(cJSON* cmd_args, char* dir_name_buf, char* file_na
 }
 
 
+/**
+ * Get the get_file_raw arguments.  dir_name and file_name are required.  offset and
+ * length are optional and default to 0 (start of file and rest of file).
+ */
+bool json_parse_file_raw_args(cJSON* cmd_args, char* dir_name_buf, char* file_name_buf, uint32_t* offset, uint32_t* length)
+{
+	int i;
+	
+	if ((cmd_args == NULL) || !cJSON_HasObjectItem(cmd_args, "dir_name") || !cJSON_HasObjectItem(cmd_args, "file_name")) {
+		ESP_LOGE(TAG, "get_file_raw requires dir_name and file_name");
+		return false;
+	}
+	
+	if (!json_parse_file_cmd_args(cmd_args, dir_name_buf, file_name_buf)) {
+		return false;
+	}
+	
+	*offset = 0;
+	*length = 0;
+	
+	if (cJSON_HasObjectItem(cmd_args, "offset")) {
+		i = cJSON_GetObjectItem(cmd_args, "offset")->valueint;
+		if (i < 0) return false;
+		*offset = (uint32_t) i;
+	}
+	
+	if (cJSON_HasObjectItem(cmd_args, "length")) {
+		i = cJSON_GetObjectItem(cmd_args, "length")->valueint;
+		if (i < 0) return false;
+		*length = (uint32_t) i;
+	}
+	
+	return true;
+}
+
+
+/**
+ * Get the get_filesystem_page arguments.  All arguments are optional.  dir_name_buf is
+ * set to "/" if no directory is specified.
+ */
+bool json_parse_fs_page_args(cJSON* cmd_args, char* dir_name_buf, file_page_req_t* req)
+{
+	char* s;
+	int i;
+	
+	// Defaults: all files in all directories starting with the first
+	strcpy(dir_name_buf, "/");
+	req->dir_index = -1;
+	req->type = FILE_PAGE_TYPE_ALL;
+	req->offset = 0;
+	req->limit = FILE_MAX_PAGE_ENTRIES;
+	req->from_dir[0] = 0;
+	req->to_dir[0] = 0;
+	
+	if (cmd_args == NULL) {
+		return true;
+	}
+	
+	if (cJSON_HasObjectItem(cmd_args, "dir_name")) {
+		s = cJSON_GetObjectItem(cmd_args, "dir_name")->valuestring;
+		if ((s != NULL) && (strlen(s) < DIR_NAME_LEN)) {
+			strcpy(dir_name_buf, s);
+		} else {
+			ESP_LOGE(TAG, "get_filesystem_page dir_name is illegal");
+			return false;
+		}
+	}
+	
+	if (cJSON_HasObjectItem(cmd_args, "type")) {
+		s = cJSON_GetObjectItem(cmd_args, "type")->valuestring;
+		if (s == NULL) {
+			return false;
+		} else if (strcmp(s, "img") == 0) {
+			req->type = FILE_PAGE_TYPE_IMG;
+		} else if (strcmp(s, "mov") == 0) {
+			req->type = FILE_PAGE_TYPE_MOV;
+		} else if (strcmp(s, "all") != 0) {
+			ESP_LOGE(TAG, "get_filesystem_page type: %s is illegal", s);
+			return false;
+		}
+	}
+	
+	if (cJSON_HasObjectItem(cmd_args, "offset")) {
+		i = cJSON_GetObjectItem(cmd_args, "offset")->valueint;
+		if (i < 0) return false;
+		req->offset = i;
+	}
+	
+	if (cJSON_HasObjectItem(cmd_args, "limit")) {
+		i = cJSON_GetObjectItem(cmd_args, "limit")->valueint;
+		if (i < 1) return false;
+		req->limit = (i > FILE_MAX_PAGE_ENTRIES) ? FILE_MAX_PAGE_ENTRIES : i;
+	}
+	
+	// Dates are "YY_MM_DD" and are compared against tcam_YY_MM_DD directory names
+	if (cJSON_HasObjectItem(cmd_args, "from_date")) {
+		s = cJSON_GetObjectItem(cmd_args, "from_date")->valuestring;
+		if ((s != NULL) && (strlen(s) == 8)) {
+			sprintf(req->from_dir, "tcam_%s", s);
+		} else {
+			ESP_LOGE(TAG, "get_filesystem_page from_date is illegal");
+			return false;
+		}
+	}
+	
+	if (cJSON_HasObjectItem(cmd_args, "to_date")) {
+		s = cJSON_GetObjectItem(cmd_args, "to_date")->valuestring;
+		if ((s != NULL) && (strlen(s) == 8)) {
+			sprintf(req->to_dir, "tcam_%s", s);
+		} else {
+			ESP_LOGE(TAG, "get_filesystem_page to_date is illegal");
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+
 /**
  * Get the get_lep_cci arguments.  Pass our cci_buf back to the calling code to hold
  * the read data.
@@ -1368,6 +1802,126 @@ bool json_parse_fw_segment(cJSON* cmd_args, uint32_t* start, uint32_t* len, uint
 }
 
 
+/**
+ * Get the set_filter arguments.  Items not included are set to their defaults.
+ */
+bool json_parse_set_filter(cJSON* cmd_args, int* consumer, filter_config_t* config)
+{
+	char* consumer_name;
+	int i;
+	
+	if (cmd_args == NULL) return false;
+	
+	if (!cJSON_HasObjectItem(cmd_args, "consumer")) return false;
+	consumer_name = cJSON_GetStringValue(cJSON_GetObjectItem(cmd_args, "consumer"));
+	if (consumer_name == NULL) return false;
+	for (i=0; i<FILTER_NUM_CONSUMERS; i++) {
+		if (strcmp(consumer_name, filter_consumer_names[i]) == 0) break;
+	}
+	if (i == FILTER_NUM_CONSUMERS) return false;
+	*consumer = i;
+	
+	config->enable = false;
+	config->strength = FILTER_DEF_STRENGTH;
+	config->motion = FILTER_DEF_MOTION;
+	
+	if (cJSON_HasObjectItem(cmd_args, "enable")) {
+		config->enable = (cJSON_GetObjectItem(cmd_args, "enable")->valueint != 0);
+	}
+	
+	if (cJSON_HasObjectItem(cmd_args, "strength")) {
+		config->strength = cJSON_GetObjectItem(cmd_args, "strength")->valueint;
+	}
+	
+	if (cJSON_HasObjectItem(cmd_args, "motion")) {
+		config->motion = cJSON_GetObjectItem(cmd_args, "motion")->valueint;
+	}
+	
+	return true;
+}
+
+
+/**
+ * Get the optional get_perf arguments.  A non-zero push_msec requests a perf record
+ * be sent periodically until the host disconnects or sends another get_perf.  Reset
+ * clears all counters and statistics after each perf record is generated.
+ */
+bool json_parse_get_perf(cJSON* cmd_args, uint32_t* push_msec, bool* reset)
+{
+	int i;
+	
+	*push_msec = 0;
+	*reset = false;
+	
+	if (cmd_args != NULL) {
+		if (cJSON_HasObjectItem(cmd_args, "push_msec")) {
+			i = cJSON_GetObjectItem(cmd_args, "push_msec")->valueint;
+			if (i < 0) {
+				ESP_LOGE(TAG, "Illegal get_perf push_msec %d", i);
+				return false;
+			}
+			*push_msec = i;
+		}
+		
+		if (cJSON_HasObjectItem(cmd_args, "reset")) {
+			*reset = (cJSON_GetObjectItem(cmd_args, "reset")->valueint != 0);
+		}
+	}
+	
+	return true;
+}
+
+
+/**
+ * Get the rule index and record setting from set_alarm arguments being forwarded to
+ * tCam-Mini.  A disabled rule never records.
+ */
+bool json_parse_set_alarm_record(cJSON* cmd_args, int* index, bool* record)
+{
+	if (cmd_args == NULL) return false;
+	
+	if (!cJSON_HasObjectItem(cmd_args, "index")) return false;
+	*index = cJSON_GetObjectItem(cmd_args, "index")->valueint;
+	
+	*record = false;
+	if (cJSON_HasObjectItem(cmd_args, "record")) {
+		*record = (cJSON_GetObjectItem(cmd_args, "record")->valueint != 0);
+	}
+	if (cJSON_HasObjectItem(cmd_args, "enable")) {
+		if (cJSON_GetObjectItem(cmd_args, "enable")->valueint == 0) {
+			*record = false;
+		}
+	}
+	
+	return true;
+}
+
+
+/**
+ * Get the rule index, state and record setting from a tCam-Mini alarm message
+ */
+bool json_parse_alarm(cJSON* obj, int* index, bool* active, bool* record)
+{
+	cJSON* alarm;
+	
+	if (obj == NULL) return false;
+	
+	alarm = cJSON_GetObjectItem(obj, "alarm");
+	if (alarm == NULL) return false;
+	
+	if (!cJSON_HasObjectItem(alarm, "index") || !cJSON_HasObjectItem(alarm, "active")) return false;
+	*index = cJSON_GetObjectItem(alarm, "index")->valueint;
+	*active = (cJSON_GetObjectItem(alarm, "active")->valueint != 0);
+	
+	*record = false;
+	if (cJSON_HasObjectItem(alarm, "record")) {
+		*record = (cJSON_GetObjectItem(alarm, "record")->valueint != 0);
+	}
+	
+	return true;
+}
+
+
 /**
  * Get the image_ready length.
  */
@@ -1499,11 +2053,6 @@ bool json_parse_image(cJSON* img_obj, uint64_t* ts_msec, lep_buffer_t* lep_img)
 	size_t len = 0;
 	int res;
 	tmElements_t te;
-	uint16_t* lepP;
-	uint16_t* min_lepP;
-	uint16_t* max_lepP;
-	uint16_t min;
-	uint16_t max;
 	
 	// Process the metadata, if it exists, to get the timestamp
 	if (cJSON_HasObjectItem(img_obj, "metadata")) {
@@ -1536,26 +2085,7 @@ bool json_parse_image(cJSON* img_obj, uint64_t* ts_msec, lep_buffer_t* lep_img)
 				success = false;
 			} else {
 				// Compute the min/max values and their location
-				min = 0xFFFF;
-				max = 0;
-				lepP = min_lepP = lep_img->lep_bufferP + LEP_NUM_PIXELS;
-				max_lepP = lep_img->lep_bufferP;
-				while (lepP-- != lep_img->lep_bufferP) {
-					if (*lepP < min) {
-						min = *lepP;
-						min_lepP = lepP;
-					}
-					if (*lepP > max) {
-						max = *lepP;
-						max_lepP = lepP;
-					}
-				}
-				lep_img->lep_min_val = min;
-				lep_img->lep_min_x = (min_lepP - lep_img->lep_bufferP) % LEP_WIDTH;
-				lep_img->lep_min_y = (min_lepP - lep_img->lep_bufferP) / LEP_WIDTH;
-				lep_img->lep_max_val = max;
-				lep_img->lep_max_x = (max_lepP - lep_img->lep_bufferP) % LEP_WIDTH;
-				lep_img->lep_max_y = (max_lepP - lep_img->lep_bufferP) / LEP_WIDTH;
+				json_set_min_max(lep_img);
 			}
 		} else {
 			success = false;
@@ -1594,11 +2124,6 @@ bool json_parse_image_string(char* img, lep_buffer_t* lep_img)
 	char* telP;
 	int res;
 	size_t len = 0;
-	uint16_t* lepP;
-	uint16_t* min_lepP;
-	uint16_t* max_lepP;
-	uint16_t min;
-	uint16_t max;
 	
 	// Find the start if the encoded image string
 	//   1. Find radiometric/telemetry
@@ -1634,26 +2159,7 @@ bool json_parse_image_string(char* img, lep_buffer_t* lep_img)
 		return false;
 	} else {
 		// Compute the min/max values and their location
-				min = 0xFFFF;
-				max = 0;
-				lepP = min_lepP = lep_img->lep_bufferP + LEP_NUM_PIXELS;
-				max_lepP = lep_img->lep_bufferP;
-				while (lepP-- != lep_img->lep_bufferP) {
-					if (*lepP < min) {
-						min = *lepP;
-						min_lepP = lepP;
-					}
-					if (*lepP > max) {
-						max = *lepP;
-						max_lepP = lepP;
-					}
-				}
-				lep_img->lep_min_val = min;
-				lep_img->lep_min_x = (min_lepP - lep_img->lep_bufferP) % LEP_WIDTH;
-				lep_img->lep_min_y = (min_lepP - lep_img->lep_bufferP) / LEP_WIDTH;
-				lep_img->lep_max_val = max;
-				lep_img->lep_max_x = (max_lepP - lep_img->lep_bufferP) % LEP_WIDTH;
-				lep_img->lep_max_y = (max_lepP - lep_img->lep_bufferP) / LEP_WIDTH;
+		json_set_min_max(lep_img);
 	}
 	
 	// Decode the telemetry
@@ -1673,6 +2179,54 @@ json_parse_image_string_err:
 }
 
 
+/**
+ * Return true if the buffer read from tCam-Mini contains a binary image frame instead of
+ * a json image string
+ */
+bool json_is_image_frame(char* buf)
+{
+	return (((json_img_frame_hdr_t*) buf)->magic == JSON_IMG_FRAME_MAGIC);
+}
+
+
+/**
+ * Directly copy the image and telemetry data from a binary image frame into the
+ * passed-in lepton buffer structure.
+ */
+bool json_parse_image_frame(char* frame, int len, lep_buffer_t* lep_img)
+{
+	char* imgP;
+	json_img_frame_hdr_t* hdrP;
+	
+	if (!json_image_frame_valid(frame, len)) return false;
+	hdrP = (json_img_frame_hdr_t*) frame;
+	
+	imgP = frame + sizeof(json_img_frame_hdr_t) + hdrP->meta_len;
+	memcpy(lep_img->lep_bufferP, imgP, LEP_NUM_PIXELS*2);
+	memcpy(lep_img->lep_telemP, imgP + LEP_NUM_PIXELS*2, LEP_TEL_WORDS*2);
+	
+	json_set_min_max(lep_img);
+	lep_img->telem_valid = true;
+	
+	return true;
+}
+
+
+/**
+ * Return a pointer to the radiometric data in a binary image frame (so it may be modified
+ * in place) or NULL if the frame is not valid
+ */
+uint16_t* json_get_image_frame_pixels(char* frame, int len)
+{
+	json_img_frame_hdr_t* hdrP;
+	
+	if (!json_image_frame_valid(frame, len)) return NULL;
+	hdrP = (json_img_frame_hdr_t*) frame;
+	
+	return (uint16_t*) (frame + sizeof(json_img_frame_hdr_t) + hdrP->meta_len);
+}
+
+
 /**
  * Parse a video_info object, returning information about the video file
  */
@@ -1881,6 +2435,50 @@ static void json_free_cci_reg_base64_data()
 }
 
 
+/**
+ * Add a base64 encoded version of len bytes of raw file data as "data" to the parent.
+ * Mallocs a buffer for the encoded data that must be freed by calling
+ * json_free_file_base64_data() after the json object is converted to a string.
+ */
+static bool json_add_file_base64_data(cJSON* parent, int len, uint8_t* buf)
+{
+	size_t base64_obj_len;
+	
+	// Get the necessary length and allocate a buffer
+	(void) mbedtls_base64_encode(base64_file_data, 0, &base64_obj_len, (const unsigned char *) buf, len);
+	base64_file_data = heap_caps_malloc(base64_obj_len, MALLOC_CAP_SPIRAM);
+	
+	if (base64_file_data != NULL) {
+		// Base-64 encode the file data
+		if (mbedtls_base64_encode(base64_file_data, base64_obj_len, &base64_obj_len, 
+							      (const unsigned char *) buf, len) != 0) {
+	                           
+			ESP_LOGE(TAG, "failed to encode file data base64 text");
+			free(base64_file_data);
+			return false;
+		}
+	} else {
+		ESP_LOGE(TAG, "failed to allocate %d bytes for file data base64 text", base64_obj_len);
+		return false;
+	}
+	
+	// Add the encoded data as a reference since we're managing the buffer
+	cJSON_AddItemToObject(parent, "data", cJSON_CreateStringReference((char*) base64_file_data));
+	
+	return true;
+}
+
+
+/**
+ * Free the base64-encoded file data string.  Call this routine after printing the
+ * file_chunk json object.
+ */
+static void json_free_file_base64_data()
+{
+	free(base64_file_data);
+}
+
+
 /**
  * Add a child object containing image metadata to the parent.
  */
@@ -1931,6 +2529,71 @@ static bool json_add_metadata_object(cJSON* parent)
 }
 
 
+/**
+ * Compute the min/max values and their location in a lepton buffer
+ */
+static void json_set_min_max(lep_buffer_t* lep_img)
+{
+	uint16_t* lepP;
+	uint16_t* min_lepP;
+	uint16_t* max_lepP;
+	uint16_t min;
+	uint16_t max;
+	
+	min = 0xFFFF;
+	max = 0;
+	lepP = min_lepP = lep_img->lep_bufferP + LEP_NUM_PIXELS;
+	max_lepP = lep_img->lep_bufferP;
+	while (lepP-- != lep_img->lep_bufferP) {
+		if (*lepP < min) {
+			min = *lepP;
+			min_lepP = lepP;
+		}
+		if (*lepP > max) {
+			max = *lepP;
+			max_lepP = lepP;
+		}
+	}
+	lep_img->lep_min_val = min;
+	lep_img->lep_min_x = (min_lepP - lep_img->lep_bufferP) % LEP_WIDTH;
+	lep_img->lep_min_y = (min_lepP - lep_img->lep_bufferP) / LEP_WIDTH;
+	lep_img->lep_max_val = max;
+	lep_img->lep_max_x = (max_lepP - lep_img->lep_bufferP) % LEP_WIDTH;
+	lep_img->lep_max_y = (max_lepP - lep_img->lep_bufferP) / LEP_WIDTH;
+}
+
+
+/**
+ * Validate a binary image frame header against the length of data read from tCam-Mini.
+ * The metadata string must be terminated inside its region so it can be parsed in place.
+ */
+static bool json_image_frame_valid(char* frame, int len)
+{
+	json_img_frame_hdr_t* hdrP = (json_img_frame_hdr_t*) frame;
+	
+	if (len < (int) sizeof(json_img_frame_hdr_t)) {
+		ESP_LOGE(TAG, "Short image frame");
+		return false;
+	}
+	
+	if ((hdrP->magic != JSON_IMG_FRAME_MAGIC) || (hdrP->version != JSON_IMG_FRAME_VERSION) ||
+	    (hdrP->img_len != LEP_NUM_PIXELS*2) || (hdrP->tel_len != LEP_TEL_WORDS*2) ||
+	    ((hdrP->meta_len & 0x3) != 0) ||
+	    ((sizeof(json_img_frame_hdr_t) + hdrP->meta_len + hdrP->img_len + hdrP->tel_len) != len)) {
+	    
+		ESP_LOGE(TAG, "Illegal image frame header");
+		return false;
+	}
+	
+	if (memchr(frame + sizeof(json_img_frame_hdr_t), 0, hdrP->meta_len) == NULL) {
+		ESP_LOGE(TAG, "Unterminated image frame metadata");
+		return false;
+	}
+	
+	return true;
+}
+
+
 /**
  * Tightly print a response into a string with delimiters for transmission over the network.
  * Returns length of the string.
@@ -34,6 +34,8 @@
 #define JSON_UTILITIES_H
 
 #include "rtc.h"
+#include "file_utilities.h"
+#include "filter_utilities.h"
 #include "lepton_utilities.h"
 #include "sys_utilities.h"
 #include "wifi_utilities.h"
@@ -57,6 +59,27 @@
 #define SET_CONFIG_INC_EMISSIVITY         0x02
 #define SET_CONFIG_INC_GAIN               0x03
 
+// Binary image frame read from tCam-Mini through the SPI interface when requested by stream_on
+//   Header (json_img_frame_hdr_t)
+//   Metadata json text, null terminated and padded to a 4-byte boundary (meta_len bytes)
+//   Lepton image (img_len bytes)
+//   Lepton telemetry (tel_len bytes)
+#define JSON_IMG_FRAME_MAGIC              0x46494354
+#define JSON_IMG_FRAME_VERSION            1
+
+
+
+//
+// JSON Utilities typedefs
+//
+typedef struct {
+	uint32_t magic;          // "TCIF" - Can never be confused with CMD_JSON_STRING_START
+	uint16_t version;
+	uint16_t meta_len;
+	uint32_t img_len;
+	uint32_t tel_len;
+} json_img_frame_hdr_t;
+
 
 
 //
@@ -68,8 +91,11 @@ cJSON* json_get_object(char* json_string);
 void json_free_object(cJSON* obj);
 
 uint32_t json_get_image_file_string(char* json_image_text, lep_buffer_t* lep_buffer);
+int json_get_image_frame_string(char* json_string, char* frame, int len);
 int json_get_config_cmd(char* json_string);
 int json_get_config(char* json_string);
+int json_get_filter(char* json_string, int consumer);
+int json_get_perf(char* json_string);
 int json_set_config(char* json_string, bool agc, int emissivity, int gain, int inc_flags);
 int json_get_status_cmd(char* json_string);
 int json_get_status(char* json_string);
@@ -77,13 +103,15 @@ int json_get_wifi(char* json_string);
 int json_get_cci_response(char* json_string, uint16_t cmd, int cci_len, uint16_t status, uint16_t* buf);
 int json_get_cam_info(char* json_string, uint32_t info_value, char* info_string);
 int json_get_filesystem_list_response(char* json_string, char* dir_name, char* name_list);
+int json_get_filesystem_page_response(char* json_string, int offset, int total, int num, file_page_entry_t* entries);
 int json_get_video_info(char* json_string, tmElements_t start_t, tmElements_t end_t, int n);
 int json_get_run_ffc(char* json_string);
-int json_get_stream_on_cmd(char* json_string, uint32_t delay_ms, uint32_t* num_frames);
+int json_get_stream_on_cmd(char* json_string, uint32_t delay_ms, uint32_t* num_frames, bool binary);
 int json_get_set_spotmeter_cmd(char* json_string, uint16_t r1, uint16_t c1, uint16_t r2, uint16_t c2);
 int json_get_set_time(char* json_string, tmElements_t* te);
 int json_get_get_fw(char* json_string, uint32_t fw_start, uint32_t fw_len);
 int json_get_dump_screen_response(char* json_string, int start_loc, int num_bytes, uint8_t* buf);
+int json_get_file_chunk_response(char* json_string, char* dir_name, char* file_name, uint32_t size, uint32_t start, int num_bytes, uint32_t crc, uint8_t* buf);
 
 bool json_parse_cmd(cJSON* cmd_obj, int* cmd, cJSON** cmd_args);
 bool json_parse_set_config(cJSON* cmd_args, lep_config_t* new_st);
@@ -92,10 +120,16 @@ bool json_parse_set_time(cJSON* cmd_args, tmElements_t* te);
 bool json_parse_set_wifi(cJSON* cmd_args, wifi_info_t* new_wifi_info);
 bool json_parse_stream_on(cJSON* cmd_args, uint32_t* delay_ms, uint32_t* num_frames);
 bool json_parse_file_cmd_args(cJSON* cmd_args, char* dir_name_buf, char* file_name_buf);
+bool json_parse_fs_page_args(cJSON* cmd_args, char* dir_name_buf, file_page_req_t* req);
+bool json_parse_file_raw_args(cJSON* cmd_args, char* dir_name_buf, char* file_name_buf, uint32_t* offset, uint32_t* length);
 bool json_parse_get_lep_cci(cJSON* cmd_args, uint16_t* cmd, int* len, uint16_t** buf);
 bool json_parse_set_lep_cci(cJSON* cmd_args, uint16_t* cmd, int* len, uint16_t** buf);
 bool json_parse_fw_upd_request(cJSON* cmd_args, uint32_t* len, char* ver);
 bool json_parse_fw_segment(cJSON* cmd_args, uint32_t* start, uint32_t* len, uint8_t* buf);
+bool json_parse_set_filter(cJSON* cmd_args, int* consumer, filter_config_t* config);
+bool json_parse_get_perf(cJSON* cmd_args, uint32_t* push_msec, bool* reset);
+bool json_parse_set_alarm_record(cJSON* cmd_args, int* index, bool* record);
+bool json_parse_alarm(cJSON* obj, int* index, bool* active, bool* record);
 bool json_parse_image_ready(cJSON* obj, uint32_t* len);
 void json_parse_status_rsp(cJSON* status_args, tcam_mini_status_t* status_st);
 void json_parse_config_rsp(cJSON* rsp_args, lep_config_t* lep_st);
@@ -104,6 +138,9 @@ const char* json_get_cmd_name(int cmd);
 int json_get_file_object_type(cJSON* obj);
 bool json_parse_image(cJSON* img_obj, uint64_t* ts_msec, lep_buffer_t* lep_img);
 bool json_parse_image_string(char* img, lep_buffer_t* lep_img);
+bool json_is_image_frame(char* buf);
+bool json_parse_image_frame(char* frame, int len, lep_buffer_t* lep_img);
+uint16_t* json_get_image_frame_pixels(char* frame, int len);
 bool json_parse_video_info(cJSON* obj, uint64_t* start_msec, uint64_t* end_msec, int* num_frames);
 
 #endif /* JSON_UTILITIES_H */
\ No newline at end of file
@@ -70,6 +70,7 @@
 #define PS_GUI_METRIC_MASK     0x04
 #define PS_GUI_SPOT_EN_MASK    0x08
 #define PS_BUI_MIN_MAX_EN_MASK 0x10
+#define PS_GUI_HIST_EQ_MASK    0x20
 
 // Lepton state boolean flags
 #define PS_LEP_AGC_EN_MASK     0x01
@@ -297,6 +298,7 @@ void ps_get_gui_state(gui_state_t* state)
 	state->spotmeter_enable = (psP->flags & PS_GUI_SPOT_EN_MASK) != 0;
 	state->temp_unit_C = (psP->flags & PS_GUI_METRIC_MASK) != 0;
 	state->man_range_mode = (psP->flags & PS_GUI_MAN_RANGE_MASK) != 0;
+	state->hist_eq_enable = (psP->flags & PS_GUI_HIST_EQ_MASK) != 0;
 	
 	state->palette = (int) psP->palette;
 	state->lcd_brightness = (int) psP->lcd_brightness;
@@ -317,7 +319,8 @@ void ps_set_gui_state(const gui_state_t* state)
 	             (state->min_max_enable ? PS_BUI_MIN_MAX_EN_MASK : 0) |
 	             (state->spotmeter_enable ? PS_GUI_SPOT_EN_MASK : 0) |
 	             (state->temp_unit_C ? PS_GUI_METRIC_MASK : 0) |
-	             (state->man_range_mode ? PS_GUI_MAN_RANGE_MASK : 0);
+	             (state->man_range_mode ? PS_GUI_MAN_RANGE_MASK : 0) |
+	             (state->hist_eq_enable ? PS_GUI_HIST_EQ_MASK : 0);
 	             
 	psP->palette = (uint8_t) state->palette;
 	psP->lcd_brightness = (uint8_t) state->lcd_brightness;
@@ -25,10 +25,13 @@
 #include "gui_task.h"
 #include "gui_screen_view.h"
 #include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "file_utilities.h"
 #include "gui_utilities.h"
+#include "render.h"
 #include "sys_utilities.h"
 #include "system_config.h"
 #include "lv_conf.h"
@@ -50,6 +53,7 @@
 //
 // Browse Files GUI Screen variables
 //
+static const char* TAG = "gui_screen_browse";
 
 // LVGL objects
 static lv_obj_t* browse_screen;
@@ -73,6 +77,11 @@ static lv_obj_t* btn_delete_label;
 static lv_obj_t* btn_format;
 static lv_obj_t* btn_format_label;
 
+// Thumbnail
+static lv_obj_t* img_thumb;
+static lv_img_dsc_t thumb_img_dsc;
+static uint16_t* thumb_img_buffer;
+
 // Storage Information
 static lv_obj_t* lbl_num_files;
 static lv_obj_t* lbl_freespace;
@@ -108,6 +117,7 @@ static void update_card_present_state(bool present);
 static void update_browse_button_state();
 static void update_format_button_state();
 static void update_info();
+static void hide_thumbnail();
 static void cb_btn_exit(lv_obj_t * btn, lv_event_t event);
 static void cb_btn_view(lv_obj_t * obj, lv_event_t event);
 static void cb_btn_delete(lv_obj_t * obj, lv_event_t event);
@@ -214,6 +224,22 @@ lv_obj_t* gui_screen_browse_create()
 	btn_format_label = lv_label_create(btn_format, NULL);
 	lv_label_set_recolor(btn_format_label, true);
 	
+	// Thumbnail of the selected file (hidden until one is available)
+	thumb_img_buffer = heap_caps_malloc(FILE_THUMB_LEN * 2, MALLOC_CAP_SPIRAM);
+	if (thumb_img_buffer == NULL) {
+		ESP_LOGE(TAG, "Could not allocate thumbnail buffer");
+	}
+	thumb_img_dsc.header.always_zero = 0;
+	thumb_img_dsc.header.cf = LV_IMG_CF_TRUE_COLOR;
+	thumb_img_dsc.header.w = FILE_THUMB_WIDTH;
+	thumb_img_dsc.header.h = FILE_THUMB_HEIGHT;
+	thumb_img_dsc.data_size = FILE_THUMB_LEN * 2;
+	thumb_img_dsc.data = (uint8_t*) thumb_img_buffer;
+	img_thumb = lv_img_create(browse_screen, NULL);
+	lv_img_set_src(img_thumb, &thumb_img_dsc);
+	lv_obj_set_pos(img_thumb, B_THUMB_X, B_THUMB_Y);
+	lv_obj_set_hidden(img_thumb, true);
+	
 	// Number of files label
 	lbl_num_files = lv_label_create(browse_screen, NULL);
 	lv_obj_set_pos(lbl_num_files, B_NUM_FILE_LBL_X, B_NUM_FILE_LBL_Y);
@@ -317,6 +343,7 @@ void gui_screen_browse_update_list()
 		prev_tbl_file_row = -1;
 		tbl_file_browse = tbl;
 		file_selected = false;
+		hide_thumbnail();
 	} else {
 		// Update directory table
 		prev_tbl_dir_row = -1;
@@ -332,6 +359,19 @@ void gui_screen_browse_update_list()
 }
 
 
+/**
+ * Display the thumbnail file_task loaded for the selected file using the current palette
+ */
+void gui_screen_browse_update_thumbnail()
+{
+	if (file_selected && (thumb_img_buffer != NULL)) {
+		render_thumbnail(file_get_gui_thumbnail(), thumb_img_buffer, FILE_THUMB_LEN);
+		lv_obj_set_hidden(img_thumb, false);
+		lv_obj_invalidate(img_thumb);
+	}
+}
+
+
 /**
  * Set the btn pressed in a messagebox - used to trigger activity in response
  * to specific buttons
@@ -429,6 +469,7 @@ void gui_screen_browse_update_after_delete()
 		
 	// Update controls state
 	update_browse_button_state();
+	hide_thumbnail();
 	
 	// Update information
 	update_info();
@@ -478,6 +519,8 @@ static void update_card_present_state(bool present)
 	dir_selected = false;
 	file_selected = false;
 	
+	hide_thumbnail();
+	
 	if (card_present) {
 		// Request list of directories to update
 		file_set_catalog_index(FILE_REQ_SRC_GUI, -1);
@@ -569,6 +612,12 @@ static void update_info()
 }
 
 
+static void hide_thumbnail()
+{
+	lv_obj_set_hidden(img_thumb, true);
+}
+
+
 static void cb_btn_exit(lv_obj_t * btn, lv_event_t event)
 {
 	if (event == LV_EVENT_CLICKED) {
@@ -689,6 +738,10 @@ static void cb_tbl_file(lv_obj_t * obj, lv_event_t event)
 				// Note user has selected a file
 				file_selected = true;
 				
+				// Request its thumbnail
+				file_set_get_image(FILE_REQ_SRC_GUI, dir_name, file_name);
+				xTaskNotify(task_handle_file, FILE_NOTIFY_GUI_GET_THUMB_MASK, eSetBits);
+				
 				// Update control state
 				update_browse_button_state();
 				
@@ -47,7 +47,11 @@
 // Directory List Table dimensions
 #define B_DIR_TBL_PAGE_X     10
 #define B_DIR_TBL_PAGE_Y     60
-#define B_DIR_TBL_PAGE_H     215
+#define B_DIR_TBL_PAGE_H     145
+
+// Thumbnail image (below the directory list)
+#define B_THUMB_X            55
+#define B_THUMB_Y            212
 
 // File List Label
 #define B_FILE_LBL_X         190
@@ -105,5 +109,6 @@ void gui_screen_browse_status_update(lv_task_t * task);
 void gui_screen_browse_update_list();
 void gui_screen_browse_set_msgbox_btn(uint16_t btn);
 void gui_screen_browse_update_after_delete();
+void gui_screen_browse_update_thumbnail();
 
 #endif /* GUI_SCREEN_BROWSE_H */
\ No newline at end of file
@@ -34,6 +34,7 @@
 #include "file_utilities.h"
 #include "gui_utilities.h"
 #include "lepton_utilities.h"
+#include "perf_utilities.h"
 #include "power_utilities.h"
 #include "ps_utilities.h"
 #include "sys_utilities.h"
@@ -421,7 +422,20 @@ static int add_mem_info(int n)
 
 static int add_fps(int n)
 {
-	sprintf(&cam_info_buf[n], "FPS: %1.1f\n", gui_st.fps);
+	int i;
+	uint32_t dropped = 0;
+	static perf_stats_t stats;
+	
+	perf_get(&stats);
+	for (i=PERF_CNT_DROP_CAPTURE; i<=PERF_CNT_DROP_STALE; i++) {
+		dropped += stats.counter[i];
+	}
+	
+	sprintf(&cam_info_buf[n], "FPS: %1.1f - Shown %u - Dropped %u - Latency %u mSec\n",
+		gui_st.fps,
+		stats.counter[PERF_CNT_DISPLAYED],
+		dropped,
+		perf_stage_avg(&stats.stage[PERF_STAGE_TOTAL]) / 1000);
 	
 	return (strlen(cam_info_buf));
 }
@@ -21,17 +21,20 @@
  */
 #include "esp_system.h"
 #include "esp_ota_ops.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "gui_screen_main.h"
 #include "gui_screen_view.h"
 #include "app_task.h"
 #include "cmd_task.h"
+#include "disp_driver.h"
 #include "file_task.h"
 #include "gui_task.h"
 #include "file_utilities.h"
 #include "gui_utilities.h"
 #include "lepton_utilities.h"
+#include "perf_utilities.h"
 #include "power_utilities.h"
 #include "ps_utilities.h"
 #include "sys_utilities.h"
@@ -136,6 +139,7 @@ static void update_colormap_marker(lep_buffer_t* sys_bufP);
 static void update_spot_temp(lep_buffer_t* sys_bufP, bool init);
 static void update_agc_btn_label();
 static void update_range_mode_btn_label();
+static bool update_lep_image_display();
 
 static void cb_lepton_image(lv_obj_t * img, lv_event_t event);
 static void cb_sw_record_mode(lv_obj_t * sw, lv_event_t event);
@@ -391,9 +395,13 @@ void gui_screen_main_set_image_state(int st)
 void gui_screen_main_update_lep_image(int n)
 {
 	lep_config_t* lep_stP = lep_get_lep_st();
+	int64_t rx_usec;
+	int64_t render_start_usec, display_start_usec, end_usec;
 	
 	// Lock the buffer
 	xSemaphoreTake(lep_gui_buffer[n].mutex, portMAX_DELAY);
+	lep_gui_buffer[n].unread = false;
+	rx_usec = lep_gui_buffer[n].rx_usec;
 	
 	// Get state from the telemetry with this image
 	gui_st.agc_enabled = (lepton_get_tel_status(lep_gui_buffer[n].lep_telemP) & LEP_STATUS_AGC_STATE) == LEP_STATUS_AGC_STATE;
@@ -413,6 +421,7 @@ void gui_screen_main_update_lep_image(int n)
 	lep_info.lep_housing_temp_k100 = lep_gui_buffer[n].lep_telemP[LEP_TEL_HSE_T_K100];
 		
 	// Update image
+	render_start_usec = esp_timer_get_time();
 	render_lep_data(&lep_gui_buffer[n], gui_lep_canvas_buffer, &gui_st);
 	
 	// Update spot meter on image
@@ -424,6 +433,8 @@ void gui_screen_main_update_lep_image(int n)
 	if (!gui_st.agc_enabled && gui_st.min_max_enable) {
 		render_min_max_markers(&lep_gui_buffer[n], gui_lep_canvas_buffer);
 	}
+	perf_count(PERF_CNT_RENDERED);
+	perf_record(PERF_STAGE_RENDER, (uint32_t) (esp_timer_get_time() - render_start_usec));
 	
 	// Update temps
 	update_colormap_temps(&lep_gui_buffer[n], false);
@@ -446,8 +457,15 @@ void gui_screen_main_update_lep_image(int n)
 		update_range_mode_btn_label();   // We need agc_enabled to handle case where AGC changed
 	}
 	
-	// Finally invalidate the object to force it to redraw from the buffer
-	lv_obj_invalidate(img_lepton);
+	// Finally update the display from the buffer.  Display latency is only known
+	// when the image is written directly.
+	display_start_usec = esp_timer_get_time();
+	if (update_lep_image_display()) {
+		end_usec = esp_timer_get_time();
+		perf_record(PERF_STAGE_DISPLAY, (uint32_t) (end_usec - display_start_usec));
+		perf_record(PERF_STAGE_TOTAL, (uint32_t) (end_usec - rx_usec));
+	}
+	perf_count(PERF_CNT_DISPLAYED);
 }
 
 
@@ -854,7 +872,11 @@ static void update_colormap_marker(lep_buffer_t* sys_bufP)
 		}
 		
 		// Update marker
-		marker_offset = 255 * (max_val - sys_bufP->lep_telemP[LEP_TEL_SPOT_MEAN]) / (max_val - min_val);
+		if (gui_st.hist_eq_enable) {
+			marker_offset = 255 - render_heq_map(sys_bufP->lep_telemP[LEP_TEL_SPOT_MEAN]);
+		} else {
+			marker_offset = 255 * (max_val - sys_bufP->lep_telemP[LEP_TEL_SPOT_MEAN]) / (max_val - min_val);
+		}
 		if (marker_offset < 0) marker_offset = 0;
 		if (marker_offset > 255) marker_offset = 255;
 		set_spot_marker(prev_marker_offset, true);
@@ -1110,3 +1132,29 @@ static void task_info_message_timeout(lv_task_t * task)
 	// Throw away the reference to this task (it is deleted)
 	lbl_info_message_task = NULL;
 }
+
+
+/**
+ * Display the lepton image in the canvas buffer.  It is written directly to its area
+ * of the LCD when possible, otherwise LVGL is told to redraw the image object.  LVGL
+ * still redraws the image object from the same buffer whenever it has to (for
+ * example when a message box over it is closed).  Returns true if the image was
+ * written directly.
+ */
+static bool update_lep_image_display()
+{
+#ifdef GUI_DIRECT_LEP_IMG_ENABLE
+	lv_area_t area;
+	
+	// A message box may be drawn over the image
+	if (!gui_message_box_displayed()) {
+		lv_obj_get_coords(img_lepton, &area);
+		if (disp_driver_write_direct(&area, (lv_color_t*) gui_lep_canvas_buffer)) {
+			return true;
+		}
+	}
+#endif
+	lv_obj_invalidate(img_lepton);
+	
+	return false;
+}
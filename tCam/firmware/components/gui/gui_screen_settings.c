@@ -109,8 +109,10 @@ static lv_obj_t* sw_min_max;
 
 // Row 4 Local controls
 static lv_obj_t* lbl_sw_metric_units_mode;
+static lv_obj_t* lbl_sw_hist_eq;
 static lv_obj_t* lbl_sl_brightness;
 static lv_obj_t* sw_metric_units_mode;
+static lv_obj_t* sw_hist_eq;
 static lv_obj_t* sl_brightness;
 
 
@@ -137,6 +139,7 @@ static void cb_btn_disp_info(lv_obj_t * btn, lv_event_t event);
 static void cb_dd_gain(lv_obj_t * dd, lv_event_t event);
 static void cb_dd_rec_interval(lv_obj_t * dd, lv_event_t event);
 static void cb_sw_metric_units_mode(lv_obj_t * sw, lv_event_t event);
+static void cb_sw_hist_eq(lv_obj_t * sw, lv_event_t event);
 static void cb_btn_emissivity(lv_obj_t * sw, lv_event_t event);
 static void cb_sw_min_max(lv_obj_t * sw, lv_event_t event);
 static void cb_sw_range_mode(lv_obj_t * sw, lv_event_t event);
@@ -285,9 +288,13 @@ lv_obj_t* gui_screen_settings_create()
 	lv_obj_set_pos(lbl_sw_metric_units_mode, LC_LBL_MET_X, LC_R4_LBL_Y);
 	lv_label_set_static_text(lbl_sw_metric_units_mode, "Metric");
 	
+	lbl_sw_hist_eq = lv_label_create(settings_screen, NULL);
+	lv_obj_set_pos(lbl_sw_hist_eq, LC_LBL_HEQ_X, LC_R4_LBL_Y);
+	lv_label_set_static_text(lbl_sw_hist_eq, "Hist Eq");
+	
 	lbl_sl_brightness = lv_label_create(settings_screen, NULL);
 	lv_obj_set_pos(lbl_sl_brightness, LC_LBL_BR_X, LC_R4_LBL_Y);
-	lv_label_set_static_text(lbl_sl_brightness, "Display Brightness");
+	lv_label_set_static_text(lbl_sl_brightness, "Brightness");
 	
 	// Row 4 controls
 	sw_metric_units_mode = lv_sw_create(settings_screen, NULL);
@@ -295,6 +302,11 @@ lv_obj_t* gui_screen_settings_create()
 	lv_obj_set_size(sw_metric_units_mode, LC_SW_MET_W, LC_SW_MET_H);
 	lv_obj_set_event_cb(sw_metric_units_mode, cb_sw_metric_units_mode);
 	
+	sw_hist_eq = lv_sw_create(settings_screen, NULL);
+	lv_obj_set_pos(sw_hist_eq, LC_SW_HEQ_X, LC_R4_CTRL_Y);
+	lv_obj_set_size(sw_hist_eq, LC_SW_HEQ_W, LC_SW_HEQ_H);
+	lv_obj_set_event_cb(sw_hist_eq, cb_sw_hist_eq);
+	
 	sl_brightness = lv_slider_create(settings_screen, NULL);
 	lv_obj_set_pos(sl_brightness, LC_SL_BR_X, LC_R4_CTRL_Y);
 	lv_obj_set_size(sl_brightness, LC_SL_BR_W, LC_SL_BR_H);
@@ -373,11 +385,14 @@ void gui_screen_settings_set_active(bool en)
 		lv_obj_set_hidden(dd_gain, !gui_st.is_radiometric);
 		lv_obj_set_hidden(sw_metric_units_mode, !gui_st.is_radiometric);
 		lv_obj_set_hidden(lbl_sw_metric_units_mode, !gui_st.is_radiometric);
+		lv_obj_set_hidden(sw_hist_eq, !gui_st.is_radiometric);
+		lv_obj_set_hidden(lbl_sw_hist_eq, !gui_st.is_radiometric);
 		
 		// Update graphics
 		lv_ddlist_set_selected(dd_gain, lep_stP->gain_mode);
 	
 		gui_st.temp_unit_C ? lv_sw_on(sw_metric_units_mode, LV_ANIM_OFF) : lv_sw_off(sw_metric_units_mode, LV_ANIM_OFF);
+		gui_st.hist_eq_enable ? lv_sw_on(sw_hist_eq, LV_ANIM_OFF) : lv_sw_off(sw_hist_eq, LV_ANIM_OFF);
 	
 		update_emissivity();
 		update_man_range_items();
@@ -416,6 +431,7 @@ static void initialize_screen_values()
 	lv_ddlist_set_selected(dd_rec_interval, i);
 	
 	gui_st.temp_unit_C ? lv_sw_on(sw_metric_units_mode, LV_ANIM_OFF) : lv_sw_off(sw_metric_units_mode, LV_ANIM_OFF);
+	gui_st.hist_eq_enable ? lv_sw_on(sw_hist_eq, LV_ANIM_OFF) : lv_sw_off(sw_hist_eq, LV_ANIM_OFF);
 	
 	update_emissivity();
 	update_man_range_items();
@@ -572,6 +588,15 @@ static void cb_sw_metric_units_mode(lv_obj_t * sw, lv_event_t event)
 }
 
 
+static void cb_sw_hist_eq(lv_obj_t * sw, lv_event_t event)
+{
+	if (event == LV_EVENT_VALUE_CHANGED) {
+		gui_st.hist_eq_enable = lv_sw_get_state(sw);
+		gui_ps_val_updated = true;
+	}
+}
+
+
 static void cb_btn_emissivity(lv_obj_t * sw, lv_event_t event)
 {
 	lep_config_t* lep_stP = lep_get_lep_st();
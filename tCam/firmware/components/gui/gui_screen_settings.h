@@ -109,15 +109,19 @@
 // Row 4 labels
 #define LC_R4_LBL_Y   (LC_R3_CTRL_Y + LC_BTN_EM_H + LC_CTRL_DY)
 #define LC_LBL_MET_X  LC_LEFT_X
-#define LC_LBL_BR_X   (LC_LBL_MET_X + 110)
+#define LC_LBL_HEQ_X  (LC_LBL_MET_X + 110)
+#define LC_LBL_BR_X   (LC_LBL_HEQ_X + 110)
 
 // Row 4 controls
 #define LC_R4_CTRL_Y  (LC_R4_LBL_Y + LC_LBL_DY)
 #define LC_SW_MET_X   LC_LEFT_X
 #define LC_SW_MET_W   80
 #define LC_SW_MET_H   30
-#define LC_SL_BR_X    (LC_SW_MET_X + LC_SW_MET_W + 30)
-#define LC_SL_BR_W    180
+#define LC_SW_HEQ_X   (LC_SW_MET_X + LC_SW_MET_W + 30)
+#define LC_SW_HEQ_W   80
+#define LC_SW_HEQ_H   LC_SW_MET_H
+#define LC_SL_BR_X    (LC_SW_HEQ_X + LC_SW_HEQ_W + 30)
+#define LC_SL_BR_W    100
 #define LC_SL_BR_H    LC_SW_MET_H
 
 
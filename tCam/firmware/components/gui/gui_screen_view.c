@@ -662,7 +662,11 @@ static void update_colormap_marker(lep_buffer_t* sys_bufP)
 		}
 		
 		// Update marker
-		marker_offset = 255 * (max_val - sys_bufP->lep_telemP[LEP_TEL_SPOT_MEAN]) / (max_val - min_val);
+		if (view_gui_st.hist_eq_enable) {
+			marker_offset = 255 - render_heq_map(sys_bufP->lep_telemP[LEP_TEL_SPOT_MEAN]);
+		} else {
+			marker_offset = 255 * (max_val - sys_bufP->lep_telemP[LEP_TEL_SPOT_MEAN]) / (max_val - min_val);
+		}
 		if (marker_offset < 0) marker_offset = 0;
 		if (marker_offset > 255) marker_offset = 255;
 		set_spot_marker(prev_marker_offset, true);
@@ -23,6 +23,7 @@
 #include "lepton_utilities.h"
 #include "ps_utilities.h"
 #include "sys_utilities.h"
+#include "temp_utilities.h"
 #include "gui_screen_settings.h"
 #include "palettes.h"
 #include "system_config.h"
@@ -49,11 +50,16 @@ static lv_obj_t*  msg_box;
 static const char* msg_box_buttons1[] = {"Ok", ""};
 static const char* msg_box_buttons2[] = {"Cancel", "Confirm", ""};
 
+// Temperature conversions for displayed lepton values and for range values (K * 100)
+static temp_conv_t disp_conv;
+static temp_conv_t range_conv;
+
 
 
 //
 // GUI Utilities Forward Declarations for internal functions
 //
+static int gui_get_temp_unit();
 static void gui_message_box(lv_obj_t* parent, const char* msg, bool dual_btn);
 static void mbox_event_callback(lv_obj_t *obj, lv_event_t evt);
 
@@ -81,6 +87,10 @@ void gui_state_init()
 	// Setup to get lepton info
 	lep_info.valid = false;
 	
+	// Initial temperature conversions
+	temp_conv_init(&disp_conv, TEMP_RES_LOW, gui_get_temp_unit());
+	temp_conv_init(&range_conv, TEMP_RES_HIGH, gui_get_temp_unit());
+	
 	// Message box starts off not displayed
 	msg_box_bg = NULL;
 	msg_box = NULL;
@@ -176,20 +186,9 @@ void gui_print_static_centered_text(lv_obj_t* obj, int x, int y, char* s)
  */
 float gui_lep_to_disp_temp(uint16_t v, bool rad_high_res)
 {
-	float t;
-	
-	if (rad_high_res) {
-		t = lepton_kelvin_to_C(v, 0.01);
-	} else {
-		t = lepton_kelvin_to_C(v, 0.1);
-	}
-
-	// Convert to F if required
-	if (!gui_st.temp_unit_C) {
-		t = t * 9.0 / 5.0 + 32.0;
-	}
+	(void) temp_conv_set(&disp_conv, rad_high_res ? TEMP_RES_HIGH : TEMP_RES_LOW, gui_get_temp_unit());
 	
-	return t;
+	return temp_counts_to_temp(&disp_conv, v);
 }
 
 
@@ -198,16 +197,9 @@ float gui_lep_to_disp_temp(uint16_t v, bool rad_high_res)
  */
 float gui_range_val_to_disp_temp(int v)
 {
-	float t;
+	(void) temp_conv_set(&range_conv, TEMP_RES_HIGH, gui_get_temp_unit());
 	
-	t = lepton_kelvin_to_C(v, 0.01);
-
-	// Convert to F if required
-	if (!gui_st.temp_unit_C) {
-		t = t * 9.0 / 5.0 + 32.0;
-	}
-	
-	return t;
+	return temp_counts_to_temp(&range_conv, v);
 }
 
 
@@ -246,18 +238,9 @@ void gui_sprintf_temp_string(char* buf, float t)
  */
 int gui_man_range_val_to_lep(int gui_val)
 {
-	float t;
-	int lep_val;
-	
-	// Convert to C if required
-	if (gui_st.temp_unit_C) {
-		t = gui_val;
-	} else {
-		t = 5.0 * (gui_val - 32) / 9.0;
-	}
+	(void) temp_conv_set(&range_conv, TEMP_RES_HIGH, gui_get_temp_unit());
 	
-	lep_val = (int) round((t + 273.15) * 100);
-    return lep_val;
+	return (int) temp_temp_to_counts(&range_conv, gui_val);
 }
 
 
@@ -266,6 +249,15 @@ int gui_man_range_val_to_lep(int gui_val)
 // GUI Utilities internal functions
 //
 
+/**
+ * Return the temp_utilities unit for the current display units
+ */
+static int gui_get_temp_unit()
+{
+	return gui_st.temp_unit_C ? TEMP_UNIT_C : TEMP_UNIT_F;
+}
+
+
 /**
  * Display a message box with at least one button for dismissal
  */
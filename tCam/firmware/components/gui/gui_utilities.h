@@ -55,6 +55,7 @@ typedef struct {
 	bool spotmeter_enable;
 	bool temp_unit_C;
 	bool man_range_mode;         // Manual range (when camera is in Radiometric mode)
+	bool hist_eq_enable;         // Histogram equalized display (when camera is in Radiometric mode)
 	bool rad_high_res;           // Set by telem when radiometric resolution is 0.01, clear when 0.1
 	bool record_mode;
 	bool recording;
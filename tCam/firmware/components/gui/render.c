@@ -31,11 +31,22 @@
 // Variables
 //
 
+// Histogram equalization.  Pixel values between the range minimum and maximum are
+// binned into heq_hist and the resulting heq_lut maps each bin to an 8-bit value.
+static uint16_t heq_hist[RENDER_HEQ_BINS];
+static uint8_t heq_lut[RENDER_HEQ_BINS];
+static uint16_t heq_min_val;
+static uint16_t heq_max_val;
+static int heq_shift;
+
 
 
 //
 // Forward declarations for internal functions
 //
+static void render_get_rad_range(lep_buffer_t* lep, gui_state_t* g, uint16_t* min_val, uint16_t* max_val);
+static void render_compute_heq_lut(lep_buffer_t* lep, uint16_t min_val, uint16_t max_val);
+static uint8_t render_heq_lookup(uint16_t val);
 static void render_double_rad_data(lep_buffer_t* lep, uint16_t* img, gui_state_t* g);
 static void render_double_agc_data(lep_buffer_t* lep, uint16_t* img);
 static void render_interp_rad_data(lep_buffer_t* lep, uint16_t* img, gui_state_t* g);
@@ -128,10 +139,118 @@ void render_min_max_markers(lep_buffer_t* lep, uint16_t* img)
 }
 
 
+void render_thumbnail(uint8_t* thumb, uint16_t* img, int len)
+{
+	while (len--) {
+		*img++ = PALETTE_LOOKUP(*thumb++);
+	}
+}
+
+
+/**
+ * Return the 8-bit palette index a radiometric value was mapped to by the histogram
+ * equalization of the most recently rendered image
+ */
+uint8_t render_heq_map(uint16_t val)
+{
+	return render_heq_lookup(val);
+}
+
+
 
 //
 // Internal functions
 //
+static void render_get_rad_range(lep_buffer_t* lep, gui_state_t* g, uint16_t* min_val, uint16_t* max_val)
+{
+	if (g->man_range_mode) {
+		// Static user-set range
+		if (g->rad_high_res) {
+			*min_val = g->man_range_min;
+			*max_val = g->man_range_max;
+		} else {
+			*min_val = g->man_range_min / 10;
+			*max_val = g->man_range_max / 10;
+		}
+	} else {
+		// Dynamic range from image
+		*min_val = lep->lep_min_val;
+		*max_val = lep->lep_max_val;
+	}
+}
+
+
+/**
+ * Build the histogram equalization lookup table for an image.  The histogram is
+ * clipped to RENDER_HEQ_CLIP_FACTOR times the mean bin count with the excess spread
+ * evenly over all bins (a global form of contrast limited equalization) so large
+ * uniform areas don't consume most of the palette.
+ */
+static void render_compute_heq_lut(lep_buffer_t* lep, uint16_t min_val, uint16_t max_val)
+{
+	int i;
+	int num_bins;
+	uint16_t v;
+	uint16_t* lepP = lep->lep_bufferP;
+	uint32_t clip;
+	uint32_t excess;
+	uint32_t cum;
+	uint32_t total;
+	
+	if (max_val < min_val) max_val = min_val;
+	heq_min_val = min_val;
+	heq_max_val = max_val;
+	
+	// Size the bins to cover the range
+	heq_shift = 0;
+	while (((uint32_t) (max_val - min_val) >> heq_shift) >= RENDER_HEQ_BINS) {
+		heq_shift++;
+	}
+	num_bins = ((max_val - min_val) >> heq_shift) + 1;
+	
+	// Histogram (pixels outside a manual range are counted at its ends)
+	memset(heq_hist, 0, num_bins * sizeof(uint16_t));
+	do {
+		v = *lepP;
+		if (v < min_val) v = min_val;
+		if (v > max_val) v = max_val;
+		heq_hist[(v - min_val) >> heq_shift]++;
+	} while (++lepP < (lep->lep_bufferP + LEP_WIDTH*LEP_HEIGHT));
+	
+	// Clip and redistribute
+	clip = (RENDER_HEQ_CLIP_FACTOR * LEP_NUM_PIXELS) / num_bins;
+	if (clip == 0) clip = 1;
+	excess = 0;
+	for (i=0; i<num_bins; i++) {
+		if (heq_hist[i] > clip) {
+			excess += heq_hist[i] - clip;
+			heq_hist[i] = clip;
+		}
+	}
+	excess = excess / num_bins;
+	
+	// Map each bin through the cumulative distribution (centered in the bin)
+	total = 0;
+	for (i=0; i<num_bins; i++) {
+		heq_hist[i] += excess;
+		total += heq_hist[i];
+	}
+	cum = 0;
+	for (i=0; i<num_bins; i++) {
+		heq_lut[i] = (uint8_t) (((cum + heq_hist[i]/2) * 255) / total);
+		cum += heq_hist[i];
+	}
+}
+
+
+static uint8_t render_heq_lookup(uint16_t val)
+{
+	if (val <= heq_min_val) return heq_lut[0];
+	if (val > heq_max_val) val = heq_max_val;
+	return heq_lut[(val - heq_min_val) >> heq_shift];
+}
+
+
 static void render_double_rad_data(lep_buffer_t* lep, uint16_t* img, gui_state_t* g)
 {
 	int src_y;
@@ -142,26 +261,19 @@ static void render_double_rad_data(lep_buffer_t* lep, uint16_t* img, gui_state_t
 	uint16_t t16;
 	uint8_t t8;
 	
-	if (g->man_range_mode) {
-		// Static user-set range
-		if (g->rad_high_res) {
-			min_val = g->man_range_min;
-			max_val = g->man_range_max;
-		} else {
-			min_val = g->man_range_min / 10;
-			max_val = g->man_range_max / 10;
-		}
-	} else {
-		// Dynamic range from image
-		min_val = lep->lep_min_val;
-		max_val = lep->lep_max_val;
-	}
+	render_get_rad_range(lep, g, &min_val, &max_val);
 	diff = max_val - min_val;
 	
+	if (g->hist_eq_enable) {
+		render_compute_heq_lut(lep, min_val, max_val);
+	}
+	
 	for (src_y=0; src_y<LEP_HEIGHT; src_y++) {
-		// Linearly scale then double each pixel in a source line into the destination buffer
+		// Scale then double each pixel in a source line into the destination buffer
 		while (ptr < (lep->lep_bufferP + ((src_y+1)*LEP_WIDTH))) {
-			if (*ptr < min_val) {
+			if (g->hist_eq_enable) {
+				t8 = render_heq_lookup(*ptr++);
+			} else if (*ptr < min_val) {
 				t8 = 0;
 				ptr++;
 			} else {
@@ -210,31 +322,26 @@ static void render_interp_rad_data(lep_buffer_t* lep, uint16_t* img, gui_state_t
 	uint16_t min_val, max_val;
 	uint32_t diff;
 	
-	if (g->man_range_mode) {
-		// Static user-set range
-		if (g->rad_high_res) {
-			min_val = g->man_range_min;
-			max_val = g->man_range_max;
-		} else {
-			min_val = g->man_range_min / 10;
-			max_val = g->man_range_max / 10;
-		}
+	render_get_rad_range(lep, g, &min_val, &max_val);
+	diff = max_val - min_val;
+	
+	if (g->hist_eq_enable) {
+		// Equalize the 16-bit data into 8-bits in the render buffer
+		render_compute_heq_lut(lep, min_val, max_val);
+		do {
+			*bufP++ = render_heq_lookup(*lepP);
+		} while (++lepP < (lep->lep_bufferP + LEP_WIDTH*LEP_HEIGHT));
 	} else {
-		// Dynamic range from image
-		min_val = lep->lep_min_val;
-		max_val = lep->lep_max_val;
+		// Linearize the 16-bit data into 8-bits in the render buffer
+		do {
+			if (*lepP < min_val) {
+				*bufP++ = 0;
+			} else {
+				t32 = ((uint32_t)(*lepP - min_val) * 255) / diff;
+				*bufP++ = (t32 > 255) ? 255 : (uint8_t) t32;
+			}
+		} while (++lepP < (lep->lep_bufferP + LEP_WIDTH*LEP_HEIGHT));
 	}
-	diff = max_val - min_val;
-	 
-	// Linearize the 16-bit data into 8-bits in the render buffer
-	do {
-		if (*lepP < min_val) {
-			*bufP++ = 0;
-		} else {
-			t32 = ((uint32_t)(*lepP - min_val) * 255) / diff;
-			*bufP++ = (t32 > 255) ? 255 : (uint8_t) t32;
-		}
-	} while (++lepP < (lep->lep_bufferP + LEP_WIDTH*LEP_HEIGHT));
 	
 	// Render 8-bit data
 	render_interp_agc_data(gui_render_buffer, img);
@@ -44,6 +44,10 @@
 // Min/Max markers
 #define IMG_MM_MARKER_SIZE  10
 
+// Histogram equalization bins and contrast limit (multiple of the mean bin count)
+#define RENDER_HEQ_BINS        1024
+#define RENDER_HEQ_CLIP_FACTOR 4
+
 // Linear Interpolation Scale Factors
 //  DS = Dual Source Pixel case (SF_DS is typically 2 or 3)
 //  QS = Quad Source Pixel case (SF_QS is typically 3 or 5)
@@ -60,5 +64,7 @@
 void render_lep_data(lep_buffer_t* lep, uint16_t* img, gui_state_t* g);
 void render_spotmeter(lep_buffer_t* lep, uint16_t* img);
 void render_min_max_markers(lep_buffer_t* lep, uint16_t* img);
+void render_thumbnail(uint8_t* thumb, uint16_t* img, int len);
+uint8_t render_heq_map(uint16_t val);
 
 #endif /* RENDER_H */
\ No newline at end of file
@@ -0,0 +1,80 @@
+/*
+ * Temporal noise reduction filter
+ *
+ * Per-pixel IIR running average with a motion-adaptive weight operating on 16-bit
+ * Lepton images, in place or into a copy.  Each consumer of images (stream, display,
+ * record) has its own configuration and filter state.
+ *
+ * Copyright 2020-2022 Dan Julio
+ *
+ * This file is part of tCam.
+ *
+ * tCam is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCam is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef FILTER_UTILITIES_H
+#define FILTER_UTILITIES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Filter Utilities Constants
+//
+
+// Image consumers
+#define FILTER_CONSUMER_STREAM  0
+#define FILTER_CONSUMER_DISPLAY 1
+#define FILTER_CONSUMER_RECORD  2
+#define FILTER_NUM_CONSUMERS    3
+
+// Strength sets the weight of a new pixel value in a static scene to 1/2^strength
+#define FILTER_MIN_STRENGTH     1
+#define FILTER_MAX_STRENGTH     4
+
+// Motion threshold (counts).  A pixel that changes by this much or more replaces the
+// filtered value.  Smaller changes are weighted linearly between the static weight
+// and 1.  The maximum keeps the fixed-point arithmetic within 32 bits.
+#define FILTER_MIN_MOTION       1
+#define FILTER_MAX_MOTION       4095
+
+// Defaults
+#define FILTER_DEF_STRENGTH     2
+#define FILTER_DEF_MOTION       100
+
+
+
+//
+// Filter Utilities typedefs
+//
+typedef struct {
+	bool enable;
+	int strength;
+	int motion;
+} filter_config_t;
+
+
+
+//
+// Filter Utilities API
+//
+bool filter_init();
+bool filter_set_config(int consumer, const filter_config_t* config);
+bool filter_get_config(int consumer, filter_config_t* config);
+void filter_reset(int consumer);
+bool filter_apply(int consumer, uint16_t* buf, int* min_index, int* max_index);
+bool filter_apply_copy(int consumer, const uint16_t* src, uint16_t* dst, int* min_index, int* max_index);
+
+#endif /* FILTER_UTILITIES_H */
@@ -107,8 +107,9 @@ void lepton_set_time()
 
 void lepton_stream_on()
 {
-	// Load a stream_on command
-	sys_cmd_lep_buffer.length = json_get_stream_on_cmd(sys_cmd_lep_buffer.bufferP, 0, 0);
+	// Load a stream_on command requesting binary image frames (older tCam-Mini firmware
+	// ignores the request and continues to send json image strings)
+	sys_cmd_lep_buffer.length = json_get_stream_on_cmd(sys_cmd_lep_buffer.bufferP, 0, 0, true);
 	if (sys_cmd_lep_buffer.length != 0) {
 		lepton_push_cmd(sys_cmd_lep_buffer.bufferP, sys_cmd_lep_buffer.length);
 	}
@@ -5,11 +5,15 @@
 #include "disp_driver.h"
 #include "disp_spi.h"
 #include "ili9488.h"
+#include <string.h>
 #ifdef SYS_SCREENDUMP_ENABLE
 #include "mem_fb.h"
 #endif
 
 
+static bool disp_driver_write_strips(const lv_area_t * area, const lv_color_t * src);
+
+
 #ifdef SYS_SCREENDUMP_ENABLE
 static bool enable_dump;
 
@@ -35,6 +39,16 @@ void disp_driver_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t *
 	}
 }
 
+bool disp_driver_write_direct(const lv_area_t * area, const lv_color_t * src)
+{
+	if (enable_dump) {
+		// Let LVGL redraw the area into the screendump frame buffer
+		return false;
+	}
+	
+	return disp_driver_write_strips(area, src);
+}
+
 void disp_driver_en_dump(bool en_dump)
 {
 	enable_dump = en_dump;
@@ -53,4 +67,64 @@ void disp_driver_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t *
 {
 	ili9488_flush(drv, area, color_map);
 }
+
+bool disp_driver_write_direct(const lv_area_t * area, const lv_color_t * src)
+{
+	return disp_driver_write_strips(area, src);
+}
 #endif
+
+
+/**
+ * Write a block of pixels from any memory (e.g. PSRAM) directly to an area of the
+ * display, bypassing LVGL.  The pixels are copied a strip of lines at a time into
+ * LVGL's DMA capable draw buffers, alternating buffers so one strip is copied while
+ * the previous one is transferred.  Must be called from the task running LVGL so
+ * the draw buffers are not being rendered into.  Returns when the transfer is done.
+ */
+static bool disp_driver_write_strips(const lv_area_t * area, const lv_color_t * src)
+{
+	lv_disp_buf_t * vdb = lv_disp_get_buf(lv_disp_get_default());
+	lv_color_t * buf[2];
+	lv_area_t strip;
+	lv_coord_t w = lv_area_get_width(area);
+	lv_coord_t lines;
+	uint32_t len;
+	int max_pending;
+	int n = 0;
+	
+	lines = vdb->size / w;
+	if (lines == 0) return false;
+	
+	buf[0] = vdb->buf1;
+	buf[1] = (vdb->buf2 != NULL) ? vdb->buf2 : vdb->buf1;
+	
+	// A buffer may be refilled once no more than the strip queued from the other
+	// buffer is outstanding
+	max_pending = (buf[0] == buf[1]) ? 0 : ILI9488_WRITE_TRANS;
+	
+	// Wait for any LVGL flush to finish with the buffers
+	disp_spi_wait_idle();
+	
+	strip.x1 = area->x1;
+	strip.x2 = area->x2;
+	strip.y1 = area->y1;
+	while (strip.y1 <= area->y2) {
+		strip.y2 = strip.y1 + lines - 1;
+		if (strip.y2 > area->y2) strip.y2 = area->y2;
+		len = w * lv_area_get_height(&strip);
+		
+		disp_spi_wait_pending(max_pending);
+		memcpy(buf[n], src, len * sizeof(lv_color_t));
+		ili9488_write(&strip, buf[n]);
+		
+		src += len;
+		strip.y1 = strip.y2 + 1;
+		n ^= 1;
+	}
+	
+	// LVGL may render into the buffers once we return
+	disp_spi_wait_idle();
+	
+	return true;
+}
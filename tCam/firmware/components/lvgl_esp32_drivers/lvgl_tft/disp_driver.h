@@ -32,6 +32,7 @@ extern "C" {
  **********************/
 void disp_driver_init(bool init_spi);
 void disp_driver_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_map);
+bool disp_driver_write_direct(const lv_area_t * area, const lv_color_t * src);
 #ifdef SYS_SCREENDUMP_ENABLE
 void disp_driver_en_dump(bool en_dump);
 #endif
@@ -25,6 +25,14 @@
 /*********************
  *      DEFINES
  *********************/
+// Number of transactions that may be queued.  A display flush is a chain of 6
+// transactions (3 command/data pairs) so this allows the next flush to be queued
+// while the previous one is finishing.
+#define DISP_SPI_QUEUE_SIZE 12
+
+// Bits in a transaction's user field
+#define DISP_SPI_USER_DC    0x01    // DC level during the transaction (1 = data)
+#define DISP_SPI_USER_FLUSH 0x02    // Call lv_disp_flush_ready when the transaction ends
 
 
 /**********************
@@ -35,15 +43,24 @@
 /**********************
  *  STATIC PROTOTYPES
  **********************/
+static void IRAM_ATTR spi_pre_transfer(spi_transaction_t *trans);
 static void IRAM_ATTR spi_ready (spi_transaction_t *trans);
+static spi_transaction_t* disp_spi_get_trans(void);
+static void disp_spi_reclaim(int max_pending);
 
 
 /**********************
  *  STATIC VARIABLES
  **********************/
 static spi_device_handle_t spi;
-static volatile bool spi_trans_in_progress = false;
-static volatile bool spi_color_sent;
+
+// Transactions must remain valid until their results are fetched so they are
+// allocated round-robin from a pool the size of the device queue
+static spi_transaction_t trans_pool[DISP_SPI_QUEUE_SIZE];
+static int trans_pool_index = 0;
+static int trans_pending = 0;
+
+static int disp_dc_io = -1;
 
 
 /**********************
@@ -60,8 +77,8 @@ void disp_spi_add_device(spi_host_device_t host)
             .clock_speed_hz=DISP_SPI_HZ,
             .mode=LCD_SPI_MODE,
             .spics_io_num=DISP_SPI_CS,
-            .queue_size=1,
-            .pre_cb=NULL,
+            .queue_size=DISP_SPI_QUEUE_SIZE,
+            .pre_cb=spi_pre_transfer,
             .post_cb=spi_ready,
             .cs_ena_pretrans = 2,            // Make sure CS brackets transaction with enough
             .cs_ena_posttrans= 2,            //   time for setup/hold on serial-parallel circuit
@@ -96,45 +113,98 @@ void disp_spi_init(void)
 }
 
 
-void disp_spi_send_data(uint8_t * data, uint16_t length)
+/**
+ * Set the GPIO driven with the DC level of each queued transaction (set before
+ * the transaction starts by the pre-transfer callback)
+ */
+void disp_spi_set_dc_io(int dc_io)
 {
-    if (length == 0) return;           //no need to send anything
+    disp_dc_io = dc_io;
+}
 
-    while (spi_trans_in_progress);
 
-    spi_transaction_t t = {
-        .length = length * 8, // transaction length is in bits
-        .tx_buffer = data
-    };
+/**
+ * Queue a command byte (DC low).  Returns immediately.
+ */
+void disp_spi_queue_cmd(uint8_t cmd)
+{
+    spi_transaction_t* t = disp_spi_get_trans();
 
-    spi_trans_in_progress = true;
-    spi_color_sent = false;             //Mark the "lv_flush_ready" NOT needs to be called in "spi_ready"
-    spi_device_queue_trans(spi, &t, portMAX_DELAY);
+    t->flags = SPI_TRANS_USE_TXDATA;
+    t->length = 8;
+    t->tx_data[0] = cmd;
+    t->user = (void*) 0;
+    spi_device_queue_trans(spi, t, portMAX_DELAY);
 }
 
 
-void disp_spi_send_colors(uint8_t * data, uint16_t length)
+/**
+ * Queue parameter data (DC high).  Up to 4 bytes are copied into the transaction
+ * so data may be on the caller's stack, otherwise it must remain valid until the
+ * transaction completes.  Returns immediately.
+ */
+void disp_spi_queue_data(const uint8_t * data, uint32_t length)
 {
-    if (length == 0) {
-	return;
+    spi_transaction_t* t;
+
+    if (length == 0) return;
+
+    t = disp_spi_get_trans();
+    if (length <= 4) {
+        t->flags = SPI_TRANS_USE_TXDATA;
+        memcpy(t->tx_data, data, length);
+    } else {
+        t->flags = 0;
+        t->tx_buffer = data;
     }
+    t->length = length * 8;
+    t->user = (void*) DISP_SPI_USER_DC;
+    spi_device_queue_trans(spi, t, portMAX_DELAY);
+}
 
-    while(spi_trans_in_progress);
 
-    spi_transaction_t t = {
-        .length = length * 8, // transaction length is in bits
-        .tx_buffer = data
-    };
-    
-    spi_trans_in_progress = true;
-    spi_color_sent = true;              //Mark the "lv_flush_ready" needs to be called in "spi_ready"
-    spi_device_queue_trans(spi, &t, portMAX_DELAY);
+/**
+ * Queue pixel data (DC high) from a DMA capable buffer.  If notify is set LVGL is
+ * told the buffer may be reused when the transfer completes.  Returns immediately.
+ */
+void disp_spi_queue_colors(const uint8_t * data, uint32_t length, bool notify)
+{
+    spi_transaction_t* t;
+
+    if (length == 0) return;
+
+    t = disp_spi_get_trans();
+    t->flags = 0;
+    t->tx_buffer = data;
+    t->length = length * 8;
+    t->user = (void*) (notify ? (DISP_SPI_USER_DC | DISP_SPI_USER_FLUSH) : DISP_SPI_USER_DC);
+    spi_device_queue_trans(spi, t, portMAX_DELAY);
+}
+
+
+/**
+ * Block until no more than max_pending of the most recently queued transactions
+ * are outstanding
+ */
+void disp_spi_wait_pending(int max_pending)
+{
+    disp_spi_reclaim(max_pending);
+}
+
+
+/**
+ * Block until all queued transactions have completed
+ */
+void disp_spi_wait_idle(void)
+{
+    disp_spi_reclaim(0);
 }
 
 
 bool disp_spi_is_busy(void)
 {
-    return spi_trans_in_progress;
+    disp_spi_reclaim(-1);
+    return (trans_pending != 0);
 }
 
 
@@ -143,10 +213,59 @@ bool disp_spi_is_busy(void)
  *   STATIC FUNCTIONS
  **********************/
 
+static void IRAM_ATTR spi_pre_transfer(spi_transaction_t *trans)
+{
+    if (disp_dc_io >= 0) {
+        gpio_set_level(disp_dc_io, (uint32_t) trans->user & DISP_SPI_USER_DC);
+    }
+}
+
+
 static void IRAM_ATTR spi_ready (spi_transaction_t *trans)
 {
-    spi_trans_in_progress = false;
+    if ((uint32_t) trans->user & DISP_SPI_USER_FLUSH) {
+        lv_disp_t * disp = lv_refr_get_disp_refreshing();
+        lv_disp_flush_ready(&disp->driver);
+    }
+}
+
 
-    lv_disp_t * disp = lv_refr_get_disp_refreshing();
-    if (spi_color_sent) lv_disp_flush_ready(&disp->driver);
+/**
+ * Return the next free transaction from the pool, first fetching the results of
+ * completed transactions if necessary to free it
+ */
+static spi_transaction_t* disp_spi_get_trans(void)
+{
+    spi_transaction_t* t;
+
+    disp_spi_reclaim(DISP_SPI_QUEUE_SIZE - 1);
+
+    t = &trans_pool[trans_pool_index];
+    if (++trans_pool_index >= DISP_SPI_QUEUE_SIZE) trans_pool_index = 0;
+    memset(t, 0, sizeof(spi_transaction_t));
+    trans_pending++;
+
+    return t;
+}
+
+
+/**
+ * Fetch transaction results until no more than max_pending are outstanding.  A
+ * negative max_pending fetches only the results already available without blocking.
+ */
+static void disp_spi_reclaim(int max_pending)
+{
+    spi_transaction_t* rt;
+
+    if (max_pending < 0) {
+        while ((trans_pending > 0) && (spi_device_get_trans_result(spi, &rt, 0) == ESP_OK)) {
+            trans_pending--;
+        }
+    } else {
+        while (trans_pending > max_pending) {
+            if (spi_device_get_trans_result(spi, &rt, portMAX_DELAY) == ESP_OK) {
+                trans_pending--;
+            }
+        }
+    }
 }
@@ -49,8 +49,12 @@ extern "C" {
  **********************/
 void disp_spi_init(void);
 void disp_spi_add_device(spi_host_device_t host);
-void disp_spi_send_data(uint8_t * data, uint16_t length);
-void disp_spi_send_colors(uint8_t * data, uint16_t length);
+void disp_spi_set_dc_io(int dc_io);
+void disp_spi_queue_cmd(uint8_t cmd);
+void disp_spi_queue_data(const uint8_t * data, uint32_t length);
+void disp_spi_queue_colors(const uint8_t * data, uint32_t length, bool notify);
+void disp_spi_wait_pending(int max_pending);
+void disp_spi_wait_idle(void);
 bool disp_spi_is_busy(void);
 
 /**********************
@@ -37,9 +37,9 @@ typedef struct {
 /**********************
  *  STATIC PROTOTYPES
  **********************/
+static void ili9488_queue_area(const lv_area_t * area, lv_color_t * color_map, bool notify);
 static void ili9488_send_cmd(uint8_t cmd);
 static void ili9488_send_data(void * data, uint16_t length);
-static void ili9488_send_color(void * data, uint16_t length);
 
 
 
@@ -82,6 +82,7 @@ void ili9488_init(void)
 	//Initialize non-SPI GPIOs
 	gpio_reset_pin(ILI9488_DC);
 	gpio_set_direction(ILI9488_DC, GPIO_MODE_OUTPUT);
+	disp_spi_set_dc_io(ILI9488_DC);
 
 	ESP_LOGI(TAG, "ILI9488 initialization.");
 
@@ -111,7 +112,30 @@ void ili9488_init(void)
 }
 
 // Flush function based on mvturnho repo
+//
+// The address-set, memory write and pixel data transactions are queued as one chain
+// with DC driven per-transaction so this returns immediately.  LVGL renders into its
+// other buffer while this one is transferred and is notified by disp_spi when the
+// pixel data has been sent.
 void ili9488_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_map)
+{
+	ili9488_queue_area(area, color_map, true);
+}
+
+// Queue a write of pixels from a DMA capable buffer to an area without notifying
+// LVGL.  The ILI9488_WRITE_TRANS transactions have been queued when this returns.
+void ili9488_write(const lv_area_t * area, lv_color_t * color_map)
+{
+	ili9488_queue_area(area, color_map, false);
+}
+
+
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static void ili9488_queue_area(const lv_area_t * area, lv_color_t * color_map, bool notify)
 {
     uint32_t size = lv_area_get_width(area) * lv_area_get_height(area);
 
@@ -132,43 +156,27 @@ void ili9488_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * col
 	};
 
 	/*Column addresses*/
-	ili9488_send_cmd(ILI9488_CMD_COLUMN_ADDRESS_SET);
-	ili9488_send_data(xb, 4);
+	disp_spi_queue_cmd(ILI9488_CMD_COLUMN_ADDRESS_SET);
+	disp_spi_queue_data(xb, 4);
 
 	/*Page addresses*/
-	ili9488_send_cmd(ILI9488_CMD_PAGE_ADDRESS_SET);
-	ili9488_send_data(yb, 4);
+	disp_spi_queue_cmd(ILI9488_CMD_PAGE_ADDRESS_SET);
+	disp_spi_queue_data(yb, 4);
 
 	/*Memory write*/
-	ili9488_send_cmd(ILI9488_CMD_MEMORY_WRITE);
-	ili9488_send_color((void *) color_map, size * 2);
+	disp_spi_queue_cmd(ILI9488_CMD_MEMORY_WRITE);
+	disp_spi_queue_colors((uint8_t *) color_map, size * 2, notify);
 }
 
-
-
-/**********************
- *   STATIC FUNCTIONS
- **********************/
-
-
+// Blocking command and data used during initialization
 static void ili9488_send_cmd(uint8_t cmd)
 {
-	while(disp_spi_is_busy()) {}
-	gpio_set_level(ILI9488_DC, 0);	 /*Command mode*/
-	disp_spi_send_data(&cmd, 1);
+	disp_spi_queue_cmd(cmd);
+	disp_spi_wait_idle();
 }
 
 static void ili9488_send_data(void * data, uint16_t length)
 {
-	while(disp_spi_is_busy()) {}
-	gpio_set_level(ILI9488_DC, 1);	 /*Data mode*/
-	disp_spi_send_data(data, length);
+	disp_spi_queue_data((uint8_t *) data, length);
+	disp_spi_wait_idle();
 }
-
-static void ili9488_send_color(void * data, uint16_t length)
-{
-	while(disp_spi_is_busy()) {}
-	gpio_set_level(ILI9488_DC, 1);   /*Data mode*/
-	disp_spi_send_colors(data, length);
-}
-
@@ -27,6 +27,9 @@ extern "C" {
 // if text/images are backwards, try setting this to 1
 #define ILI9488_INVERT_DISPLAY 0
 
+// Number of SPI transactions queued to write an area
+#define ILI9488_WRITE_TRANS 6
+
 /*******************
  * ILI9488 REGS
 *********************/
@@ -140,6 +143,7 @@ extern "C" {
  **********************/
 void ili9488_init(void);
 void ili9488_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_map);
+void ili9488_write(const lv_area_t * area, lv_color_t * color_map);
 
 
 
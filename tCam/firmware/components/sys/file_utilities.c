@@ -37,6 +37,7 @@
 #include "sdmmc_cmd.h"
 #include "diskio.h"
 #include "diskio_sdmmc.h"
+#include "esp_rom_crc.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <string.h>
@@ -58,6 +59,59 @@
 //#define DEBUG_FS_INFO_STRUCT
 
 
+
+//
+// File Utilities internal data structures
+//
+
+// Catalog cache file header.  The file is valid for the card when the card serial number
+// and the number of free clusters match the values stored when it was written (any file
+// written or deleted by another host will almost certainly change the free cluster count).
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t card_serial;
+	uint32_t free_clusters;
+	uint32_t num_dirs;
+	uint32_t num_files;
+	uint32_t crc;             // CRC32 of all records following the header
+} catalog_cache_header_t;
+
+// Catalog cache directory record.  Followed by num_files file records.
+typedef struct {
+	char name[DIR_NAME_LEN];
+	uint16_t fdate;
+	uint16_t ftime;
+	int32_t num_entries;
+	int32_t num_files;
+} catalog_cache_dir_t;
+
+// Catalog cache file record
+typedef struct {
+	char name[FILE_NAME_LEN];
+	uint32_t size;
+	int32_t num_frames;
+	uint16_t fdate;
+	uint16_t ftime;
+} catalog_cache_file_t;
+
+
+// Thumbnail container header
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint8_t width;
+	uint8_t height;
+} thumb_header_t;
+
+// Thumbnail container record header.  Followed by FILE_THUMB_LEN bytes of image data.
+// The file size identifies stale records for a file name that was reused.
+typedef struct {
+	char name[FILE_NAME_LEN];
+	uint32_t size;
+} thumb_record_t;
+
+
 //
 // File Utilities internal variables
 //
@@ -88,10 +142,17 @@ static char write_file_name[FILE_NAME_LEN];
 // Pointer to indexed storage
 static void* file_info_cur_bufferP;
 static directory_node_t* indexed_fs_rootP;
+static bool file_info_full;                      // Set when an allocation did not fit
 
 // Mutex to protect access to the indexed storage data structure
 static SemaphoreHandle_t catalog_mutex;
 
+// Catalog cache file object (statically allocated because it contains a sector buffer)
+static FIL cache_fil;
+
+// Thumbnail container file object
+static FIL thumb_fil;
+
 // Card Info
 static uint64_t card_total_bytes = 0;
 static uint64_t card_free_bytes = 0;
@@ -103,7 +164,23 @@ static uint64_t card_free_bytes = 0;
 //
 static void file_get_card_stats();
 static bool file_create_directory(char* dir_name);
+static bool file_load_catalog_cache(bool* valid);
+static bool file_read_cache_record(void* rec, int len, uint32_t* crc);
+static bool file_write_cache_record(void* rec, int len, uint32_t* crc);
+static uint32_t file_get_free_clusters();
+static bool file_thumb_header_valid();
+static bool file_scan_directory(directory_node_t* dirP);
+static bool file_scan_top_directory(directory_node_t** cached_rootPP, int* num_rescanned);
+static int file_count_directory_entries(char* name);
+static void file_reset_filesystem_info();
+static directory_node_t* file_find_directory_node(directory_node_t* rootP, char* name);
+static bool file_page_dir_match(file_page_req_t* req, directory_node_t* dirP, int dir_index);
+static bool file_page_file_match(file_page_req_t* req, file_node_t* fileP);
+static uint32_t file_fat_to_secs(uint16_t fdate, uint16_t ftime);
+static uint32_t file_names_to_secs(char* dir_name, char* file_name);
+static uint32_t file_date_to_secs(int year, int month, int day, int hour, int min, int sec);
 static directory_node_t* file_insert_directory_info(char* name);
+static void file_link_directory_info(directory_node_t* newP);
 static file_node_t* file_insert_file_info(directory_node_t* dirP, char* name);
 static directory_node_t* file_allocate_dir_entry();
 static file_node_t* file_allocate_file_entry();
@@ -493,69 +570,88 @@ void file_unmount_sdcard()
 
 
 /**
- * Traverse the storage medium finding tCam related directories and files and
- * create a filesystem information structure.  Should only be called on a mounted
- * filesystem.
+ * Create the filesystem information structure.  The catalog cache file is loaded first
+ * and used as-is if it is still valid for the card.  Otherwise the storage medium is
+ * traversed finding tCam related directories and files.  Directories in a loaded (but
+ * stale) cache whose date/time and entry count are unchanged are taken from the cache
+ * and only the remaining directories are rescanned.  FATFS does not update a directory's
+ * date/time when its contents change so the entry count catches files added or deleted
+ * by another device.  Should only be called on a mounted filesystem.
  */
 bool file_create_filesystem_info()
 {
-	bool success = true;
-    FF_DIR top_dir;
-    FF_DIR file_dir;
-    FRESULT res;
-    static FILINFO dir_fno;
-    static FILINFO file_fno;
-    char dir_name[sizeof(dir_fno.fname) + 2];
-    directory_node_t* cur_dirP;
+	bool cache_valid;
+	bool have_cache = false;
+	bool success;
+	directory_node_t* cached_rootP = NULL;
+	int num_rescanned = 0;
     
 #ifdef DEBUG_FS_INFO_STRUCT
 	ESP_LOGI(TAG, "file_create_filesystem_info()");
 #endif
 
-    // Start allocating at the start of our buffer
-    file_info_cur_bufferP = file_info_bufferP;
-    indexed_fs_rootP = NULL;
-    
-	// Open the top-level directory
-	res = f_opendir(&top_dir, "/");
-	if (res == FR_OK) {
-		// Scan through all directories at the top level
-		for (;;) {
-			res = f_readdir(&top_dir, &dir_fno);
-			if ((res != FR_OK) || (dir_fno.fname[0] == 0)) {
-				// Break on error or end of dir
-				break;
-			}
-			// Look for valid tcam directories
-			if ((dir_fno.fattrib & AM_DIR) && file_is_valid_dir(dir_fno.fname)) {
-				// Add the directory to the filesystem information structure
-				cur_dirP = file_insert_directory_info(dir_fno.fname);
-				
-				// Open the tcam directory
-				sprintf(dir_name, "/%s", dir_fno.fname);
-				res = f_opendir(&file_dir, dir_name);
-				if (res == FR_OK) {
-					// Scan through the tcam directory
-					for (;;) {
-						res = f_readdir(&file_dir, &file_fno);
-						if ((res != FR_OK) || (file_fno.fname[0] == 0)) {
-							// Break on error or end of dir
-							break;
-						}
-						// Look for valid tcam files
-						if (((file_fno.fattrib & AM_DIR) == 0) && (file_fno.fsize != 0) && file_is_valid_name(file_fno.fname)) {
-							// Add the file to the filesystem information structure
-							(void) file_insert_file_info(cur_dirP, file_fno.fname);
-						}
-					}
-					f_closedir(&file_dir);
+	// Start allocating at the start of our buffer
+	file_reset_filesystem_info();
+	
+	// Attempt to load the catalog cache
+	if (file_load_catalog_cache(&cache_valid)) {
+		if (cache_valid) {
+			ESP_LOGI(TAG, "Using catalog cache");
+#ifdef DEBUG_FS_INFO_STRUCT
+			dump_filesystem_info();
+#endif
+			return true;
+		}
+		
+		// Hold on to the stale cache so unchanged directories don't have to be rescanned
+		have_cache = true;
+		cached_rootP = indexed_fs_rootP;
+		indexed_fs_rootP = NULL;
+	} else {
+		// Discard anything partially loaded
+		file_reset_filesystem_info();
+	}
+	
+	success = file_scan_top_directory(&cached_rootP, &num_rescanned);
+	
+	// Stale cache records replaced by a rescan (or of deleted directories) are left in
+	// the buffer since it is only ever appended
+	have_cache = have_cache && ((num_rescanned != 0) || (cached_rootP != NULL));
+	
+	if (success && have_cache && file_info_full) {
+		// The stale records used room needed for new ones so rebuild from scratch
+		ESP_LOGI(TAG, "Catalog full - rebuilding without cache");
+		file_reset_filesystem_info();
+		have_cache = false;
+		cached_rootP = NULL;
+		num_rescanned = 0;
+		success = file_scan_top_directory(&cached_rootP, &num_rescanned);
+	}
+	
+	if (success) {
+		// Update the cache file so it is valid the next time the card is mounted
+		if (file_save_filesystem_info()) {
+			if (have_cache) {
+				// Reload the cache just written to drop the stale records from our buffer
+				file_reset_filesystem_info();
+				if (!file_load_catalog_cache(&cache_valid) || !cache_valid) {
+					ESP_LOGE(TAG, "Could not reload catalog cache");
+					file_reset_filesystem_info();
+					cached_rootP = NULL;
+					num_rescanned = 0;
+					success = file_scan_top_directory(&cached_rootP, &num_rescanned);
 				}
 			}
+		} else {
+			ESP_LOGE(TAG, "Could not save catalog cache");
 		}
-		f_closedir(&top_dir);
-	} else {
-		success = false;
+		ESP_LOGI(TAG, "Scanned %d directories", num_rescanned);
+	}
+	
+	if (file_info_full) {
+		ESP_LOGE(TAG, "Catalog buffer full - some files are not listed");
 	}
+	
 #ifdef DEBUG_FS_INFO_STRUCT
 	dump_filesystem_info();
 #endif
@@ -563,6 +659,217 @@ bool file_create_filesystem_info()
 }
 
 
+/**
+ * Write the filesystem information structure to the catalog cache file.  Should only be
+ * called on a mounted filesystem after the catalog has been modified.
+ */
+bool file_save_filesystem_info()
+{
+	bool success = true;
+	catalog_cache_header_t header;
+	catalog_cache_dir_t dir_rec;
+	catalog_cache_file_t file_rec;
+	directory_node_t* dirP;
+	file_node_t* fileP;
+	FRESULT res;
+	static FILINFO fno;
+	char dir_name[sizeof(fno.fname) + 2];
+	uint32_t crc = 0;
+	
+	xSemaphoreTake(catalog_mutex, portMAX_DELAY);
+	
+	res = f_open(&cache_fil, CATALOG_CACHE_NAME, FA_WRITE | FA_CREATE_ALWAYS);
+	if (res != FR_OK) {
+		xSemaphoreGive(catalog_mutex);
+		ESP_LOGE(TAG, "Could not open %s for writing (%d)", CATALOG_CACHE_NAME, res);
+		return false;
+	}
+	
+	// Reserve space for the header (written last when the free cluster count is known)
+	memset(&header, 0, sizeof(catalog_cache_header_t));
+	success = file_write_cache_record(&header, sizeof(catalog_cache_header_t), NULL);
+	
+	dirP = indexed_fs_rootP;
+	while (success && (dirP != NULL)) {
+		// Get the date/time for directories created since the catalog was built
+		if ((dirP->fdate == 0) && (dirP->ftime == 0)) {
+			sprintf(dir_name, "/%s", dirP->nameP);
+			if (f_stat(dir_name, &fno) == FR_OK) {
+				dirP->fdate = fno.fdate;
+				dirP->ftime = fno.ftime;
+			}
+		}
+		
+		memset(&dir_rec, 0, sizeof(catalog_cache_dir_t));
+		strncpy(dir_rec.name, dirP->nameP, DIR_NAME_LEN - 1);
+		dir_rec.fdate = dirP->fdate;
+		dir_rec.ftime = dirP->ftime;
+		dir_rec.num_entries = dirP->num_entries;
+		dir_rec.num_files = dirP->num_files;
+		success = file_write_cache_record(&dir_rec, sizeof(catalog_cache_dir_t), &crc);
+		header.num_dirs += 1;
+		
+		fileP = dirP->fileP;
+		while (success && (fileP != NULL)) {
+			memset(&file_rec, 0, sizeof(catalog_cache_file_t));
+			strncpy(file_rec.name, fileP->nameP, FILE_NAME_LEN - 1);
+			file_rec.size = fileP->size;
+			file_rec.num_frames = fileP->num_frames;
+			file_rec.fdate = fileP->fdate;
+			file_rec.ftime = fileP->ftime;
+			success = file_write_cache_record(&file_rec, sizeof(catalog_cache_file_t), &crc);
+			header.num_files += 1;
+			fileP = fileP->nextP;
+		}
+		
+		dirP = dirP->nextP;
+	}
+	
+	// Flush the file so the free cluster count reflects its final size and then
+	// rewrite the header in place (which doesn't change the file's allocation)
+	if (success) {
+		success = (f_sync(&cache_fil) == FR_OK);
+	}
+	if (success) {
+		header.magic = CATALOG_CACHE_MAGIC;
+		header.version = CATALOG_CACHE_VERSION;
+		header.card_serial = (uint32_t) sd_card.cid.serial;
+		header.free_clusters = file_get_free_clusters();
+		header.crc = crc;
+		if (f_lseek(&cache_fil, 0) == FR_OK) {
+			success = file_write_cache_record(&header, sizeof(catalog_cache_header_t), NULL);
+		} else {
+			success = false;
+		}
+	}
+	
+	f_close(&cache_fil);
+	
+	// Don't leave a partial cache file that could be mistaken for a valid one
+	if (!success) {
+		(void) f_unlink(CATALOG_CACHE_NAME);
+	}
+	
+	xSemaphoreGive(catalog_mutex);
+	
+#ifdef DEBUG_FS_INFO_STRUCT
+	ESP_LOGI(TAG, "%d <- file_save_filesystem_info() (%d dirs, %d files)", success, header.num_dirs, header.num_files);
+#endif
+	
+	return success;
+}
+
+
+/**
+ * Read the thumbnail for a file from its directory's thumbnail container.  size is the
+ * current length of the file.  Returns false if there is no matching thumbnail.
+ */
+bool file_read_thumbnail(char* dir_name, char* file_name, uint32_t size, uint8_t* thumb)
+{
+	bool found = false;
+	char full_name[DIR_NAME_LEN + sizeof(FILE_THUMB_NAME) + 3];
+	thumb_record_t rec;
+	UINT n;
+	
+	sprintf(full_name, "/%s/%s", dir_name, FILE_THUMB_NAME);
+	if (f_open(&thumb_fil, full_name, FA_READ) != FR_OK) {
+		return false;
+	}
+	
+	if (file_thumb_header_valid()) {
+		// Search the records (skipping over image data)
+		for (;;) {
+			if ((f_read(&thumb_fil, &rec, sizeof(thumb_record_t), &n) != FR_OK) || (n != sizeof(thumb_record_t))) {
+				break;
+			}
+			if ((rec.size == size) && (strncmp(rec.name, file_name, FILE_NAME_LEN) == 0)) {
+				if ((f_read(&thumb_fil, thumb, FILE_THUMB_LEN, &n) == FR_OK) && (n == FILE_THUMB_LEN)) {
+					found = true;
+				}
+				break;
+			}
+			if (f_lseek(&thumb_fil, f_tell(&thumb_fil) + FILE_THUMB_LEN) != FR_OK) {
+				break;
+			}
+		}
+	}
+	
+	f_close(&thumb_fil);
+	
+	return found;
+}
+
+
+/**
+ * Append the thumbnail for a file to its directory's thumbnail container, creating the
+ * container if necessary.
+ */
+bool file_write_thumbnail(char* dir_name, char* file_name, uint32_t size, uint8_t* thumb)
+{
+	bool created = false;
+	char full_name[DIR_NAME_LEN + sizeof(FILE_THUMB_NAME) + 3];
+	directory_node_t* dirP;
+	thumb_header_t header;
+	thumb_record_t rec;
+	UINT n;
+	
+	sprintf(full_name, "/%s/%s", dir_name, FILE_THUMB_NAME);
+	
+	if (f_open(&thumb_fil, full_name, FA_READ | FA_WRITE | FA_OPEN_EXISTING) == FR_OK) {
+		if (!file_thumb_header_valid()) {
+			// Unusable container - start over
+			f_close(&thumb_fil);
+			if (f_open(&thumb_fil, full_name, FA_READ | FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) {
+				ESP_LOGE(TAG, "Could not recreate %s", full_name);
+				return false;
+			}
+		}
+	} else if (f_open(&thumb_fil, full_name, FA_READ | FA_WRITE | FA_CREATE_NEW) == FR_OK) {
+		created = true;
+	} else {
+		ESP_LOGE(TAG, "Could not create %s", full_name);
+		return false;
+	}
+	
+	if (f_size(&thumb_fil) == 0) {
+		header.magic = FILE_THUMB_MAGIC;
+		header.version = FILE_THUMB_VERSION;
+		header.width = FILE_THUMB_WIDTH;
+		header.height = FILE_THUMB_HEIGHT;
+		if ((f_write(&thumb_fil, &header, sizeof(thumb_header_t), &n) != FR_OK) || (n != sizeof(thumb_header_t))) {
+			f_close(&thumb_fil);
+			return false;
+		}
+	}
+	
+	memset(rec.name, 0, FILE_NAME_LEN);
+	strncpy(rec.name, file_name, FILE_NAME_LEN - 1);
+	rec.size = size;
+	
+	if ((f_lseek(&thumb_fil, f_size(&thumb_fil)) != FR_OK) ||
+	    (f_write(&thumb_fil, &rec, sizeof(thumb_record_t), &n) != FR_OK) || (n != sizeof(thumb_record_t)) ||
+	    (f_write(&thumb_fil, thumb, FILE_THUMB_LEN, &n) != FR_OK) || (n != FILE_THUMB_LEN)) {
+		ESP_LOGE(TAG, "Could not write thumbnail to %s", full_name);
+		f_close(&thumb_fil);
+		return false;
+	}
+	
+	f_close(&thumb_fil);
+	
+	// Count the new container's directory entry
+	if (created) {
+		xSemaphoreTake(catalog_mutex, portMAX_DELAY);
+		dirP = file_find_directory_node(indexed_fs_rootP, dir_name);
+		if (dirP != NULL) {
+			dirP->num_entries += 1;
+		}
+		xSemaphoreGive(catalog_mutex);
+	}
+	
+	return true;
+}
+
+
 /**
  * Delete the filesystem information structure
  */
@@ -599,6 +906,9 @@ directory_node_t* file_add_directory_info(char* name)
 		newP->prevP = NULL;
 		newP->fileP = NULL;
 		newP->num_files = 0;
+		newP->num_entries = 0;
+		newP->fdate = 0;
+		newP->ftime = 0;
 		
 		// Add the name
 		nameP = file_allocate_name_entry(name);
@@ -651,6 +961,10 @@ file_node_t* file_add_file_info(directory_node_t* dirP, char* name)
 #endif
 	
 	newP = file_insert_file_info(dirP, name);
+	if (newP != NULL) {
+		// Count the new file's directory entry
+		dirP->num_entries += 1;
+	}
 	
 #ifdef DEBUG_FS_INFO_STRUCT
 	dump_filesystem_info();
@@ -763,8 +1077,9 @@ void file_delete_file_info(directory_node_t* dirP, int n)
 			}
 		}
 		
-		// Decrement the count of files
+		// Decrement the count of files and of directory entries
 		dirP->num_files = dirP->num_files - 1;
+		dirP->num_entries = dirP->num_entries - 1;
 	}
 	
 #ifdef DEBUG_FS_INFO_STRUCT
@@ -775,6 +1090,42 @@ void file_delete_file_info(directory_node_t* dirP, int n)
 }
 
 
+/**
+ * Set the information for a file record created by this system.  The modification time
+ * is set to the current time.
+ */
+void file_set_file_info(file_node_t* fileP, uint32_t size, int num_frames)
+{
+	tmElements_t te;
+	
+	if (fileP == NULL) return;
+	
+	time_get(&te);
+	
+	xSemaphoreTake(catalog_mutex, portMAX_DELAY);
+	
+	fileP->size = size;
+	fileP->num_frames = num_frames;
+	fileP->fdate = (uint16_t) (((te.Year - 10) << 9) | (te.Month << 5) | te.Day);
+	fileP->ftime = (uint16_t) ((te.Hour << 11) | (te.Minute << 5) | (te.Second / 2));
+	
+	xSemaphoreGive(catalog_mutex);
+}
+
+
+/**
+ * Set the number of frames for a file record (once it has been read from a movie file)
+ */
+void file_set_file_num_frames(file_node_t* fileP, int num_frames)
+{
+	if (fileP == NULL) return;
+	
+	xSemaphoreTake(catalog_mutex, portMAX_DELAY);
+	fileP->num_frames = num_frames;
+	xSemaphoreGive(catalog_mutex);
+}
+
+
 /**
  * Generate a list of comma separated names.
  *   type - specify the list type (-1 for list of directory names, 0-n for list
@@ -832,6 +1183,65 @@ int file_get_name_list(int type, char* list)
 
 
 
+/**
+ * Fill entries with information for the files selected by a page request.  Files are
+ * ordered by directory and then by name.  Up to the lesser of req->limit and
+ * FILE_MAX_PAGE_ENTRIES entries are returned starting with the file at req->offset in
+ * the sequence of matching files.  Returns the number of entries and sets total to the
+ * number of files that match the filters.
+ */
+int file_get_page(file_page_req_t* req, file_page_entry_t* entries, int* total)
+{
+	int dir_index = 0;
+	int limit;
+	int match_index = 0;
+	int n = 0;
+	directory_node_t* dirP;
+	file_node_t* fileP;
+	
+	limit = (req->limit < FILE_MAX_PAGE_ENTRIES) ? req->limit : FILE_MAX_PAGE_ENTRIES;
+	
+	xSemaphoreTake(catalog_mutex, portMAX_DELAY);
+	
+	dirP = indexed_fs_rootP;
+	while (dirP != NULL) {
+		if (file_page_dir_match(req, dirP, dir_index)) {
+			fileP = dirP->fileP;
+			while (fileP != NULL) {
+				if (file_page_file_match(req, fileP)) {
+					if ((match_index >= req->offset) && (n < limit)) {
+						entries[n].fileP = fileP;
+						strncpy(entries[n].dir_name, dirP->nameP, DIR_NAME_LEN-1);
+						entries[n].dir_name[DIR_NAME_LEN-1] = 0;
+						strncpy(entries[n].file_name, fileP->nameP, FILE_NAME_LEN-1);
+						entries[n].file_name[FILE_NAME_LEN-1] = 0;
+						entries[n].size = fileP->size;
+						entries[n].num_frames = fileP->num_frames;
+						entries[n].start_secs = file_names_to_secs(dirP->nameP, fileP->nameP);
+						entries[n].end_secs = file_fat_to_secs(fileP->fdate, fileP->ftime);
+						n++;
+					}
+					match_index++;
+				}
+				fileP = fileP->nextP;
+			}
+		}
+		dirP = dirP->nextP;
+		dir_index++;
+	}
+	
+	xSemaphoreGive(catalog_mutex);
+	
+	*total = match_index;
+	
+#ifdef DEBUG_FS_INFO_STRUCT
+	ESP_LOGI(TAG, "%d <- file_get_page(%d, %d, %d, %d) total = %d", n, req->dir_index, req->type, req->offset, req->limit, *total);
+#endif
+	
+	return n;
+}
+
+
 /**
  * Find and return the nth directory record pointer (n = 0 returns the indexed_fs_rootP).
  */
@@ -1199,20 +1609,472 @@ static bool file_create_directory(char* dir_name)
 }
 
 
-static directory_node_t* file_insert_directory_info(char* name)
+/**
+ * Load the catalog cache file into the filesystem information structure.  Returns false
+ * if the file does not exist or could not be read (the structure may be partially built).
+ * Sets valid if the cache matches the current state of the card and may be used as-is.
+ */
+static bool file_load_catalog_cache(bool* valid)
 {
-	bool done = false;
+	bool success = true;
+	catalog_cache_header_t header;
+	catalog_cache_dir_t dir_rec;
+	catalog_cache_file_t file_rec;
 	char* nameP;
 	directory_node_t* dirP;
+	directory_node_t* last_dirP = NULL;
+	file_node_t* fileP;
+	file_node_t* last_fileP;
+	FRESULT res;
+	int i, j;
+	uint32_t crc = 0;
+	
+	*valid = false;
+	
+	res = f_open(&cache_fil, CATALOG_CACHE_NAME, FA_READ);
+	if (res != FR_OK) {
+		return false;
+	}
+	
+	if (!file_read_cache_record(&header, sizeof(catalog_cache_header_t), NULL) ||
+	    (header.magic != CATALOG_CACHE_MAGIC) ||
+	    (header.version != CATALOG_CACHE_VERSION) ||
+	    (header.card_serial != (uint32_t) sd_card.cid.serial)) {
+	    
+		f_close(&cache_fil);
+		ESP_LOGI(TAG, "Ignoring catalog cache");
+		return false;
+	}
+	
+	// Directory and file records are stored in sorted order so they are appended directly
+	for (i=0; i<header.num_dirs; i++) {
+		if (!file_read_cache_record(&dir_rec, sizeof(catalog_cache_dir_t), &crc)) {
+			success = false;
+			break;
+		}
+		dir_rec.name[DIR_NAME_LEN-1] = 0;
+		
+		dirP = file_allocate_dir_entry();
+		nameP = file_allocate_name_entry(dir_rec.name);
+		if ((dirP == NULL) || (nameP == NULL)) {
+			success = false;
+			break;
+		}
+		strcpy(nameP, dir_rec.name);
+		dirP->nameP = nameP;
+		dirP->nextP = NULL;
+		dirP->prevP = last_dirP;
+		dirP->fileP = NULL;
+		dirP->num_files = 0;
+		dirP->num_entries = dir_rec.num_entries;
+		dirP->fdate = dir_rec.fdate;
+		dirP->ftime = dir_rec.ftime;
+		if (last_dirP == NULL) {
+			indexed_fs_rootP = dirP;
+		} else {
+			last_dirP->nextP = dirP;
+		}
+		last_dirP = dirP;
+		
+		last_fileP = NULL;
+		for (j=0; j<dir_rec.num_files; j++) {
+			if (!file_read_cache_record(&file_rec, sizeof(catalog_cache_file_t), &crc)) {
+				success = false;
+				break;
+			}
+			file_rec.name[FILE_NAME_LEN-1] = 0;
+			
+			fileP = file_allocate_file_entry();
+			nameP = file_allocate_name_entry(file_rec.name);
+			if ((fileP == NULL) || (nameP == NULL)) {
+				success = false;
+				break;
+			}
+			strcpy(nameP, file_rec.name);
+			fileP->nameP = nameP;
+			fileP->nextP = NULL;
+			fileP->prevP = last_fileP;
+			fileP->size = file_rec.size;
+			fileP->num_frames = file_rec.num_frames;
+			fileP->fdate = file_rec.fdate;
+			fileP->ftime = file_rec.ftime;
+			if (last_fileP == NULL) {
+				dirP->fileP = fileP;
+			} else {
+				last_fileP->nextP = fileP;
+			}
+			last_fileP = fileP;
+			dirP->num_files += 1;
+		}
+		if (!success) break;
+	}
+	
+	f_close(&cache_fil);
+	
+	if (success && (crc != header.crc)) {
+		ESP_LOGE(TAG, "Catalog cache CRC mismatch");
+		success = false;
+	}
+	
+	if (success) {
+		*valid = (header.free_clusters == file_get_free_clusters());
+	}
+	
+#ifdef DEBUG_FS_INFO_STRUCT
+	ESP_LOGI(TAG, "%d <- file_load_catalog_cache(* %d)", success, *valid);
+#endif
+	
+	return success;
+}
+
+
+/**
+ * Read a record from the open catalog cache file, updating a running CRC if crc is not NULL.
+ */
+static bool file_read_cache_record(void* rec, int len, uint32_t* crc)
+{
+	UINT n;
+	
+	if ((f_read(&cache_fil, rec, len, &n) != FR_OK) || (n != len)) {
+		return false;
+	}
+	
+	if (crc != NULL) {
+		*crc = esp_rom_crc32_le(*crc, (uint8_t*) rec, len);
+	}
+	
+	return true;
+}
+
+
+/**
+ * Write a record to the open catalog cache file, updating a running CRC if crc is not NULL.
+ */
+static bool file_write_cache_record(void* rec, int len, uint32_t* crc)
+{
+	UINT n;
+	
+	if ((f_write(&cache_fil, rec, len, &n) != FR_OK) || (n != len)) {
+		return false;
+	}
+	
+	if (crc != NULL) {
+		*crc = esp_rom_crc32_le(*crc, (uint8_t*) rec, len);
+	}
+	
+	return true;
+}
+
+
+/**
+ * Return the number of free clusters on the mounted filesystem (0 on failure).  FATFS
+ * keeps this value once it has been computed so this is fast after the card is mounted.
+ */
+static uint32_t file_get_free_clusters()
+{
+	FATFS *fs;
+	DWORD fre_clust;
+	
+	if (f_getfree("0:", &fre_clust, &fs) != FR_OK) {
+		return 0;
+	}
+	
+	return (uint32_t) fre_clust;
+}
+
+
+/**
+ * Add all valid tcam files in the directory to the directory record
+ */
+static bool file_scan_directory(directory_node_t* dirP)
+{
+	file_node_t* fileP;
+	FF_DIR file_dir;
+	FRESULT res;
+	static FILINFO file_fno;
+	char dir_name[sizeof(file_fno.fname) + 2];
+	
+	// Open the tcam directory
+	sprintf(dir_name, "/%s", dirP->nameP);
+	res = f_opendir(&file_dir, dir_name);
+	if (res != FR_OK) {
+		return false;
+	}
+	
+	// Scan through the tcam directory
+	for (;;) {
+		res = f_readdir(&file_dir, &file_fno);
+		if ((res != FR_OK) || (file_fno.fname[0] == 0)) {
+			// Break on error or end of dir
+			break;
+		}
+		dirP->num_entries += 1;
+		
+		// Look for valid tcam files
+		if (((file_fno.fattrib & AM_DIR) == 0) && (file_fno.fsize != 0) && file_is_valid_name(file_fno.fname)) {
+			// Add the file to the filesystem information structure
+			fileP = file_insert_file_info(dirP, file_fno.fname);
+			if (fileP != NULL) {
+				fileP->size = (uint32_t) file_fno.fsize;
+				fileP->fdate = file_fno.fdate;
+				fileP->ftime = file_fno.ftime;
+			}
+		}
+	}
+	f_closedir(&file_dir);
+	
+	return true;
+}
+
+
+/**
+ * Read and validate the header of the open thumbnail container.  Leaves the file
+ * positioned at the first record.
+ */
+static bool file_thumb_header_valid()
+{
+	thumb_header_t header;
+	UINT n;
+	
+	if ((f_read(&thumb_fil, &header, sizeof(thumb_header_t), &n) != FR_OK) || (n != sizeof(thumb_header_t))) {
+		return false;
+	}
+	
+	return ((header.magic == FILE_THUMB_MAGIC) && (header.version == FILE_THUMB_VERSION) &&
+	        (header.width == FILE_THUMB_WIDTH) && (header.height == FILE_THUMB_HEIGHT));
+}
+
+
+/**
+ * Traverse the top-level directory adding each tcam directory to the filesystem
+ * information structure.  Directories found with an unchanged date/time and entry count
+ * in the stale cache list at *cached_rootPP are moved from it, others are scanned and
+ * counted in num_rescanned.
+ */
+static bool file_scan_top_directory(directory_node_t** cached_rootPP, int* num_rescanned)
+{
+	FF_DIR top_dir;
+	FRESULT res;
+	static FILINFO dir_fno;
+	directory_node_t* cur_dirP;
+	
+	// Open the top-level directory
+	res = f_opendir(&top_dir, "/");
+	if (res != FR_OK) {
+		return false;
+	}
+	
+	// Scan through all directories at the top level
+	for (;;) {
+		res = f_readdir(&top_dir, &dir_fno);
+		if ((res != FR_OK) || (dir_fno.fname[0] == 0)) {
+			// Break on error or end of dir
+			break;
+		}
+		// Look for valid tcam directories
+		if ((dir_fno.fattrib & AM_DIR) && file_is_valid_dir(dir_fno.fname)) {
+			// Use the cached directory record if the directory hasn't changed
+			cur_dirP = file_find_directory_node(*cached_rootPP, dir_fno.fname);
+			if ((cur_dirP != NULL) &&
+			    (cur_dirP->fdate == dir_fno.fdate) &&
+			    (cur_dirP->ftime == dir_fno.ftime) &&
+			    (cur_dirP->num_entries == file_count_directory_entries(dir_fno.fname))) {
+			    
+				// Move the directory record from the cached list to the new list
+				if (cur_dirP->prevP == NULL) {
+					*cached_rootPP = cur_dirP->nextP;
+				} else {
+					cur_dirP->prevP->nextP = cur_dirP->nextP;
+				}
+				if (cur_dirP->nextP != NULL) {
+					cur_dirP->nextP->prevP = cur_dirP->prevP;
+				}
+				file_link_directory_info(cur_dirP);
+			} else {
+				// Add the directory to the filesystem information structure and scan it
+				cur_dirP = file_insert_directory_info(dir_fno.fname);
+				if (cur_dirP != NULL) {
+					cur_dirP->fdate = dir_fno.fdate;
+					cur_dirP->ftime = dir_fno.ftime;
+					(void) file_scan_directory(cur_dirP);
+				}
+				*num_rescanned += 1;
+			}
+		}
+	}
+	f_closedir(&top_dir);
+	
+	return true;
+}
+
+
+/**
+ * Return the number of entries in a directory without examining them (-1 on failure)
+ */
+static int file_count_directory_entries(char* name)
+{
+	FF_DIR file_dir;
+	FRESULT res;
+	static FILINFO file_fno;
+	char dir_name[sizeof(file_fno.fname) + 2];
+	int n = 0;
+	
+	sprintf(dir_name, "/%s", name);
+	res = f_opendir(&file_dir, dir_name);
+	if (res != FR_OK) {
+		return -1;
+	}
+	
+	for (;;) {
+		res = f_readdir(&file_dir, &file_fno);
+		if ((res != FR_OK) || (file_fno.fname[0] == 0)) {
+			break;
+		}
+		n++;
+	}
+	f_closedir(&file_dir);
+	
+	return (res == FR_OK) ? n : -1;
+}
+
+
+/**
+ * Empty the filesystem information structure and start allocating at the start of
+ * its buffer
+ */
+static void file_reset_filesystem_info()
+{
+	file_info_cur_bufferP = file_info_bufferP;
+	file_info_full = false;
+	indexed_fs_rootP = NULL;
+}
+
+
+/**
+ * Return the directory record in the list starting at rootP with the specified name
+ * or NULL if it is not found.
+ */
+static directory_node_t* file_find_directory_node(directory_node_t* rootP, char* name)
+{
+	while (rootP != NULL) {
+		if (strcmp(rootP->nameP, name) == 0) {
+			return rootP;
+		}
+		rootP = rootP->nextP;
+	}
+	
+	return NULL;
+}
+
+
+/**
+ * Return true if the directory passes the page request filters
+ */
+static bool file_page_dir_match(file_page_req_t* req, directory_node_t* dirP, int dir_index)
+{
+	if ((req->dir_index >= 0) && (req->dir_index != dir_index)) {
+		return false;
+	}
+	
+	if ((req->from_dir[0] != 0) && (strcmp(dirP->nameP, req->from_dir) < 0)) {
+		return false;
+	}
+	
+	if ((req->to_dir[0] != 0) && (strcmp(dirP->nameP, req->to_dir) > 0)) {
+		return false;
+	}
+	
+	return true;
+}
+
+
+/**
+ * Return true if the file passes the page request filters
+ */
+static bool file_page_file_match(file_page_req_t* req, file_node_t* fileP)
+{
+	switch (req->type) {
+		case FILE_PAGE_TYPE_IMG:
+			return (*fileP->nameP == 'i');
+		case FILE_PAGE_TYPE_MOV:
+			return (*fileP->nameP == 'm');
+		default:
+			return true;
+	}
+}
+
+
+/**
+ * Convert a FATFS date/time into seconds since 1970.  Returns 0 if the date is not set.
+ */
+static uint32_t file_fat_to_secs(uint16_t fdate, uint16_t ftime)
+{
+	if (fdate == 0) return 0;
+	
+	return file_date_to_secs(1980 + (fdate >> 9), (fdate >> 5) & 0x0F, fdate & 0x1F,
+	                         ftime >> 11, (ftime >> 5) & 0x3F, (ftime & 0x1F) * 2);
+}
+
+
+/**
+ * Convert the date in a "tcam_YY_MM_DD" directory name and the time in a "XXX_HH_MM_SS.ext"
+ * file name into seconds since 1970.  Returns 0 if the names aren't in the expected format.
+ */
+static uint32_t file_names_to_secs(char* dir_name, char* file_name)
+{
+	int i;
+	int v[6];
+	char* s;
+	
+	for (i=0; i<6; i++) {
+		s = (i < 3) ? (dir_name + 5 + i*3) : (file_name + 4 + (i-3)*3);
+		if ((s[0] < '0') || (s[0] > '9') || (s[1] < '0') || (s[1] > '9')) {
+			return 0;
+		}
+		v[i] = (s[0] - '0')*10 + (s[1] - '0');
+	}
+	
+	return file_date_to_secs(2000 + v[0], v[1], v[2], v[3], v[4], v[5]);
+}
+
+
+/**
+ * Convert a calendar date and time into seconds since 1970 (no timezone adjustment)
+ */
+static uint32_t file_date_to_secs(int year, int month, int day, int hour, int min, int sec)
+{
+	int era;
+	int yoe;
+	int doy;
+	int doe;
+	int32_t days;
+	
+	// Days from civil algorithm (http://howardhinnant.github.io/date_algorithms.html)
+	if ((month < 1) || (month > 12) || (day < 1)) return 0;
+	year -= (month <= 2) ? 1 : 0;
+	era = year / 400;
+	yoe = year - era * 400;
+	doy = (153 * (month + ((month > 2) ? -3 : 9)) + 2) / 5 + day - 1;
+	doe = yoe * 365 + yoe/4 - yoe/100 + doy;
+	days = era * 146097 + doe - 719468;
+	
+	return (uint32_t) days * 86400 + hour * 3600 + min * 60 + sec;
+}
+
+
+static directory_node_t* file_insert_directory_info(char* name)
+{
+	char* nameP;
 	directory_node_t* newP;
 	
 	// Create a new directory record
 	newP = file_allocate_dir_entry();
 	if (newP != NULL) {
-		newP->nextP = NULL;
-		newP->prevP = NULL;
 		newP->fileP = NULL;
 		newP->num_files = 0;
+		newP->num_entries = 0;
+		newP->fdate = 0;
+		newP->ftime = 0;
 		
 		// Add the name
 		nameP = file_allocate_name_entry(name);
@@ -1221,42 +2083,54 @@ static directory_node_t* file_insert_directory_info(char* name)
 		}
 		newP->nameP = nameP;
 		
-		// Then either add it as the first record or insert it alphabetically in list
-		if (indexed_fs_rootP == NULL) {
-			indexed_fs_rootP = newP;
-		} else {
-			// Insert it before the first entry that is greater than it
-			dirP = indexed_fs_rootP;
-			while (!done) {
-				if (strcmp(dirP->nameP, name) > 0) {
-					// Insert before dirP
-					if (dirP == indexed_fs_rootP) {
-						// Insert at head of list
-						newP->nextP = indexed_fs_rootP;
-						indexed_fs_rootP = newP;
-						dirP->prevP = newP;
-					} else {
-						// Insert in the middle of list
-						newP->nextP = dirP;
-						newP->prevP = dirP->prevP;
-						dirP->prevP->nextP = newP;
-						dirP->prevP = newP;
-					}
-					done = true;
-				} else if (dirP->nextP == NULL) {
-					// Insert at end of list
-					dirP->nextP = newP;
-					newP->prevP = dirP;
-					done = true;
+		file_link_directory_info(newP);
+	}
+	
+	return newP;
+}
+
+
+static void file_link_directory_info(directory_node_t* newP)
+{
+	bool done = false;
+	directory_node_t* dirP;
+	
+	newP->nextP = NULL;
+	newP->prevP = NULL;
+	
+	// Either add it as the first record or insert it alphabetically in list
+	if (indexed_fs_rootP == NULL) {
+		indexed_fs_rootP = newP;
+	} else {
+		// Insert it before the first entry that is greater than it
+		dirP = indexed_fs_rootP;
+		while (!done) {
+			if (strcmp(dirP->nameP, newP->nameP) > 0) {
+				// Insert before dirP
+				if (dirP == indexed_fs_rootP) {
+					// Insert at head of list
+					newP->nextP = indexed_fs_rootP;
+					indexed_fs_rootP = newP;
+					dirP->prevP = newP;
 				} else {
-					// Move to next record
-					dirP = dirP->nextP;
+					// Insert in the middle of list
+					newP->nextP = dirP;
+					newP->prevP = dirP->prevP;
+					dirP->prevP->nextP = newP;
+					dirP->prevP = newP;
 				}
+				done = true;
+			} else if (dirP->nextP == NULL) {
+				// Insert at end of list
+				dirP->nextP = newP;
+				newP->prevP = dirP;
+				done = true;
+			} else {
+				// Move to next record
+				dirP = dirP->nextP;
 			}
 		}
 	}
-	
-	return newP;
 }
 
 
@@ -1272,6 +2146,10 @@ static file_node_t* file_insert_file_info(directory_node_t* dirP, char* name)
 	if (newP != NULL) {
 		newP->nextP = NULL;
 		newP->prevP = NULL;
+		newP->size = 0;
+		newP->num_frames = (*name == 'm') ? -1 : 1;  // Movie length unknown until read
+		newP->fdate = 0;
+		newP->ftime = 0;
 	
 		// Add the name
 		nameP = file_allocate_name_entry(name);
@@ -1327,9 +2205,12 @@ static directory_node_t* file_allocate_dir_entry()
 	int len = sizeof(directory_node_t);
 	directory_node_t* dirP;
 	
-	if (file_info_cur_bufferP >= file_info_bufferP + FILE_INFO_BUFFER_LEN) {
+	if (file_info_cur_bufferP + len > file_info_bufferP + FILE_INFO_BUFFER_LEN) {
 		dirP = NULL;
-		ESP_LOGE(TAG, "filesystem information structure directory allocate failed");
+		if (!file_info_full) {
+			file_info_full = true;
+			ESP_LOGE(TAG, "filesystem information structure directory allocate failed");
+		}
 	} else {
 		dirP = (directory_node_t*) file_info_cur_bufferP;
 		file_info_cur_bufferP += len;	
@@ -1344,9 +2225,12 @@ static file_node_t* file_allocate_file_entry()
 	int len = sizeof(file_node_t);
 	file_node_t* fileP;
 	
-	if (file_info_cur_bufferP >= file_info_bufferP + FILE_INFO_BUFFER_LEN) {
+	if (file_info_cur_bufferP + len > file_info_bufferP + FILE_INFO_BUFFER_LEN) {
 		fileP = NULL;
-		ESP_LOGE(TAG, "filesystem information structure file allocate failed");
+		if (!file_info_full) {
+			file_info_full = true;
+			ESP_LOGE(TAG, "filesystem information structure file allocate failed");
+		}
 	} else {
 		fileP = (file_node_t*) file_info_cur_bufferP;
 		file_info_cur_bufferP += len;	
@@ -1361,14 +2245,18 @@ static char* file_allocate_name_entry(char* name)
 	char* nameP;
 	int len = strlen(name) + 1;
 	
-	if (file_info_cur_bufferP >= file_info_bufferP + FILE_INFO_BUFFER_LEN) {
+	// Make sure length is 32-bit aligned
+	if (len & 0x3) {
+		len = (len & 0xFFFFFFFC) + 4;
+	}
+	
+	if (file_info_cur_bufferP + len > file_info_bufferP + FILE_INFO_BUFFER_LEN) {
 		nameP = NULL;
-		ESP_LOGE(TAG, "filesystem information structure name allocate failed");
-	} else {
-		// Make sure length is 32-bit aligned
-		if (len & 0x3) {
-			len = (len & 0xFFFFFFFC) + 4;
+		if (!file_info_full) {
+			file_info_full = true;
+			ESP_LOGE(TAG, "filesystem information structure name allocate failed");
 		}
+	} else {
 		nameP = (char*) file_info_cur_bufferP;
 		file_info_cur_bufferP += len;	
 	}
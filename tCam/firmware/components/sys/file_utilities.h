@@ -48,6 +48,28 @@
 // taken from the heap during runtime without causing memory allocation problems.
 #define STREAM_BUF_SIZE 8192
 
+// Catalog cache file stored in the root directory of the card.  It holds a snapshot
+// of the filesystem information structure so it doesn't have to be rebuilt by scanning
+// every directory each time a card is mounted.
+#define CATALOG_CACHE_NAME    "/tcamcat.bin"
+#define CATALOG_CACHE_MAGIC   0x54434154
+#define CATALOG_CACHE_VERSION 4
+
+// Thumbnail container file stored in each tcam directory.  It holds a small 8-bit
+// preview of each image or movie (first frame) in the directory, linearly scaled
+// between the minimum and maximum pixel values so any palette may be applied.
+#define FILE_THUMB_NAME       "tcamthm.bin"
+#define FILE_THUMB_MAGIC      0x5443544E
+#define FILE_THUMB_VERSION    1
+#define FILE_THUMB_WIDTH      80
+#define FILE_THUMB_HEIGHT     60
+#define FILE_THUMB_LEN        (FILE_THUMB_WIDTH * FILE_THUMB_HEIGHT)
+
+// Catalog page file type filters
+#define FILE_PAGE_TYPE_ALL    0
+#define FILE_PAGE_TYPE_IMG    1
+#define FILE_PAGE_TYPE_MOV    2
+
 
 //
 // File System local data structure
@@ -58,6 +80,10 @@ struct file_node_t {
 	char* nameP;
 	file_node_t* nextP;
 	file_node_t* prevP;
+	uint32_t size;       // File length in bytes
+	int num_frames;      // Number of images in the file (-1 if not yet known)
+	uint16_t fdate;      // FATFS modification date/time
+	uint16_t ftime;
 };
 
 typedef struct directory_node_t directory_node_t;
@@ -68,9 +94,34 @@ struct directory_node_t {
 	directory_node_t* prevP;
 	file_node_t* fileP;
 	int num_files;
+	int num_entries;     // Raw FATFS directory entry count (catalog cache validation)
+	uint16_t fdate;      // FATFS directory date/time (catalog cache validation)
+	uint16_t ftime;
 };
 
 
+// Catalog page request - selects a range of files matching the filters
+typedef struct {
+	int dir_index;                 // Directory to list or -1 for all directories
+	int type;                      // FILE_PAGE_TYPE_xxx
+	int offset;                    // Index of the first matching file to return
+	int limit;                     // Maximum number of files to return
+	char from_dir[DIR_NAME_LEN];   // First directory to include (empty for no limit)
+	char to_dir[DIR_NAME_LEN];     // Last directory to include (empty for no limit)
+} file_page_req_t;
+
+// Catalog page entry - a copy of the catalog information for one file
+typedef struct {
+	file_node_t* fileP;            // Catalog record (for updating information)
+	char dir_name[DIR_NAME_LEN];
+	char file_name[FILE_NAME_LEN];
+	uint32_t size;
+	int num_frames;
+	uint32_t start_secs;           // Recording start (from the names) in seconds since 1970
+	uint32_t end_secs;             // File modification time in seconds since 1970
+} file_page_entry_t;
+
+
 //
 // File Utilities API
 //
@@ -95,12 +146,18 @@ void file_unmount_sdcard();
 
 // Local filesystem info management (file_task only)
 bool file_create_filesystem_info();
+bool file_save_filesystem_info();
+bool file_read_thumbnail(char* dir_name, char* file_name, uint32_t size, uint8_t* thumb);
+bool file_write_thumbnail(char* dir_name, char* file_name, uint32_t size, uint8_t* thumb);
 void file_delete_filesystem_info();
 directory_node_t* file_add_directory_info(char* name);
 file_node_t* file_add_file_info(directory_node_t* dirP, char* name);
 void file_delete_directory_info(int n);
 void file_delete_file_info(directory_node_t* dirP, int n);
+void file_set_file_info(file_node_t* fileP, uint32_t size, int num_frames);
+void file_set_file_num_frames(file_node_t* fileP, int num_frames);
 int file_get_name_list(int type, char* list);
+int file_get_page(file_page_req_t* req, file_page_entry_t* entries, int* total);
 
 // Local filesystem info management (mutex protected for multiple task access)
 directory_node_t* file_get_indexed_directory(int n);
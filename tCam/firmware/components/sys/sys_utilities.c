@@ -29,8 +29,10 @@
 #include "driver/gpio.h"
 #include "driver/spi_master.h"
 #include "file_utilities.h"
+#include "filter_utilities.h"
 #include "json_utilities.h"
 #include "lepton_utilities.h"
+#include "perf_utilities.h"
 #include "power_utilities.h"
 #include "ps_utilities.h"
 #include "sys_utilities.h"
@@ -45,6 +47,10 @@
 //
 static const char* TAG = "sys";
 
+// Reference counted image json string buffers shared by lep_rsp_buffer and lep_file_buffer
+static shared_image_t shared_image[SYS_SHARED_IMAGE_BUFFERS];
+static SemaphoreHandle_t shared_image_mutex;
+
 
 //
 // Task handle externs for use by tasks to communicate with each other
@@ -70,8 +76,8 @@ lep_buffer_t lep_gui_buffer[2];    // Loaded by lep_task for gui_task (ping-pong
 lep_buffer_t file_gui_buffer[2];   // Loaded by file_task for gui_task (ping-pong)
 
 json_string_t lep_spi_buffer;      // Loaded by lep_task SPI read for each image
-json_string_t lep_rsp_buffer[2];   // Loaded by lep_task for rsp_task (ping-pong)
-json_string_t lep_file_buffer[2];  // Loaded by lep_task for file_task (ping-pong)
+json_image_ref_t lep_rsp_buffer[2];   // Loaded by lep_task for rsp_task (ping-pong)
+json_image_ref_t lep_file_buffer[2];  // Loaded by lep_task for file_task (ping-pong)
 
 json_cmd_response_queue_t lep_cmd_buffer;  // Loaded by other tasks with commands for lep_task to forward
 
@@ -189,6 +195,7 @@ bool system_buffer_init()
 			ESP_LOGE(TAG, "malloc GUI lepton shared telemetry buffer %d failed", i);
 			return false;
 		}
+		lep_gui_buffer[i].unread = false;
 		lep_gui_buffer[i].mutex = xSemaphoreCreateMutex();
 	}
 	
@@ -215,24 +222,30 @@ bool system_buffer_init()
 		return false;
 	}
 				
-	// Allocate the cmd/rsp_task lepton image json string buffers in the external RAM
-	for (i=0; i<2; i++) {
-		lep_rsp_buffer[i].mutex = xSemaphoreCreateMutex();
-		lep_rsp_buffer[i].bufferP = heap_caps_malloc(JSON_MAX_IMAGE_TEXT_LEN, MALLOC_CAP_SPIRAM);
-		if (lep_rsp_buffer[i].bufferP == NULL) {
-			ESP_LOGE(TAG, "malloc RSP lepton shared json buffer %d failed", i);
+	// Allocate the lepton image json string buffers shared by rsp_task and file_task
+	// in the external RAM
+	shared_image_mutex = xSemaphoreCreateMutex();
+	for (i=0; i<SYS_SHARED_IMAGE_BUFFERS; i++) {
+		shared_image[i].refs = 0;
+		shared_image[i].length = 0;
+		shared_image[i].bufferP = heap_caps_malloc(JSON_MAX_IMAGE_TEXT_LEN, MALLOC_CAP_SPIRAM);
+		if (shared_image[i].bufferP == NULL) {
+			ESP_LOGE(TAG, "malloc lepton shared json buffer %d failed", i);
 			return false;
 		}
 	}
 	
-	// Allocate the file_task lepton image json string buffers in the external RAM
+	// The cmd/rsp_task and file_task buffers hold references to the shared buffers
 	for (i=0; i<2; i++) {
+		lep_rsp_buffer[i].mutex = xSemaphoreCreateMutex();
+		lep_rsp_buffer[i].imageP = NULL;
+		lep_rsp_buffer[i].bufferP = NULL;
+		lep_rsp_buffer[i].length = 0;
+		
 		lep_file_buffer[i].mutex = xSemaphoreCreateMutex();
-		lep_file_buffer[i].bufferP = heap_caps_malloc(JSON_MAX_IMAGE_TEXT_LEN, MALLOC_CAP_SPIRAM);
-		if (lep_file_buffer[i].bufferP == NULL) {		
-			ESP_LOGE(TAG, "malloc FILE lepton shared json buffer %d failed", i);
-			return false;
-		}
+		lep_file_buffer[i].imageP = NULL;
+		lep_file_buffer[i].bufferP = NULL;
+		lep_file_buffer[i].length = 0;
 	}
 	
 	// Allocate the outgoing command response json buffer
@@ -273,6 +286,18 @@ bool system_buffer_init()
 		return false;
 	}
 	
+	// Initialize the temporal noise filter
+	if (!filter_init()) {
+		ESP_LOGE(TAG, "filter initialization failed");
+		return false;
+	}
+	
+	// Initialize performance accounting
+	if (!perf_init()) {
+		ESP_LOGE(TAG, "perf initialization failed");
+		return false;
+	}
+	
 	// Allocate the incoming command buffers
 	rx_circular_buffer = heap_caps_malloc(JSON_MAX_CMD_TEXT_LEN, MALLOC_CAP_SPIRAM);
 	if (rx_circular_buffer == NULL) {
@@ -342,6 +367,76 @@ bool system_buffer_init()
 }
 
 
+/**
+ * Get an unused shared image buffer with one reference held by the caller.  Returns
+ * NULL if all buffers are in use.
+ */
+shared_image_t* system_image_alloc()
+{
+	int i;
+	shared_image_t* image = NULL;
+	
+	xSemaphoreTake(shared_image_mutex, portMAX_DELAY);
+	for (i=0; i<SYS_SHARED_IMAGE_BUFFERS; i++) {
+		if (shared_image[i].refs == 0) {
+			shared_image[i].refs = 1;
+			shared_image[i].length = 0;
+			image = &shared_image[i];
+			break;
+		}
+	}
+	xSemaphoreGive(shared_image_mutex);
+	
+	return image;
+}
+
+
+/**
+ * Point ref at a shared image, taking a reference to it and releasing the one ref held
+ * on its previous image.  The caller must hold ref's mutex.
+ */
+void system_image_attach(json_image_ref_t* ref, shared_image_t* image)
+{
+	xSemaphoreTake(shared_image_mutex, portMAX_DELAY);
+	if (ref->imageP != NULL) {
+		ref->imageP->refs--;
+	}
+	image->refs++;
+	xSemaphoreGive(shared_image_mutex);
+	
+	ref->imageP = image;
+	ref->bufferP = image->bufferP;
+	ref->length = image->length;
+}
+
+
+/**
+ * Release the reference ref holds, if any, leaving it empty.  The caller must hold
+ * ref's mutex.
+ */
+void system_image_detach(json_image_ref_t* ref)
+{
+	if (ref->imageP != NULL) {
+		system_image_release(ref->imageP);
+		ref->imageP = NULL;
+	}
+	ref->length = 0;
+}
+
+
+/**
+ * Release a reference to a shared image obtained from system_image_alloc
+ */
+void system_image_release(shared_image_t* image)
+{
+	xSemaphoreTake(shared_image_mutex, portMAX_DELAY);
+	if (image->refs > 0) {
+		image->refs--;
+	}
+	xSemaphoreGive(shared_image_mutex);
+}
+
+
 /**
  * Shut the system off
  */
@@ -52,6 +52,9 @@ typedef struct {
 	uint16_t lep_max_y;
 	uint16_t* lep_bufferP;
 	uint16_t* lep_telemP;
+	uint32_t seq;             // Lepton frame counter (display pipeline accounting)
+	int64_t rx_usec;          // Time the image was read from tCam-Mini
+	bool unread;              // Set when loaded, cleared when displayed
 	SemaphoreHandle_t mutex;
 } lep_buffer_t;
 
@@ -61,6 +64,23 @@ typedef struct {
 	SemaphoreHandle_t mutex;
 } json_string_t;
 
+// Image json string shared by multiple consumers.  The buffer is free to reuse when
+// refs is 0.
+typedef struct {
+	int refs;
+	uint32_t length;
+	char* bufferP;
+} shared_image_t;
+
+// Consumer's reference to a shared image.  bufferP and length are copied from the
+// shared image so consumers use it like a json_string_t.
+typedef struct {
+	uint32_t length;
+	char* bufferP;
+	shared_image_t* imageP;   // NULL when no image is held
+	SemaphoreHandle_t mutex;
+} json_image_ref_t;
+
 typedef struct {
 	int length;
 	char* pushP;
@@ -101,8 +121,8 @@ extern lep_buffer_t lep_gui_buffer[2];    // Loaded by lep_task for gui_task (pi
 extern lep_buffer_t file_gui_buffer[2];   // Loaded by file_task for gui_task (ping-pong)
 
 extern json_string_t lep_spi_buffer;      // Loaded by lep_task SPI read for each image
-extern json_string_t lep_rsp_buffer[2];   // Loaded by lep_task for rsp_task (ping-pong)
-extern json_string_t lep_file_buffer[2];  // Loaded by lep_task for file_task (ping-pong)
+extern json_image_ref_t lep_rsp_buffer[2];   // Loaded by lep_task for rsp_task (ping-pong)
+extern json_image_ref_t lep_file_buffer[2];  // Loaded by lep_task for file_task (ping-pong)
 
 extern json_cmd_response_queue_t lep_cmd_buffer;  // Loaded by other tasks with commands for lep_task to forward
 
@@ -139,6 +159,10 @@ extern void* file_info_bufferP;      // Loaded by file_task with the filesystem
 bool system_esp_io_init();
 bool system_peripheral_init();
 bool system_buffer_init();
+shared_image_t* system_image_alloc();
+void system_image_attach(json_image_ref_t* ref, shared_image_t* image);
+void system_image_detach(json_image_ref_t* ref);
+void system_image_release(shared_image_t* image);
 void system_shutoff();
  
 #endif /* SYS_UTILITIES_H */
\ No newline at end of file
@@ -26,10 +26,13 @@
 #include "cmd_task.h"
 #include "file_task.h"
 #include "gui_task.h"
+#include "lep_task.h"
 #include "rsp_task.h"
 #include "file_utilities.h"
+#include "filter_utilities.h"
 #include "json_utilities.h"
 #include "lepton_utilities.h"
+#include "perf_utilities.h"
 #include "power_utilities.h"
 #include "ps_utilities.h"
 #include "sys_utilities.h"
@@ -85,11 +88,16 @@ static void process_rx_packet();
 static void push_response(char* buf, uint32_t len);
 static void push_lep_command();
 static bool process_set_config(cJSON* cmd_args);
+static bool process_set_alarm(cJSON* cmd_args);
+static bool process_set_filter(cJSON* cmd_args, bool* forwarded);
+static bool process_get_perf(cJSON* cmd_args);
 static bool process_stream_on(cJSON* cmd_args);
 static bool process_record_on(cJSON* cmd_args);
 static bool process_set_time(cJSON* cmd_args);
 static bool process_set_wifi(cJSON* cmd_args);
 static bool process_get_fs_list(cJSON* cmd_args);
+static bool process_get_fs_page(cJSON* cmd_args);
+static bool process_get_file_raw(cJSON* cmd_args);
 static bool process_get_fs_file(cJSON* cmd_args);
 static bool process_del_fs_obj(cJSON* cmd_args);
 static bool process_fw_upd_request(cJSON* cmd_args);
@@ -319,6 +327,7 @@ static void process_rx_packet()
 	int cmd;
 	int cmd_success = -1;  // -1: response sent (as ACK), 0: determined elsewhere, 1: success,
 						   //  2: fail, 3: unimplemented, 3-4: unknown cmd, 4-5: unknown json, 5-6: bad json
+	bool forwarded;
 	char cmd_st_buf[80];
 	
 	// Create a json object to parse
@@ -442,6 +451,22 @@ static void process_rx_packet()
 					}
 					break;
 				
+				case CMD_GET_FS_PAGE:
+					if (process_get_fs_page(cmd_args)) {
+						cmd_success = 0;
+					} else {
+						cmd_success = 2;
+					}
+					break;
+				
+				case CMD_GET_FS_RAW:
+					if (process_get_file_raw(cmd_args)) {
+						cmd_success = 0;
+					} else {
+						cmd_success = 2;
+					}
+					break;
+				
 				case CMD_GET_FS_FILE:
 					if (process_get_fs_file(cmd_args)) {
 						cmd_success = 0;
@@ -462,6 +487,50 @@ static void process_rx_packet()
 				case CMD_SET_LEP_CCI:
 					push_lep_command();
 					break;
+				
+				case CMD_SET_ALARM:
+					if (process_set_alarm(cmd_args)) {
+						push_lep_command();
+					} else {
+						cmd_success = 2;
+					}
+					break;
+				
+				case CMD_SET_ROI:
+				case CMD_GET_ROI:
+				case CMD_GET_ALARM:
+					// Handled by tCam-Mini
+					push_lep_command();
+					break;
+				
+				case CMD_SET_FILTER:
+					if (process_set_filter(cmd_args, &forwarded)) {
+						if (!forwarded) {
+							cmd_success = 1;
+						}
+					} else {
+						cmd_success = 2;
+					}
+					break;
+				
+				case CMD_GET_FILTER:
+					// Report our display and record filters and let tCam-Mini report its stream filter
+					sys_response_cmd_buffer.length = json_get_filter(sys_response_cmd_buffer.bufferP, FILTER_CONSUMER_DISPLAY);
+					if (sys_response_cmd_buffer.length != 0) {
+						push_response(sys_response_cmd_buffer.bufferP, sys_response_cmd_buffer.length);
+					}
+					sys_response_cmd_buffer.length = json_get_filter(sys_response_cmd_buffer.bufferP, FILTER_CONSUMER_RECORD);
+					if (sys_response_cmd_buffer.length != 0) {
+						push_response(sys_response_cmd_buffer.bufferP, sys_response_cmd_buffer.length);
+					}
+					push_lep_command();
+					break;
+				
+				case CMD_GET_PERF:
+					if (!process_get_perf(cmd_args)) {
+						cmd_success = 2;
+					}
+					break;
 					
 				case CMD_FW_UPD_REQ:
 					if (process_fw_upd_request(cmd_args)) {
@@ -635,6 +704,68 @@ static bool process_set_config(cJSON* cmd_args)
 }
 
 
+static bool process_set_alarm(cJSON* cmd_args)
+{
+	bool record;
+	int index;
+	
+	// Note the rule's record setting so lep_task can hold pre-trigger images
+	if (json_parse_set_alarm_record(cmd_args, &index, &record)) {
+		lep_set_alarm_record(index, record);
+		return true;
+	}
+	
+	return false;
+}
+
+
+/**
+ * The display and record filters run here.  The stream filter runs in tCam-Mini, which
+ * filters every image it sends us, so the command is forwarded.
+ */
+static bool process_set_filter(cJSON* cmd_args, bool* forwarded)
+{
+	int consumer;
+	filter_config_t config;
+	
+	*forwarded = false;
+	if (json_parse_set_filter(cmd_args, &consumer, &config)) {
+		if ((consumer == FILTER_CONSUMER_DISPLAY) || (consumer == FILTER_CONSUMER_RECORD)) {
+			return filter_set_config(consumer, &config);
+		} else {
+			push_lep_command();
+			*forwarded = true;
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+
+static bool process_get_perf(cJSON* cmd_args)
+{
+	bool reset;
+	uint32_t push_msec;
+	
+	if (!json_parse_get_perf(cmd_args, &push_msec, &reset)) return false;
+	
+	sys_response_cmd_buffer.length = json_get_perf(sys_response_cmd_buffer.bufferP);
+	if (sys_response_cmd_buffer.length == 0) return false;
+	push_response(sys_response_cmd_buffer.bufferP, sys_response_cmd_buffer.length);
+	
+	if (reset) {
+		perf_reset();
+	}
+	
+	// Start (or stop) periodic perf records
+	rsp_set_perf_parameters(push_msec, reset);
+	xTaskNotify(task_handle_rsp, RSP_NOTIFY_CMD_PERF_MASK, eSetBits);
+	
+	return true;
+}
+
+
 static bool process_stream_on(cJSON* cmd_args)
 {
 	uint32_t delay_ms, num_frames;
@@ -730,6 +861,31 @@ static bool process_get_fs_list(cJSON* cmd_args)
 }
 
 
+static bool process_get_fs_page(cJSON* cmd_args)
+{
+	char dir_name[DIR_NAME_LEN];
+	file_page_req_t req;
+	
+	if (!power_get_sdcard_present()) {
+		return false;
+	} else if (json_parse_fs_page_args(cmd_args, &dir_name[0], &req)) {
+		if (strcmp(dir_name, "/") != 0) {
+			// Requesting files in one directory
+			req.dir_index = file_get_named_directory_index(dir_name);
+			if (req.dir_index < 0) {
+				return false;
+			}
+		}
+		
+		file_set_page_request(&req);
+		xTaskNotify(task_handle_file, FILE_NOTIFY_CMD_GET_PAGE_MASK, eSetBits);
+		return true;
+	}
+	
+	return false;
+}
+
+
 static bool process_get_fs_file(cJSON* cmd_args)
 {
 	bool image_is_video;
@@ -753,6 +909,25 @@ static bool process_get_fs_file(cJSON* cmd_args)
 }
 
 
+static bool process_get_file_raw(cJSON* cmd_args)
+{
+	char dir_name[DIR_NAME_LEN];
+	char file_name[FILE_NAME_LEN];
+	uint32_t offset;
+	uint32_t length;
+	
+	if (!power_get_sdcard_present()) {
+		return false;
+	} else if (json_parse_file_raw_args(cmd_args, &dir_name[0], &file_name[0], &offset, &length)) {
+		file_set_get_raw(dir_name, file_name, offset, length);
+		xTaskNotify(task_handle_file, FILE_NOTIFY_CMD_GET_RAW_MASK, eSetBits);
+		return true;
+	}
+	
+	return false;
+}
+
+
 static bool process_del_fs_obj(cJSON* cmd_args)
 {
 	char dir_name[DIR_NAME_LEN];
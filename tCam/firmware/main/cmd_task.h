@@ -58,7 +58,16 @@
 #define CMD_FW_UPD_REQ  20
 #define CMD_FW_UPD_SEG  21
 #define CMD_DUMP_SCREEN 22
-#define CMD_NUM         23
+#define CMD_GET_FS_PAGE 23
+#define CMD_GET_FS_RAW  24
+#define CMD_SET_ROI     25
+#define CMD_GET_ROI     26
+#define CMD_SET_ALARM   27
+#define CMD_GET_ALARM   28
+#define CMD_SET_FILTER  29
+#define CMD_GET_FILTER  30
+#define CMD_GET_PERF    31
+#define CMD_NUM         32
 
 #define CMD_UNKNOWN     999
 
@@ -86,6 +95,15 @@
 #define CMD_FW_UPD_REQ_S  "fw_update_request"
 #define CMD_FW_UPD_SEG_S  "fw_segment"
 #define CMD_DUMP_SCREEN_S "dump_screen"
+#define CMD_GET_FS_PAGE_S "get_filesystem_page"
+#define CMD_GET_FS_RAW_S "get_file_raw"
+#define CMD_SET_ROI_S     "set_roi"
+#define CMD_GET_ROI_S     "get_roi"
+#define CMD_SET_ALARM_S   "set_alarm"
+#define CMD_GET_ALARM_S   "get_alarm"
+#define CMD_SET_FILTER_S  "set_filter"
+#define CMD_GET_FILTER_S  "get_filter"
+#define CMD_GET_PERF_S    "get_perf"
 
 
 // Delimiters used to wrap json strings sent over the network
@@ -31,11 +31,14 @@
 #include "rsp_task.h"
 #include "file_utilities.h"
 #include "json_utilities.h"
+#include "perf_utilities.h"
 #include "power_utilities.h"
 #include "time_utilities.h"
 #include "sys_utilities.h"
 #include "esp_system.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_rom_crc.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
@@ -67,6 +70,9 @@ static int card_check_count = FILE_CARD_CHECK_PERIOD_MSEC / FILE_TASK_EVAL_NORM_
 // Hardware card detection state from the hardware switch on the card socket
 static bool card_present;
 
+// Counter used to delay updating the catalog cache file after the catalog is modified (0 = idle)
+static int catalog_save_count = 0;
+
 // Recording state
 static bool got_lep_image_0;
 static bool got_lep_image_1;
@@ -86,6 +92,10 @@ static uint32_t cur_record_frame_num;
 static uint32_t record_remaining_frames;            // Remaining frames to record
 static int64_t record_req_usec;                     // ESP32 uSec timestamp of requested record image
 
+// Alarm triggered recording
+static uint32_t alarm_active_mask;                  // Bit set for each active alarm rule that records
+static bool alarm_recording;                        // Current recording was started by an alarm
+
 // Read state
 //  - Used to coordinate reading files and transferring data to gui/rsp tasks
 //  - Two sets of state: CMD/RSP and GUI
@@ -114,6 +124,17 @@ static cJSON* read_json_obj;
 // CMD/RSP Video playback control
 static bool rsp_ready_for_video_image;               // Set by rsp_task when it is ready for the next image
 
+// CMD/RSP Raw file download control
+//  - Uses the CMD/RSP read state and rsp_file_text ping-pong buffers so the next chunk
+//    is read from the card while rsp_task is sending the previous one
+static bool raw_xfer_active;
+static uint8_t* raw_xfer_buffer;                     // Holds one chunk of raw file data
+static uint32_t raw_xfer_size;                       // File size
+static uint32_t raw_xfer_pos;                        // File position of the next chunk
+static uint32_t raw_xfer_remaining;                  // Bytes left to read
+static uint32_t raw_xfer_req_offset;                 // Requested start offset
+static uint32_t raw_xfer_req_length;                 // Requested length (0 = to end of file)
+
 // GUI Video playback control
 static bool video_playing;
 static bool video_fixed_playback;
@@ -131,6 +152,21 @@ static int catalog_type[2];                            // -1 is list of director
 static int num_catalog_names[2];                       // Set with catalog_names_buffer
 static char catalog_names_buffer[2][FILE_MAX_CATALOG_NAMES * FILE_NAME_LEN];
 
+// GUI browse thumbnail (for the file last set with file_set_get_image)
+static uint8_t gui_thumbnail[FILE_THUMB_LEN];
+
+// Filesystem catalog page for CMD/RSP
+//  - page_req_mutex protects the request set by cmd_task
+//  - page_mutex protects the result read by rsp_task so a following request can't
+//    overwrite it while it is being converted to json
+static SemaphoreHandle_t page_req_mutex;
+static SemaphoreHandle_t page_mutex;
+static file_page_req_t page_req;
+static file_page_entry_t page_entries[FILE_MAX_PAGE_ENTRIES];
+static int num_page_entries;
+static int page_offset;
+static int page_total;
+
 
 
 //
@@ -140,12 +176,20 @@ static void init_task();
 static void handle_notifications();
 static void update_card_present_info();
 static void catalog_filesystem();
+static void catalog_modified();
+static void update_catalog_cache();
+static void get_catalog_page();
+static bool get_movie_num_frames(char* dir_name, char* file_name, int* num_frames);
+static bool get_thumbnail();
+static void create_thumbnail(lep_buffer_t* lep, uint8_t* thumb);
 static bool delete_image(int src);
 static bool delete_directory(int src);
 static bool format_card(int src);
 static void setup_delete_image(int src);
 static bool setup_store_image();
-static bool setup_recording();
+static bool setup_recording(bool pretrig);
+static void save_pretrig_images();
+static void eval_alarm_recording();
 static bool stop_recording();
 static void eval_record_ready();
 static void save_image(int n);
@@ -154,12 +198,16 @@ static bool write_json_buffer(char* buf, int buf_len);
 static void close_open_write_file(bool err);
 static bool get_json_time_date(char* src, int len, tmElements_t* te);
 static bool copy_date_time(char* src, char* dst, int max);
+static bool read_video_info(FILE* fp, char* rbuf, uint64_t* start_msec, uint64_t* end_msec, int* num_frames);
 static bool read_image(int dst);
 static bool setup_playback(int dst);
 static bool start_gui_playback(bool* eof);
 static void pause_gui_playback();
 static void stop_playback(int dst);
 static bool eval_rsp_playback(bool* eof);
+static bool setup_raw_download();
+static bool eval_rsp_raw_download(bool* eof);
+static bool read_raw_chunk();
 static bool eval_gui_playback(bool* eof);
 static bool read_json_record(int dst, bool is_img, bool* eof);
 static void setup_read_ping_pong(int dst);
@@ -223,6 +271,7 @@ void file_task()
 		
 		if (!rec_file_open && !read_file_open[FILE_REQ_SRC_CMD] && !read_file_open[FILE_REQ_SRC_GUI]) {
 			update_card_present_info();
+			update_catalog_cache();
 		}
 		
 		// Evaluate saving
@@ -242,7 +291,17 @@ void file_task()
 		}
 		
 		// Evaluate playback
-		if (read_file_open[FILE_REQ_SRC_CMD]) {
+		if (read_file_open[FILE_REQ_SRC_CMD] && raw_xfer_active) {
+			fast_eval = true;
+			if (!eval_rsp_raw_download(&eof)) {
+				if (eof) {
+					xTaskNotify(task_handle_rsp, RSP_NOTIFY_FILE_VID_END_MASK, eSetBits);
+				} else {
+					xTaskNotify(task_handle_app, APP_NOTIFY_PB_CMD_FAIL_MASK, eSetBits);
+				}
+				stop_playback(FILE_REQ_SRC_CMD);
+			}
+		} else if (read_file_open[FILE_REQ_SRC_CMD]) {
 			if (!eval_rsp_playback(&eof)) {
 				if (eof) {
 					xTaskNotify(task_handle_rsp, RSP_NOTIFY_FILE_VID_END_MASK, eSetBits);
@@ -291,6 +350,19 @@ void file_set_record_parameters(uint32_t delay_ms, uint32_t num_frames)
 }
 
 
+// Called by lep_task before sending FILE_NOTIFY_ALARM_RECORD_MASK
+void file_set_alarm_record(int rule, bool active)
+{
+	if ((rule < 0) || (rule > 31)) return;
+	
+	if (active) {
+		alarm_active_mask |= (1 << rule);
+	} else {
+		alarm_active_mask &= ~(1 << rule);
+	}
+}
+
+
 // Called by another task before sending FILE_NOTIFY_GET_CATALOG.
 void file_set_catalog_index(int src, int type)
 {
@@ -307,6 +379,34 @@ char* file_get_catalog(int src, int* num, int* type)
 }
 
 
+// Called by cmd_task before sending FILE_NOTIFY_CMD_GET_PAGE_MASK
+void file_set_page_request(file_page_req_t* req)
+{
+	xSemaphoreTake(page_req_mutex, portMAX_DELAY);
+	page_req = *req;
+	xSemaphoreGive(page_req_mutex);
+}
+
+
+// Called by rsp_task to get the catalog page entries.  Locks the entries until
+// file_release_page_entries is called.
+file_page_entry_t* file_get_page_entries(int* num, int* offset, int* total)
+{
+	xSemaphoreTake(page_mutex, portMAX_DELAY);
+	*num = num_page_entries;
+	*offset = page_offset;
+	*total = page_total;
+	return page_entries;
+}
+
+
+// Called by rsp_task when it is done with the entries from file_get_page_entries
+void file_release_page_entries()
+{
+	xSemaphoreGive(page_mutex);
+}
+
+
 // Called by another task to setup a read of file
 void file_set_get_image(int src, char* dir_name, char* file_name)
 {
@@ -315,6 +415,16 @@ void file_set_get_image(int src, char* dir_name, char* file_name)
 }
 
 
+// Called by cmd_task before sending FILE_NOTIFY_CMD_GET_RAW_MASK
+void file_set_get_raw(char* dir_name, char* file_name, uint32_t offset, uint32_t length)
+{
+	strcpy(&read_dir_names[FILE_REQ_SRC_CMD][0], dir_name);
+	strcpy(&read_file_names[FILE_REQ_SRC_CMD][0], file_name);
+	raw_xfer_req_offset = offset;
+	raw_xfer_req_length = length;
+}
+
+
 // Called by another task to setup the deletion of a directory
 void file_set_del_dir(int src, char* dir_name)
 {
@@ -330,6 +440,13 @@ void file_set_del_image(int src, char* dir_name, char* file_name)
 }
 
 
+// Called by gui_task to get the thumbnail after GUI_NOTIFY_FILE_THUMB_READY_MASK
+uint8_t* file_get_gui_thumbnail()
+{
+	return gui_thumbnail;
+}
+
+
 // Called by rsp_task to get a pointer to the current rsp_file_text ping-pong buffer
 // side being read.
 char* file_get_rsp_file_text(int* len)
@@ -358,11 +475,24 @@ static void init_task()
 	got_lep_image_1 = false;
 	recording = false;
 	rec_image_ready = false;
+	alarm_active_mask = 0;
+	alarm_recording = false;
 	next_record_frame_delay_msec = 0;
 	next_record_frame_num = 0;
 	rsp_ready_for_video_image = false;
+	raw_xfer_active = false;
 	video_playing = false;
 	video_gui_buf_index = 0;
+	num_page_entries = 0;
+	page_offset = 0;
+	page_total = 0;
+	page_req_mutex = xSemaphoreCreateMutex();
+	page_mutex = xSemaphoreCreateMutex();
+	
+	raw_xfer_buffer = heap_caps_malloc(FILE_RAW_CHUNK_LEN, MALLOC_CAP_SPIRAM);
+	if (raw_xfer_buffer == NULL) {
+		ESP_LOGE(TAG, "Could not allocate raw download buffer");
+	}
 }
 
 
@@ -436,6 +566,11 @@ static void handle_notifications()
 			xTaskNotify(task_handle_rsp, RSP_NOTIFY_FILE_CATALOG_READY_MASK, eSetBits);
 		}
 		
+		if (Notification(notification_value, FILE_NOTIFY_CMD_GET_PAGE_MASK)) {
+			get_catalog_page();
+			xTaskNotify(task_handle_rsp, RSP_NOTIFY_FILE_PAGE_READY_MASK, eSetBits);
+		}
+		
 		if (Notification(notification_value, FILE_NOTIFY_GUI_GET_CATALOG_MASK)) {
 			num_catalog_names[FILE_REQ_SRC_GUI] = file_get_name_list(catalog_type[FILE_REQ_SRC_GUI], &catalog_names_buffer[FILE_REQ_SRC_GUI][0]);
 			xTaskNotify(task_handle_gui, GUI_NOTIFY_FILE_CATALOG_READY_MASK, eSetBits);
@@ -472,10 +607,14 @@ static void handle_notifications()
 
 		if (Notification(notification_value, FILE_NOTIFY_START_RECORDING_MASK)) {
 			// Setup to store a series of images to a single file
-			if (!setup_recording()) {
+			if (!setup_recording(false)) {
 				xTaskNotify(task_handle_app, APP_NOTIFY_RECORD_FAIL_MASK, eSetBits);
 			}
 		}
+		
+		if (Notification(notification_value, FILE_NOTIFY_ALARM_RECORD_MASK)) {
+			eval_alarm_recording();
+		}
 
 		if (Notification(notification_value, FILE_NOTIFY_STOP_RECORDING_MASK)) {
 			if (recording) {
@@ -531,6 +670,18 @@ static void handle_notifications()
 			}
 		}
 		
+		if (Notification(notification_value, FILE_NOTIFY_CMD_GET_RAW_MASK)) {
+			if (!setup_raw_download()) {
+				xTaskNotify(task_handle_app, APP_NOTIFY_PB_CMD_FAIL_MASK, eSetBits);
+			}
+		}
+		
+		if (Notification(notification_value, FILE_NOTIFY_GUI_GET_THUMB_MASK)) {
+			if (get_thumbnail()) {
+				xTaskNotify(task_handle_gui, GUI_NOTIFY_FILE_THUMB_READY_MASK, eSetBits);
+			}
+		}
+		
 		if (Notification(notification_value, FILE_NOTIFY_GUI_GET_VIDEO_MASK)) {
 			if (setup_playback(FILE_REQ_SRC_GUI)) {
 				// Let the GUI know how long the video is
@@ -597,6 +748,7 @@ static void update_card_present_info()
 			if (card_present) {
 				// Card just removed, clear memory of it
 				init_task();   // Reset ourselves
+				catalog_save_count = 0;
 				file_delete_filesystem_info();  // Delete the filesystem information structure (catalog)
 				xTaskNotify(task_handle_app, APP_NOTIFY_SDCARD_MISSING_MASK, eSetBits);
 				ESP_LOGI(TAG, "SD Card detected removed");
@@ -627,6 +779,201 @@ static void catalog_filesystem()
 }
 
 
+/**
+ * Schedule an update of the catalog cache file after the filesystem information
+ * structure has been modified.
+ */
+static void catalog_modified()
+{
+	catalog_save_count = FILE_CATALOG_SAVE_DELAY_MSEC / FILE_TASK_EVAL_NORM_MSEC;
+}
+
+
+/**
+ * Update the catalog cache file when a scheduled update expires.  Called when no files
+ * are open so the card is not mounted.
+ */
+static void update_catalog_cache()
+{
+	if ((catalog_save_count > 0) && (--catalog_save_count == 0)) {
+		if (card_present && file_mount_sdcard()) {
+			if (!file_save_filesystem_info()) {
+				ESP_LOGE(TAG, "Could not update catalog cache");
+			}
+			file_unmount_sdcard();
+		}
+	}
+}
+
+
+/**
+ * Load page_entries with the files selected by the current page request.  The number of
+ * frames in movie files that haven't been read since the catalog was built are read from
+ * the video_info record at the end of the file and stored in the catalog.
+ */
+static void get_catalog_page()
+{
+	bool mounted_here = false;
+	int i;
+	int n;
+	file_page_req_t req;
+	
+	xSemaphoreTake(page_req_mutex, portMAX_DELAY);
+	req = page_req;
+	xSemaphoreGive(page_req_mutex);
+	
+	xSemaphoreTake(page_mutex, portMAX_DELAY);
+	num_page_entries = file_get_page(&req, page_entries, &page_total);
+	page_offset = req.offset;
+	
+	for (i=0; i<num_page_entries; i++) {
+		if (page_entries[i].num_frames < 0) {
+			if (!file_get_card_mounted()) {
+				if (!file_mount_sdcard()) break;
+				mounted_here = true;
+			}
+			if (get_movie_num_frames(page_entries[i].dir_name, page_entries[i].file_name, &n)) {
+				page_entries[i].num_frames = n;
+				file_set_file_num_frames(page_entries[i].fileP, n);
+				catalog_modified();
+			}
+		}
+	}
+	
+	if (mounted_here) {
+		file_unmount_sdcard();
+	}
+	xSemaphoreGive(page_mutex);
+}
+
+
+/**
+ * Get the number of frames from the video_info record of a movie file.  The filesystem
+ * should be mounted.
+ */
+static bool get_movie_num_frames(char* dir_name, char* file_name, int* num_frames)
+{
+	bool ret;
+	static char rbuf[VIDEO_INFO_READ_LEN + 1];
+	FILE* fp;
+	uint64_t start_msec;
+	uint64_t end_msec;
+	
+	if (!file_open_image_read_file(dir_name, file_name, &fp)) {
+		return false;
+	}
+	
+	ret = read_video_info(fp, rbuf, &start_msec, &end_msec, num_frames);
+	
+	file_close_file(fp);
+	
+	return ret;
+}
+
+
+/**
+ * Load gui_thumbnail with the thumbnail for the file set by the GUI.  The thumbnail
+ * is read from the directory's thumbnail container if it has already been created.
+ * Otherwise it is created from the (first) image in the file and added to the container.
+ */
+static bool get_thumbnail()
+{
+	bool ret = false;
+	char* dir_name = read_dir_names[FILE_REQ_SRC_GUI];
+	char* file_name = read_file_names[FILE_REQ_SRC_GUI];
+	directory_node_t* dirP;
+	file_node_t* fileP;
+	int n;
+	
+	// The GUI read state is in use during playback
+	if (read_file_open[FILE_REQ_SRC_GUI]) {
+		return false;
+	}
+	
+	// Get the file length from the catalog to validate the stored thumbnail
+	n = file_get_named_directory_index(dir_name);
+	if (n < 0) return false;
+	dirP = file_get_indexed_directory(n);
+	n = file_get_named_file_index(dirP, file_name);
+	if (n < 0) return false;
+	fileP = file_get_indexed_file(dirP, n);
+	if (fileP == NULL) return false;
+	
+	if (!file_get_card_mounted()) {
+		if (!file_mount_sdcard()) {
+			ESP_LOGE(TAG, "Could not mount the SD Card");
+			return false;
+		}
+	}
+	
+	if (file_read_thumbnail(dir_name, file_name, fileP->size, gui_thumbnail)) {
+		ret = true;
+	} else if (read_image(FILE_REQ_SRC_GUI)) {
+		// read_image reads the first record of a movie so we can use the same
+		// process for images and movies
+		if (string_to_read_json_obj(gui_file_text[0]+1) == FILE_JSON_IMAGE) {
+			if (json_parse_image(read_json_obj, &video_cur_img_msec, &file_gui_buffer[video_gui_buf_index])) {
+				create_thumbnail(&file_gui_buffer[video_gui_buf_index], gui_thumbnail);
+				ret = true;
+				
+				// read_image unmounts the card when it closes the file
+				if (file_get_card_mounted() || file_mount_sdcard()) {
+					if (file_write_thumbnail(dir_name, file_name, fileP->size, gui_thumbnail)) {
+						catalog_modified();
+					}
+				}
+			}
+		} else {
+			ESP_LOGE(TAG, "Could not decode image for thumbnail");
+		}
+		free_read_json_obj();
+	}
+	
+	if (!rec_file_open && !read_file_open[FILE_REQ_SRC_CMD]) {
+		file_unmount_sdcard();
+	}
+	
+	return ret;
+}
+
+
+/**
+ * Reduce a lepton image to a thumbnail by averaging each 2x2 block of pixels and then
+ * linearly scaling the result between its minimum and maximum values
+ */
+static void create_thumbnail(lep_buffer_t* lep, uint8_t* thumb)
+{
+	int x, y;
+	uint16_t* src;
+	uint16_t* dst;
+	uint16_t min_val = 0xFFFF;
+	uint16_t max_val = 0;
+	uint16_t t16;
+	uint32_t diff;
+	
+	// Average into the first half of the lepton buffer (which is re-read for display anyway)
+	dst = lep->lep_bufferP;
+	for (y=0; y<LEP_HEIGHT; y+=2) {
+		src = lep->lep_bufferP + (y * LEP_WIDTH);
+		for (x=0; x<LEP_WIDTH; x+=2) {
+			t16 = (uint16_t) (((uint32_t) *src + *(src+1) + *(src+LEP_WIDTH) + *(src+LEP_WIDTH+1)) / 4);
+			if (t16 < min_val) min_val = t16;
+			if (t16 > max_val) max_val = t16;
+			*dst++ = t16;
+			src += 2;
+		}
+	}
+	
+	diff = max_val - min_val;
+	if (diff == 0) diff = 1;
+	
+	src = lep->lep_bufferP;
+	for (x=0; x<FILE_THUMB_LEN; x++) {
+		*thumb++ = (uint8_t) (((uint32_t)(*src++ - min_val) * 255) / diff);
+	}
+}
+
+
 /**
  * Delete the file specified by the directory/file names previously loaded by src
  */
@@ -652,6 +999,7 @@ static bool delete_image(int src)
 				if (file_delete_file(del_dir_names[src], &del_file_names[src][0])) {
 					// Update the filesystem information structure
 					file_delete_file_info(dir, file_index);
+					catalog_modified();
 					
 					// Delete the directory itself if it is now empty
 					if (dir->num_files == 0) {
@@ -711,6 +1059,7 @@ static bool delete_directory(int src)
 					if (file_delete_file(del_dir_names[src], file->nameP)) {
 						// Update the filesystem information structure
 						file_delete_file_info(dir, i);
+						catalog_modified();
 					} else {
 						// Stop on failure
 						break;
@@ -722,6 +1071,7 @@ static bool delete_directory(int src)
 			if (dir->num_files == 0) {
 				if (file_delete_directory(&del_dir_names[src][0])) {
 					file_delete_directory_info(dir_index);
+					catalog_modified();
 					success = true;
 				}
 			}
@@ -755,6 +1105,7 @@ static bool format_card(int src)
 	if (file_format_card()) {
 		ESP_LOGI(TAG, "Format SD Card");
 		file_delete_filesystem_info();
+		catalog_save_count = 0;
 		return true;
 	} else {
 		ESP_LOGE(TAG, "Format SD Card failed");
@@ -835,9 +1186,10 @@ static bool setup_store_image()
 
 
 /**
- * Setup to start a recording
+ * Setup to start a recording, optionally starting with the images held by lep_task
+ * before an alarm triggered
  */
-static bool setup_recording()
+static bool setup_recording(bool pretrig)
 {
 	bool ret = true;
 	
@@ -863,6 +1215,11 @@ static bool setup_recording()
 				record_remaining_frames = next_record_frame_num;
 				recording = true;
 				
+				// Save the pre-trigger images before the live images start
+				if (pretrig) {
+					save_pretrig_images();
+				}
+				
 				// Request images from lep_task and get a precision timestamp
 				xTaskNotify(task_handle_lep, LEP_NOTIFY_EN_FILE_FRAME_MASK, eSetBits);
 				record_req_usec = esp_timer_get_time();
@@ -893,6 +1250,7 @@ static bool stop_recording()
 	int len;
 	
 	recording = false;
+	alarm_recording = false;
 	
 	// Create the video_info json record as the final information written to the file
 	len = json_get_video_info(buf, rec_start_time, rec_stop_time, num_record_frames);
@@ -917,6 +1275,60 @@ static bool stop_recording()
 }
 
 
+/**
+ * Write the images held in lep_task's pre-trigger ring to the recording file, oldest
+ * first.  lep_file_buffer[0] is free to use since lep_task has not been asked for
+ * recording images yet.
+ */
+static void save_pretrig_images()
+{
+	bool valid;
+	int i;
+	int n;
+	
+	n = lep_pretrig_lock();
+	for (i=0; i<n; i++) {
+		valid = false;
+		if (xSemaphoreTake(lep_file_buffer[0].mutex, portMAX_DELAY)) {
+			valid = lep_pretrig_get_frame(i, &lep_file_buffer[0]);
+			xSemaphoreGive(lep_file_buffer[0].mutex);
+		}
+		if (valid) {
+			save_image(0);
+			
+			// Stop if the write failed
+			if (!rec_file_open) break;
+		}
+	}
+	lep_pretrig_unlock();
+}
+
+
+/**
+ * Start a recording when an alarm rule that records becomes active and stop it when
+ * all such rules have cleared.  Recordings started by the user are left alone.
+ */
+static void eval_alarm_recording()
+{
+	if (alarm_active_mask != 0) {
+		if (!recording && card_present) {
+			// Record every image until the alarm clears
+			next_record_frame_delay_msec = 0;
+			next_record_frame_num = 0;
+			if (setup_recording(true)) {
+				alarm_recording = true;
+			} else {
+				xTaskNotify(task_handle_app, APP_NOTIFY_RECORD_FAIL_MASK, eSetBits);
+			}
+		}
+	} else if (alarm_recording && recording) {
+		if (!stop_recording()) {
+			xTaskNotify(task_handle_app, APP_NOTIFY_RECORD_FAIL_MASK, eSetBits);
+		}
+	}
+}
+
+
 /**
  * Evaluate if we're ready to store an image while recording
  */
@@ -974,6 +1386,7 @@ static void save_image(int n)
 static bool write_image_file(int n)
 {
 	bool err = false;
+	int64_t write_start_usec;
 	
 	if (recording) {
 		// Get the timestamp (used for the video_info record) immediately before creating
@@ -993,12 +1406,17 @@ static bool write_image_file(int n)
 	// Write the json string (minus the START delimiter but including the END if recording) to the file
 	if (!err) {
 		if (xSemaphoreTake(lep_file_buffer[n].mutex, portMAX_DELAY)) {
+			write_start_usec = esp_timer_get_time();
 			if (recording) {
 				err = !write_json_buffer(lep_file_buffer[n].bufferP + 1, lep_file_buffer[n].length - 1);
 			} else {
 				err = !write_json_buffer(lep_file_buffer[n].bufferP + 1, lep_file_buffer[n].length - 2);
 			}
 			xSemaphoreGive(lep_file_buffer[n].mutex);
+			if (!err) {
+				perf_count(PERF_CNT_WRITTEN);
+				perf_record(PERF_STAGE_WRITE, (uint32_t) (esp_timer_get_time() - write_start_usec));
+			}
 		} else {
 			err = true;
 		}
@@ -1066,6 +1484,7 @@ static void close_open_write_file(bool err)
 	char* dir_name;
 	char* file_name;
 	directory_node_t* dir_node;
+	file_node_t* file_node;
 	int dir_num;
 	
 	// Update the filesystem information structure (catalog)
@@ -1080,7 +1499,10 @@ static void close_open_write_file(bool err)
 			if (dir_num < 0) dir_num = file_get_num_directories() - 1;
 			dir_node = file_get_indexed_directory(dir_num);
 		}
-		(void) file_add_file_info(dir_node, file_name);
+		file_node = file_add_file_info(dir_node, file_name);
+		file_set_file_info(file_node, (uint32_t) file_get_open_filelength(rec_fp),
+		                   (*file_name == 'm') ? (int) num_record_frames : 1);
+		catalog_modified();
 	}
 	
 	// Close the file
@@ -1176,6 +1598,70 @@ static bool copy_date_time(char* src, char* dst, int max)
 }
 
 
+/**
+ * Read and parse the video_info record at the end of an open movie file.  rbuf must be
+ * able to hold VIDEO_INFO_READ_LEN bytes.  File stream is positioned at beginning on return.
+ */
+static bool read_video_info(FILE* fp, char* rbuf, uint64_t* start_msec, uint64_t* end_msec, int* num_frames)
+{
+	bool ret = true;
+	int brace_pos;
+	int n;
+	
+	n = file_get_open_filelength(fp);
+	if (n) {
+		if (file_read_open_section(fp, rbuf, n - VIDEO_INFO_READ_LEN, VIDEO_INFO_READ_LEN)) {
+			// Find the json record ending brace and set the character following it to
+			// null to accurately terminate the json string
+			brace_pos = -1;
+			for (n=VIDEO_INFO_READ_LEN-1; n>=0; n--) {
+				if (rbuf[n] == '}') {
+					brace_pos = n;
+					break;
+				} else {
+					rbuf[n] = 0;
+				}
+			}
+			
+			// Find the json record starting brace
+			brace_pos = -1;
+			for (n=0; n<VIDEO_INFO_READ_LEN; n++) {
+				if (rbuf[n] == '{') {
+					brace_pos = n;
+					break;
+				}
+			}
+			
+			// Create the video_info json record
+			if (brace_pos != -1) {
+				if (string_to_read_json_obj(&rbuf[brace_pos]) == FILE_JSON_VIDEO_INFO) {
+					// Parse the video_info object
+					if (!json_parse_video_info(read_json_obj, start_msec, end_msec, num_frames)) {
+						ESP_LOGE(TAG, "Could not parse video_info json object");
+						ret = false;
+					}
+				} else {
+					ESP_LOGE(TAG, "Could not convert string into video_info obj: %s", &rbuf[brace_pos]);
+					ret = false;
+				}
+				free_read_json_obj();
+			} else {
+				ESP_LOGE(TAG, "Could not find video_info record in file");
+				ret = false;
+			}
+		} else {
+			ESP_LOGE(TAG, "Could not read video_info from file");
+			ret = false;
+		}
+	} else {
+		ESP_LOGE(TAG, "Could not get video file length");
+		ret = false;
+	}
+	
+	return ret;
+}
+
+
 /**
  * Read a single image file into the first half of the ping-pong buffer
  */
@@ -1233,7 +1719,6 @@ static bool setup_playback(int dst)
 	char* ppbuf;
 	char* rbuf;
 	int n;
-	int brace_pos;
 	int rec_type;
 	uint64_t end_msec;
 	
@@ -1256,70 +1741,24 @@ static bool setup_playback(int dst)
 	// Process the video_info record at the end of the file to setup playback parameters
 	// for images going to the gui
 	if (ret && (dst == FILE_REQ_SRC_GUI)) {
-		n = file_get_open_filelength(read_fp[dst]);
-		if (n) {
-			// Use the read_buffer to hold the section of the file containing
-			// the video_info json string
-			rbuf = &read_buffers[FILE_REQ_SRC_GUI][0];
-			if (file_read_open_section(read_fp[dst], rbuf, n - VIDEO_INFO_READ_LEN, VIDEO_INFO_READ_LEN)) {
-				// Find the json record ending brace and set the character following it to
-				// null to accurately terminate the json string
-				brace_pos = -1;
-				for (n=VIDEO_INFO_READ_LEN-1; n>=0; n--) {
-					if (rbuf[n] == '}') {
-						brace_pos = n;
-						break;
-					} else {
-						rbuf[n] = 0;
-					}
-				}
-				
-				// Find the json record starting brace
-				brace_pos = -1;
-				for (n=0; n<VIDEO_INFO_READ_LEN; n++) {
-					if (rbuf[n] == '{') {
-						brace_pos = n;
-						break;
-					}
-				}
-				
-				// Create the video_info json record
-				if (brace_pos != -1) {
-					if (string_to_read_json_obj(&rbuf[brace_pos]) == FILE_JSON_VIDEO_INFO) {
-						// Parse the video_info object
-						if (json_parse_video_info(read_json_obj, &video_start_img_msec, &end_msec, &n)) {
-							if (n != 0) {
-								// Determine if we will used a fixed playback speed
-								video_len_msec = (uint32_t) (end_msec - video_start_img_msec);
-								video_fixed_playback = (video_len_msec / n) >= VIDEO_FIXED_PLAYBACK_MSEC;
-	#ifdef LOG_VIDEO_TIMING
-								ESP_LOGI(TAG, "video len = %d", video_len_msec);
-								ESP_LOGI(TAG, "num frames = %d", n);
-								ESP_LOGI(TAG, "video_fixed_playback = %d", video_fixed_playback);
-	#endif			
-							} else {
-								ESP_LOGE(TAG, "video_info indicated 0 frames");
-								ret = false;
-							}
-						} else {
-							ESP_LOGE(TAG, "Could not parse video_info json object");
-							ret = false;
-						}
-					} else {
-						ESP_LOGE(TAG, "Could not convert string into video_info obj: %s", &rbuf[brace_pos]);
-						ret = false;
-					}
-					free_read_json_obj();
-				} else {
-					ESP_LOGE(TAG, "Could not find video_info record in file");
-					ret = false;
-				}
+		// Use the read_buffer to hold the section of the file containing
+		// the video_info json string
+		rbuf = &read_buffers[FILE_REQ_SRC_GUI][0];
+		if (read_video_info(read_fp[dst], rbuf, &video_start_img_msec, &end_msec, &n)) {
+			if (n != 0) {
+				// Determine if we will used a fixed playback speed
+				video_len_msec = (uint32_t) (end_msec - video_start_img_msec);
+				video_fixed_playback = (video_len_msec / n) >= VIDEO_FIXED_PLAYBACK_MSEC;
+#ifdef LOG_VIDEO_TIMING
+				ESP_LOGI(TAG, "video len = %d", video_len_msec);
+				ESP_LOGI(TAG, "num frames = %d", n);
+				ESP_LOGI(TAG, "video_fixed_playback = %d", video_fixed_playback);
+#endif			
 			} else {
-				ESP_LOGE(TAG, "Could not read video_info from file");
+				ESP_LOGE(TAG, "video_info indicated 0 frames");
 				ret = false;
 			}
 		} else {
-			ESP_LOGE(TAG, "Could not get video file length");
 			ret = false;
 		}
 	}
@@ -1479,6 +1918,8 @@ static void stop_playback(int dst)
 {
 	if (dst == FILE_REQ_SRC_GUI) {
 		video_playing = false;
+	} else {
+		raw_xfer_active = false;
 	}
 	num_pp_valid[dst] = 0;
 	close_open_read_file(dst);
@@ -1523,6 +1964,163 @@ static bool eval_rsp_playback(bool* eof)
 }
 
 
+/**
+ * Setup a raw download of a file:
+ *   - Attempt to open the file and position it at the requested offset
+ *   - Attempt to read the first chunk into the first half of the ping-pong buffer
+ *   - Attempt to read the second chunk, if any, into the second half
+ * Always sends at least one (possibly empty) chunk so the host sees the file size.
+ */
+static bool setup_raw_download()
+{
+	bool ret = true;
+	int n;
+	
+	// Initialize
+	if (read_file_open[FILE_REQ_SRC_CMD]) {
+		stop_playback(FILE_REQ_SRC_CMD);
+	}
+	setup_read_ping_pong(FILE_REQ_SRC_CMD);
+	
+	if (raw_xfer_buffer == NULL) {
+		return false;
+	}
+	
+	if (!file_get_card_mounted()) {
+		ret = file_mount_sdcard();
+	}
+	
+	// Open the file and compute the section to send
+	if (ret) {
+		if (file_open_image_read_file(read_dir_names[FILE_REQ_SRC_CMD], read_file_names[FILE_REQ_SRC_CMD], &read_fp[FILE_REQ_SRC_CMD])) {
+			read_file_open[FILE_REQ_SRC_CMD] = true;
+			raw_xfer_active = true;
+			
+			n = file_get_open_filelength(read_fp[FILE_REQ_SRC_CMD]);
+			raw_xfer_size = (uint32_t) n;
+			if (raw_xfer_req_offset > raw_xfer_size) {
+				ESP_LOGE(TAG, "Raw download offset %d past end of file (%d)", raw_xfer_req_offset, raw_xfer_size);
+				ret = false;
+			} else {
+				raw_xfer_pos = raw_xfer_req_offset;
+				raw_xfer_remaining = raw_xfer_size - raw_xfer_req_offset;
+				if ((raw_xfer_req_length != 0) && (raw_xfer_req_length < raw_xfer_remaining)) {
+					raw_xfer_remaining = raw_xfer_req_length;
+				}
+				if (fseek(read_fp[FILE_REQ_SRC_CMD], raw_xfer_pos, SEEK_SET) != 0) {
+					ESP_LOGE(TAG, "Could not seek to %d", raw_xfer_pos);
+					ret = false;
+				}
+			}
+		} else {
+			ret = false;
+		}
+	} else {
+		ESP_LOGE(TAG, "Could not mount the SD Card");
+	}
+	
+	// Load the ping-pong buffer
+	if (ret) {
+		ret = read_raw_chunk();
+	}
+	if (ret && (raw_xfer_remaining != 0)) {
+		ret = read_raw_chunk();
+	}
+	
+	if (ret) {
+		// Start streaming immediately
+		xTaskNotify(task_handle_rsp, RSP_NOTIFY_FILE_VID_START_MASK, eSetBits);
+		xTaskNotify(task_handle_rsp, RSP_NOTIFY_FILE_IMG_READY_MASK, eSetBits);
+	} else {
+		stop_playback(FILE_REQ_SRC_CMD);
+	}
+	
+	return ret;
+}
+
+
+/**
+ * Process a raw download for the rsp_task in response to a command
+ *  - Hand the last chunk loaded to rsp_task as soon as it's ready for it
+ *  - Read the following chunk while rsp_task is sending
+ * Returns false on failure or eof.  Sets eof when rsp_task has consumed the final chunk.
+ */
+static bool eval_rsp_raw_download(bool* eof)
+{
+	bool ret = true;
+	
+	*eof = false;
+	
+	if (rsp_ready_for_video_image) {
+		rsp_ready_for_video_image = false;
+		
+		if (num_pp_valid[FILE_REQ_SRC_CMD] > 0) {
+			xTaskNotify(task_handle_rsp, RSP_NOTIFY_FILE_IMG_READY_MASK, eSetBits);
+			
+			if (raw_xfer_remaining != 0) {
+				ret = read_raw_chunk();
+			}
+		} else {
+			// Final chunk sent
+			*eof = true;
+		}
+	}
+	
+	return ret && !*eof;
+}
+
+
+/**
+ * Read the next chunk of a raw download and format it as a file_chunk response in the
+ * current rsp_file_text ping-pong load buffer
+ */
+static bool read_raw_chunk()
+{
+	char* ppbuf;
+	int len;
+	int read_ret;
+	uint32_t crc;
+#ifdef LOG_READ_TIMESTAMP
+	int64_t tb, te;
+	
+	tb = esp_timer_get_time();
+#endif
+	
+	len = (raw_xfer_remaining > FILE_RAW_CHUNK_LEN) ? FILE_RAW_CHUNK_LEN : raw_xfer_remaining;
+	if (len != 0) {
+		read_ret = fread(raw_xfer_buffer, 1, len, read_fp[FILE_REQ_SRC_CMD]);
+		if (read_ret != len) {
+			ESP_LOGE(TAG, "Error in raw file read - %d", ferror(read_fp[FILE_REQ_SRC_CMD]));
+			return false;
+		}
+	}
+	crc = esp_rom_crc32_le(0, raw_xfer_buffer, len);
+	
+	ppbuf = rsp_file_text[cur_pp_load_index[FILE_REQ_SRC_CMD]];
+	cur_pp_length[FILE_REQ_SRC_CMD][cur_pp_load_index[FILE_REQ_SRC_CMD]] = 
+		json_get_file_chunk_response(ppbuf, read_dir_names[FILE_REQ_SRC_CMD], read_file_names[FILE_REQ_SRC_CMD],
+		                             raw_xfer_size, raw_xfer_pos, len, crc, raw_xfer_buffer);
+	if (cur_pp_length[FILE_REQ_SRC_CMD][cur_pp_load_index[FILE_REQ_SRC_CMD]] == 0) {
+		ESP_LOGE(TAG, "Could not create file_chunk response");
+		return false;
+	}
+	
+	raw_xfer_pos += len;
+	raw_xfer_remaining -= len;
+	
+	// Point to the next ping-pong buffer
+	cur_pp_load_index[FILE_REQ_SRC_CMD] = (cur_pp_load_index[FILE_REQ_SRC_CMD] == 0) ? 1 : 0;
+	if (num_pp_valid[FILE_REQ_SRC_CMD] < 2) num_pp_valid[FILE_REQ_SRC_CMD] += 1;
+	
+#ifdef LOG_READ_TIMESTAMP
+	te = esp_timer_get_time();
+	ESP_LOGI(TAG, "read_raw_chunk took %d uSec (%d bytes)", (int) (te - tb), len);
+#endif
+	
+	return true;
+}
+
+
 /**
  * Process video playback for the GUI
  *  - Determine if an image should be sent, converting it to lepton data
@@ -28,6 +28,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "file_utilities.h"
 
 
 //
@@ -61,6 +62,12 @@
 #define FILE_NOTIFY_GUI_DEL_DIR_MASK      0x00800000
 #define FILE_NOTIFY_GUI_FORMAT_MASK       0x01000000
 
+#define FILE_NOTIFY_CMD_GET_PAGE_MASK     0x02000000
+#define FILE_NOTIFY_CMD_GET_RAW_MASK      0x04000000
+#define FILE_NOTIFY_GUI_GET_THUMB_MASK    0x08000000
+
+#define FILE_NOTIFY_ALARM_RECORD_MASK     0x10000000
+
 
 // Maximum file write size - maximum bytes to write through the system call so that
 // we don't put too large a pressure on the stack or heap
@@ -74,9 +81,18 @@
 // the video_info record.  Must be <= MAX_FILE_READ_LEN.
 #define VIDEO_INFO_READ_LEN               256
 
+// Raw file download chunk size.  Each chunk is base64 encoded (4/3 expansion) into a
+// file_chunk response that must fit in a JSON_MAX_IMAGE_TEXT_LEN rsp_file_text buffer.
+#define FILE_RAW_CHUNK_LEN                32768
+
 // Period between checks for card present state.
 #define FILE_CARD_CHECK_PERIOD_MSEC       2000
 
+// Delay after the last catalog modification before the catalog cache file is updated.
+// Restarted by each modification so a series of recordings or deletions results in
+// a single update.
+#define FILE_CATALOG_SAVE_DELAY_MSEC      5000
+
 // Catalog request sources
 #define FILE_REQ_SRC_CMD                  0
 #define FILE_REQ_SRC_GUI                  1
@@ -89,9 +105,15 @@
 void file_task();
 bool file_card_present();
 void file_set_record_parameters(uint32_t delay_ms, uint32_t num_frames);
+void file_set_alarm_record(int rule, bool active);
 void file_set_catalog_index(int src, int type);
 char* file_get_catalog(int src, int* num, int* type);
+void file_set_page_request(file_page_req_t* req);
+file_page_entry_t* file_get_page_entries(int* num, int* offset, int* total);
+void file_release_page_entries();
 void file_set_get_image(int src, char* dir_name, char* file_name);
+void file_set_get_raw(char* dir_name, char* file_name, uint32_t offset, uint32_t length);
+uint8_t* file_get_gui_thumbnail();
 void file_set_del_dir(int src, char* dir_name);
 void file_set_del_image(int src, char* dir_name, char* file_name);
 char* file_get_rsp_file_text(int* len);
@@ -30,12 +30,14 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_system.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
 #include "esp_freertos_hooks.h"
 #include "system_config.h"
 #include "disp_spi.h"
 #include "disp_driver.h"
 #include "touch_driver.h"
+#include "perf_utilities.h"
 #include "sys_utilities.h"
 #include "gui_screen_main.h"
 #include "gui_screen_settings.h"
@@ -72,8 +74,9 @@
 static const char* TAG = "gui_task";
 
 // Dual display update buffers to allow DMA/SPI transfer of one while the other is updated
-static lv_color_t lvgl_disp_buf1[LVGL_DISP_BUF_SIZE];
-static lv_color_t lvgl_disp_buf2[LVGL_DISP_BUF_SIZE];
+// (allocated in DMA capable internal memory)
+static lv_color_t* lvgl_disp_buf1;
+static lv_color_t* lvgl_disp_buf2;
 static lv_disp_buf_t lvgl_disp_buf;
 
 // Display driver
@@ -114,6 +117,7 @@ static void gui_add_subtasks();
 static void gui_task_event_handler_task(lv_task_t * task);
 static void gui_task_messagebox_handler_task(lv_task_t * task);
 static void IRAM_ATTR lv_tick_callback();
+static int gui_select_lep_image(uint32_t notification_value);
 static void gui_init_fps();
 static void gui_update_fps();
 #ifdef SYS_SCREENDUMP_ENABLE
@@ -271,6 +275,14 @@ void gui_set_playback_ts(uint32_t ts)
  */
 static bool gui_lvgl_init()
 {
+	// Allocate the display update buffers
+	lvgl_disp_buf1 = heap_caps_malloc(LVGL_DISP_BUF_SIZE * sizeof(lv_color_t), MALLOC_CAP_DMA);
+	lvgl_disp_buf2 = heap_caps_malloc(LVGL_DISP_BUF_SIZE * sizeof(lv_color_t), MALLOC_CAP_DMA);
+	if ((lvgl_disp_buf1 == NULL) || (lvgl_disp_buf2 == NULL)) {
+		ESP_LOGE(TAG, "malloc display buffers failed");
+		return false;
+	}
+	
 	// Initialize lvgl
 	lv_init();
 	
@@ -348,22 +360,12 @@ static void gui_task_event_handler_task(lv_task_t * task)
 		//
 		// LEPTON
 		//
-		if (Notification(notification_value, GUI_NOTIFY_LEP_FRAME_MASK_1)) {
-			// lep_task has updated the shared buffer with a new image
-			if (gui_cur_screen_index == GUI_SCREEN_MAIN) {
-				// Trigger the main screen to draw the image from the buffer to the display
-				gui_screen_main_update_lep_image(0);
-				
-				// Update FPS stats
-				gui_update_fps();
-				//printf("fps: %1.1f\n", gui_st.fps);
-			}
-		}
-		if (Notification(notification_value, GUI_NOTIFY_LEP_FRAME_MASK_2)) {
-			// lep_task has updated the shared buffer with a new image
+		if (Notification(notification_value, GUI_NOTIFY_LEP_FRAME_MASK_1) ||
+		    Notification(notification_value, GUI_NOTIFY_LEP_FRAME_MASK_2)) {
+			// lep_task has updated one or both shared buffers with a new image
 			if (gui_cur_screen_index == GUI_SCREEN_MAIN) {
-				// Trigger the main screen to draw the image from the buffer to the display
-				gui_screen_main_update_lep_image(1);
+				// Trigger the main screen to draw the newest image from the buffer to the display
+				gui_screen_main_update_lep_image(gui_select_lep_image(notification_value));
 				
 				// Update FPS stats
 				gui_update_fps();
@@ -451,6 +453,12 @@ static void gui_task_event_handler_task(lv_task_t * task)
 			}
 		}
 		
+		if (Notification(notification_value, GUI_NOTIFY_FILE_THUMB_READY_MASK)) {
+			if (gui_cur_screen_index == GUI_SCREEN_BROWSE) {
+				gui_screen_browse_update_thumbnail();
+			}
+		}
+		
 		if (Notification(notification_value, GUI_NOTIFY_FILE_IMAGE_READY_MASK)) {
 			if (gui_cur_screen_index == GUI_SCREEN_VIEW) {
 				gui_screen_view_update_image();
@@ -536,6 +544,31 @@ static void IRAM_ATTR lv_tick_callback()
 }
 
 
+/**
+ * Return the index of the lep_gui_buffer to display.  If we fell behind and both
+ * buffers hold new images only the newest is displayed, the older one is dropped
+ * so the display doesn't lag the camera.
+ */
+static int gui_select_lep_image(uint32_t notification_value)
+{
+	int older;
+	
+	if (!Notification(notification_value, GUI_NOTIFY_LEP_FRAME_MASK_1)) return 1;
+	if (!Notification(notification_value, GUI_NOTIFY_LEP_FRAME_MASK_2)) return 0;
+	
+	older = (lep_gui_buffer[0].rx_usec < lep_gui_buffer[1].rx_usec) ? 0 : 1;
+	
+	xSemaphoreTake(lep_gui_buffer[older].mutex, portMAX_DELAY);
+	if (lep_gui_buffer[older].unread) {
+		lep_gui_buffer[older].unread = false;
+		perf_count(PERF_CNT_DROP_STALE);
+	}
+	xSemaphoreGive(lep_gui_buffer[older].mutex);
+	
+	return (older == 0) ? 1 : 0;
+}
+
+
 /**
  * Frame/sec averaging
  */
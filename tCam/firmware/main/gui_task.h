@@ -81,6 +81,7 @@
 #define GUI_NOTIFY_FILE_UPDATE_PB_LEN_MASK  0x00400000
 #define GUI_NOTIFY_FILE_UPDATE_PB_TS_MASK   0x00800000
 #define GUI_NOTIFY_FILE_PB_DONE_MASK        0x01000000
+#define GUI_NOTIFY_FILE_THUMB_READY_MASK    0x02000000
 
 // From gcore_task
 #define GUI_NOTIFY_SNAP_BTN_PRESSED_MASK    0x10000000
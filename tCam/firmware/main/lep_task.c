@@ -28,6 +28,7 @@
 #include "esp_log.h"
 #include "esp_heap_caps.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "driver/spi_master.h"
 #include "app_task.h"
@@ -36,8 +37,10 @@
 #include "gui_task.h"
 #include "lep_task.h"
 #include "rsp_task.h"
+#include "filter_utilities.h"
 #include "json_utilities.h"
 #include "lepton_utilities.h"
+#include "perf_utilities.h"
 #include "sif_utilities.h"
 #include "sys_utilities.h"
 #include "system_config.h"
@@ -86,6 +89,15 @@ static char json_rsp[JSON_MAX_RSP_TEXT_LEN];  // Single json response
 static int rsp_push_index;
 static int rsp_pop_index;
 
+// Pre-trigger image ring for alarm recordings - holds images exactly as read from
+// tCam-Mini (json strings or binary frames) in the external RAM
+static SemaphoreHandle_t pretrig_mutex;
+static uint32_t alarm_record_mask;            // Bit set for each alarm rule that records
+static json_string_t pretrig_buffer[LEP_PRETRIG_FRAMES];
+static bool pretrig_binary[LEP_PRETRIG_FRAMES];
+static int pretrig_push_index;
+static int pretrig_count;
+
 
 
 //
@@ -97,6 +109,15 @@ static bool rx_rsp_available();
 static void process_rx_response();
 static void process_status(cJSON* json_obj);
 static void process_image(cJSON* json_obj);
+static bool init_pretrig();
+static void push_pretrig_frame(bool binary);
+static void process_alarm(cJSON* json_obj);
+static void filter_display_image(lep_buffer_t* lep_buffer);
+static void load_record_image(int index);
+static void attach_file_image(int index, shared_image_t* imageP);
+static void account_gui_image(lep_buffer_t* lep_buffer, int64_t rx_usec);
+static void reset_gui_accounting();
+static shared_image_t* load_shared_image(char* src, int len, bool binary);
 static bool check_checksum(uint32_t exp_cs);
 static void push_response(char* buf, uint32_t len);
 
@@ -125,6 +146,12 @@ void lep_task()
 	json_image_index = 0;
 	rsp_push_index = 0;
 	rsp_pop_index = 0;
+	alarm_record_mask = 0;
+	
+	// Allocate the alarm recording pre-trigger image ring
+	if (!init_pretrig()) {
+		ESP_LOGE(TAG, "Could not allocate pre-trigger buffers");
+	}
 	
 	// Initialize the serial interface
 	sif_init();
@@ -149,12 +176,19 @@ void lep_task()
 			}
 			if (Notification(notification_value, LEP_NOTIFY_EN_FILE_FRAME_MASK)) {
 				file_image_requested = true;
+				
+				// Images were skipped while not recording
+				filter_reset(FILTER_CONSUMER_RECORD);
 			}
 			if (Notification(notification_value, LEP_NOTIFY_DIS_FILE_FRAME_MASK)) {
 				file_image_requested = false;
 			}
 			if (Notification(notification_value, LEP_NOTIFY_EN_GUI_FRAME_MASK)) {
 				gui_image_requested = true;
+				
+				// Images were skipped while the display was not live
+				filter_reset(FILTER_CONSUMER_DISPLAY);
+				reset_gui_accounting();
 			}
 			if (Notification(notification_value, LEP_NOTIFY_DIS_GUI_FRAME_MASK)) {
 				gui_image_requested = false;
@@ -196,6 +230,73 @@ bool lep_available()
 }
 
 
+/**
+ * Called by cmd_task when it forwards a set_alarm command to tCam-Mini.  Images are
+ * held in the pre-trigger ring while any rule records.
+ */
+void lep_set_alarm_record(int rule, bool en)
+{
+	if ((rule < 0) || (rule > 31)) return;
+	
+	if (en) {
+		alarm_record_mask |= (1 << rule);
+	} else {
+		alarm_record_mask &= ~(1 << rule);
+	}
+}
+
+
+/**
+ * Called by file_task to freeze the pre-trigger ring while it saves the images.
+ * Returns the number of images held.  Must be followed by lep_pretrig_unlock.
+ */
+int lep_pretrig_lock()
+{
+	if (pretrig_mutex == NULL) return 0;
+	
+	xSemaphoreTake(pretrig_mutex, portMAX_DELAY);
+	return pretrig_count;
+}
+
+
+/**
+ * Point dst at pre-trigger image n (0 is the oldest) loaded as a json image string.
+ * dst's current image is released first so this load does not need a shared buffer
+ * beyond those counted in SYS_SHARED_IMAGE_BUFFERS.  The caller must hold dst's mutex.
+ */
+bool lep_pretrig_get_frame(int n, json_image_ref_t* dst)
+{
+	int i;
+	shared_image_t* imageP;
+	
+	if ((n < 0) || (n >= pretrig_count)) return false;
+	
+	i = pretrig_push_index - pretrig_count + n;
+	if (i < 0) i += LEP_PRETRIG_FRAMES;
+	
+	system_image_detach(dst);
+	imageP = load_shared_image(pretrig_buffer[i].bufferP, pretrig_buffer[i].length, pretrig_binary[i]);
+	if (imageP == NULL) return false;
+	
+	system_image_attach(dst, imageP);
+	system_image_release(imageP);
+	return true;
+}
+
+
+/**
+ * Empty the pre-trigger ring (its images have been consumed) and let lep_task
+ * start filling it again
+ */
+void lep_pretrig_unlock()
+{
+	if (pretrig_mutex == NULL) return;
+	
+	pretrig_count = 0;
+	xSemaphoreGive(pretrig_mutex);
+}
+
+
 
 //
 // LEP Task Internal functions
@@ -326,11 +427,23 @@ static void process_rx_response()
 			// of a get_cci_reg or set_cci_reg command
 			push_response(json_rsp, i);
 		}
+		else if (cJSON_HasObjectItem(json_obj, "roi") || cJSON_HasObjectItem(json_obj, "alarm_rules") ||
+		         cJSON_HasObjectItem(json_obj, "filter")) {
+			// Push response string to rsp_task since this is the result of a forwarded
+			// get_roi, get_alarm or get_filter command
+			push_response(json_rsp, i);
+		}
+		else if (cJSON_HasObjectItem(json_obj, "alarm")) {
+			// Report the alarm and start or stop an alarm recording
+			push_response(json_rsp, i);
+			process_alarm(json_obj);
+		}
 		else if (cJSON_HasObjectItem(json_obj, "cam_info")) {
-			// Push cam_info response string if it is from a cci_reg command since
+			// Push cam_info response string if it is from a forwarded command since
 			// we want to report any failures if they occur (the command will have 
 			// returned the cci_reg response above if successful)
-			if (strstr(json_rsp, "cci") != NULL) {
+			if ((strstr(json_rsp, "cci") != NULL) || (strstr(json_rsp, "roi") != NULL) ||
+			    (strstr(json_rsp, "alarm") != NULL) || (strstr(json_rsp, "filter") != NULL)) {
 				push_response(json_rsp, i);
 			}
 		}
@@ -378,11 +491,35 @@ static void process_status(cJSON* json_obj)
 }
 
 
+static void process_alarm(cJSON* json_obj)
+{
+	bool active;
+	bool record;
+	int index;
+	
+	if (json_parse_alarm(json_obj, &index, &active, &record)) {
+		if (record) {
+			file_set_alarm_record(index, active);
+			xTaskNotify(task_handle_file, FILE_NOTIFY_ALARM_RECORD_MASK, eSetBits);
+		}
+	} else {
+		ESP_LOGE(TAG, "Could not parse alarm");
+	}
+}
+
+
 static void process_image(cJSON* json_obj)
 {
+	bool binary;
 	bool good_checksum;
+	bool record_filter;
+	int file_image_index;
 	uint32_t exp_cs;
 	uint32_t mask;
+	filter_config_t filter_config;
+	int64_t rx_start_usec, rx_end_usec;
+	int64_t parse_start_usec;
+	shared_image_t* imageP;
 
 #ifdef LOG_SEND_TIMESTAMP
 	int64_t tb, te;
@@ -406,7 +543,12 @@ static void process_image(cJSON* json_obj)
 #ifdef LOG_SEND_TIMESTAMP
 		tb = esp_timer_get_time();
 #endif
+		rx_start_usec = esp_timer_get_time();
 		if (spi_device_transmit(spi, &lep_spi_trans) == ESP_OK) {
+			rx_end_usec = esp_timer_get_time();
+			perf_count(PERF_CNT_RECEIVED);
+			perf_record(PERF_STAGE_RX, (uint32_t) (rx_end_usec - rx_start_usec));
+			
 			// Get the expected checksum from the data just read in (last four bytes)
 			exp_cs  = (uint32_t) (*(lep_spi_buffer.bufferP + lep_spi_buffer.length - 4) << 24);
 			exp_cs |= (uint32_t) (*(lep_spi_buffer.bufferP + lep_spi_buffer.length - 3) << 16);
@@ -421,73 +563,115 @@ static void process_image(cJSON* json_obj)
 
 			// Checksum
 			good_checksum = check_checksum(exp_cs);
+			if (!good_checksum) {
+				perf_count(PERF_CNT_DROP_CHECKSUM);
+			}
 #ifdef DEBUG_RSP
 			if (!good_checksum) {
 				ESP_LOGE(TAG, "bad checksum");
 			}
 #endif
 			
-			// Copy the json string to rsp_task and/or file_task if requested
-			 if (cmd_image_requested && good_checksum) {
-			 	if (xSemaphoreTake(lep_rsp_buffer[json_image_index].mutex, pdMS_TO_TICKS(LEP_TASK_MUTEX_WAIT_MSEC))) {
-			 		memcpy(lep_rsp_buffer[json_image_index].bufferP, lep_spi_buffer.bufferP, lep_spi_buffer.length - 4);
-			 		lep_rsp_buffer[json_image_index].length = lep_spi_buffer.length - 4;
-			 		xSemaphoreGive(lep_rsp_buffer[json_image_index].mutex);
-			 		mask = (json_image_index == 0) ? RSP_NOTIFY_LEP_FRAME_MASK_1 : RSP_NOTIFY_LEP_FRAME_MASK_2;
-			 		xTaskNotify(task_handle_rsp, mask, eSetBits);
-			 	}
-			} 
-			if (file_image_requested && good_checksum) {
-				if (xSemaphoreTake(lep_file_buffer[json_image_index].mutex, pdMS_TO_TICKS(LEP_TASK_MUTEX_WAIT_MSEC))) {
-			 		memcpy(lep_file_buffer[json_image_index].bufferP, lep_spi_buffer.bufferP, lep_spi_buffer.length - 4);
-			 		lep_file_buffer[json_image_index].length = lep_spi_buffer.length - 4;
-			 		xSemaphoreGive(lep_file_buffer[json_image_index].mutex);
-			 		mask = (json_image_index == 0) ? FILE_NOTIFY_LEP_FRAME_MASK_1 : FILE_NOTIFY_LEP_FRAME_MASK_2;
-			 		xTaskNotify(task_handle_file, mask, eSetBits);
-			 	}
+			// tCam-Mini sends binary image frames if it supports them
+			binary = json_is_image_frame(lep_spi_buffer.bufferP);
+			
+			// The record filter can only be applied to binary frames.  Recorded images are
+			// loaded separately when it runs, after the other consumers have the unfiltered
+			// image, since it modifies the frame in place.
+			record_filter = false;
+			if (file_image_requested && binary && good_checksum) {
+				if (filter_get_config(FILTER_CONSUMER_RECORD, &filter_config)) {
+					record_filter = filter_config.enable;
+				}
 			}
+			file_image_index = json_image_index;
+			
+			// Load the json string once into a shared buffer and hand references to rsp_task
+			// and/or file_task if requested.  Binary frames are converted to json strings
+			// only when necessary.
 			if ((cmd_image_requested || file_image_requested) && good_checksum) {
+				if (cmd_image_requested || !record_filter) {
+					imageP = load_shared_image(lep_spi_buffer.bufferP, lep_spi_buffer.length - 4, binary);
+					if (imageP != NULL) {
+						if (cmd_image_requested) {
+							if (xSemaphoreTake(lep_rsp_buffer[json_image_index].mutex, pdMS_TO_TICKS(LEP_TASK_MUTEX_WAIT_MSEC))) {
+								system_image_attach(&lep_rsp_buffer[json_image_index], imageP);
+								mask = (json_image_index == 0) ? RSP_NOTIFY_LEP_FRAME_MASK_1 : RSP_NOTIFY_LEP_FRAME_MASK_2;
+								xTaskNotify(task_handle_rsp, mask, eSetBits);
+								xSemaphoreGive(lep_rsp_buffer[json_image_index].mutex);
+							}
+						}
+						if (file_image_requested && !record_filter) {
+							attach_file_image(json_image_index, imageP);
+						}
+						
+						// The consumers hold their own references
+						system_image_release(imageP);
+					}
+				}
+				
 				// Flip ping-pong index
 				json_image_index = (json_image_index == 0) ? 1 : 0;
 			}
+			
+			// Hold the image for a possible alarm recording (not necessary while a
+			// recording is already running)
+			if ((alarm_record_mask != 0) && !file_image_requested && good_checksum) {
+				push_pretrig_frame(binary);
+			}
 #ifdef LOG_SEND_TIMESTAMP
 				te = esp_timer_get_time();
 				ESP_LOGI(TAG, "process took %d uSec", (int) (te - tb));
 #endif
 			
-			// Convert the json image string into a lepton image buffer for gui_task if requested
+			// Load the lepton image buffer for gui_task if requested, directly from a binary
+			// frame or by converting the json image string
 			if (gui_image_requested && good_checksum) {
 #ifdef LOG_SEND_TIMESTAMP
 				tb = esp_timer_get_time();
 #endif
 				mask = 0;
-				if (gui_image_index == 0) {
-					if (xSemaphoreTake(lep_gui_buffer[0].mutex, pdMS_TO_TICKS(LEP_TASK_MUTEX_WAIT_MSEC))) {
-						if (json_parse_image_string(lep_spi_buffer.bufferP, &lep_gui_buffer[0])) {
-							mask = GUI_NOTIFY_LEP_FRAME_MASK_1;
-						}
-						xSemaphoreGive(lep_gui_buffer[0].mutex);
+				parse_start_usec = esp_timer_get_time();
+				if (xSemaphoreTake(lep_gui_buffer[gui_image_index].mutex, pdMS_TO_TICKS(LEP_TASK_MUTEX_WAIT_MSEC))) {
+					if (lep_gui_buffer[gui_image_index].unread) {
+						// gui_task never displayed the image we're about to overwrite
+						lep_gui_buffer[gui_image_index].unread = false;
+						perf_count(PERF_CNT_DROP_STALE);
 					}
-					gui_image_index = 1;
-				} else {
-					if (xSemaphoreTake(lep_gui_buffer[1].mutex, pdMS_TO_TICKS(LEP_TASK_MUTEX_WAIT_MSEC))) {
-						if (json_parse_image_string(lep_spi_buffer.bufferP, &lep_gui_buffer[1])) {
-							mask = GUI_NOTIFY_LEP_FRAME_MASK_2;
+					if (binary) {
+						if (json_parse_image_frame(lep_spi_buffer.bufferP, lep_spi_buffer.length - 4, &lep_gui_buffer[gui_image_index])) {
+							mask = (gui_image_index == 0) ? GUI_NOTIFY_LEP_FRAME_MASK_1 : GUI_NOTIFY_LEP_FRAME_MASK_2;
+						}
+					} else {
+						if (json_parse_image_string(lep_spi_buffer.bufferP, &lep_gui_buffer[gui_image_index])) {
+							mask = (gui_image_index == 0) ? GUI_NOTIFY_LEP_FRAME_MASK_1 : GUI_NOTIFY_LEP_FRAME_MASK_2;
 						}
-						xSemaphoreGive(lep_gui_buffer[1].mutex);
 					}
-					gui_image_index = 0;
+					if (mask != 0) {
+						filter_display_image(&lep_gui_buffer[gui_image_index]);
+						account_gui_image(&lep_gui_buffer[gui_image_index], rx_end_usec);
+						perf_record(PERF_STAGE_PARSE, (uint32_t) (esp_timer_get_time() - parse_start_usec));
+					}
+					xSemaphoreGive(lep_gui_buffer[gui_image_index].mutex);
+				} else {
+					perf_count(PERF_CNT_DROP_BUSY);
 				}
+				gui_image_index = (gui_image_index == 0) ? 1 : 0;
 				if (mask != 0) {
 					xTaskNotify(task_handle_gui, mask, eSetBits);
 				}
 				
 #ifdef LOG_SEND_TIMESTAMP
 				te = esp_timer_get_time();
-				ESP_LOGI(TAG, "json_parse_image_string took %d uSec", (int) (te - tb));
+				ESP_LOGI(TAG, "gui image load took %d uSec", (int) (te - tb));
 #endif
 			}
 			
+			// Filter and load the recorded image last
+			if (record_filter) {
+				load_record_image(file_image_index);
+			}
+			
 #ifdef LOG_SPI_PASS_FAIL			
 			if (good_checksum) {
 				ESP_LOGI(TAG, "good");
@@ -504,6 +688,175 @@ static void process_image(cJSON* json_obj)
 }
 
 
+static bool init_pretrig()
+{
+	int i;
+	
+	pretrig_push_index = 0;
+	pretrig_count = 0;
+	
+	pretrig_mutex = xSemaphoreCreateMutex();
+	if (pretrig_mutex == NULL) {
+		return false;
+	}
+	
+	for (i=0; i<LEP_PRETRIG_FRAMES; i++) {
+		pretrig_buffer[i].length = 0;
+		pretrig_buffer[i].bufferP = heap_caps_malloc(JSON_MAX_IMAGE_TEXT_LEN, MALLOC_CAP_SPIRAM);
+		if (pretrig_buffer[i].bufferP == NULL) {
+			vSemaphoreDelete(pretrig_mutex);
+			pretrig_mutex = NULL;
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+
+/**
+ * Copy the image just read from tCam-Mini into the pre-trigger ring, overwriting the
+ * oldest image when full.  The image is skipped if file_task is saving the ring.
+ */
+static void push_pretrig_frame(bool binary)
+{
+	if (pretrig_mutex == NULL) return;
+	
+	if (xSemaphoreTake(pretrig_mutex, 0)) {
+		memcpy(pretrig_buffer[pretrig_push_index].bufferP, lep_spi_buffer.bufferP, lep_spi_buffer.length - 4);
+		pretrig_buffer[pretrig_push_index].length = lep_spi_buffer.length - 4;
+		pretrig_binary[pretrig_push_index] = binary;
+		if (++pretrig_push_index == LEP_PRETRIG_FRAMES) pretrig_push_index = 0;
+		if (pretrig_count < LEP_PRETRIG_FRAMES) pretrig_count++;
+		xSemaphoreGive(pretrig_mutex);
+	}
+}
+
+
+/**
+ * Apply the display temporal filter to a decoded image, updating the min/max values
+ * and their locations when it is enabled
+ */
+static void filter_display_image(lep_buffer_t* lep_buffer)
+{
+	int min_index, max_index;
+	
+	if (filter_apply(FILTER_CONSUMER_DISPLAY, lep_buffer->lep_bufferP, &min_index, &max_index)) {
+		lep_buffer->lep_min_val = lep_buffer->lep_bufferP[min_index];
+		lep_buffer->lep_min_x = min_index % LEP_WIDTH;
+		lep_buffer->lep_min_y = min_index / LEP_WIDTH;
+		lep_buffer->lep_max_val = lep_buffer->lep_bufferP[max_index];
+		lep_buffer->lep_max_x = max_index % LEP_WIDTH;
+		lep_buffer->lep_max_y = max_index / LEP_WIDTH;
+	}
+}
+
+
+/**
+ * Apply the record temporal filter in place to the binary frame in lep_spi_buffer and
+ * load it into a shared image for file_task.  Must be called after all other consumers
+ * have used the frame.
+ */
+static void load_record_image(int index)
+{
+	int min_index, max_index;
+	uint16_t* pixelP;
+	shared_image_t* imageP;
+	
+	pixelP = json_get_image_frame_pixels(lep_spi_buffer.bufferP, lep_spi_buffer.length - 4);
+	if (pixelP == NULL) return;
+	
+	// The json image is generated from the frame so the min/max values are not needed
+	(void) filter_apply(FILTER_CONSUMER_RECORD, pixelP, &min_index, &max_index);
+	
+	imageP = load_shared_image(lep_spi_buffer.bufferP, lep_spi_buffer.length - 4, true);
+	if (imageP != NULL) {
+		attach_file_image(index, imageP);
+		system_image_release(imageP);
+	}
+}
+
+
+/**
+ * Hand file_task a reference to a shared image in the specified half of lep_file_buffer
+ */
+static void attach_file_image(int index, shared_image_t* imageP)
+{
+	uint32_t mask;
+	
+	if (xSemaphoreTake(lep_file_buffer[index].mutex, pdMS_TO_TICKS(LEP_TASK_MUTEX_WAIT_MSEC))) {
+		system_image_attach(&lep_file_buffer[index], imageP);
+		mask = (index == 0) ? FILE_NOTIFY_LEP_FRAME_MASK_1 : FILE_NOTIFY_LEP_FRAME_MASK_2;
+		xTaskNotify(task_handle_file, mask, eSetBits);
+		xSemaphoreGive(lep_file_buffer[index].mutex);
+	}
+}
+
+
+/**
+ * Tag an image loaded for gui_task with its sequence number and receive time for
+ * display pipeline accounting
+ */
+static void account_gui_image(lep_buffer_t* lep_buffer, int64_t rx_usec)
+{
+	lep_buffer->seq = ((uint32_t) lep_buffer->lep_telemP[LEP_TEL_FC_HIGH] << 16) |
+	                  lep_buffer->lep_telemP[LEP_TEL_FC_LOW];
+	lep_buffer->rx_usec = rx_usec;
+	lep_buffer->unread = true;
+	
+	perf_sequence(lep_buffer->seq);
+	perf_count(PERF_CNT_PARSED);
+}
+
+
+/**
+ * Restart display pipeline accounting when gui_task starts displaying images again
+ * since images it did not display while on other screens are not drops
+ */
+static void reset_gui_accounting()
+{
+	int i;
+	
+	for (i=0; i<2; i++) {
+		xSemaphoreTake(lep_gui_buffer[i].mutex, portMAX_DELAY);
+		lep_gui_buffer[i].unread = false;
+		xSemaphoreGive(lep_gui_buffer[i].mutex);
+	}
+	perf_restart_sequence();
+}
+
+
+/**
+ * Load an image read from tCam-Mini into a shared json image string buffer, either
+ * directly or by generating the json string from a binary frame.  Returns the buffer
+ * with one reference held by the caller or NULL if it could not be loaded.
+ */
+static shared_image_t* load_shared_image(char* src, int len, bool binary)
+{
+	shared_image_t* imageP;
+	
+	imageP = system_image_alloc();
+	if (imageP == NULL) {
+		ESP_LOGE(TAG, "No free shared image buffer");
+		return NULL;
+	}
+	
+	if (binary) {
+		imageP->length = json_get_image_frame_string(imageP->bufferP, src, len);
+	} else {
+		memcpy(imageP->bufferP, src, len);
+		imageP->length = len;
+	}
+	
+	if (imageP->length == 0) {
+		system_image_release(imageP);
+		return NULL;
+	}
+	
+	return imageP;
+}
+
+
 static bool check_checksum(uint32_t exp_cs)
 {
 	char* ps;
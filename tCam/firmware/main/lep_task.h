@@ -26,7 +26,9 @@
 #ifndef LEP_TASK_H
 #define LEP_TASK_H
 
+#include <stdbool.h>
 #include <stdint.h>
+#include "sys_utilities.h"
 
 
 
@@ -45,6 +47,10 @@
 // buffer before giving up so we can service everyone else (they'll loose an image)
 #define LEP_TASK_MUTEX_WAIT_MSEC 10
 
+// Number of images held before an alarm triggered recording starts.  Images are
+// only held while tCam-Mini has an alarm rule with recording enabled.
+#define LEP_PRETRIG_FRAMES       8
+
 // LEP Task notifications
 #define LEP_NOTIFY_EN_RSP_FRAME_MASK   0x00000001
 #define LEP_NOTIFY_DIS_RSP_FRAME_MASK  0x00000002
@@ -61,5 +67,9 @@
 void lep_task();
 bool lep_available();
 char* lep_get_version();
+void lep_set_alarm_record(int rule, bool en);
+int lep_pretrig_lock();
+bool lep_pretrig_get_frame(int n, json_image_ref_t* dst);
+void lep_pretrig_unlock();
 
 #endif /* LEP_TASK_H */
\ No newline at end of file
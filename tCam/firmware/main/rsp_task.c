@@ -31,6 +31,7 @@
 #include "rsp_task.h"
 #include "file_utilities.h"
 #include "json_utilities.h"
+#include "perf_utilities.h"
 #include "sys_utilities.h"
 #include "upd_utilities.h"
 #include "system_config.h"
@@ -96,6 +97,13 @@ static uint32_t cur_stream_frame_num;
 static uint32_t stream_remaining_frames;        // Remaining frames to stream
 static int64_t stream_ready_usec;               // Next ESP32 uSec timestamp to send image
 
+// Periodic performance record control
+static uint32_t next_perf_push_msec;            // mSec between periodic perf records; 0 = off
+static bool next_perf_reset;
+static uint32_t perf_push_msec;
+static bool perf_push_reset;                    // Clear statistics after each periodic perf record
+static int64_t perf_push_usec;                  // Next ESP32 uSec timestamp to push a perf record
+
 // rsp_task initiated (non-image) json strings
 static SemaphoreHandle_t rsp_task_mutex;
 static char rsp_task_response_buffer[JSON_MAX_RSP_TEXT_LEN];
@@ -125,8 +133,9 @@ static void eval_stream_ready();
 static void handle_notifications();
 static void send_image(int n);
 static bool process_catalog();
+static bool process_catalog_page();
 static void push_response(char* buf, uint32_t len);
-static void send_response(char* rsp, int len);
+static bool send_response(char* rsp, int len);
 static bool cmd_response_available();
 static int get_cmd_response();
 static char pop_cmd_response_buffer();
@@ -165,6 +174,11 @@ void rsp_task()
 		if (cmd_connected()) {
 			connected = true;
 		} else if (connected) {
+			// Stop any file being sent to us so file_task doesn't wait for us forever
+			if (video_response_in_progress) {
+				xTaskNotify(task_handle_file, FILE_NOTIFY_CMD_END_VIDEO_MASK, eSetBits);
+			}
+			
 			// Clear our state since we are no longer connected
 			init_state();
 		}
@@ -244,6 +258,18 @@ void rsp_task()
 			}
 		}
 		
+		// Push a periodic perf record if requested
+		if (connected && (perf_push_msec != 0) && (esp_timer_get_time() >= perf_push_usec)) {
+			perf_push_usec = esp_timer_get_time() + (int64_t) perf_push_msec * 1000;
+			sys_response_rsp_buffer.length = json_get_perf(sys_response_rsp_buffer.bufferP);
+			if (sys_response_rsp_buffer.length != 0) {
+				push_response(sys_response_rsp_buffer.bufferP, sys_response_rsp_buffer.length);
+			}
+			if (perf_push_reset) {
+				perf_reset();
+			}
+		}
+		
 		if (cmd_response_available()) {
 			// Get the command response and send it if possible
 			len = get_cmd_response();
@@ -263,8 +289,10 @@ void rsp_task()
 		}
 #endif
 		
-		// Sleep task - less if we are streaming
-		if (stream_on) {
+		// Sleep task - less if we are streaming or sending a file
+		if (video_response_in_progress) {
+			vTaskDelay(pdMS_TO_TICKS(RSP_TASK_EVAL_XFER_MSEC));
+		} else if (stream_on) {
 			vTaskDelay(pdMS_TO_TICKS(RSP_TASK_EVAL_FAST_MSEC));
 		} else {
 			vTaskDelay(pdMS_TO_TICKS(RSP_TASK_EVAL_NORM_MSEC));
@@ -281,6 +309,17 @@ void rsp_set_stream_parameters(uint32_t delay_ms, uint32_t num_frames)
 }
 
 
+// Called before sending RSP_NOTIFY_CMD_PERF_MASK
+void rsp_set_perf_parameters(uint32_t push_msec, bool reset)
+{
+	if ((push_msec != 0) && (push_msec < RSP_PERF_MIN_PUSH_MSEC)) {
+		push_msec = RSP_PERF_MIN_PUSH_MSEC;
+	}
+	next_perf_push_msec = push_msec;
+	next_perf_reset = reset;
+}
+
+
 // Called before sending RSP_NOTIFY_CAM_INFO_MASK
 void rsp_set_cam_info_msg(uint32_t info_value, char* info_string)
 {
@@ -367,6 +406,7 @@ static void init_state()
 	got_image_0 = false;
 	got_image_1 = false;
 	got_file = false;
+	perf_push_msec = 0;
 	fw_update_state = FW_UPD_IDLE;
 	
 	// Create the mutex to protect firmware update percent value
@@ -455,6 +495,13 @@ static void handle_notifications()
 			stream_ready_usec = esp_timer_get_time();
 		}
 		
+		if (Notification(notification_value, RSP_NOTIFY_CMD_PERF_MASK)) {
+			// Setup periodic perf records (cmd_task sent the first one)
+			perf_push_msec = next_perf_push_msec;
+			perf_push_reset = next_perf_reset;
+			perf_push_usec = esp_timer_get_time() + (int64_t) perf_push_msec * 1000;
+		}
+		
 		if (Notification(notification_value, RSP_NOTIFY_CMD_STREAM_OFF_MASK)) {
 			// Stop images from lep_task
 			xTaskNotify(task_handle_lep, LEP_NOTIFY_DIS_RSP_FRAME_MASK, eSetBits);
@@ -473,6 +520,12 @@ static void handle_notifications()
 			}
 		}
 		
+		if (Notification(notification_value, RSP_NOTIFY_FILE_PAGE_READY_MASK)) {
+			if (!process_catalog_page()) {
+				rsp_set_cam_info_msg(RSP_INFO_CMD_NACK, "Failed to get filesystem page");
+			}
+		}
+		
 		if (Notification(notification_value, RSP_NOTIFY_FILE_IMG_READY_MASK)) {
 			got_file = true;
 		}
@@ -620,11 +673,17 @@ static void handle_notifications()
  */
 static void send_image(int n)
 {
+	int64_t send_start_usec;
+	
 	// Get access to the buffer
 	if (xSemaphoreTake(lep_rsp_buffer[n].mutex, portMAX_DELAY)) {
 		// Send the image
 		if (lep_rsp_buffer[n].length != 0) {
-			send_response(lep_rsp_buffer[n].bufferP, lep_rsp_buffer[n].length);
+			send_start_usec = esp_timer_get_time();
+			if (send_response(lep_rsp_buffer[n].bufferP, lep_rsp_buffer[n].length)) {
+				perf_count(PERF_CNT_SENT);
+				perf_record(PERF_STAGE_SEND, (uint32_t) (esp_timer_get_time() - send_start_usec));
+			}
 		}
 		
 		xSemaphoreGive(lep_rsp_buffer[n].mutex);
@@ -666,6 +725,31 @@ static bool process_catalog()
 }
 
 
+/**
+ * Convert a catalog page just created by file_task into a json record for delimiters and
+ * push it into our cmd_task_response_buffer
+ */
+static bool process_catalog_page()
+{
+	file_page_entry_t* entries;
+	int num;
+	int offset;
+	int total;
+	
+	entries = file_get_page_entries(&num, &offset, &total);
+	
+	// Create and push the json response
+	sys_response_rsp_buffer.length = json_get_filesystem_page_response(sys_response_rsp_buffer.bufferP, offset, total, num, entries);
+	file_release_page_entries();
+	if (sys_response_rsp_buffer.length != 0) {
+		push_response(sys_response_rsp_buffer.bufferP, sys_response_rsp_buffer.length);
+		return true;
+	} else {
+		return false;
+	}
+}
+
+
 /**
  * Push a response into the cmd_task_response_buffer if there is room, otherwise
  * just drop it (up to the external host to make sure this doesn't happen)
@@ -697,10 +781,11 @@ static void push_response(char* buf, uint32_t len)
 
 
 /**
- * Send a response
+ * Send a response.  Returns false if the socket write failed.
  */
-static void send_response(char* rsp, int rsp_length)
+static bool send_response(char* rsp, int rsp_length)
 {
+	bool success = true;
 	int byte_offset;
 	int err;
 	int len;
@@ -721,6 +806,7 @@ static void send_response(char* rsp, int rsp_length)
 		err = send(sock, rsp + byte_offset, len, 0);
 		if (err < 0) {
 			ESP_LOGE(TAG, "Error in socket send: errno %d", errno);
+			success = false;
 			break;
 		}
 		byte_offset += err;
@@ -730,6 +816,8 @@ static void send_response(char* rsp, int rsp_length)
 	te = esp_timer_get_time();
 	ESP_LOGI(TAG, "send_response took %d uSec", (int) (te - tb));
 #endif
+
+	return success;
 }
 
 
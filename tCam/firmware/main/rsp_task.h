@@ -45,10 +45,14 @@
 // Task evaluation interval
 #define RSP_TASK_EVAL_NORM_MSEC 50
 #define RSP_TASK_EVAL_FAST_MSEC 20
+#define RSP_TASK_EVAL_XFER_MSEC 10
 
 // Maximum send packet size (less than a MTU)
 #define RSP_MAX_TX_PKT_LEN 1280
 
+// Minimum interval between periodic perf records pushed to the host
+#define RSP_PERF_MIN_PUSH_MSEC 1000
+
 // Maximum cam_info string length
 #define RSP_MAX_CAM_INFO_LEN 128
 
@@ -65,6 +69,7 @@
 #define RSP_NOTIFY_CMD_GET_IMG_MASK         0x00000001
 #define RSP_NOTIFY_CMD_STREAM_ON_MASK       0x00000002
 #define RSP_NOTIFY_CMD_STREAM_OFF_MASK      0x00000004
+#define RSP_NOTIFY_CMD_PERF_MASK            0x00000008
 #define RSP_NOTIFY_LEP_FRAME_MASK_1         0x00000100
 #define RSP_NOTIFY_LEP_FRAME_MASK_2         0x00000200
 #define RSP_NOTIFY_FILE_CATALOG_READY_MASK  0x00001000
@@ -75,6 +80,7 @@
 #define RSP_NOTIFY_FW_UPD_SEG_MASK          0x00020000
 #define RSP_NOTIFY_FW_UPD_EN_MASK           0x00040000
 #define RSP_NOTIFY_FW_UPD_END_MASK          0x00080000
+#define RSP_NOTIFY_FILE_PAGE_READY_MASK     0x00100000
 #define RSP_NOTIFY_SCREEN_DUMP_START_MASK   0x40000000
 #define RSP_NOTIFY_SCREEN_DUMP_AVAIL_MASK   0x80000000
 
@@ -85,6 +91,7 @@
 //
 void rsp_task();
 void rsp_set_stream_parameters(uint32_t delay_ms, uint32_t num_frames);
+void rsp_set_perf_parameters(uint32_t push_msec, bool reset);
 void rsp_set_cam_info_msg(uint32_t info_value, char* info_string);
 void rsp_set_fw_upd_req_info(uint32_t length, char* version);
 void rsp_set_fw_upd_seg_info(uint32_t start, uint32_t length);
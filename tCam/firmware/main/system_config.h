@@ -121,8 +121,15 @@
 //#define SYS_SCREENDUMP_ENABLE
 
 
-// Little VGL buffer update size
-#define LVGL_DISP_BUF_SIZE (480 * 10)
+// Comment out to draw the live Lepton image through LVGL instead of writing it
+// directly to its area of the display
+#define GUI_DIRECT_LEP_IMG_ENABLE
+
+
+// Little VGL buffer update size (pixels).  Sized so the 320 pixel wide Lepton image
+// region is flushed in 8 DMA transfers of 30 lines each (full width areas in 20 lines).
+#define LVGL_DISP_BUF_LINES 30
+#define LVGL_DISP_BUF_SIZE  (LEP_IMG_WIDTH * LVGL_DISP_BUF_LINES)
 
 // Theme hue (0-360)
 #define GUI_THEME_HUE       240
@@ -143,6 +150,13 @@
 // Manually calculate this and round to 4-byte boundary
 #define JSON_MAX_IMAGE_TEXT_LEN (1024 * 53)
 
+// Number of reference counted image json string buffers shared by rsp_task and file_task.
+// Each of the four lep_rsp_buffer and lep_file_buffer slots holds at most one reference
+// and lep_task holds one while loading the next image.  lep_pretrig_get_frame (called by
+// file_task) empties its lep_file_buffer slot before loading a pre-trigger image so the
+// two loads together never need more than one buffer beyond the slots.
+#define SYS_SHARED_IMAGE_BUFFERS 5
+
 // Maximum firmware update chunk request size
 #define FW_UPD_CHUNK_MAX_LEN    (1024 * 8)
 
@@ -178,14 +192,18 @@
 #define SIF_TX_BUFFER_SIZE JSON_MAX_RSP_TEXT_LEN
 
 // Filesystem Information Structure buffer (catalog)
-//   Holds records for directories (~36 bytes/each) and files in those directories
-//   (~32 bytes/each).  This buffer should be sized larger than the most files and
+//   Holds records for directories (~44 bytes/each) and files in those directories
+//   (~44 bytes/each).  This buffer should be sized larger than the most files and
 //   directories ever expected to be seen by the system.
 #define FILE_INFO_BUFFER_LEN (1024 * 512) 
 
 // Maximum number of names stored in a comma separated catalog listing
 #define FILE_MAX_CATALOG_NAMES 150
 
+// Maximum number of files returned in a filesystem_page response (each entry takes
+// up to ~85 bytes and the response must fit in JSON_MAX_RSP_TEXT_LEN)
+#define FILE_MAX_PAGE_ENTRIES 20
+
 // Fixed Speed Video playback interval - also used to determine when a video should
 // be played back at a fixed rate on the GUI.
 #define VIDEO_FIXED_PLAYBACK_MSEC 1000